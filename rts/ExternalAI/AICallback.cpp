@@ -1048,11 +1048,13 @@ const unsigned short* CAICallback::GetLosMap()
 
 const unsigned short* CAICallback::GetRadarMap()
 {
+	radarhandler->UpdateSimThread();
 	return &radarhandler->radarMaps[teamHandler->AllyTeam(team)].front();
 }
 
 const unsigned short* CAICallback::GetJammerMap()
 {
+	radarhandler->UpdateSimThread();
 	return &radarhandler->jammerMaps[teamHandler->AllyTeam(team)].front();
 }
 
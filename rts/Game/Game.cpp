@@ -7,6 +7,7 @@
 #include <cctype>
 #include <locale>
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
 
 #include <boost/thread/thread.hpp>
@@ -147,6 +148,7 @@
 #include "System/FileSystem/VFSHandler.h"
 #include "System/FileSystem/SimpleParser.h"
 #include "System/LoadSave/LoadSaveHandler.h"
+#include "System/LoadSave/CregLoadSaveHandler.h"
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/Log/ILog.h"
 #include "System/Net/PackPacket.h"
@@ -179,6 +181,7 @@ CONFIG(int, ShowPlayerInfo).defaultValue(1);
 CONFIG(float, GuiOpacity).defaultValue(0.8f);
 CONFIG(std::string, InputTextGeo).defaultValue("");
 CONFIG(bool, LuaModUICtrl).defaultValue(true);
+CONFIG(int, GameStateSnapshotInterval).defaultValue(0).minimumValue(0).description("Seconds between the snapshots of the game-state the host hands to players joining mid-game, which then only need to catch up from the latest one. The game pauses on the host while saving one. Only works when the host also runs the server (not with a dedicated one), and not in games with LuaRules or LuaGaia, whose state is not part of a snapshot. 0 disables them.");
 
 
 CGame* game = NULL;
@@ -270,6 +273,7 @@ CGame::CGame(const std::string& mapName, const std::string& modName, ILoadSaveHa
 	, speedControl(-1)
 	, luaLockTime(0)
 	, luaExportSize(0)
+	, gameStateInterval(0)
 	, saveFile(saveFile)
 	, infoConsole(NULL)
 	, consoleHistory(NULL)
@@ -308,6 +312,7 @@ CGame::CGame(const std::string& mapName, const std::string& modName, ILoadSaveHa
 	mtInfoCtrl = 0;
 
 	speedControl = configHandler->GetInt("SpeedControl");
+	gameStateInterval = configHandler->GetInt("GameStateSnapshotInterval") * GAME_SPEED;
 
 	playerRoster.SetSortTypeByCode((PlayerRoster::SortType)configHandler->GetInt("ShowPlayerInfo"));
 
@@ -1522,6 +1527,7 @@ void CGame::SimFrame() {
 	GUnitScriptEngine.Tick(33);
 	wind.Update();
 	loshandler->Update();
+	radarhandler->Update();
 	interceptHandler.Update(false);
 
 	teamHandler->GameFrame(gs->frameNum);
@@ -1544,6 +1550,12 @@ void CGame::SimFrame() {
 	#endif
 
 	DumpState(-1, -1, 1);
+
+	// the server only takes snapshots from its local player, so a dedicated
+	// server never gets any; saving one holds up this frame on the host
+	if (gameServer != NULL && gameStateInterval > 0 && (gs->frameNum % gameStateInterval) == 0)
+		SendGameState();
+
 	LEAVE_SYNCED_CODE();
 }
 
@@ -2344,6 +2356,37 @@ void CGame::SaveGame(const std::string& filename, bool overwrite)
 }
 
 
+void CGame::SendGameState()
+{
+	if (luaRules != NULL || luaGaia != NULL) {
+		// joiners would start without the synced Lua state and desync
+		LOG_L(L_WARNING, "[%s] game-state snapshots are not supported with LuaRules or LuaGaia, disabled", __FUNCTION__);
+		gameStateInterval = 0;
+		return;
+	}
+
+	SCOPED_TIMER("Game::SendGameState");
+
+	CCregLoadSaveHandler ls;
+	ls.mapName = gameSetup->mapName;
+	ls.modName = gameSetup->modName;
+
+	std::ostringstream state(std::ios::out | std::ios::binary);
+
+	if (!ls.SaveGame(state, false))
+		return;
+
+	const std::string& data = state.str();
+	// leave room for the message header within the 64KB limit
+	const unsigned int partSize = 1 << 15;
+
+	for (unsigned int pos = 0; pos < data.size(); pos += partSize) {
+		const unsigned int length = std::min(partSize, unsigned(data.size()) - pos);
+		net->Send(CBaseNetProtocol::Get().SendGameState(gs->frameNum, data.size(), reinterpret_cast<const boost::uint8_t*>(data.data() + pos), length));
+	}
+}
+
+
 void CGame::ReloadGame()
 {
 	if (saveFile) {
@@ -96,6 +96,8 @@ public:
 
 	void ReloadGame();
 	void SaveGame(const std::string& filename, bool overwrite);
+	/// send a snapshot of the game-state to the server, for players joining mid-game (disables them in games with LuaRules or LuaGaia)
+	void SendGameState();
 	void DumpState(int newMinFrameNum, int newMaxFrameNum, int newFramePeriod);
 
 	void ResizeEvent();
@@ -216,6 +218,8 @@ public:
 	int speedControl;
 	int luaLockTime;
 	int luaExportSize;
+	/// frames between game-state snapshots we send as the host, 0 for none
+	int gameStateInterval;
 
 	/// for reloading the savefile
 	ILoadSaveHandler* saveFile;
@@ -50,7 +50,7 @@
 CGameHelper* helper;
 
 
-CGameHelper::CGameHelper()
+CGameHelper::CGameHelper(): batchExplosions(false)
 {
 	stdExplosionGenerator = new CStdExplosionGenerator();
 }
@@ -182,7 +182,93 @@ void CGameHelper::DoExplosionDamage(
 
 
 
+CGameHelper::QueuedExplosion::QueuedExplosion(const ExplosionParams& params)
+	: pos(params.pos)
+	, dir(params.dir)
+	, damages(params.damages)
+	, weaponDef(params.weaponDef)
+	, owner(params.owner)
+	, hitUnit(params.hitUnit)
+	, hitFeature(params.hitFeature)
+	, craterAreaOfEffect(params.craterAreaOfEffect)
+	, damageAreaOfEffect(params.damageAreaOfEffect)
+	, edgeEffectiveness(params.edgeEffectiveness)
+	, explosionSpeed(params.explosionSpeed)
+	, gfxMod(params.gfxMod)
+	, impactOnly(params.impactOnly)
+	, ignoreOwner(params.ignoreOwner)
+	, damageGround(params.damageGround)
+	, projectileID(params.projectileID)
+{
+}
+
+CGameHelper::ExplosionParams CGameHelper::QueuedExplosion::GetParams() const {
+	const ExplosionParams params = {
+		pos,
+		dir,
+		damages,
+		weaponDef,
+		owner,
+		hitUnit,
+		hitFeature,
+		craterAreaOfEffect,
+		damageAreaOfEffect,
+		edgeEffectiveness,
+		explosionSpeed,
+		gfxMod,
+		impactOnly,
+		ignoreOwner,
+		damageGround,
+		projectileID
+	};
+
+	return params;
+}
+
+
 void CGameHelper::Explosion(const ExplosionParams& params) {
+	if (batchExplosions) {
+		// the caller's pos, dir and damages may not outlive this call
+		queuedExplosions.push_back(QueuedExplosion(params));
+	} else {
+		DoExplosion(params, NULL, NULL);
+	}
+}
+
+void CGameHelper::ResolveExplosions() {
+	batchExplosions = false;
+
+	if (queuedExplosions.empty())
+		return;
+
+	explosionBatch.swap(queuedExplosions);
+	explosionSpheres.clear();
+
+	for (size_t n = 0; n < explosionBatch.size(); ++n) {
+		if (!explosionBatch[n].impactOnly) {
+			explosionSpheres.push_back(float4(explosionBatch[n].pos, std::max(1.0f, explosionBatch[n].damageAreaOfEffect)));
+		}
+	}
+
+	quadField->GetUnitsAndFeaturesExact(explosionSpheres, explosionUnits, explosionFeatures);
+
+	// explosionBatch is not touched until the loop ends, explosions set off
+	// by these take effect immediately (batchExplosions is false again)
+	for (size_t n = 0, sphereIdx = 0; n < explosionBatch.size(); ++n) {
+		const ExplosionParams params = explosionBatch[n].GetParams();
+
+		if (params.impactOnly) {
+			DoExplosion(params, NULL, NULL);
+		} else {
+			DoExplosion(params, &explosionUnits[sphereIdx], &explosionFeatures[sphereIdx]);
+			++sphereIdx;
+		}
+	}
+
+	explosionBatch.clear();
+}
+
+void CGameHelper::DoExplosion(const ExplosionParams& params, const std::vector<CUnit*>* units, const std::vector<CFeature*>* features) {
 	const float3& dir = params.dir;
 	const float3 expPos = params.pos;
 	const DamageArray& damages = params.damages;
@@ -225,10 +311,15 @@ void CGameHelper::Explosion(const ExplosionParams& params) {
 	} else {
 		{
 			// damage all units within the explosion radius
-			const vector<CUnit*>& units = quadField->GetUnitsExact(expPos, damageAOE);
+			vector<CUnit*> expUnits;
 			bool hitUnitDamaged = false;
 
-			for (vector<CUnit*>::const_iterator ui = units.begin(); ui != units.end(); ++ui) {
+			if (units == NULL) {
+				quadField->GetUnitsExact(expUnits, expPos, damageAOE);
+				units = &expUnits;
+			}
+
+			for (vector<CUnit*>::const_iterator ui = units->begin(); ui != units->end(); ++ui) {
 				CUnit* unit = *ui;
 
 				if (unit == hitUnit) {
@@ -248,10 +339,15 @@ void CGameHelper::Explosion(const ExplosionParams& params) {
 
 		{
 			// damage all features within the explosion radius
-			const vector<CFeature*>& features = quadField->GetFeaturesExact(expPos, damageAOE);
+			vector<CFeature*> expFeatures;
 			bool hitFeatureDamaged = false;
 
-			for (vector<CFeature*>::const_iterator fi = features.begin(); fi != features.end(); ++fi) {
+			if (features == NULL) {
+				quadField->GetFeaturesExact(expFeatures, expPos, damageAOE);
+				features = &expFeatures;
+			}
+
+			for (vector<CFeature*>::const_iterator fi = features->begin(); fi != features->end(); ++fi) {
 				CFeature* feature = *fi;
 
 				if (feature == hitFeature) {
@@ -347,8 +443,8 @@ static inline void QueryUnits(TFilter filter, TQuery& query)
 			if (!filter.Team(t)) {
 				continue;
 			}
-			std::list<CUnit*>::const_iterator ui;
-			const std::list<CUnit*>& allyTeamUnits = quad.teamUnits[t];
+			std::vector<CUnit*>::const_iterator ui;
+			const std::vector<CUnit*>& allyTeamUnits = quad.teamUnits[t];
 			for (ui = allyTeamUnits.begin(); ui != allyTeamUnits.end(); ++ui) {
 				if ((*ui)->tempNum != tempNum) {
 					(*ui)->tempNum = tempNum;
@@ -611,12 +707,7 @@ namespace {
 	}; // end of namespace Query
 }; // end of namespace
 
-// Use this instead of unit->tempNum here, because it requires a mutex lock that will deadlock if luaRules is invoked simultaneously.
-// Not the cleanest solution, but faster than e.g. a std::set, and this function is called quite frequently.
-static int tempTargetUnits[MAX_UNITS] = {0};
-static int targetTempNum = 2;
-
-void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::multimap<float, CUnit*>& targets)
+void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::vector<WeaponTarget>& targets)
 {
 	const CUnit* attacker = weapon->owner;
 	const float radius    = weapon->range;
@@ -630,118 +721,104 @@ void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* last
 	const float secDamage = weaponDef->damages.GetDefaultDamage() * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
 	const bool paralyzer  = (weaponDef->damages.paralyzeDamageTime != 0);
 
-	const std::vector<int>& quads = quadField->GetQuads(pos, radius + (aHeight - std::max(0.f, readmap->initMinHeight)) * heightMod);
+	// shared with the previous weapon if it covered the same quads
+	const std::vector<CUnit*>& units = quadField->GetEnemyUnitsInQuads(pos, radius + (aHeight - std::max(0.f, readmap->initMinHeight)) * heightMod, attacker->allyteam);
 
-	const int tempNum = targetTempNum++;
+	targets.clear();
 
-	typedef std::vector<int>::const_iterator VectorIt;
-	typedef std::list<CUnit*>::const_iterator ListIt;
+	for (std::vector<CUnit*>::const_iterator ui = units.begin(); ui != units.end(); ++ui) {
+		CUnit* targetUnit = *ui;
+		float targetPriority = 1.0f;
 
-	for (VectorIt qi = quads.begin(); qi != quads.end(); ++qi) {
-		for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
-			if (teamHandler->Ally(attacker->allyteam, t)) {
+		if (!(targetUnit->category & weapon->onlyTargetCategory)) {
+			continue;
+		}
+		if (targetUnit->GetTransporter() != NULL) {
+			if (!modInfo.targetableTransportedUnits)
 				continue;
-			}
-
-			const std::list<CUnit*>& allyTeamUnits = quadField->GetQuad(*qi).teamUnits[t];
-
-			for (ListIt ui = allyTeamUnits.begin(); ui != allyTeamUnits.end(); ++ui) {
-				CUnit* targetUnit = *ui;
-				float targetPriority = 1.0f;
-
-				if (!(targetUnit->category & weapon->onlyTargetCategory)) {
-					continue;
-				}
-				if (targetUnit->GetTransporter() != NULL) {
-					if (!modInfo.targetableTransportedUnits)
-						continue;
-					// the transportee might be "hidden" below terrain, in which case we can't target it
-					if (targetUnit->pos.y < ground->GetHeightReal(targetUnit->pos.x, targetUnit->pos.z))
-						continue;
-				}
-				if (tempTargetUnits[targetUnit->id] == tempNum) {
-					continue;
-				}
-
-				tempTargetUnits[targetUnit->id] = tempNum;
-
-				if (targetUnit->isUnderWater && !weaponDef->waterweapon) {
-					continue;
-				}
-				if (targetUnit->isDead) {
-					continue;
-				}
+			// the transportee might be "hidden" below terrain, in which case we can't target it
+			if (targetUnit->pos.y < ground->GetHeightReal(targetUnit->pos.x, targetUnit->pos.z))
+				continue;
+		}
 
-				float3 targPos;
-				const unsigned short targetLOSState = targetUnit->losStatus[attacker->allyteam];
+		if (targetUnit->isUnderWater && !weaponDef->waterweapon) {
+			continue;
+		}
+		if (targetUnit->isDead) {
+			continue;
+		}
 
-				if (targetLOSState & LOS_INLOS) {
-					targPos = targetUnit->aimPos;
-				} else if (targetLOSState & LOS_INRADAR) {
-					targPos = targetUnit->aimPos + (targetUnit->posErrorVector * radarhandler->radarErrorSize[attacker->allyteam]);
-					targetPriority *= 10.0f;
-				} else {
-					continue;
-				}
+		float3 targPos;
+		const unsigned short targetLOSState = targetUnit->losStatus[attacker->allyteam];
 
-				const float modRange = radius + (aHeight - targPos.y) * heightMod;
+		if (targetLOSState & LOS_INLOS) {
+			targPos = targetUnit->aimPos;
+		} else if (targetLOSState & LOS_INRADAR) {
+			targPos = targetUnit->aimPos + (targetUnit->posErrorVector * radarhandler->radarErrorSize[attacker->allyteam]);
+			targetPriority *= 10.0f;
+		} else {
+			continue;
+		}
 
-				if ((pos - targPos).SqLength2D() > modRange * modRange) {
-					continue;
-				}
+		const float modRange = radius + (aHeight - targPos.y) * heightMod;
 
-				const float dist2D = (pos - targPos).Length2D();
-				const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-				const float damageMul = weaponDef->damages[targetUnit->armorType] * targetUnit->curArmorMultiple;
+		if ((pos - targPos).SqLength2D() > modRange * modRange) {
+			continue;
+		}
 
-				targetPriority *= rangeMul;
+		const float dist2D = (pos - targPos).Length2D();
+		const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
+		const float damageMul = weaponDef->damages[targetUnit->armorType] * targetUnit->curArmorMultiple;
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPriority *= (secDamage + targetUnit->health);
+		targetPriority *= rangeMul;
 
-					if (targetUnit == lastTargetUnit) {
-						targetPriority *= weapon->avoidTarget ? 10.0f : 0.4f;
-					}
+		if (targetLOSState & LOS_INLOS) {
+			targetPriority *= (secDamage + targetUnit->health);
 
-					if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health)) {
-						targetPriority *= 4.0f;
-					}
+			if (targetUnit == lastTargetUnit) {
+				targetPriority *= weapon->avoidTarget ? 10.0f : 0.4f;
+			}
 
-					if (weapon->hasTargetWeight) {
-						targetPriority *= weapon->TargetWeight(targetUnit);
-					}
-				} else {
-					targetPriority *= (secDamage + 10000.0f);
-				}
+			if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health)) {
+				targetPriority *= 4.0f;
+			}
 
-				if (targetLOSState & LOS_PREVLOS) {
-					targetPriority /= (damageMul * targetUnit->power * (0.7f + gs->randFloat() * 0.6f));
+			if (weapon->hasTargetWeight) {
+				targetPriority *= weapon->TargetWeight(targetUnit);
+			}
+		} else {
+			targetPriority *= (secDamage + 10000.0f);
+		}
 
-					if (targetUnit->category & weapon->badTargetCategory) {
-						targetPriority *= 100.0f;
-					}
-					if (targetUnit->IsCrashing()) {
-						targetPriority *= 1000.0f;
-					}
-				}
+		if (targetLOSState & LOS_PREVLOS) {
+			targetPriority /= (damageMul * targetUnit->power * (0.7f + gs->randFloat() * 0.6f));
 
-				if (luaRules != NULL) {
-					if (!luaRules->AllowWeaponTarget(attacker->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority)) {
-						continue;
-					}
-				}
+			if (targetUnit->category & weapon->badTargetCategory) {
+				targetPriority *= 100.0f;
+			}
+			if (targetUnit->IsCrashing()) {
+				targetPriority *= 1000.0f;
+			}
+		}
 
-				targets.insert(std::pair<float, CUnit*>(targetPriority, targetUnit));
+		if (luaRules != NULL) {
+			if (!luaRules->AllowWeaponTarget(attacker->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority)) {
+				continue;
 			}
 		}
+
+		targets.push_back(WeaponTarget(targetPriority, targets.size(), targetUnit));
 	}
 
 #ifdef TRACE_SYNC
 	{
 		tracefile << "[GenerateWeaponTargets] attackerID, attackRadius: " << attacker->id << ", " << radius << " ";
 
-		for (std::multimap<float, CUnit*>::const_iterator ti = targets.begin(); ti != targets.end(); ++ti)
-			tracefile << "\tpriority: " << (ti->first) <<  ", targetID: " << (ti->second)->id <<  " ";
+		std::vector<WeaponTarget> sortedTargets(targets);
+		std::sort(sortedTargets.begin(), sortedTargets.end());
+
+		for (std::vector<WeaponTarget>::const_iterator ti = sortedTargets.begin(); ti != sortedTargets.end(); ++ti)
+			tracefile << "\tpriority: " << (ti->priority) <<  ", targetID: " << (ti->unit)->id <<  " ";
 
 		tracefile << "\n";
 	}
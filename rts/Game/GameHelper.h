@@ -7,6 +7,7 @@
 #include "Sim/Projectiles/ExplosionListener.h"
 #include "Sim/Units/CommandAI/Command.h"
 #include "System/float3.h"
+#include "System/float4.h"
 #include "System/MemPool.h"
 
 #include <list>
@@ -63,6 +64,26 @@ public:
 		unsigned int projectileID;
 	};
 
+	/// an auto-targeting candidate, see GenerateWeaponTargets
+	struct WeaponTarget {
+		WeaponTarget(float priority, unsigned int index, CUnit* unit)
+			: priority(priority), index(index), unit(unit) {}
+
+		/// ordered by priority, equal ones in the order they were found
+		/// (which is how a std::multimap would order them)
+		bool operator < (const WeaponTarget& t) const {
+			if (priority != t.priority)
+				return (priority < t.priority);
+
+			return (index < t.index);
+		}
+
+		/// lower is better
+		float priority;
+		unsigned int index;
+		CUnit* unit;
+	};
+
 	CGameHelper();
 	~CGameHelper();
 
@@ -110,7 +131,12 @@ public:
 	 */
 	static float3 ClosestBuildSite(int team, const UnitDef* unitDef, float3 pos, float searchRadius, int minDist, int facing = 0);
 
-	static void GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::multimap<float, CUnit*>& targets);
+	/**
+	 * Collects the units <weapon> could auto-target into <targets>, unsorted
+	 * and without duplicates. <targets> is cleared first, callers should
+	 * reuse it to save the allocations.
+	 */
+	static void GenerateWeaponTargets(const CWeapon* weapon, const CUnit* lastTargetUnit, std::vector<WeaponTarget>& targets);
 
 	void Update();
 
@@ -136,11 +162,70 @@ public:
 		const int projectileID
 	);
 
+	/**
+	 * Lets an explosion take effect right away, or queues it for the next
+	 * ResolveExplosions if called between BeginExplosionBatch and that.
+	 */
 	void Explosion(const ExplosionParams& params);
+	/**
+	 * Queues the explosions of the following Explosion calls (used while
+	 * CProjectileHandler checks projectile collisions).
+	 */
+	void BeginExplosionBatch() { batchExplosions = true; }
+	/**
+	 * Lets all queued explosions take effect, one after the other in the
+	 * order they were queued. Explosions set off by them (eg. by killing
+	 * units) take effect immediately, as outside of a batch.
+	 *
+	 * The units and features each one damages are found for the whole
+	 * batch at once, before any of them takes effect, so the batch does
+	 * not affect objects created or moved by its own explosions.
+	 */
+	void ResolveExplosions();
+
+private:
+	/// an ExplosionParams that owns what the former only references
+	struct QueuedExplosion {
+		QueuedExplosion(const ExplosionParams& params);
+
+		ExplosionParams GetParams() const;
+
+		float3 pos;
+		float3 dir;
+		DamageArray damages;
+		const WeaponDef* weaponDef;
+
+		CUnit* owner;
+		CUnit* hitUnit;
+		CFeature* hitFeature;
+
+		float craterAreaOfEffect;
+		float damageAreaOfEffect;
+		float edgeEffectiveness;
+		float explosionSpeed;
+		float gfxMod;
+
+		bool impactOnly;
+		bool ignoreOwner;
+		bool damageGround;
+
+		unsigned int projectileID;
+	};
+
+	/// units and features are queried at the explosion if NULL
+	void DoExplosion(const ExplosionParams& params, const std::vector<CUnit*>* units, const std::vector<CFeature*>* features);
 
 private:
 	CStdExplosionGenerator* stdExplosionGenerator;
 
+	bool batchExplosions;
+	std::vector<QueuedExplosion> queuedExplosions;
+	/// buffers for ResolveExplosions, kept to reuse their storage
+	std::vector<QueuedExplosion> explosionBatch;
+	std::vector<float4> explosionSpheres;
+	std::vector< std::vector<CUnit*> > explosionUnits;
+	std::vector< std::vector<CFeature*> > explosionFeatures;
+
 	struct WaitingDamage {
 #if !defined(SYNCIFY)
 		inline void* operator new(size_t size) {
@@ -69,7 +69,6 @@
 
 
 #define ALLOW_DEMO_GODMODE
-#define PKTCACHE_VECSIZE 1000
 
 using netcode::RawPacket;
 
@@ -78,6 +77,7 @@ CONFIG(bool, BypassScriptPasswordCheck).defaultValue(false);
 CONFIG(bool, WhiteListAdditionalPlayers).defaultValue(true);
 CONFIG(std::string, AutohostIP).defaultValue("127.0.0.1");
 CONFIG(int, AutohostPort).defaultValue(0);
+CONFIG(int, PacketCacheSize).defaultValue(0).minimumValue(0).description("Megabytes of in-game packets (kept for players joining or rejoining mid-game) after which the server logs a warning. Packets are only released once a game-state snapshot covers them (see GameStateSnapshotInterval). 0 never warns.");
 
 /// frames until a syncchech will time out and a warning is given out
 const unsigned SYNCCHECK_TIMEOUT = 300;
@@ -133,6 +133,8 @@ CGameServer::CGameServer(const std::string& hostIP, int hostPort, const GameData
 	syncErrorFrame = 0;
 	syncWarningFrame = 0;
 	serverFrameNum = 0;
+	gameStateFrame = -1;
+	gameStateBytes = 0;
 	timeLeft = 0;
 	modGameTime = 0.0f;
 	gameTime = 0.0f;
@@ -161,6 +163,7 @@ CGameServer::CGameServer(const std::string& hostIP, int hostPort, const GameData
 
 	bypassScriptPasswordCheck = configHandler->GetBool("BypassScriptPasswordCheck");
 	whiteListAdditionalPlayers = configHandler->GetBool("WhiteListAdditionalPlayers");
+	packetCache.SetWarnSize(configHandler->GetInt("PacketCacheSize") << 20);
 
 	if (!setup->onlyLocal) {
 		UDPNet.reset(new netcode::UDPListener(hostPort, hostIP));
@@ -347,6 +350,10 @@ void CGameServer::SkipTo(int targetFrameNum)
 	//
 	// note that we must maintain <modGameTime> ourselves
 	// since we do we NOT go through ::Update when skipping
+	//
+	// the demo's key-frame index (CDemoReader::GetKeyFrame) is of no
+	// use here: clients have to simulate every skipped frame, and demos
+	// hold no sim-state snapshots they could resume from instead
 	while (SendDemoData(targetFrameNum)) {
 		gameTime = GetDemoTime();
 		modGameTime = demoReader->GetModGameTime() + 0.001f;
@@ -568,7 +575,7 @@ void CGameServer::Broadcast(boost::shared_ptr<const netcode::RawPacket> packet)
 	for (size_t p = 0; p < players.size(); ++p)
 		players[p].SendData(packet);
 	if (canReconnect || bypassScriptPasswordCheck || !gameHasStarted)
-		AddToPacketCache(packet);
+		packetCache.Add(packet);
 #ifdef DEDICATED
 	if (demoRecorder)
 		demoRecorder->SaveToDemo(packet->data, packet->length, GetDemoTime());
@@ -821,6 +828,10 @@ void CGameServer::Update()
 			quitServer = true;
 		}
 	}
+
+	// send what this update broadcast now (in one batch), not with the next UDPNet->Update
+	if (UDPNet)
+		UDPNet->FlushConnections();
 }
 
 
@@ -1239,6 +1250,42 @@ void CGameServer::ProcessPacket(const unsigned playerNum, boost::shared_ptr<cons
 			}
 		} break;
 
+		case NETMSG_GAMESTATE: {
+			// only the host's state is trusted to hand out to others
+			if (!players[a].isLocal || demoReader)
+				break;
+
+			try {
+				netcode::UnpackPacket pckt(packet, 3);
+				int frameNum;
+				unsigned int stateSize;
+				pckt >> frameNum;
+				pckt >> stateSize;
+
+				if (frameNum != gameStateFrame) {
+					gameStateParts.clear();
+					gameStateFrame = frameNum;
+					gameStateBytes = 0;
+				}
+
+				gameStateParts.push_back(packet);
+				gameStateBytes += (packet->length - 11);
+
+				if (gameStateBytes < stateSize)
+					break;
+
+				if (gameStateBytes == stateSize && packetCache.SetSnapshot(gameStateFrame, gameStateParts)) {
+					LOG_L(L_DEBUG, "[%s] game-state snapshot of frame %d (%u bytes), packet cache now %u bytes", __FUNCTION__, gameStateFrame, stateSize, packetCache.GetSize());
+				}
+
+				gameStateParts.clear();
+				gameStateFrame = -1;
+				gameStateBytes = 0;
+			} catch (const netcode::UnpackPacketException& ex) {
+				Message(str(format("Player %s sent invalid GameState: %s") %players[a].name %ex.what()));
+			}
+		} break;
+
 
 		case NETMSG_SYNCRESPONSE: {
 #ifdef SYNCCHECK
@@ -1825,7 +1872,7 @@ void CGameServer::ServerReadNet()
 				if (!packet)
 					break;
 
-				bool droppablePacket = (packet->length <= 0 || (packet->data[0] != NETMSG_SYNCRESPONSE && packet->data[0] != NETMSG_KEYFRAME));
+				bool droppablePacket = (packet->length <= 0 || (packet->data[0] != NETMSG_SYNCRESPONSE && packet->data[0] != NETMSG_KEYFRAME && packet->data[0] != NETMSG_GAMESTATE));
 				if (dropPacket && droppablePacket)
 					++numDropped;
 				else if (!bwLimitIsReached || !droppablePacket) {
@@ -1951,7 +1998,7 @@ void CGameServer::StartGame()
 	gameHasStarted = true;
 	startTime = gameTime;
 	if (!canReconnect && !bypassScriptPasswordCheck)
-		packetCache.clear(); // free memory
+		packetCache.Clear(); // free memory
 
 	if (UDPNet && !canReconnect && !bypassScriptPasswordCheck)
 		UDPNet->SetAcceptingConnections(false); // do not accept new connections
@@ -2572,12 +2619,12 @@ unsigned CGameServer::BindConnection(std::string name, const std::string& passwd
 
 	newPlayer.Connected(link, isLocal);
 	newPlayer.SendData(boost::shared_ptr<const RawPacket>(gameData->Pack()));
+	// a recent game-state (if the host provided one) replaces the cache up to its frame
+	packetCache.SendSnapshot(*newPlayer.link);
 	newPlayer.SendData(CBaseNetProtocol::Get().SendSetPlayerNum((unsigned char)newPlayerNumber));
 
 	// after gamedata and playerNum, the player can start loading
-	for (std::list< std::vector<boost::shared_ptr<const netcode::RawPacket> > >::const_iterator lit = packetCache.begin(); lit != packetCache.end(); ++lit)
-		for (std::vector<boost::shared_ptr<const netcode::RawPacket> >::const_iterator vit = lit->begin(); vit != lit->end(); ++vit)
-			newPlayer.SendData(*vit); // throw at him all stuff he missed until now
+	packetCache.Send(*newPlayer.link); // throw at him all stuff he missed until now
 
 	if (!demoReader || setup->demoName.empty()) { // gamesetup from demo?
 		if (!newPlayer.spectator) {
@@ -2661,11 +2708,3 @@ unsigned char CGameServer::ReserveNextAvailableSkirmishAIId() {
 void CGameServer::FreeSkirmishAIId(const unsigned char skirmishAIId) {
 	usedSkirmishAIIds.remove(skirmishAIId);
 }
-
-void CGameServer::AddToPacketCache(boost::shared_ptr<const netcode::RawPacket> &pckt) {
-	if (packetCache.empty() || packetCache.back().size() >= PKTCACHE_VECSIZE) {
-		packetCache.push_back(std::vector<boost::shared_ptr<const netcode::RawPacket> >());
-		packetCache.back().reserve(PKTCACHE_VECSIZE);
-	}
-	packetCache.back().push_back(pckt);
-}
@@ -12,6 +12,7 @@
 #include <list>
 
 #include "GameData.h"
+#include "Server/PacketCache.h"
 #include "Sim/Misc/TeamBase.h"
 #include "System/UnsyncedRNG.h"
 #include "System/float3.h"
@@ -154,8 +155,6 @@ private:
 	void Message(const std::string& message, bool broadcast = true);
 	void PrivateMessage(int playerNum, const std::string& message);
 
-	void AddToPacketCache(boost::shared_ptr<const netcode::RawPacket>& pckt);
-
 	bool AdjustPlayerNumber(netcode::RawPacket* buf, int pos, int val = -1);
 	void UpdatePlayerNumberMap();
 
@@ -227,7 +226,12 @@ private:
 	bool allowSpecDraw;
 	bool bypassScriptPasswordCheck;
 	bool whiteListAdditionalPlayers;
-	std::list< std::vector<boost::shared_ptr<const netcode::RawPacket> > > packetCache;
+	CPacketCache packetCache;
+
+	/// NETMSG_GAMESTATE parts received from the host so far
+	std::vector< boost::shared_ptr<const netcode::RawPacket> > gameStateParts;
+	int gameStateFrame;
+	unsigned int gameStateBytes;
 
 	/////////////////// sync stuff ///////////////////
 #ifdef SYNCCHECK
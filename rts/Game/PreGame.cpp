@@ -5,6 +5,7 @@
 #include <SDL_timer.h>
 #include <set>
 #include <cfloat>
+#include <sstream>
 
 #include "PreGame.h"
 
@@ -42,6 +43,7 @@
 #include "System/LoadSave/DemoRecorder.h"
 #include "System/LoadSave/DemoReader.h"
 #include "System/LoadSave/LoadSaveHandler.h"
+#include "System/LoadSave/CregLoadSaveHandler.h"
 #include "System/Log/ILog.h"
 #include "System/Net/RawPacket.h"
 #include "System/Net/UnpackPacket.h"
@@ -60,6 +62,8 @@ extern SelectMenu* selectMenu;
 CPreGame::CPreGame(const ClientSetup* setup) :
 	settings(setup),
 	savefile(NULL),
+	gameStateSize(0),
+	gameStateFrame(-1),
 	timer(0),
 	wantDemo(true)
 {
@@ -314,6 +318,29 @@ void CPreGame::UpdateClientNet()
 				GameDataReceived(packet);
 				break;
 			}
+			case NETMSG_GAMESTATE: {
+				// sent between gamedata and playernum if the host provided
+				// a recent state, the packets we get next start after it
+				try {
+					netcode::UnpackPacket pckt(packet, 3);
+					int frameNum;
+					unsigned int stateSize;
+					pckt >> frameNum;
+					pckt >> stateSize;
+
+					if (frameNum != gameStateFrame) {
+						gameState.clear();
+						gameState.reserve(stateSize);
+						gameStateFrame = frameNum;
+						gameStateSize = stateSize;
+					}
+
+					gameState.append(reinterpret_cast<const char*>(packet->data + 11), packet->length - 11);
+				} catch (const netcode::UnpackPacketException& ex) {
+					LOG_L(L_ERROR, "Got invalid GameState message: %s", ex.what());
+				}
+				break;
+			}
 			case NETMSG_SETPLAYERNUM: {
 				// this is sent after NETMSG_GAMEDATA, to let us know which
 				// playernum we have
@@ -328,6 +355,20 @@ void CPreGame::UpdateClientNet()
 				LOG("User number %i (team %i, allyteam %i)",
 						gu->myPlayerNum, gu->myTeam, gu->myAllyTeam);
 
+				if (savefile == NULL && !gameState.empty()) {
+					if (gameState.size() == gameStateSize) {
+						LOG("Catching up from the game-state of frame %i (%u KB)", gameStateFrame, unsigned(gameStateSize / 1024));
+
+						CCregLoadSaveHandler* ls = new CCregLoadSaveHandler();
+						ls->LoadGameStartInfo(new std::istringstream(gameState, std::ios::in | std::ios::binary), "");
+						savefile = ls;
+					} else {
+						throw content_error("Incomplete game-state received from server");
+					}
+
+					std::string().swap(gameState);
+				}
+
 				CLoadScreen::CreateInstance(gameSetup->MapFile(), modArchive, savefile);
 
 				pregame = NULL;
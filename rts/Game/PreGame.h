@@ -66,6 +66,11 @@ private:
 	const ClientSetup* settings;
 	std::string modArchive;
 	ILoadSaveHandler *savefile;
+
+	/// game-state snapshot the server sends to mid-game joiners (if it has one)
+	std::string gameState;
+	unsigned int gameStateSize;
+	int gameStateFrame;
 	
 	unsigned timer;
 	bool wantDemo;
@@ -0,0 +1,163 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "PacketCache.h"
+
+#include "System/BaseNetProtocol.h"
+#include "System/Net/Connection.h"
+#include "System/Net/RawPacket.h"
+#include "System/Log/ILog.h"
+
+#define PKTCACHE_VECSIZE 1000
+
+
+void CPacketCache::Add(const PacketPtr& packet)
+{
+	if (packet->length <= 0)
+		return;
+
+	const unsigned char msgID = packet->data[0];
+	const bool isFrame = (msgID == NETMSG_NEWFRAME || msgID == NETMSG_KEYFRAME);
+
+	numBytes += packet->length;
+
+	if (chunks.empty() && !isFrame && numFrames == 0) {
+		header.push_back(packet);
+		return;
+	}
+
+	if (chunks.empty() || chunks.back().packets.size() >= PKTCACHE_VECSIZE) {
+		chunks.push_back(Chunk());
+		chunks.back().frameNum = numFrames;
+		chunks.back().packets.reserve(PKTCACHE_VECSIZE);
+	}
+
+	chunks.back().packets.push_back(packet);
+
+	if (msgID == NETMSG_NEWFRAME) {
+		numFrames += 1;
+	} else if (msgID == NETMSG_KEYFRAME && packet->length >= 5) {
+		// clients simulate up to the keyframe's number (see CGame::ClientReadNet)
+		numFrames = *reinterpret_cast<const int*>(packet->data + 1);
+	}
+
+	if (warnBytes > 0 && numBytes > warnBytes) {
+		// joiners need all of it, only a snapshot could release some
+		LOG_L(L_WARNING, "[PacketCache] %u MB of packets kept for mid-game joins", numBytes >> 20);
+		warnBytes = 0;
+	}
+}
+
+void CPacketCache::Clear()
+{
+	header.clear();
+	chunks.clear();
+	snapshot.clear();
+
+	numFrames = 0;
+	snapshotFrame = -1;
+	numBytes = 0;
+}
+
+
+bool CPacketCache::SetSnapshot(int frameNum, const std::vector<PacketPtr>& state)
+{
+	if (chunks.empty() || frameNum <= snapshotFrame || frameNum > numFrames || frameNum < chunks.front().frameNum)
+		return false;
+
+	// find the packet after which clients are at <frameNum>
+	std::list<Chunk>::iterator cit = chunks.begin();
+	size_t pos = 0;
+
+	if (frameNum > cit->frameNum) {
+		for (; cit != chunks.end(); ++cit) {
+			int frame = cit->frameNum;
+
+			for (pos = 0; pos < cit->packets.size() && frame < frameNum; ++pos) {
+				const PacketPtr& packet = cit->packets[pos];
+
+				if (packet->data[0] == NETMSG_NEWFRAME) {
+					frame += 1;
+				} else if (packet->data[0] == NETMSG_KEYFRAME && packet->length >= 5) {
+					frame = *reinterpret_cast<const int*>(packet->data + 1);
+				}
+			}
+
+			if (frame >= frameNum)
+				break;
+		}
+
+		if (cit == chunks.end())
+			return false;
+	}
+
+	// release everything before, except what the state does not cover
+	ReleaseChunks(cit, pos);
+	cit->frameNum = frameNum;
+
+	for (std::vector<PacketPtr>::const_iterator it = snapshot.begin(); it != snapshot.end(); ++it)
+		numBytes -= (*it)->length;
+	for (std::vector<PacketPtr>::const_iterator it = state.begin(); it != state.end(); ++it)
+		numBytes += (*it)->length;
+
+	snapshot = state;
+	snapshotFrame = frameNum;
+	return true;
+}
+
+void CPacketCache::ReleaseChunks(std::list<Chunk>::iterator cit, size_t pos)
+{
+	for (std::list<Chunk>::iterator it = chunks.begin(); it != cit; it = chunks.erase(it)) {
+		for (std::vector<PacketPtr>::const_iterator pit = it->packets.begin(); pit != it->packets.end(); ++pit) {
+			if (IsPersistent(*pit)) {
+				header.push_back(*pit);
+			} else {
+				numBytes -= (*pit)->length;
+			}
+		}
+	}
+
+	if (cit == chunks.end())
+		return;
+
+	for (size_t n = 0; n < pos; ++n) {
+		if (IsPersistent(cit->packets[n])) {
+			header.push_back(cit->packets[n]);
+		} else {
+			numBytes -= cit->packets[n]->length;
+		}
+	}
+
+	cit->packets.erase(cit->packets.begin(), cit->packets.begin() + pos);
+}
+
+
+void CPacketCache::SendSnapshot(netcode::CConnection& link) const
+{
+	for (std::vector<PacketPtr>::const_iterator it = snapshot.begin(); it != snapshot.end(); ++it)
+		link.SendData(*it);
+}
+
+void CPacketCache::Send(netcode::CConnection& link) const
+{
+	for (std::vector<PacketPtr>::const_iterator it = header.begin(); it != header.end(); ++it)
+		link.SendData(*it);
+
+	for (std::list<Chunk>::const_iterator cit = chunks.begin(); cit != chunks.end(); ++cit)
+		for (std::vector<PacketPtr>::const_iterator it = cit->packets.begin(); it != cit->packets.end(); ++it)
+			link.SendData(*it);
+}
+
+
+bool CPacketCache::IsPersistent(const PacketPtr& packet)
+{
+	// the player list is not part of a creg save
+	switch (packet->data[0]) {
+		case NETMSG_CREATE_NEWPLAYER:
+		case NETMSG_PLAYERNAME:
+		case NETMSG_PLAYERLEFT:
+		case NETMSG_GAMEID:
+			return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,95 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _PACKET_CACHE_H
+#define _PACKET_CACHE_H
+
+#include <boost/shared_ptr.hpp>
+#include <list>
+#include <vector>
+
+namespace netcode
+{
+	class RawPacket;
+	class CConnection;
+}
+
+/**
+ * @brief Log of the packets a mid-game joiner needs
+ *
+ * Everything broadcast before the first frame (the pre-game setup) is kept
+ * for good; the rest is stored in fixed-size chunks. Once the host provides
+ * a game-state snapshot (NETMSG_GAMESTATE) of a frame, every chunk before
+ * that frame is released, keeping only the packets the state does not
+ * cover (see IsPersistent). Joiners get the snapshot followed by the
+ * packets after it, instead of everything since frame 0, so both the memory
+ * used by the log and the catch-up time are bounded by the snapshot
+ * interval rather than by the length of the game.
+ *
+ * Nothing after the latest snapshot is ever released, without snapshots
+ * (the default, see GameStateSnapshotInterval) the log grows for the whole
+ * game like before; SetWarnSize only makes that visible.
+ */
+class CPacketCache
+{
+public:
+	typedef boost::shared_ptr<const netcode::RawPacket> PacketPtr;
+
+	CPacketCache(): numFrames(0), snapshotFrame(-1), numBytes(0), warnBytes(0) {}
+
+	void Add(const PacketPtr& packet);
+	void Clear();
+
+	/// log a warning (once) when the log grows past <bytes>, 0 for never
+	void SetWarnSize(unsigned int bytes) { warnBytes = bytes; }
+
+	/**
+	 * @brief replace the log up to frame <frameNum> by a game-state snapshot
+	 * @param state the NETMSG_GAMESTATE packets making up the snapshot,
+	 *   taken right after the client simulated frame <frameNum>
+	 * @return false if the log does not reach back (or forth) to <frameNum>
+	 */
+	bool SetSnapshot(int frameNum, const std::vector<PacketPtr>& state);
+	/// @return frame of the current snapshot, -1 if there is none
+	int GetSnapshotFrame() const { return snapshotFrame; }
+
+	/// queue the snapshot (if any) on <link>, has to go out before NETMSG_SETPLAYERNUM
+	void SendSnapshot(netcode::CConnection& link) const;
+	/// queue the log on <link>
+	void Send(netcode::CConnection& link) const;
+
+	/// total size of all packets held (snapshot included)
+	unsigned int GetSize() const { return numBytes; }
+
+private:
+	/// packets that change state a snapshot does not contain (players)
+	static bool IsPersistent(const PacketPtr& packet);
+
+
+	struct Chunk {
+		/// number of frames preceding the first packet
+		int frameNum;
+		std::vector<PacketPtr> packets;
+	};
+
+	/**
+	 * release the chunks before <cit> and the first <pos> packets of <cit>
+	 * (all chunks if <cit> is the end), keeping those IsPersistent is true for
+	 */
+	void ReleaseChunks(std::list<Chunk>::iterator cit, size_t pos);
+
+	/// never released: pre-game packets and those IsPersistent is true for
+	std::vector<PacketPtr> header;
+	std::list<Chunk> chunks;
+	std::vector<PacketPtr> snapshot;
+
+	/// number of frames added so far (adjusted to NETMSG_KEYFRAME's)
+	int numFrames;
+	int snapshotFrame;
+
+	/// size of all packets held, as GetSize returns it
+	unsigned int numBytes;
+	/// reset once the warning was given
+	unsigned int warnBytes;
+};
+
+#endif // _PACKET_CACHE_H
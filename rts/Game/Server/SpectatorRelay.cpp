@@ -0,0 +1,259 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/Net/UDPListener.h"
+#include "System/Net/UDPConnection.h"
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "SpectatorRelay.h"
+
+#include "Game/GameVersion.h"
+#include "System/BaseNetProtocol.h"
+#include "System/GlobalConfig.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Net/RawPacket.h"
+#include "System/Net/UnpackPacket.h"
+#include "System/Platform/EngineTypeHandler.h"
+#include "System/Platform/errorhandler.h"
+#include "System/Platform/Threading.h"
+
+using netcode::RawPacket;
+using boost::format;
+
+
+CSpectatorRelay::CSpectatorRelay(const std::string& hostIP, int hostPort, const std::string& serverIP, int serverPort, const std::string& name, const std::string& passwd, const std::string& specPasswd)
+	: playerName(name)
+	, spectatorPasswd(specPasswd)
+	, playerNum(-1)
+	, lostServer(false)
+	, thread(NULL)
+	, quitRelay(false)
+{
+	UDPNet.reset(new netcode::UDPListener(hostPort, hostIP));
+
+	serverLink = UDPNet->SpawnConnection(serverIP, serverPort);
+	serverLink->Unmute();
+	serverLink->SendData(CBaseNetProtocol::Get().SendAttemptConnect(name, passwd, SpringVersion::GetFull(), globalConfig->networkLossFactor));
+	serverLink->Flush(true);
+
+	LOG("[%s] relaying %s:%i to spectators on port %i, joining as %s", __FUNCTION__, serverIP.c_str(), serverPort, hostPort, name.c_str());
+
+	if (spectatorPasswd.empty())
+		LOG_L(L_WARNING, "[%s] no spectator password set, anyone can watch the game through this relay", __FUNCTION__);
+
+	thread = new boost::thread(boost::bind<void, CSpectatorRelay, CSpectatorRelay*>(&CSpectatorRelay::UpdateLoop, this));
+}
+
+CSpectatorRelay::~CSpectatorRelay()
+{
+	quitRelay = true;
+	thread->join();
+	delete thread;
+}
+
+
+void CSpectatorRelay::UpdateLoop()
+{
+	try {
+		Threading::SetThreadName("netcode");
+
+		while (!quitRelay) {
+			spring_sleep(spring_msecs(10));
+
+			UDPNet->Update();
+
+			ReadServerNet();
+			AcceptSpectators();
+			ReadSpectatorNet();
+
+			// pass on what came in from the server right away
+			UDPNet->FlushConnections();
+		}
+
+		if (!lostServer) {
+			serverLink->SendData(CBaseNetProtocol::Get().SendQuit("Relay shutdown"));
+			Broadcast(CBaseNetProtocol::Get().SendQuit("Relay shutdown"));
+		}
+
+		// same as CGameServer::UpdateLoop: let the quit messages go out before closing
+		spring_sleep(spring_msecs(1000));
+		serverLink->Flush(false);
+		for (std::list< boost::shared_ptr<netcode::CConnection> >::iterator it = spectators.begin(); it != spectators.end(); ++it) {
+			(*it)->Flush();
+		}
+		spring_sleep(spring_msecs(3000));
+	} CATCH_SPRING_ERRORS
+}
+
+
+void CSpectatorRelay::ReadServerNet()
+{
+	if (serverLink->CheckTimeout(0, playerNum < 0)) {
+		LOG_L(L_WARNING, "[%s] lost connection to the game server", __FUNCTION__);
+		Broadcast(CBaseNetProtocol::Get().SendQuit("Relay lost connection to the game server"));
+		lostServer = true;
+		quitRelay = true;
+		return;
+	}
+
+	boost::shared_ptr<const RawPacket> packet;
+
+	while ((packet = serverLink->GetData())) {
+		if (packet->length <= 0)
+			continue;
+
+		switch (packet->data[0]) {
+			case NETMSG_SETPLAYERNUM: {
+				if (packet->length < 2)
+					continue;
+
+				// the server waits for this before it counts us as in-game
+				playerNum = packet->data[1];
+				serverLink->SendData(CBaseNetProtocol::Get().SendPlayerName(playerNum, playerName));
+
+				LOG("[%s] joined the game server as player %d, accepting spectators", __FUNCTION__, playerNum);
+			} break;
+
+			case NETMSG_QUIT: {
+				try {
+					netcode::UnpackPacket msg(packet, 3);
+					std::string reason;
+					msg >> reason;
+					LOG_L(L_WARNING, "[%s] game server closed the connection: %s", __FUNCTION__, reason.c_str());
+				} catch (const netcode::UnpackPacketException& ex) {
+					LOG_L(L_WARNING, "[%s] game server closed the connection", __FUNCTION__);
+				}
+
+				lostServer = true;
+				quitRelay = true;
+			} break;
+		}
+
+		// like the server, do not cache progress info (it is outdated for anyone joining later)
+		if (packet->data[0] != NETMSG_GAME_FRAME_PROGRESS)
+			packetCache.Add(packet);
+
+		Broadcast(packet);
+	}
+}
+
+
+void CSpectatorRelay::AcceptSpectators()
+{
+	// until the server told us our player number there is nothing to hand out
+	while (playerNum >= 0 && UDPNet->HasIncomingConnections()) {
+		boost::shared_ptr<netcode::UDPConnection> prev = UDPNet->PreviewConnection().lock();
+		boost::shared_ptr<const RawPacket> packet = prev->GetData();
+
+		if (!packet || packet->length < 3 || packet->data[0] != NETMSG_ATTEMPTCONNECT) {
+			LOG_L(L_WARNING, "[%s] rejected connection attempt from %s: invalid message", __FUNCTION__, prev->GetFullAddress().c_str());
+			UDPNet->RejectConnection();
+			continue;
+		}
+
+		std::string name, passwd, version;
+		unsigned char reconnect, netloss;
+		unsigned short netversion;
+		EngineTypeHandler::EngineTypeVersion etv;
+
+		try {
+			netcode::UnpackPacket msg(packet, 3);
+			msg >> netversion;
+			if (netversion != NETWORK_VERSION)
+				throw netcode::UnpackPacketException(str(format("Wrong network version: %d, required version: %d") %(int)netversion %(int)NETWORK_VERSION));
+			msg >> etv;
+			msg >> name;
+			msg >> passwd;
+			msg >> version;
+			msg >> reconnect;
+			msg >> netloss;
+		} catch (const netcode::UnpackPacketException& ex) {
+			LOG_L(L_WARNING, "[%s] rejected connection attempt from %s: %s", __FUNCTION__, prev->GetFullAddress().c_str(), ex.what());
+			UDPNet->RejectConnection();
+			continue;
+		}
+
+		if (reconnect) {
+			// a reconnecting client expects to continue where it left off,
+			// which only its original connection could do; let it time out
+			UDPNet->RejectConnection();
+			continue;
+		}
+
+		boost::shared_ptr<netcode::CConnection> link = UDPNet->AcceptConnection();
+		link->Unmute();
+		link->SetLossFactor(netloss);
+
+		if (etv != EngineTypeHandler::GetCurrentEngineTypeVersion()) {
+			link->SendData(CBaseNetProtocol::Get().SendQuit("Wrong engine type or version!\n\nThis relay requires engine: " + EngineTypeHandler::GetEngine(EngineTypeHandler::GetCurrentEngineTypeVersion())));
+			link->Flush(true);
+			link->Close();
+			continue;
+		}
+		if (!spectatorPasswd.empty() && passwd != spectatorPasswd) {
+			LOG_L(L_WARNING, "[%s] rejected %s from %s: incorrect password", __FUNCTION__, name.c_str(), link->GetFullAddress().c_str());
+			link->SendData(CBaseNetProtocol::Get().SendQuit("Incorrect password"));
+			link->Flush(true);
+			link->Close();
+			continue;
+		}
+
+		// everything since (and including) GAMEDATA, same as the server does on join
+		packetCache.Send(*link);
+
+		spectators.push_back(link);
+
+		LOG("[%s] %s connected from %s (%u spectators)", __FUNCTION__, name.c_str(), link->GetFullAddress().c_str(), unsigned(spectators.size()));
+	}
+}
+
+
+void CSpectatorRelay::ReadSpectatorNet()
+{
+	std::list< boost::shared_ptr<netcode::CConnection> >::iterator it = spectators.begin();
+
+	while (it != spectators.end()) {
+		netcode::CConnection* link = it->get();
+		const bool isFirst = (it == spectators.begin());
+
+		bool quit = link->CheckTimeout();
+		boost::shared_ptr<const RawPacket> packet;
+
+		while ((packet = link->GetData())) {
+			if (packet->length <= 0)
+				continue;
+
+			switch (packet->data[0]) {
+				case NETMSG_QUIT: {
+					quit = true;
+				} break;
+
+				case NETMSG_KEYFRAME:
+				case NETMSG_SYNCRESPONSE: {
+					// sent with our player number, the server can take them as is
+					if (isFirst)
+						serverLink->SendData(packet);
+				} break;
+			}
+		}
+
+		if (quit) {
+			LOG("[%s] spectator at %s left (%u spectators)", __FUNCTION__, link->GetFullAddress().c_str(), unsigned(spectators.size() - 1));
+			link->Close();
+			it = spectators.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+
+void CSpectatorRelay::Broadcast(boost::shared_ptr<const netcode::RawPacket> packet)
+{
+	for (std::list< boost::shared_ptr<netcode::CConnection> >::iterator it = spectators.begin(); it != spectators.end(); ++it) {
+		(*it)->SendData(packet);
+	}
+}
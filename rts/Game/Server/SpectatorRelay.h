@@ -0,0 +1,99 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _SPECTATOR_RELAY_H
+#define _SPECTATOR_RELAY_H
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "PacketCache.h"
+
+namespace boost {
+	class thread;
+}
+
+namespace netcode
+{
+	class RawPacket;
+	class CConnection;
+	class UDPConnection;
+	class UDPListener;
+}
+
+/**
+ * @brief Fans the stream of a running game out to spectators
+ *
+ * The relay joins an (authoritative) CGameServer as one spectator and lets
+ * any number of spectators connect to itself instead, so the game server
+ * only has to send its stream once per relay instead of once per spectator.
+ *
+ * Everything the relay receives from the server, starting with GAMEDATA,
+ * is forwarded to all of its spectators and kept in its own packet cache,
+ * which late joiners get first (so the server needs to keep its cache too
+ * when the relay joins a running game, see CGameServer::BindConnection).
+ * All spectators of a relay share the player number the server gave it.
+ * Unless a spectator password is given, anyone can join the relay (under
+ * any name) and watch the game.
+ * Apart from NETMSG_QUIT nothing they send is relayed upstream, except the
+ * frame- and sync-responses of the spectator that connected first, which
+ * stand in for the ones the server expects from the relay.
+ *
+ * Like CGameServer this runs in its own thread.
+ */
+class CSpectatorRelay
+{
+public:
+	/**
+	 * @param hostIP local IP to accept spectators on, "" for any
+	 * @param hostPort local port to accept spectators on
+	 * @param serverIP IP of the game server to relay
+	 * @param serverPort port of the game server to relay
+	 * @param name player name to join the game server as
+	 * @param passwd password for <name> on the game server
+	 * @param specPasswd password spectators need to join the relay, "" for none
+	 */
+	CSpectatorRelay(const std::string& hostIP, int hostPort, const std::string& serverIP, int serverPort, const std::string& name, const std::string& passwd, const std::string& specPasswd);
+	~CSpectatorRelay();
+
+	/// Is the relay still running? (stops when the connection to the server is lost)
+	bool HasFinished() const { return quitRelay; }
+
+private:
+	void UpdateLoop();
+
+	/// forward everything new from the server
+	void ReadServerNet();
+	/// hand out the packet cache to newly connected spectators
+	void AcceptSpectators();
+	/// drop spectators that left, forward the responses of the first one
+	void ReadSpectatorNet();
+
+	void Broadcast(boost::shared_ptr<const netcode::RawPacket> packet);
+
+private:
+	const std::string playerName;
+	/// checked against the password of joining spectators if not empty
+	const std::string spectatorPasswd;
+
+	boost::scoped_ptr<netcode::UDPListener> UDPNet;
+	/// our connection to the game server (spawned on UDPNet's socket)
+	boost::shared_ptr<netcode::UDPConnection> serverLink;
+
+	/// in order of connection, the first one answers the server's frames
+	std::list< boost::shared_ptr<netcode::CConnection> > spectators;
+	/// everything from the server in order, the relay never gets snapshots of its own
+	CPacketCache packetCache;
+
+	/// the player number the server gave us (and all our spectators), -1 while joining
+	int playerNum;
+	/// set when the server ended the connection, it sent our spectators a NETMSG_QUIT then
+	bool lostServer;
+
+	boost::thread* thread;
+	volatile bool quitRelay;
+};
+
+#endif // _SPECTATOR_RELAY_H
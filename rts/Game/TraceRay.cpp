@@ -192,7 +192,7 @@ float TraceRay(
 			for (int* quadPtr = begQuad; quadPtr != endQuad; ++quadPtr) {
 				const CQuadField::Quad& quad = quadField->GetQuad(*quadPtr);
 
-				for (std::list<CFeature*>::const_iterator ui = quad.features.begin(); ui != quad.features.end(); ++ui) {
+				for (std::vector<CFeature*>::const_iterator ui = quad.features.begin(); ui != quad.features.end(); ++ui) {
 					CFeature* f = *ui;
 
 					// NOTE:
@@ -219,7 +219,7 @@ float TraceRay(
 			for (int* quadPtr = begQuad; quadPtr != endQuad; ++quadPtr) {
 				const CQuadField::Quad& quad = quadField->GetQuad(*quadPtr);
 
-				for (std::list<CUnit*>::const_iterator ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+				for (std::vector<CUnit*>::const_iterator ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
 					CUnit* u = *ui;
 
 					if (u == owner)
@@ -302,8 +302,8 @@ float GuiTraceRay(
 
 	quadField->GetQuadsOnRay(start, dir, length, begQuad, endQuad);
 
-	std::list<CUnit*>::const_iterator ui;
-	std::list<CFeature*>::const_iterator fi;
+	std::vector<CUnit*>::const_iterator ui;
+	std::vector<CFeature*>::const_iterator fi;
 
 	for (int* quadPtr = begQuad; quadPtr != endQuad; ++quadPtr) {
 		const CQuadField::Quad& quad = quadField->GetQuad(*quadPtr);
@@ -420,8 +420,8 @@ bool TestCone(
 		const CQuadField::Quad& quad = quadField->GetQuad(*quadPtr);
 
 		if (!ignoreAllies) {
-			const std::list<CUnit*>& units = quad.teamUnits[allyteam];
-			      std::list<CUnit*>::const_iterator unitsIt;
+			const std::vector<CUnit*>& units = quad.teamUnits[allyteam];
+			      std::vector<CUnit*>::const_iterator unitsIt;
 
 			for (unitsIt = units.begin(); unitsIt != units.end(); ++unitsIt) {
 				const CUnit* u = *unitsIt;
@@ -435,8 +435,8 @@ bool TestCone(
 		}
 
 		if (!ignoreNeutrals) {
-			const std::list<CUnit*>& units = quad.units;
-			      std::list<CUnit*>::const_iterator unitsIt;
+			const std::vector<CUnit*>& units = quad.units;
+			      std::vector<CUnit*>::const_iterator unitsIt;
 
 			for (unitsIt = units.begin(); unitsIt != units.end(); ++unitsIt) {
 				const CUnit* u = *unitsIt;
@@ -452,8 +452,8 @@ bool TestCone(
 		}
 
 		if (!ignoreFeatures) {
-			const std::list<CFeature*>& features = quad.features;
-			      std::list<CFeature*>::const_iterator featuresIt;
+			const std::vector<CFeature*>& features = quad.features;
+			      std::vector<CFeature*>::const_iterator featuresIt;
 
 			for (featuresIt = features.begin(); featuresIt != features.end(); ++featuresIt) {
 				const CFeature* f = *featuresIt;
@@ -502,8 +502,8 @@ bool TestTrajectoryCone(
 
 		// friendly units in this quad
 		if (!ignoreAllies) {
-			const std::list<CUnit*>& units = quad.teamUnits[allyteam];
-			      std::list<CUnit*>::const_iterator unitsIt;
+			const std::vector<CUnit*>& units = quad.teamUnits[allyteam];
+			      std::vector<CUnit*>::const_iterator unitsIt;
 
 			for (unitsIt = units.begin(); unitsIt != units.end(); ++unitsIt) {
 				const CUnit* u = *unitsIt;
@@ -519,8 +519,8 @@ bool TestTrajectoryCone(
 
 		// neutral units in this quad
 		if (!ignoreNeutrals) {
-			const std::list<CUnit*>& units = quad.units;
-			      std::list<CUnit*>::const_iterator unitsIt;
+			const std::vector<CUnit*>& units = quad.units;
+			      std::vector<CUnit*>::const_iterator unitsIt;
 
 			for (unitsIt = units.begin(); unitsIt != units.end(); ++unitsIt) {
 				const CUnit* u = *unitsIt;
@@ -537,8 +537,8 @@ bool TestTrajectoryCone(
 
 		// features in this quad
 		if (!ignoreFeatures) {
-			const std::list<CFeature*>& features = quad.features;
-			      std::list<CFeature*>::const_iterator featuresIt;
+			const std::vector<CFeature*>& features = quad.features;
+			      std::vector<CFeature*>::const_iterator featuresIt;
 
 			for (featuresIt = features.begin(); featuresIt != features.end(); ++featuresIt) {
 				const CFeature* f = *featuresIt;
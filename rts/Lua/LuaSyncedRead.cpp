@@ -88,6 +88,15 @@ enum UnitAllegiance {
 	EnemyUnits = -4
 };
 
+// field bits for GetUnitsFields, in the order the values are packed
+enum UnitField {
+	UnitFieldPosition = (1 << 0), // 3 values, like GetUnitPosition
+	UnitFieldMidPos   = (1 << 1), // 3 values
+	UnitFieldAimPos   = (1 << 2), // 3 values
+	UnitFieldHealth   = (1 << 3), // 5 values, like GetUnitHealth
+	UnitFieldVectors  = (1 << 4)  // 9 values, like GetUnitVectors
+};
+
 
 /******************************************************************************/
 /******************************************************************************/
@@ -100,6 +109,13 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	LuaPushNamedNumber(L, "ALLY_UNITS",  AllyUnits);
 	LuaPushNamedNumber(L, "ENEMY_UNITS", EnemyUnits);
 
+	// GetUnitsFields constants
+	LuaPushNamedNumber(L, "UNIT_FIELD_POSITION", UnitFieldPosition);
+	LuaPushNamedNumber(L, "UNIT_FIELD_MIDPOS",   UnitFieldMidPos);
+	LuaPushNamedNumber(L, "UNIT_FIELD_AIMPOS",   UnitFieldAimPos);
+	LuaPushNamedNumber(L, "UNIT_FIELD_HEALTH",   UnitFieldHealth);
+	LuaPushNamedNumber(L, "UNIT_FIELD_VECTORS",  UnitFieldVectors);
+
 #define REGISTER_LUA_CFUNC(x) \
 	lua_pushstring(L, #x);      \
 	lua_pushcfunction(L, x);    \
@@ -207,6 +223,7 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetUnitPosition);
 	REGISTER_LUA_CFUNC(GetUnitBasePosition);
 	REGISTER_LUA_CFUNC(GetUnitVectors);
+	REGISTER_LUA_CFUNC(GetUnitsFields);
 	REGISTER_LUA_CFUNC(GetUnitDirection);
 	REGISTER_LUA_CFUNC(GetUnitHeading);
 	REGISTER_LUA_CFUNC(GetUnitVelocity);
@@ -2893,6 +2910,133 @@ int LuaSyncedRead::GetUnitVectors(lua_State* L)
 }
 
 
+static inline void SetArrayNumber(lua_State* L, int table, int& index, float value)
+{
+	lua_pushnumber(L, value);
+	lua_rawseti(L, table, ++index);
+}
+
+static inline void SetArrayFalse(lua_State* L, int table, int& index, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		lua_pushboolean(L, false);
+		lua_rawseti(L, table, ++index);
+	}
+}
+
+static inline void SetArrayVector(lua_State* L, int table, int& index, const float3& v)
+{
+	SetArrayNumber(L, table, index, v.x);
+	SetArrayNumber(L, table, index, v.y);
+	SetArrayNumber(L, table, index, v.z);
+}
+
+/**
+ * GetUnitsFields(unitIDs, fieldMask [, array]) --> array, stride
+ *
+ * Packs the fields (UNIT_FIELD_*) selected by fieldMask of every unit in
+ * unitIDs into one flat array, stride values per unit in the order of the
+ * unitIDs and of the field bits. Values a caller could not get from the
+ * per-unit getters (GetUnitPosition, GetUnitHealth, GetUnitVectors), for
+ * invalid or dead units among them, are false. If array is given it is
+ * filled (from index 1) instead of a new one; entries past the last unit
+ * are left as they were.
+ */
+int LuaSyncedRead::GetUnitsFields(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	const int fieldMask = luaL_checkint(L, 2);
+	const int numUnits = lua_objlen(L, 1);
+
+	int stride = 0;
+	if (fieldMask & UnitFieldPosition) { stride += 3; }
+	if (fieldMask & UnitFieldMidPos)   { stride += 3; }
+	if (fieldMask & UnitFieldAimPos)   { stride += 3; }
+	if (fieldMask & UnitFieldHealth)   { stride += 5; }
+	if (fieldMask & UnitFieldVectors)  { stride += 9; }
+
+	if (lua_istable(L, 3)) {
+		lua_pushvalue(L, 3);
+	} else {
+		lua_createtable(L, numUnits * stride, 0);
+	}
+
+	const int table = lua_gettop(L);
+	int index = 0;
+
+	for (int i = 1; i <= numUnits; ++i) {
+		lua_rawgeti(L, 1, i);
+		const CUnit* unit = ParseRawUnit(L, NULL, -1);
+		lua_pop(L, 1);
+
+		if (unit == NULL) {
+			SetArrayFalse(L, table, index, stride);
+			continue;
+		}
+
+		const bool allyUnit = IsAllyUnit(L, unit);
+		const bool enemyUnit = IsEnemyUnit(L, unit);
+		const bool visible = IsUnitVisible(L, unit);
+		const bool inLos = IsUnitInLos(L, unit);
+
+		if (fieldMask & (UnitFieldPosition | UnitFieldMidPos | UnitFieldAimPos)) {
+			float3 err = ZeroVector;
+
+			if (visible && !allyUnit) {
+				err += CGameHelper::GetUnitErrorPos(unit, CLuaHandle::GetHandleReadAllyTeam(L));
+				err -= unit->midPos;
+			}
+
+			if (fieldMask & UnitFieldPosition) {
+				if (visible) { SetArrayVector(L, table, index, unit->pos + err); } else { SetArrayFalse(L, table, index, 3); }
+			}
+			if (fieldMask & UnitFieldMidPos) {
+				if (visible) { SetArrayVector(L, table, index, unit->midPos + err); } else { SetArrayFalse(L, table, index, 3); }
+			}
+			if (fieldMask & UnitFieldAimPos) {
+				if (visible) { SetArrayVector(L, table, index, unit->aimPos + err); } else { SetArrayFalse(L, table, index, 3); }
+			}
+		}
+
+		if (fieldMask & UnitFieldHealth) {
+			if (inLos) {
+				const UnitDef* ud = unit->unitDef;
+
+				if (ud->hideDamage && enemyUnit) {
+					SetArrayFalse(L, table, index, 3);
+				} else if (!enemyUnit || (ud->decoyDef == NULL)) {
+					SetArrayNumber(L, table, index, unit->health);
+					SetArrayNumber(L, table, index, unit->maxHealth);
+					SetArrayNumber(L, table, index, unit->paralyzeDamage);
+				} else {
+					const float scale = (ud->decoyDef->health / ud->health);
+					SetArrayNumber(L, table, index, scale * unit->health);
+					SetArrayNumber(L, table, index, scale * unit->maxHealth);
+					SetArrayNumber(L, table, index, scale * unit->paralyzeDamage);
+				}
+				SetArrayNumber(L, table, index, unit->captureProgress);
+				SetArrayNumber(L, table, index, unit->buildProgress);
+			} else {
+				SetArrayFalse(L, table, index, 5);
+			}
+		}
+
+		if (fieldMask & UnitFieldVectors) {
+			if (inLos) {
+				SetArrayVector(L, table, index, unit->frontdir);
+				SetArrayVector(L, table, index, unit->updir);
+				SetArrayVector(L, table, index, unit->rightdir);
+			} else {
+				SetArrayFalse(L, table, index, 9);
+			}
+		}
+	}
+
+	lua_pushnumber(L, stride);
+	return 2;
+}
+
+
 int LuaSyncedRead::GetUnitDirection(lua_State* L)
 {
 	CUnit* unit = ParseInLosUnit(L, __FUNCTION__, 1);
@@ -4952,6 +5096,8 @@ int LuaSyncedRead::GetPositionLosState(lua_State* L)
 
 	const int allyTeamID = GetEffectiveLosAllyTeam(L, 4);
 
+	radarhandler->UpdateSimThread();
+
 	bool inLos    = false;
 	bool inRadar  = false;
 
@@ -5015,6 +5161,8 @@ int LuaSyncedRead::IsPosInRadar(lua_State* L)
 
 	const int allyTeamID = GetEffectiveLosAllyTeam(L, 4);
 
+	radarhandler->UpdateSimThread();
+
 	bool state = false;
 	if (allyTeamID >= 0) {
 		state = radarhandler->InRadar(pos, allyTeamID);
@@ -668,7 +668,7 @@ public:
 	CUnitQuads() : count(0) {};
 
 	int count;
-	std::vector<const std::list<CUnit*>*> visunits;
+	std::vector<const std::vector<CUnit*>*> visunits;
 
 	void DrawQuad(int x, int y)
 	{
@@ -686,7 +686,7 @@ public:
 	CFeatureQuads() : count(0) {};
 
 	int count;
-	std::vector<const std::list<CFeature*>*> visfeatures;
+	std::vector<const std::vector<CFeature*>*> visfeatures;
 
 	void DrawQuad(int x, int y)
 	{
@@ -765,9 +765,9 @@ int LuaUnsyncedRead::GetVisibleUnits(lua_State* L)
 		} else {
 			// objects can exist in multiple quads, so we still need to do a duplication check
 			visQuadUnits.clear();
-			std::vector<const std::list<CUnit*>*>::iterator sit;
+			std::vector<const std::vector<CUnit*>*>::iterator sit;
 			for (sit = quadIter.visunits.begin(); sit != quadIter.visunits.end(); ++sit) {
-				std::list<CUnit*>::const_iterator unitIt;
+				std::vector<CUnit*>::const_iterator unitIt;
 				for (unitIt = (*sit)->begin(); unitIt != (*sit)->end(); ++unitIt) {
 					CUnit* unit = *unitIt;
 					if ((teamID == AllUnits) ||
@@ -876,9 +876,9 @@ int LuaUnsyncedRead::GetVisibleFeatures(lua_State* L)
 		} else {
 			//! features can exist in multiple quads, so we need to do a duplication check
 			visQuadFeatures.clear();
-			std::vector<const std::list<CFeature*>*>::iterator it;
+			std::vector<const std::vector<CFeature*>*>::iterator it;
 			for (it = quadIter.visfeatures.begin(); it != quadIter.visfeatures.end(); ++it) {
-				std::list<CFeature*>::const_iterator featureIt;
+				std::vector<CFeature*>::const_iterator featureIt;
 				for (featureIt = (*it)->begin(); featureIt != (*it)->end(); ++featureIt) {
 					visQuadFeatures.insert(*featureIt);
 				}
@@ -22,14 +22,6 @@
 
 CBasicMapDamage::CBasicMapDamage()
 {
-	const int numQuads = quadField->GetNumQuadsX() * quadField->GetNumQuadsZ();
-	inRelosQue = new bool[numQuads];
-	for (int a = 0; a < numQuads; ++a) {
-		inRelosQue[a] = false;
-	}
-	relosSize = 0;
-	neededLosUpdate = 0;
-
 	for (int a = 0; a <= CRATER_TABLE_SIZE; ++a) {
 		const float r = a / float(CRATER_TABLE_SIZE);
 		const float d = math::cos((r - 0.1f) * (PI + 0.3f)) * (1 - r) * (0.5f + 0.5f * math::cos(std::max(0.0f, r * 3 - 2) * PI));
@@ -51,7 +43,6 @@ CBasicMapDamage::~CBasicMapDamage()
 		delete explosions.front();
 		explosions.pop_front();
 	}
-	delete[] inRelosQue;
 }
 
 void CBasicMapDamage::Explosion(const float3& pos, float strength, float radius)
@@ -173,37 +164,46 @@ void CBasicMapDamage::Explosion(const float3& pos, float strength, float radius)
 
 void CBasicMapDamage::RecalcArea(int x1, int x2, int y1, int y2)
 {
-	const int decy = std::max(                     0, (y1 * SQUARE_SIZE - CQuadField::QUAD_SIZE / 2) / CQuadField::QUAD_SIZE);
-	const int incy = std::min(quadField->GetNumQuadsZ() - 1, (y2 * SQUARE_SIZE + CQuadField::QUAD_SIZE / 2) / CQuadField::QUAD_SIZE);
-	const int decx = std::max(                     0, (x1 * SQUARE_SIZE - CQuadField::QUAD_SIZE / 2) / CQuadField::QUAD_SIZE);
-	const int incx = std::min(quadField->GetNumQuadsX() - 1, (x2 * SQUARE_SIZE + CQuadField::QUAD_SIZE / 2) / CQuadField::QUAD_SIZE);
+	readmap->UpdateHeightMapSynced(SRectangle(x1, y1, x2, y2));
+	pathManager->TerrainChange(x1, y1, x2, y2, TERRAINCHANGE_DAMAGE_RECALCULATION);
+	featureHandler->TerrainChanged(x1, y1, x2, y2);
+	// re-casts the affected rays of all LOS-instances in this frame's
+	// CLosHandler::Update, which runs after ours (units no longer need
+	// to be queued for MoveUnit(unit, true) here)
+	loshandler->TerrainChanged(x1, y1, x2, y2);
+}
 
-	const int numQuadsX = quadField->GetNumQuadsX();
-	const int frameNum  = gs->frameNum;
 
-	for (int y = decy; y <= incy; y++) {
-		for (int x = decx; x <= incx; x++) {
-			if (inRelosQue[y * numQuadsX + x]) {
-				continue;
-			}
+static inline int GetRecalcAreaSize(const SRectangle& r)
+{
+	return ((r.x2 - r.x1 + 1) * (r.z2 - r.z1 + 1));
+}
 
-			RelosSquare rs;
-			rs.x = x;
-			rs.y = y;
-			rs.neededUpdate = frameNum;
-			rs.numUnits = quadField->GetQuadAt(x, y).units.size();
-			relosSize += rs.numUnits;
-			inRelosQue[y * numQuadsX + x] = true;
-			relosQue.push_back(rs);
+void CBasicMapDamage::AddRecalcArea(SRectangle area)
+{
+	// the areas are inclusive; merge two only if their bounding box is not
+	// larger than both together (e.g. a diagonal chain of craters would
+	// otherwise grow into one box over the whole chain), overlapping parts
+	// of areas kept apart are just recalculated twice
+	for (size_t n = 0; n < recalcAreas.size(); ) {
+		const SRectangle& a = recalcAreas[n];
+		const SRectangle box(std::min(a.x1, area.x1), std::min(a.z1, area.z1), std::max(a.x2, area.x2), std::max(a.z2, area.z2));
+
+		if (GetRecalcAreaSize(box) > (GetRecalcAreaSize(a) + GetRecalcAreaSize(area))) {
+			++n;
+			continue;
 		}
+
+		area = box;
+
+		// the grown area might overlap ones it did not before, start over
+		recalcAreas.erase(recalcAreas.begin() + n);
+		n = 0;
 	}
 
-	readmap->UpdateHeightMapSynced(SRectangle(x1, y1, x2, y2));
-	pathManager->TerrainChange(x1, y1, x2, y2, TERRAINCHANGE_DAMAGE_RECALCULATION);
-	featureHandler->TerrainChanged(x1, y1, x2, y2);
+	recalcAreas.push_back(area);
 }
 
-
 void CBasicMapDamage::Update()
 {
 	SCOPED_TIMER("BasicMapDamage::Update");
@@ -249,52 +249,20 @@ void CBasicMapDamage::Update()
 			}
 		}
 		if (e->ttl == 0) {
-			RecalcArea(x1 - 2, x2 + 2, y1 - 2, y2 + 2);
+			AddRecalcArea(SRectangle(x1 - 2, y1 - 2, x2 + 2, y2 + 2));
 		}
 	}
 
-	while (!explosions.empty() && explosions.front()->ttl == 0) {
-		delete explosions.front();
-		explosions.pop_front();
+	// explosions finishing together (eg. those of a cluster bomb) mostly
+	// overlap, so recalculate every connected area only once
+	for (std::vector<SRectangle>::const_iterator ai = recalcAreas.begin(); ai != recalcAreas.end(); ++ai) {
+		RecalcArea(ai->x1, ai->x2, ai->z1, ai->z2);
 	}
 
-	UpdateLos();
-}
-
-void CBasicMapDamage::UpdateLos()
-{
-	const int updateSpeed = (int) (relosSize * 0.01f) + 1;
-
-	if (relosUnits.empty()) {
-		if (relosQue.empty()) {
-			return;
-		}
-
-		RelosSquare* rs = &relosQue.front();
-		const std::list<CUnit*>& units = quadField->GetQuadAt(rs->x, rs->y).units;
-
-		std::list<CUnit*>::const_iterator ui;
-		for (ui = units.begin(); ui != units.end(); ++ui) {
-			relosUnits.push_back((*ui)->id);
-		}
-		relosSize -= rs->numUnits;
-		neededLosUpdate = rs->neededUpdate;
-		inRelosQue[rs->y * quadField->GetNumQuadsX() + rs->x] = false;
-		relosQue.pop_front();
-	}
+	recalcAreas.clear();
 
-	for (int a = 0; a < updateSpeed; ++a) {
-		if (relosUnits.empty()) {
-			return;
-		}
-
-		CUnit* unit = unitHandler->units[relosUnits.front()];
-		relosUnits.pop_front();
-
-		if (unit == NULL || unit->lastLosUpdate >= neededLosUpdate) {
-			continue;
-		}
-
-		loshandler->MoveUnit(unit, true);
+	while (!explosions.empty() && explosions.front()->ttl == 0) {
+		delete explosions.front();
+		explosions.pop_front();
 	}
 }
@@ -4,12 +4,11 @@
 #define _BASIC_MAP_DAMAGE_H
 
 #include "MapDamage.h"
+#include "System/Rectangle.h"
 
 #include <deque>
 #include <vector>
 
-class CUnit;
-
 class CBasicMapDamage : public IMapDamage
 {
 public:
@@ -21,7 +20,8 @@ public:
 	void Update();
 
 private:
-	void UpdateLos();
+	/// adds <area> to recalcAreas, merged with the ones close enough to it
+	void AddRecalcArea(SRectangle area);
 
 	struct ExploBuilding {
 		/**
@@ -45,21 +45,8 @@ private:
 	};
 
 	std::deque<Explo*> explosions;
-
-	struct RelosSquare {
-		int x;
-		int y;
-		/// frame number
-		int neededUpdate;
-		int numUnits;
-	};
-	std::deque<RelosSquare> relosQue;
-
-	bool* inRelosQue;
-	int relosSize;
-	/// frame number when LOS-update-required was triggered
-	int neededLosUpdate;
-	std::deque<int> relosUnits;
+	/// areas of the explosions finishing in this Update, see AddRecalcArea
+	std::vector<SRectangle> recalcAreas;
 
 	static const unsigned int CRATER_TABLE_SIZE = 200;
 
@@ -219,8 +219,14 @@ bool CBitmap::Load(std::string const& filename, unsigned char defaultAlpha)
 		return false;
 	}
 
-	unsigned char* buffer = new unsigned char[file.FileSize() + 2];
-	file.Read(buffer, file.FileSize());
+	// archived files are used in place, only raw ones need to be read
+	std::vector<unsigned char> buffer;
+	const unsigned char* data = file.GetData();
+	if (data == NULL) {
+		buffer.resize(file.FileSize() + 2);
+		file.Read(&buffer[0], file.FileSize());
+		data = &buffer[0];
+	}
 
 	boost::mutex::scoped_lock lck(devilMutex);
 	ilOriginFunc(IL_ORIGIN_UPPER_LEFT);
@@ -234,9 +240,8 @@ bool CBitmap::Load(std::string const& filename, unsigned char defaultAlpha)
 		// do not signal floating point exceptions in devil library
 		ScopedDisableFpuExceptions fe;
 
-		const bool success = !!ilLoadL(IL_TYPE_UNKNOWN, buffer, file.FileSize());
+		const bool success = !!ilLoadL(IL_TYPE_UNKNOWN, data, file.FileSize());
 		ilDisable(IL_ORIGIN_SET);
-		delete[] buffer;
 
 		if (success == false) {
 			AllocDummy();
@@ -277,8 +282,13 @@ bool CBitmap::LoadGrayscale(const std::string& filename)
 		return false;
 	}
 
-	unsigned char* buffer = new unsigned char[file.FileSize() + 1];
-	file.Read(buffer, file.FileSize());
+	std::vector<unsigned char> buffer;
+	const unsigned char* data = file.GetData();
+	if (data == NULL) {
+		buffer.resize(file.FileSize() + 1);
+		file.Read(&buffer[0], file.FileSize());
+		data = &buffer[0];
+	}
 
 	boost::mutex::scoped_lock lck(devilMutex);
 	ilOriginFunc(IL_ORIGIN_UPPER_LEFT);
@@ -288,9 +298,8 @@ bool CBitmap::LoadGrayscale(const std::string& filename)
 	ilGenImages(1, &ImageName);
 	ilBindImage(ImageName);
 
-	const bool success = !!ilLoadL(IL_TYPE_UNKNOWN, buffer, file.FileSize());
+	const bool success = !!ilLoadL(IL_TYPE_UNKNOWN, data, file.FileSize());
 	ilDisable(IL_ORIGIN_SET);
-	delete[] buffer;
 
 	if (success == false) {
 		return false;
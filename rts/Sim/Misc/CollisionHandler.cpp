@@ -23,6 +23,18 @@ void CCollisionHandler::PrintStats()
 	LOG("[CCollisionHandler] dis-/continuous tests: %i/%i", numDiscTests, numContTests);
 }
 
+float CCollisionHandler::GetPreTestRadius(const CollisionVolume* v)
+{
+	// pieces are not bounded by the unit volume, and IntersectCylinder
+	// also reports some hits just behind the start of the segment (so
+	// outside of any sphere the segment touches): always test these
+	// (finite so that the squared radius does not overflow)
+	if (v->DefaultToPieceTree() || v->GetVolumeType() == CollisionVolume::COLVOL_TYPE_CYLINDER)
+		return 1e15f;
+
+	return ((v->GetBoundingRadius() + v->GetOffsets().Length()) * 1.01f + 1.0f);
+}
+
 
 bool CCollisionHandler::DetectHit(const CUnit* u, const float3 p0, const float3 p1, CollisionQuery* q, bool forceTrace)
 {
@@ -140,9 +152,9 @@ bool CCollisionHandler::CollisionFootPrint(const CSolidObject* o, const float3&
 	if (squareIdx < 0 || squareIdx >= gs->mapSquares)
 		return false;
 
-	const BlockingMapCell& cell = groundBlockingObjectMap->GetCell(squareIdx);
+	const BlockingMapCell cell = groundBlockingObjectMap->GetCell(squareIdx);
 
-	return (cell.find(o->GetBlockingMapID()) != cell.end());
+	return (cell.Contains(o));
 }
 
 
@@ -83,6 +83,54 @@ class CCollisionHandler {
 		static bool DetectHit(const CollisionVolume* v, const CSolidObject* f, const float3 p0, const float3 p1, CollisionQuery* q, bool forceTrace = false);
 		static bool MouseHit(const CUnit* u, const float3& p0, const float3& p1, const CollisionVolume* v, CollisionQuery* q);
 
+		/**
+		 * Broad-phase pre-test of the ray segment [p0, p1] against a batch
+		 * of bounding spheres. Sphere i is given by (xs[i], ys[i], zs[i])
+		 * and rs[i]. The coordinates are stored as separate arrays so the
+		 * compiler can vectorize the loop.
+		 * Sets mask[i] to 0 if the segment can not touch sphere i, and to 1
+		 * otherwise. The test is conservative: only DetectHit decides hits.
+		 */
+		static void SegmentSpheresPreTest(
+			const float3& p0,
+			const float3& p1,
+			const float* xs,
+			const float* ys,
+			const float* zs,
+			const float* rs,
+			unsigned char* mask,
+			unsigned int count
+		) {
+			const float3 d = p1 - p0;
+			const float dd = d.dot(d);
+			const float ddInv = (dd > 0.0f)? (1.0f / dd): 0.0f;
+
+			for (unsigned int i = 0; i < count; i++) {
+				const float vx = xs[i] - p0.x;
+				const float vy = ys[i] - p0.y;
+				const float vz = zs[i] - p0.z;
+
+				// closest point on the segment to the sphere center
+				float t = (vx * d.x + vy * d.y + vz * d.z) * ddInv;
+				t = (t < 0.0f)? 0.0f: t;
+				t = (t > 1.0f)? 1.0f: t;
+
+				const float cx = vx - d.x * t;
+				const float cy = vy - d.y * t;
+				const float cz = vz - d.z * t;
+
+				mask[i] = ((cx * cx + cy * cy + cz * cz) <= (rs[i] * rs[i]));
+			}
+		}
+
+		/**
+		 * Radius around an object's midPos that SegmentSpheresPreTest has
+		 * to use for volume <v> (which may be offset from midPos), with some
+		 * slack for rounding differences to the transform used by DetectHit;
+		 * so large that nothing is culled for volumes it can not bound.
+		 */
+		static float GetPreTestRadius(const CollisionVolume* v);
+
 	private:
 		// HITTEST_DISC helpers for DetectHit
 		static bool Collision(const CollisionVolume* v, const CSolidObject* u, const float3 p, CollisionQuery* q);
@@ -99,6 +147,10 @@ class CCollisionHandler {
 		static bool Collision(const CollisionVolume* v, const CMatrix44f& m, const float3& p);
 		static bool CollisionFootPrint(const CSolidObject* o, const float3& p);
 
+		static bool IntersectPieceTree(const CUnit* u, const float3& p0, const float3& p1, CollisionQuery* q);
+		static void IntersectPieceTreeHelper(LocalModelPiece* lmp, CMatrix44f mat, const float3& p0, const float3& p1, std::list<CollisionQuery>* hits);
+
+	public:
 		/**
 		 * Test if a ray intersects a volume.
 		 * @param v volume
@@ -107,10 +159,6 @@ class CCollisionHandler {
 		 * @param p1 end of ray (in world-coordinates)
 		 */
 		static bool Intersect(const CollisionVolume* v, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* q);
-		static bool IntersectPieceTree(const CUnit* u, const float3& p0, const float3& p1, CollisionQuery* q);
-		static void IntersectPieceTreeHelper(LocalModelPiece* lmp, CMatrix44f mat, const float3& p0, const float3& p1, std::list<CollisionQuery>* hits);
-
-	public:
 		static bool IntersectEllipsoid(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* q);
 		static bool IntersectCylinder(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* q);
 		static bool IntersectBox(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* q);
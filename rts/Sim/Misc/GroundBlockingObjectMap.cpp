@@ -1,6 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include <assert.h>
+#include <algorithm>
 
 #include "GroundBlockingObjectMap.h"
 
@@ -9,14 +10,22 @@
 #include "Sim/Objects/SolidObject.h"
 #include "Sim/Objects/SolidObjectDef.h"
 #include "Sim/Path/IPathManager.h"
-#include "System/creg/STL_Map.h"
 #include "lib/gml/gmlmut.h"
 
 CGroundBlockingObjectMap* groundBlockingObjectMap;
 
 CR_BIND(CGroundBlockingObjectMap, (1))
 CR_REG_METADATA(CGroundBlockingObjectMap, (
-	CR_MEMBER(groundBlockingMap)
+	CR_MEMBER(groundBlockingMap),
+	CR_MEMBER(overflowPool),
+	CR_MEMBER(freeOverflowSlots)
+));
+
+CR_BIND(CGroundBlockingObjectMap::CellStorage, )
+CR_REG_METADATA_SUB(CGroundBlockingObjectMap, CellStorage, (
+	CR_MEMBER(objects),
+	CR_MEMBER(numObjects),
+	CR_MEMBER(overflowIdx)
 ));
 
 
@@ -30,6 +39,95 @@ inline static const int GetObjectID(CSolidObject* obj)
 }
 
 
+/**
+  * Inserts <object> into <cell> keeping the objects sorted by ID,
+  * does nothing if the object is already present (like the former
+  * std::map<int, CSolidObject*>::operator[] did).
+  */
+void CGroundBlockingObjectMap::AddCellObject(CellStorage& cell, CSolidObject* object, int objID)
+{
+	CSolidObject** objects = const_cast<CSolidObject**>(GetCellObjects(cell));
+
+	unsigned int idx = 0;
+
+	for (; idx < cell.numObjects; idx++) {
+		if (objects[idx] == object)
+			return;
+		if (GetObjectID(objects[idx]) > objID)
+			break;
+	}
+
+	if (cell.overflowIdx == -1 && cell.numObjects == CELL_INLINE_OBJECTS) {
+		// move the cell's objects into an overflow slot
+		if (freeOverflowSlots.empty()) {
+			cell.overflowIdx = overflowPool.size();
+			overflowPool.push_back(std::vector<CSolidObject*>());
+		} else {
+			cell.overflowIdx = freeOverflowSlots.back();
+			freeOverflowSlots.pop_back();
+		}
+
+		std::vector<CSolidObject*>& slot = overflowPool[cell.overflowIdx];
+
+		slot.assign(&cell.objects[0], &cell.objects[0] + CELL_INLINE_OBJECTS);
+		slot.insert(slot.begin() + idx, object);
+
+		for (unsigned int i = 0; i < CELL_INLINE_OBJECTS; i++) {
+			cell.objects[i] = NULL;
+		}
+	} else if (cell.overflowIdx != -1) {
+		std::vector<CSolidObject*>& slot = overflowPool[cell.overflowIdx];
+		slot.insert(slot.begin() + idx, object);
+	} else {
+		for (unsigned int i = cell.numObjects; i > idx; i--) {
+			cell.objects[i] = cell.objects[i - 1];
+		}
+
+		cell.objects[idx] = object;
+	}
+
+	cell.numObjects += 1;
+}
+
+void CGroundBlockingObjectMap::DelCellObject(CellStorage& cell, CSolidObject* object)
+{
+	if (cell.overflowIdx == -1) {
+		for (unsigned int idx = 0; idx < cell.numObjects; idx++) {
+			if (cell.objects[idx] != object)
+				continue;
+
+			for (unsigned int i = idx + 1; i < cell.numObjects; i++) {
+				cell.objects[i - 1] = cell.objects[i];
+			}
+
+			cell.objects[cell.numObjects -= 1] = NULL;
+			return;
+		}
+
+		return;
+	}
+
+	std::vector<CSolidObject*>& slot = overflowPool[cell.overflowIdx];
+	std::vector<CSolidObject*>::iterator it = std::find(slot.begin(), slot.end(), object);
+
+	if (it == slot.end())
+		return;
+
+	slot.erase(it);
+	cell.numObjects -= 1;
+
+	if (cell.numObjects > CELL_INLINE_OBJECTS)
+		return;
+
+	// few enough objects left to move them back in-place
+	std::copy(slot.begin(), slot.end(), &cell.objects[0]);
+
+	slot.clear();
+	freeOverflowSlots.push_back(cell.overflowIdx);
+	cell.overflowIdx = -1;
+}
+
+
 void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object)
 {
 	if (object->blockMap != NULL) {
@@ -58,8 +156,7 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object)
 
 	for (int zSqr = minZSqr; zSqr < maxZSqr; zSqr++) {
 		for (int xSqr = minXSqr; xSqr < maxXSqr; xSqr++) {
-			BlockingMapCell& cell = groundBlockingMap[xSqr + zSqr * gs->mapx];
-			cell[objID] = object;
+			AddCellObject(groundBlockingMap[xSqr + zSqr * gs->mapx], object, objID);
 		}
 	}
 
@@ -95,8 +192,7 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object, con
 			const float3 testPos = float3(x, 0.0f, z) * SQUARE_SIZE;
 
 			if (object->GetGroundBlockingMaskAtPos(testPos) & mask) {
-				BlockingMapCell& cell = groundBlockingMap[x + (z) * gs->mapx];
-				cell[objID] = object;
+				AddCellObject(groundBlockingMap[x + (z) * gs->mapx], object, objID);
 			}
 		}
 	}
@@ -112,8 +208,6 @@ void CGroundBlockingObjectMap::RemoveGroundBlockingObject(CSolidObject* object)
 {
 	GML_STDMUTEX_LOCK(block); // RemoveGroundBlockingObject
 
-	const int objID = GetObjectID(object);
-
 	const int bx = object->mapPos.x;
 	const int bz = object->mapPos.y;
 	const int sx = object->xsize;
@@ -125,8 +219,7 @@ void CGroundBlockingObjectMap::RemoveGroundBlockingObject(CSolidObject* object)
 		for (int x = bx; x < bx + sx; ++x) {
 			const int idx = x + z * gs->mapx;
 
-			BlockingMapCell& cell = groundBlockingMap[idx];
-			cell.erase(objID);
+			DelCellObject(groundBlockingMap[idx], object);
 		}
 	}
 
@@ -145,13 +238,13 @@ void CGroundBlockingObjectMap::RemoveGroundBlockingObject(CSolidObject* object)
 CSolidObject* CGroundBlockingObjectMap::GroundBlockedUnsafe(int mapSquare) const {
 	GML_STDMUTEX_LOCK(block); // GroundBlockedUnsafe
 
-	const BlockingMapCell& cell = groundBlockingMap[mapSquare];
+	const CellStorage& cell = groundBlockingMap[mapSquare];
 
-	if (cell.empty()) {
+	if (cell.numObjects == 0) {
 		return NULL;
 	}
 
-	return cell.begin()->second;
+	return (GetCellObjects(cell)[0]);
 }
 
 
@@ -179,25 +272,19 @@ bool CGroundBlockingObjectMap::GroundBlocked(int x, int z, CSolidObject* ignoreO
 
 	GML_STDMUTEX_LOCK(block); // GroundBlockedUnsafe
 
-	if (groundBlockingMap[mapSquare].empty()) {
+	const CellStorage& cell = groundBlockingMap[mapSquare];
+
+	if (cell.numObjects == 0) {
 		return false;
 	}
 
-	const int objID = GetObjectID(ignoreObj);
-
-	const BlockingMapCell& cell = groundBlockingMap[mapSquare];
-	BlockingMapCellIt it = cell.begin();
-	if (it != cell.end()) {
-		if (it->first != objID) {
-			// there are other objects blocking the square
-			return true;
-		} else {
-			// ignoreObj is in the square. Check if there are other objects, too
-			return (cell.size() >= 2);
-		}
+	if (GetCellObjects(cell)[0] != ignoreObj) {
+		// there are other objects blocking the square
+		return true;
 	}
 
-	return false;
+	// ignoreObj is in the square. Check if there are other objects, too
+	return (cell.numObjects >= 2);
 }
 
 
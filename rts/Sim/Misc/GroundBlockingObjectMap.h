@@ -3,21 +3,50 @@
 #ifndef GROUNDBLOCKINGOBJECTMAP_H
 #define GROUNDBLOCKINGOBJECTMAP_H
 
-#include <map>
+#include <vector>
 #include "System/creg/creg_cond.h"
 
 #include "Sim/Objects/SolidObject.h"
 #include "System/float3.h"
 
 
-typedef std::map<int, CSolidObject*> BlockingMapCell;
-typedef BlockingMapCell::const_iterator BlockingMapCellIt;
-typedef std::vector<BlockingMapCell> BlockingMap;
+/**
+ * Read-only view of the objects blocking one map square, sorted by
+ * increasing blocking-map ID (so the first object is the top-most).
+ * Only valid until the next change to the blocking-map.
+ */
+class BlockingMapCell
+{
+public:
+	BlockingMapCell(CSolidObject* const* objs, unsigned int numObjs)
+		: objects(objs)
+		, numObjects(numObjs)
+	{}
+
+	bool empty() const { return (numObjects == 0); }
+	unsigned int size() const { return numObjects; }
+
+	CSolidObject* operator [] (unsigned int i) const { return objects[i]; }
+
+	bool Contains(const CSolidObject* obj) const {
+		for (unsigned int i = 0; i < numObjects; i++) {
+			if (objects[i] == obj)
+				return true;
+		}
+
+		return false;
+	}
+
+private:
+	CSolidObject* const* objects;
+	unsigned int numObjects;
+};
 
 
 class CGroundBlockingObjectMap
 {
 	CR_DECLARE_STRUCT(CGroundBlockingObjectMap);
+	CR_DECLARE_SUB(CellStorage);
 
 public:
 	CGroundBlockingObjectMap(int numSquares) {
@@ -45,15 +74,52 @@ public:
 	bool GroundBlocked(const float3& pos, CSolidObject* ignoreObj) const;
 
 	// for full thread safety, access via GetCell would need to be mutexed, but it appears only sim thread uses it
-	const BlockingMapCell& GetCell(int mapSquare) const {
-		return groundBlockingMap[mapSquare];
+	BlockingMapCell GetCell(int mapSquare) const {
+		const CellStorage& cell = groundBlockingMap[mapSquare];
+		return (BlockingMapCell(GetCellObjects(cell), cell.numObjects));
 	}
 
 private:
+	static const unsigned int CELL_INLINE_OBJECTS = 2;
+
+	/**
+	 * Per-square storage: up to CELL_INLINE_OBJECTS objects are stored
+	 * in-place, a square with more moves all of its objects into a slot
+	 * of the overflow-pool (which is rare, most squares hold zero or one
+	 * object)
+	 */
+	struct CellStorage {
+		CR_DECLARE_STRUCT(CellStorage);
+
+		CellStorage(): numObjects(0), overflowIdx(-1) {
+			for (unsigned int i = 0; i < CELL_INLINE_OBJECTS; i++) {
+				objects[i] = NULL;
+			}
+		}
+
+		CSolidObject* objects[CELL_INLINE_OBJECTS];
+
+		unsigned int numObjects;
+		int overflowIdx;
+	};
+
+	CSolidObject* const* GetCellObjects(const CellStorage& cell) const {
+		if (cell.overflowIdx == -1)
+			return &cell.objects[0];
+
+		return &overflowPool[cell.overflowIdx][0];
+	}
+
+	void AddCellObject(CellStorage& cell, CSolidObject* object, int objID);
+	void DelCellObject(CellStorage& cell, CSolidObject* object);
+
 	bool CheckYard(CSolidObject* yardUnit, const YardMapStatus& mask) const;
 
 private:
-	BlockingMap groundBlockingMap;
+	std::vector<CellStorage> groundBlockingMap;
+
+	std::vector< std::vector<CSolidObject*> > overflowPool;
+	std::vector<int> freeOverflowSlots;
 };
 
 extern CGroundBlockingObjectMap* groundBlockingObjectMap;
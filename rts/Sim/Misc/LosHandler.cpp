@@ -13,6 +13,7 @@
 #include "Map/ReadMap.h"
 #include "System/Log/ILog.h"
 #include "System/TimeProfiler.h"
+#include "System/Rectangle.h"
 #include "System/creg/STL_Deque.h"
 #include "System/creg/STL_List.h"
 
@@ -25,6 +26,7 @@ CR_BIND(CLosHandler::DelayedInstance, );
 
 CR_REG_METADATA(LosInstance,(
 		CR_IGNORED(losSquares),
+		CR_IGNORED(losRayOffsets),
 		CR_MEMBER(losSize),
 		CR_MEMBER(airLosSize),
 		CR_MEMBER(refCount),
@@ -52,6 +54,9 @@ CR_REG_METADATA(CLosHandler,(
 		CR_MEMBER(instanceHash),
 		CR_MEMBER(toBeDeleted),
 		CR_MEMBER(delayQue),
+		CR_MEMBER(terrainChanges),
+		CR_IGNORED(recastRemovedSquares),
+		CR_IGNORED(recastAddedSquares),
 		CR_RESERVED(8),
 		CR_POSTLOAD(PostLoad)
 		));
@@ -188,7 +193,11 @@ void CLosHandler::LosAdd(LosInstance* instance)
 	assert(instance);
 	assert(teamHandler->IsValidAllyTeam(instance->allyteam));
 
-	losAlgo.LosAdd(instance->basePos, instance->losSize, instance->baseHeight, instance->losSquares);
+	// instances keep their squares while unused, only
+	// ray-cast if they were never computed or cleared
+	if (instance->losSquares.empty()) {
+		losAlgo.LosAdd(instance->basePos, instance->losSize, instance->baseHeight, instance->losSquares, &instance->losRayOffsets);
+	}
 
 	if (instance->losSize > 0) { losMaps[instance->allyteam].AddMapSquares(instance->losSquares, instance->allyteam, 1); }
 	if (instance->airLosSize > 0) { airLosMaps[instance->allyteam].AddMapArea(instance->baseAirPos, instance->allyteam, instance->airLosSize, 1); }
@@ -272,8 +281,88 @@ void CLosHandler::CleanupInstance(LosInstance* instance)
 }
 
 
+void CLosHandler::LosRecast(LosInstance* instance, const SRectangle& losRect)
+{
+	if (instance->losSize <= 0)
+		return;
+
+	if (instance->refCount == 0) {
+		// not on the LOS-map; just make the next LosAdd re-cast everything
+		instance->losSquares.clear();
+		return;
+	}
+
+	recastRemovedSquares.clear();
+	recastAddedSquares.clear();
+
+	const int numRays = losAlgo.LosRecast(
+		instance->basePos, instance->losSize, instance->baseHeight, losRect,
+		instance->losSquares, instance->losRayOffsets,
+		recastRemovedSquares, recastAddedSquares
+	);
+
+	if (numRays == 0)
+		return;
+
+	// add before removing so that squares seen by both the old
+	// and new rays never drop to zero (and re-enter LOS) in between
+	losMaps[instance->allyteam].AddMapSquares(recastAddedSquares, instance->allyteam, 1);
+	losMaps[instance->allyteam].AddMapSquares(recastRemovedSquares, instance->allyteam, -1);
+}
+
+
+void CLosHandler::TerrainChanged(int x1, int z1, int x2, int z2)
+{
+	// the heightmap update touches one extra square on each side (see
+	// CReadMap::UpdateHeightMapSynced), convert that to LOS-map squares
+	SRectangle losRect(
+		std::max(0, x1 - 1) >> losMipLevel,
+		std::max(0, z1 - 1) >> losMipLevel,
+		std::min(gs->mapx, x2 + 1) >> losMipLevel,
+		std::min(gs->mapy, z2 + 1) >> losMipLevel
+	);
+
+	terrainChanges.push_back(losRect);
+}
+
+
+void CLosHandler::UpdateTerrainChanges()
+{
+	if (terrainChanges.empty())
+		return;
+
+	SCOPED_TIMER("LOSHandler::TerrainChanged");
+
+	// iterate in hash-order, which is the same on all clients
+	for (int a = 0; a < LOSHANDLER_MAGIC_PRIME; ++a) {
+		for (std::list<LosInstance*>::iterator li = instanceHash[a].begin(); li != instanceHash[a].end(); ++li) {
+			LosInstance* instance = *li;
+
+			if (instance->losSize <= 0)
+				continue;
+
+			const int2& p = instance->basePos;
+			const int r = instance->losSize;
+
+			for (std::vector<SRectangle>::const_iterator ri = terrainChanges.begin(); ri != terrainChanges.end(); ++ri) {
+				if ((p.x + r) < ri->x1 || (p.x - r) > ri->x2) { continue; }
+				if ((p.y + r) < ri->y1 || (p.y - r) > ri->y2) { continue; }
+
+				LosRecast(instance, *ri);
+			}
+		}
+	}
+
+	terrainChanges.clear();
+}
+
+
 void CLosHandler::Update()
 {
+	SCOPED_TIMER("LOSHandler::Update");
+
+	UpdateTerrainChanges();
+
 	while (!delayQue.empty() && delayQue.front().timeoutTime < gs->frameNum) {
 		FreeInstance(delayQue.front().instance);
 		delayQue.pop_front();
@@ -26,6 +26,11 @@
  * is not particularly fast and more importantly 2) the terrain may have changed
  * between the LosAdd and the moment we want to undo the LosAdd.
  *
+ * The squares are also kept while an instance is unused (refCount 0) so that
+ * re-using it does not require a new ray-cast, and they are grouped per ray
+ * (see losRayOffsets) so that a terrain change only re-casts the rays passing
+ * through the changed area (CLosHandler::TerrainChanged).
+ *
  * LosInstances may be shared between multiple units. Reference counting is
  * used to track how many units currently use one instance.
  *
@@ -66,6 +71,8 @@ public:
 	{}
 
  	std::vector<int> losSquares;
+	/// index into losSquares of the first square of each ray, see CLosAlgorithm::LosAdd
+	std::vector<int> losRayOffsets;
 	int losSize;
 	int airLosSize;
 	int refCount;
@@ -106,9 +113,26 @@ class CLosHandler : public boost::noncopyable
 	CR_DECLARE_SUB(DelayedInstance);
 
 public:
+	/**
+	 * Moves the unit's LOS to its current LOS-map square. Moves are not
+	 * re-cast incrementally: every ray starts at the base square, so none
+	 * of the old instance's rays are valid at the new one. The new square's
+	 * footprint is only taken without ray-casting if a (possibly unused)
+	 * instance with the same parameters is still cached there.
+	 * @param redoCurrent re-cast the unit's current instance in place
+	 */
 	void MoveUnit(CUnit* unit, bool redoCurrent);
 	void FreeInstance(LosInstance* instance);
 
+	/**
+	 * Marks the heightmap rectangle (inclusive, in heightmap squares) as
+	 * changed; LosInstances whose footprint touches it re-cast the affected
+	 * rays during the next Update. This covers every instance, shared and
+	 * unused ones included, so terrain changes need no MoveUnit(unit, true)
+	 * calls for the units around them.
+	 */
+	void TerrainChanged(int x1, int z1, int x2, int z2);
+
 	inline bool InLos(const CWorldObject* object, int allyTeam) const {
 		if (object->alwaysVisible || gs->globalLOS[allyTeam])
 			return true;
@@ -188,6 +212,8 @@ private:
 
 	void PostLoad();
 	void LosAdd(LosInstance* instance);
+	void LosRecast(LosInstance* instance, const SRectangle& losRect);
+	void UpdateTerrainChanges();
 	int GetHashNum(CUnit* unit);
 	void AllocInstance(LosInstance* instance);
 	void CleanupInstance(LosInstance* instance);
@@ -206,6 +232,12 @@ private:
 
 	std::deque<DelayedInstance> delayQue;
 
+	/// changed terrain areas (in LOS-map squares) not yet processed by Update
+	std::vector<SRectangle> terrainChanges;
+
+	std::vector<int> recastRemovedSquares;
+	std::vector<int> recastAddedSquares;
+
 public:
 	void Update();
 	void DelayedFreeInstance(LosInstance* instance);
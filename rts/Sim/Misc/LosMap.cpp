@@ -305,22 +305,6 @@ void CLosTables::DrawLine(char* PaintTable, int x, int y, int Size)
 //////////////////////////////////////////////////////////////////////
 
 
-void CLosAlgorithm::LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares)
-{
-	if (radius <= 0) { return; }
-
-	pos.x = Clamp(pos.x, 0, size.x - 1);
-	pos.y = Clamp(pos.y, 0, size.y - 1);
-
-	if ((pos.x - radius < radius) || (pos.x + radius >= size.x - radius) || // FIXME: This additional margin is due to a suspect bug in losalgorithm
-	    (pos.y - radius < radius) || (pos.y + radius >= size.y - radius)) { // causing rare crash with big units such as arm Colossus
-		SafeLosAdd(pos, radius, baseHeight, squares);
-	} else {
-		UnsafeLosAdd(pos, radius, baseHeight, squares);
-	}
-}
-
-
 #define MAP_SQUARE(pos) \
 	((pos).y * size.x + (pos).x)
 
@@ -337,77 +321,184 @@ void CLosAlgorithm::LosAdd(int2 pos, int radius, float baseHeight, std::vector<i
 	}
 
 
-void CLosAlgorithm::UnsafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares)
+/// maps a point on a LOS table line into one of the four quadrants
+static inline int2 GetRayOffset(const int2& p, const int quadrant)
 {
+	switch (quadrant) {
+		case 0: { return int2( p.x,  p.y); } break;
+		case 1: { return int2(-p.x, -p.y); } break;
+		case 2: { return int2( p.y, -p.x); } break;
+		default: {} break;
+	}
+
+	return int2(-p.y, p.x);
+}
+
+/**
+ * Casts a single ray: every line of a LOS table is mirrored into the four
+ * quadrants around the base square, and each of those is an independent
+ * ray (with its own maximum angle) whose visible squares are appended
+ * to <squares>.
+ */
+static inline void CastLosRay(
+	const int2 size,
+	const float minMaxAng,
+	const float extraHeight,
+	const float* heightmap,
+	const int2 pos,
+	const int mapSquare,
+	const float baseHeight,
+	const LosLine& line,
+	const int quadrant,
+	const bool safe,
+	std::vector<int>& squares
+) {
+	float maxAng = minMaxAng;
+	float r = 1;
+
+	for (LosLine::const_iterator linei = line.begin(); linei != line.end(); ++linei) {
+		const float invR = 1.0f / r;
+		const int2 d = GetRayOffset(*linei, quadrant);
+
+		r++;
+
+		if (safe) {
+			if ((pos.x + d.x < 0) || (pos.x + d.x >= size.x)) { continue; }
+			if ((pos.y + d.y < 0) || (pos.y + d.y >= size.y)) { continue; }
+		}
+
+		LOS_ADD(mapSquare + d.x + d.y * size.x, maxAng);
+	}
+}
+
+
+bool CLosAlgorithm::NeedsSafeLosAdd(int2 pos, int radius) const
+{
+	// FIXME: the additional margin is due to a suspect bug in losalgorithm
+	// causing rare crash with big units such as arm Colossus
+	return
+		(pos.x - radius < radius) || (pos.x + radius >= size.x - radius) ||
+		(pos.y - radius < radius) || (pos.y + radius >= size.y - radius);
+}
+
+
+void CLosAlgorithm::LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares, std::vector<int>* rayOffsets)
+{
+	if (radius <= 0) { return; }
+
+	pos.x = Clamp(pos.x, 0, size.x - 1);
+	pos.y = Clamp(pos.y, 0, size.y - 1);
+
+	const bool safe = NeedsSafeLosAdd(pos, radius);
 	const int mapSquare = MAP_SQUARE(pos);
 	const LosTable& table = CLosTables::GetForLosSize(radius);
 
 	baseHeight += heightmap[mapSquare];
 
 	size_t neededSpace = squares.size() + 1;
-	for(LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
+	for (LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
 		neededSpace += li->size() * 4;
 	}
 	squares.reserve(neededSpace);
-
 	squares.push_back(mapSquare);
 
-	for(LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
-		const LosLine& line = *li;
-		float maxAng1 = minMaxAng;
-		float maxAng2 = minMaxAng;
-		float maxAng3 = minMaxAng;
-		float maxAng4 = minMaxAng;
-		float r = 1;
-
-		for(LosLine::const_iterator linei = line.begin(); linei != line.end(); ++linei) {
-			const float invR = 1.0f / r;
+	if (rayOffsets != NULL) {
+		rayOffsets->clear();
+		rayOffsets->reserve(table.size() * 4 + 1);
+	}
 
-			LOS_ADD(mapSquare + linei->x + linei->y * size.x, maxAng1);
-			LOS_ADD(mapSquare - linei->x - linei->y * size.x, maxAng2);
-			LOS_ADD(mapSquare - linei->x * size.x + linei->y, maxAng3);
-			LOS_ADD(mapSquare + linei->x * size.x - linei->y, maxAng4);
+	for (LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
+		for (int q = 0; q < 4; q++) {
+			if (rayOffsets != NULL) {
+				rayOffsets->push_back(squares.size());
+			}
 
-			r++;
+			CastLosRay(size, minMaxAng, extraHeight, heightmap, pos, mapSquare, baseHeight, *li, q, safe, squares);
 		}
 	}
+
+	if (rayOffsets != NULL) {
+		rayOffsets->push_back(squares.size());
+	}
 }
 
 
-void CLosAlgorithm::SafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares)
-{
-	const int mapSquare = MAP_SQUARE(pos);
+int CLosAlgorithm::LosRecast(
+	int2 pos,
+	int radius,
+	float baseHeight,
+	const SRectangle& rect,
+	std::vector<int>& squares,
+	std::vector<int>& rayOffsets,
+	std::vector<int>& removed,
+	std::vector<int>& added
+) {
+	if (radius <= 0) { return 0; }
+
+	pos.x = Clamp(pos.x, 0, size.x - 1);
+	pos.y = Clamp(pos.y, 0, size.y - 1);
+
 	const LosTable& table = CLosTables::GetForLosSize(radius);
+	const int numRays = table.size() * 4;
+
+	const bool centerInRect =
+		(pos.x >= rect.x1 && pos.x <= rect.x2) &&
+		(pos.y >= rect.y1 && pos.y <= rect.y2);
+
+	if (centerInRect || squares.empty() || rayOffsets.size() != size_t(numRays + 1)) {
+		// the base height changed (or we have no per-ray data), redo everything
+		removed.insert(removed.end(), squares.begin(), squares.end());
+		squares.clear();
+		LosAdd(pos, radius, baseHeight, squares, &rayOffsets);
+		added.insert(added.end(), squares.begin(), squares.end());
+		return numRays;
+	}
+
+	const bool safe = NeedsSafeLosAdd(pos, radius);
+	const int mapSquare = MAP_SQUARE(pos);
 
 	baseHeight += heightmap[mapSquare];
 
-	squares.push_back(mapSquare);
+	std::vector<int> newSquares;
+	std::vector<int> newRayOffsets;
+	newSquares.reserve(squares.size());
+	newRayOffsets.reserve(rayOffsets.size());
+	newSquares.push_back(mapSquare);
 
-	for (LosTable::const_iterator li = table.begin(); li != table.end(); ++li) {
-		const LosLine& line = *li;
-		float maxAng1 = minMaxAng;
-		float maxAng2 = minMaxAng;
-		float maxAng3 = minMaxAng;
-		float maxAng4 = minMaxAng;
-		float r = 1;
-
-		for(LosLine::const_iterator linei = line.begin(); linei != line.end(); ++linei) {
-			const float invR = 1.0f / r;
-
-			if ((pos.x + linei->x < size.x) && (pos.y + linei->y < size.y)) {
-				LOS_ADD(mapSquare + linei->x + linei->y * size.x, maxAng1);
-			}
-			if ((pos.x - linei->x >= 0) && (pos.y - linei->y >= 0)) {
-				LOS_ADD(mapSquare - linei->x - linei->y * size.x, maxAng2);
-			}
-			if ((pos.x + linei->y < size.x) && (pos.y - linei->x >= 0)) {
-				LOS_ADD(mapSquare - linei->x * size.x + linei->y, maxAng3);
-			}
-			if ((pos.x - linei->y >= 0) && (pos.y + linei->x < size.y)) {
-				LOS_ADD(mapSquare + linei->x * size.x - linei->y, maxAng4);
-			}
+	int numRecastRays = 0;
+
+	for (int r = 0; r < numRays; r++) {
+		const LosLine& line = table[r >> 2];
+		const int quadrant = r & 3;
+
+		const std::vector<int>::const_iterator oldRayBeg = squares.begin() + rayOffsets[r    ];
+		const std::vector<int>::const_iterator oldRayEnd = squares.begin() + rayOffsets[r + 1];
 
-			r++;
+		newRayOffsets.push_back(newSquares.size());
+
+		// rays are straight lines starting at the base square,
+		// so their bounding-box is spanned by the last point
+		const int2 d = GetRayOffset(line.back(), quadrant);
+		const int rx1 = pos.x + std::min(0, d.x), rx2 = pos.x + std::max(0, d.x);
+		const int rz1 = pos.y + std::min(0, d.y), rz2 = pos.y + std::max(0, d.y);
+
+		if (rx2 < rect.x1 || rx1 > rect.x2 || rz2 < rect.y1 || rz1 > rect.y2) {
+			newSquares.insert(newSquares.end(), oldRayBeg, oldRayEnd);
+			continue;
 		}
+
+		const size_t newRayBeg = newSquares.size();
+
+		CastLosRay(size, minMaxAng, extraHeight, heightmap, pos, mapSquare, baseHeight, line, quadrant, safe, newSquares);
+
+		removed.insert(removed.end(), oldRayBeg, oldRayEnd);
+		added.insert(added.end(), newSquares.begin() + newRayBeg, newSquares.end());
+		numRecastRays++;
 	}
+
+	newRayOffsets.push_back(newSquares.size());
+
+	squares.swap(newSquares);
+	rayOffsets.swap(newRayOffsets);
+	return numRecastRays;
 }
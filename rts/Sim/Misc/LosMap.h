@@ -7,6 +7,7 @@
 
 #include <vector>
 #include "System/Vec2.h"
+#include "System/Rectangle.h"
 
 /// map containing counts of how many units have Line Of Sight (LOS) to each square
 class CLosMap
@@ -52,11 +53,29 @@ public:
 	CLosAlgorithm(int2 size, float minMaxAng, float extraHeight, const float* heightmap)
 	: size(size), minMaxAng(minMaxAng), extraHeight(extraHeight), heightmap(heightmap) {}
 
-	void LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares);
+	/**
+	 * Ray-casts the LOS footprint around <pos> and appends the visible squares
+	 * to <squares>. The center square comes first, followed by the squares of
+	 * each ray in turn; if <rayOffsets> is given, it receives the index into
+	 * <squares> at which every ray starts (plus one past-the-end entry) so the
+	 * result can later be patched by LosRecast.
+	 */
+	void LosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares, std::vector<int>* rayOffsets = NULL);
+
+	/**
+	 * Re-casts only those rays of a footprint previously produced by LosAdd
+	 * (with ray offsets) that cross <rect> (inclusive, in LOS-map squares),
+	 * and updates <squares> and <rayOffsets> in place. The squares of the
+	 * old rays are appended to <removed>, those of the new rays to <added>.
+	 * Falls back to a full re-cast if the center square lies inside <rect>.
+	 * @return the number of rays that were re-cast
+	 */
+	int LosRecast(int2 pos, int radius, float baseHeight, const SRectangle& rect,
+		std::vector<int>& squares, std::vector<int>& rayOffsets,
+		std::vector<int>& removed, std::vector<int>& added);
 
 private:
-	void UnsafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares);
-	void SafeLosAdd(int2 pos, int radius, float baseHeight, std::vector<int>& squares);
+	bool NeedsSafeLosAdd(int2 pos, int radius) const;
 
 	int2 size;
 	float minMaxAng;
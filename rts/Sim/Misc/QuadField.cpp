@@ -10,7 +10,7 @@
 #include "Sim/Features/Feature.h"
 #include "Sim/Units/Unit.h"
 #include "Sim/Projectiles/Projectile.h"
-#include "System/creg/STL_List.h"
+#include "System/Util.h"
 
 #define REMOVE_PROJECTILE_FAST
 
@@ -43,7 +43,7 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 
 CQuadField* quadField = NULL;
 
-CQuadField::CQuadField()
+CQuadField::CQuadField(): unitQuadsVersion(0)
 {
 	numQuadsX = gs->mapx * SQUARE_SIZE / QUAD_SIZE;
 	numQuadsZ = gs->mapy * SQUARE_SIZE / QUAD_SIZE;
@@ -54,6 +54,9 @@ CQuadField::CQuadField()
 
 	baseQuads.resize(numQuadsX * numQuadsZ);
 	tempQuads.resize(std::max(numTempQuads, numQuadsX * numQuadsZ));
+
+	enemyUnitsQuery.enemyAllyTeams.resize(teamHandler->ActiveAllyTeams(), false);
+	enemyUnitsQuery.unitTempNums.resize(MAX_UNITS, 0);
 }
 
 CQuadField::~CQuadField()
@@ -146,7 +149,7 @@ std::vector<CUnit*> CQuadField::GetUnits(const float3& pos, float radius)
 	GetQuads(pos, radius, begQuad, endQuad);
 
 	std::vector<CUnit*> units;
-	std::list<CUnit*>::iterator ui;
+	std::vector<CUnit*>::const_iterator ui;
 
 	for (int* a = begQuad; a != endQuad; ++a) {
 		Quad& quad = baseQuads[*a];
@@ -163,6 +166,20 @@ std::vector<CUnit*> CQuadField::GetUnits(const float3& pos, float radius)
 }
 
 std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& pos, float radius, bool spherical)
+{
+	std::vector<CUnit*> units;
+	GetUnitsExact(units, pos, radius, spherical);
+	return units;
+}
+
+std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& mins, const float3& maxs)
+{
+	std::vector<CUnit*> units;
+	GetUnitsExact(units, mins, maxs);
+	return units;
+}
+
+void CQuadField::GetUnitsExact(std::vector<CUnit*>& units, const float3& pos, float radius, bool spherical)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetUnitsExact
 
@@ -173,11 +190,10 @@ std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& pos, float radius, b
 
 	GetQuads(pos, radius, begQuad, endQuad);
 
-	std::vector<CUnit*> units;
-	std::list<CUnit*>::iterator ui;
+	std::vector<CUnit*>::const_iterator ui;
 
 	for (int* a = begQuad; a != endQuad; ++a) {
-		Quad& quad = baseQuads[*a];
+		const Quad& quad = baseQuads[*a];
 
 		for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
 			if ((*ui)->tempNum == tempNum) { continue; }
@@ -194,23 +210,20 @@ std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& pos, float radius, b
 			units.push_back(*ui);
 		}
 	}
-
-	return units;
 }
 
-std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& mins, const float3& maxs)
+void CQuadField::GetUnitsExact(std::vector<CUnit*>& units, const float3& mins, const float3& maxs)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetUnitsExact
 
 	const std::vector<int>& quads = GetQuadsRectangle(mins, maxs);
 	const int tempNum = gs->tempNum++;
 
-	std::vector<CUnit*> units;
 	std::vector<int>::const_iterator qi;
 
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		std::list<CUnit*>& quadUnits = baseQuads[*qi].units;
-		std::list<CUnit*>::iterator ui;
+		const std::vector<CUnit*>& quadUnits = baseQuads[*qi].units;
+		std::vector<CUnit*>::const_iterator ui;
 
 		for (ui = quadUnits.begin(); ui != quadUnits.end(); ++ui) {
 			CUnit* unit = *ui;
@@ -224,8 +237,6 @@ std::vector<CUnit*> CQuadField::GetUnitsExact(const float3& mins, const float3&
 			units.push_back(unit);
 		}
 	}
-
-	return units;
 }
 
 
@@ -386,6 +397,69 @@ unsigned int CQuadField::GetQuadsOnRay(float3 start, float3 dir, float length, i
 
 
 
+const std::vector<CUnit*>& CQuadField::GetEnemyUnitsInQuads(const float3& pos, float radius, int allyTeam)
+{
+	GML_RECMUTEX_LOCK(qnum); // GetEnemyUnitsInQuads
+
+	EnemyUnitsQuery& query = enemyUnitsQuery;
+
+	int* begQuad = &tempQuads[0];
+	int* endQuad = &tempQuads[0];
+
+	GetQuads(pos, radius, begQuad, endQuad);
+
+	bool sameQuery =
+		query.valid &&
+		(query.unitQuadsVersion == unitQuadsVersion) &&
+		(query.quads.size() == (endQuad - begQuad)) &&
+		std::equal(begQuad, endQuad, query.quads.begin());
+
+	for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
+		const bool isEnemy = !teamHandler->Ally(allyTeam, t);
+
+		sameQuery &= (query.enemyAllyTeams[t] == isEnemy);
+		query.enemyAllyTeams[t] = isEnemy;
+	}
+
+	if (sameQuery) {
+		return query.units;
+	}
+
+	query.valid = true;
+	query.unitQuadsVersion = unitQuadsVersion;
+	query.quads.assign(begQuad, endQuad);
+	query.units.clear();
+
+	if ((++query.tempNum) == 0) {
+		std::fill(query.unitTempNums.begin(), query.unitTempNums.end(), 0);
+		query.tempNum = 1;
+	}
+
+	for (int* qi = begQuad; qi != endQuad; ++qi) {
+		for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
+			if (!query.enemyAllyTeams[t]) {
+				continue;
+			}
+
+			const std::vector<CUnit*>& allyTeamUnits = baseQuads[*qi].teamUnits[t];
+
+			for (std::vector<CUnit*>::const_iterator ui = allyTeamUnits.begin(); ui != allyTeamUnits.end(); ++ui) {
+				CUnit* unit = *ui;
+
+				if (query.unitTempNums[unit->id] == query.tempNum) {
+					continue;
+				}
+
+				query.unitTempNums[unit->id] = query.tempNum;
+				query.units.push_back(unit);
+			}
+		}
+	}
+
+	return query.units;
+}
+
+
 void CQuadField::MovedUnit(CUnit* unit)
 {
 	const std::vector<int>& newQuads = GetQuads(unit->pos, unit->radius);
@@ -399,24 +473,19 @@ void CQuadField::MovedUnit(CUnit* unit)
 
 	GML_RECMUTEX_LOCK(quad); // MovedUnit
 
+	++unitQuadsVersion;
+
 	std::vector<int>::const_iterator qi;
 	for (qi = unit->quads.begin(); qi != unit->quads.end(); ++qi) {
-		std::list<CUnit*>& quadUnits     = baseQuads[*qi].units;
-		std::list<CUnit*>& quadAllyUnits = baseQuads[*qi].teamUnits[unit->allyteam];
-		std::list<CUnit*>::iterator ui;
-
-		ui = std::find(quadUnits.begin(), quadUnits.end(), unit);
-		if (ui != quadUnits.end())
-			quadUnits.erase(ui);
-
-		ui = std::find(quadAllyUnits.begin(), quadAllyUnits.end(), unit);
-		if (ui != quadAllyUnits.end())
-			quadAllyUnits.erase(ui);
+		VectorErase(baseQuads[*qi].units, unit);
+		VectorErase(baseQuads[*qi].teamUnits[unit->allyteam], unit);
 	}
 
+	// newest first, the order in which queries (and hence damage,
+	// targeting, ...) see the units of a quad is part of the sim
 	for (qi = newQuads.begin(); qi != newQuads.end(); ++qi) {
-		baseQuads[*qi].units.push_front(unit);
-		baseQuads[*qi].teamUnits[unit->allyteam].push_front(unit);
+		baseQuads[*qi].units.insert(baseQuads[*qi].units.begin(), unit);
+		baseQuads[*qi].teamUnits[unit->allyteam].insert(baseQuads[*qi].teamUnits[unit->allyteam].begin(), unit);
 	}
 	unit->quads = newQuads;
 }
@@ -425,19 +494,12 @@ void CQuadField::RemoveUnit(CUnit* unit)
 {
 	GML_RECMUTEX_LOCK(quad); // RemoveUnit
 
+	++unitQuadsVersion;
+
 	std::vector<int>::const_iterator qi;
 	for (qi = unit->quads.begin(); qi != unit->quads.end(); ++qi) {
-		std::list<CUnit*>& quadUnits     = baseQuads[*qi].units;
-		std::list<CUnit*>& quadAllyUnits = baseQuads[*qi].teamUnits[unit->allyteam];
-		std::list<CUnit*>::iterator ui;
-
-		ui = std::find(quadUnits.begin(), quadUnits.end(), unit);
-		if (ui != quadUnits.end())
-			quadUnits.erase(ui);
-
-		ui = std::find(quadAllyUnits.begin(), quadAllyUnits.end(), unit);
-		if (ui != quadAllyUnits.end())
-			quadAllyUnits.erase(ui);
+		VectorErase(baseQuads[*qi].units, unit);
+		VectorErase(baseQuads[*qi].teamUnits[unit->allyteam], unit);
 	}
 	unit->quads.clear();
 }
@@ -452,7 +514,7 @@ void CQuadField::AddFeature(CFeature* feature)
 
 	std::vector<int>::const_iterator qi;
 	for (qi = newQuads.begin(); qi != newQuads.end(); ++qi) {
-		baseQuads[*qi].features.push_front(feature);
+		baseQuads[*qi].features.insert(baseQuads[*qi].features.begin(), feature);
 	}
 }
 
@@ -464,20 +526,16 @@ void CQuadField::RemoveFeature(CFeature* feature)
 
 	std::vector<int>::const_iterator qi;
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		baseQuads[*qi].features.remove(feature);
+		VectorErase(baseQuads[*qi].features, feature);
 	}
 
 	#ifdef DEBUG_QUADFIELD
 	for (int x = 0; x < numQuadsX; x++) {
 		for (int z = 0; z < numQuadsZ; z++) {
 			const Quad& q = baseQuads[z * numQuadsX + x];
-			const std::list<CFeature*>& f = q.features;
-
-			std::list<CFeature*>::const_iterator fIt;
+			const std::vector<CFeature*>& f = q.features;
 
-			for (fIt = f.begin(); fIt != f.end(); ++fIt) {
-				assert((*fIt) != feature);
-			}
+			assert(std::find(f.begin(), f.end(), feature) == f.end());
 		}
 	}
 	#endif
@@ -514,10 +572,11 @@ void CQuadField::AddProjectile(CProjectile* p)
 	GML_RECMUTEX_LOCK(quad); // AddProjectile
 
 	Quad& q = baseQuads[numQuadsX * cellCoors.y + cellCoors.x];
-	std::list<CProjectile*>& projectiles = q.projectiles;
+	std::vector<CProjectile*>& projectiles = q.projectiles;
 
 	p->SetQuadFieldCellCoors(cellCoors);
-	p->SetQuadFieldCellIter(projectiles.insert(projectiles.end(), p));
+	p->SetQuadFieldCellIndex(projectiles.size());
+	projectiles.push_back(p);
 }
 
 void CQuadField::RemoveProjectile(CProjectile* p)
@@ -531,44 +590,57 @@ void CQuadField::RemoveProjectile(CProjectile* p)
 
 	Quad& q = baseQuads[cellIdx];
 
-	std::list<CProjectile*>& projectiles = q.projectiles;
-	std::list<CProjectile*>::iterator pi = p->GetQuadFieldCellIter();
+	std::vector<CProjectile*>& projectiles = q.projectiles;
+	unsigned int pi = p->GetQuadFieldCellIndex();
+
+	#ifndef REMOVE_PROJECTILE_FAST
+	pi = std::find(projectiles.begin(), projectiles.end(), p) - projectiles.begin();
+	#endif
+
+	if (pi < projectiles.size()) {
+		assert(projectiles[pi] == p);
+
+		// the stored index saves the search; keep the
+		// order of the others (queries see projectiles
+		// in insertion order) and fix up their indices
+		projectiles.erase(projectiles.begin() + pi);
 
-	#ifdef REMOVE_PROJECTILE_FAST
-	if (pi != projectiles.end()) {
-		// this is O(1) instead of O(n) and crucially
-		// important for projectiles, but less clean
-		projectiles.erase(pi);
+		for (; pi < projectiles.size(); ++pi) {
+			projectiles[pi]->SetQuadFieldCellIndex(pi);
+		}
 	} else {
 		assert(false);
 	}
-	#else
-	for (pi = projectiles.begin(); pi != projectiles.end(); ++pi) {
-		if ((*pi) == p) {
-			projectiles.erase(pi);
-			break;
-		}
-	}
-	#endif
 
-	p->SetQuadFieldCellIter(projectiles.end());
+	p->SetQuadFieldCellIndex(-1u);
 }
 
 
 
 std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& pos, float radius)
+{
+	std::vector<CFeature*> features;
+	GetFeaturesExact(features, pos, radius);
+	return features;
+}
+
+void CQuadField::GetFeaturesExact(std::vector<CFeature*>& features, const float3& pos, float radius)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetFeaturesExact
 
-	const std::vector<int>& quads = GetQuads(pos, radius);
 	const int tempNum = gs->tempNum++;
 
-	std::vector<CFeature*> features;
-	std::vector<int>::const_iterator qi;
-	std::list<CFeature*>::iterator fi;
+	int* begQuad = &tempQuads[0];
+	int* endQuad = &tempQuads[0];
 
-	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		for (fi = baseQuads[*qi].features.begin(); fi != baseQuads[*qi].features.end(); ++fi) {
+	GetQuads(pos, radius, begQuad, endQuad);
+
+	std::vector<CFeature*>::const_iterator fi;
+
+	for (int* a = begQuad; a != endQuad; ++a) {
+		const Quad& quad = baseQuads[*a];
+
+		for (fi = quad.features.begin(); fi != quad.features.end(); ++fi) {
 			const float totRad = radius + (*fi)->radius;
 
 			if ((*fi)->tempNum == tempNum) { continue; }
@@ -578,8 +650,6 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& pos, float rad
 			features.push_back(*fi);
 		}
 	}
-
-	return features;
 }
 
 std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& pos, float radius, bool spherical)
@@ -591,7 +661,7 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& pos, float rad
 
 	std::vector<CFeature*> features;
 	std::vector<int>::const_iterator qi;
-	std::list<CFeature*>::iterator fi;
+	std::vector<CFeature*>::const_iterator fi;
 	const float totRadSq = radius * radius;
 
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
@@ -619,10 +689,10 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& mins, const fl
 
 	std::vector<CFeature*> features;
 	std::vector<int>::const_iterator qi;
-	std::list<CFeature*>::iterator fi;
+	std::vector<CFeature*>::const_iterator fi;
 
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		std::list<CFeature*>& quadFeatures = baseQuads[*qi].features;
+		const std::vector<CFeature*>& quadFeatures = baseQuads[*qi].features;
 
 		for (fi = quadFeatures.begin(); fi != quadFeatures.end(); ++fi) {
 			CFeature* feature = *fi;
@@ -643,17 +713,25 @@ std::vector<CFeature*> CQuadField::GetFeaturesExact(const float3& mins, const fl
 
 
 std::vector<CProjectile*> CQuadField::GetProjectilesExact(const float3& pos, float radius)
+{
+	std::vector<CProjectile*> projectiles;
+	GetProjectilesExact(projectiles, pos, radius);
+	return projectiles;
+}
+
+void CQuadField::GetProjectilesExact(std::vector<CProjectile*>& projectiles, const float3& pos, float radius)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetProjectilesExact
 
-	const std::vector<int>& quads = GetQuads(pos, radius);
+	int* begQuad = &tempQuads[0];
+	int* endQuad = &tempQuads[0];
 
-	std::vector<CProjectile*> projectiles;
-	std::vector<int>::const_iterator qi;
-	std::list<CProjectile*>::iterator pi;
+	GetQuads(pos, radius, begQuad, endQuad);
 
-	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		std::list<CProjectile*>& quadProjectiles = baseQuads[*qi].projectiles;
+	std::vector<CProjectile*>::const_iterator pi;
+
+	for (int* a = begQuad; a != endQuad; ++a) {
+		const std::vector<CProjectile*>& quadProjectiles = baseQuads[*a].projectiles;
 
 		for (pi = quadProjectiles.begin(); pi != quadProjectiles.end(); ++pi) {
 			const float totRad = radius + (*pi)->radius;
@@ -665,8 +743,6 @@ std::vector<CProjectile*> CQuadField::GetProjectilesExact(const float3& pos, flo
 			projectiles.push_back(*pi);
 		}
 	}
-
-	return projectiles;
 }
 
 std::vector<CProjectile*> CQuadField::GetProjectilesExact(const float3& mins, const float3& maxs)
@@ -677,10 +753,10 @@ std::vector<CProjectile*> CQuadField::GetProjectilesExact(const float3& mins, co
 
 	std::vector<CProjectile*> projectiles;
 	std::vector<int>::const_iterator qi;
-	std::list<CProjectile*>::iterator pi;
+	std::vector<CProjectile*>::const_iterator pi;
 
 	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		std::list<CProjectile*>& quadProjectiles = baseQuads[*qi].projectiles;
+		const std::vector<CProjectile*>& quadProjectiles = baseQuads[*qi].projectiles;
 
 		for (pi = quadProjectiles.begin(); pi != quadProjectiles.end(); ++pi) {
 			CProjectile* projectile = *pi;
@@ -699,18 +775,30 @@ std::vector<CProjectile*> CQuadField::GetProjectilesExact(const float3& mins, co
 
 
 std::vector<CSolidObject*> CQuadField::GetSolidsExact(const float3& pos, float radius)
+{
+	std::vector<CSolidObject*> solids;
+	GetSolidsExact(solids, pos, radius);
+	return solids;
+}
+
+void CQuadField::GetSolidsExact(std::vector<CSolidObject*>& solids, const float3& pos, float radius)
 {
 	GML_RECMUTEX_LOCK(qnum); // GetSolidsExact
 
-	const std::vector<int>& quads = GetQuads(pos, radius);
 	const int tempNum = gs->tempNum++;
 
-	std::vector<CSolidObject*> solids;
-	std::vector<int>::const_iterator qi;
-	std::list<CUnit*>::iterator ui;
+	int* begQuad = &tempQuads[0];
+	int* endQuad = &tempQuads[0];
 
-	for (qi = quads.begin(); qi != quads.end(); ++qi) {
-		for (ui = baseQuads[*qi].units.begin(); ui != baseQuads[*qi].units.end(); ++ui) {
+	GetQuads(pos, radius, begQuad, endQuad);
+
+	std::vector<CUnit*>::const_iterator ui;
+	std::vector<CFeature*>::const_iterator fi;
+
+	for (int* a = begQuad; a != endQuad; ++a) {
+		const Quad& quad = baseQuads[*a];
+
+		for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
 			const float totRad = radius + (*ui)->radius;
 
 			if (!(*ui)->blocking) { continue; }
@@ -721,8 +809,7 @@ std::vector<CSolidObject*> CQuadField::GetSolidsExact(const float3& pos, float r
 			solids.push_back(*ui);
 		}
 
-		std::list<CFeature*>::iterator fi;
-		for (fi = baseQuads[*qi].features.begin(); fi != baseQuads[*qi].features.end(); ++fi) {
+		for (fi = quad.features.begin(); fi != quad.features.end(); ++fi) {
 			const float totRad = radius + (*fi)->radius;
 
 			if (!(*fi)->blocking) { continue; }
@@ -733,8 +820,6 @@ std::vector<CSolidObject*> CQuadField::GetSolidsExact(const float3& pos, float r
 			solids.push_back(*fi);
 		}
 	}
-
-	return solids;
 }
 
 
@@ -772,6 +857,97 @@ std::vector<int> CQuadField::GetQuadsRectangle(const float3& pos1, const float3&
 
 
 
+/// drops all but the first occurrence of each object, keeping their order
+template<typename T>
+static void RemoveDuplicates(std::vector<T*>& objects)
+{
+	const int tempNum = gs->tempNum++;
+
+	typename std::vector<T*>::iterator dst = objects.begin();
+	typename std::vector<T*>::const_iterator src;
+
+	for (src = objects.begin(); src != objects.end(); ++src) {
+		if ((*src)->tempNum == tempNum) { continue; }
+
+		(*src)->tempNum = tempNum;
+		*(dst++) = *src;
+	}
+
+	objects.erase(dst, objects.end());
+}
+
+void CQuadField::GetUnitsAndFeaturesExact(
+	const std::vector<float4>& spheres,
+	std::vector< std::vector<CUnit*> >& units,
+	std::vector< std::vector<CFeature*> >& features
+) {
+	GML_RECMUTEX_LOCK(qnum); // GetUnitsAndFeaturesExact
+
+	units.resize(spheres.size());
+	features.resize(spheres.size());
+	sphereQuads.clear();
+
+	for (unsigned int i = 0; i < spheres.size(); ++i) {
+		units[i].clear();
+		features[i].clear();
+
+		int* begQuad = &tempQuads[0];
+		int* endQuad = &tempQuads[0];
+
+		GetQuads(spheres[i], spheres[i].w, begQuad, endQuad);
+
+		for (int* a = begQuad; a != endQuad; ++a) {
+			sphereQuads.push_back(std::make_pair(*a, i));
+		}
+	}
+
+	// GetQuads lists quads in increasing order, so after sorting each
+	// sphere still sees its quads (and their objects) in the same order
+	// as the single queries do
+	std::sort(sphereQuads.begin(), sphereQuads.end());
+
+	std::vector<CUnit*>::const_iterator ui;
+	std::vector<CFeature*>::const_iterator fi;
+
+	for (size_t begPair = 0, endPair = 0; begPair < sphereQuads.size(); begPair = endPair) {
+		const Quad& quad = baseQuads[sphereQuads[begPair].first];
+
+		while (endPair < sphereQuads.size() && sphereQuads[endPair].first == sphereQuads[begPair].first) {
+			++endPair;
+		}
+
+		for (ui = quad.units.begin(); ui != quad.units.end(); ++ui) {
+			for (size_t n = begPair; n < endPair; ++n) {
+				const float3& pos = spheres[sphereQuads[n].second];
+				const float totRad = spheres[sphereQuads[n].second].w + (*ui)->radius;
+
+				if ((pos - (*ui)->midPos).SqLength() >= (totRad * totRad)) { continue; }
+
+				units[sphereQuads[n].second].push_back(*ui);
+			}
+		}
+
+		for (fi = quad.features.begin(); fi != quad.features.end(); ++fi) {
+			for (size_t n = begPair; n < endPair; ++n) {
+				const float3& pos = spheres[sphereQuads[n].second];
+				const float totRad = spheres[sphereQuads[n].second].w + (*fi)->radius;
+
+				if ((pos - (*fi)->midPos).SqLength() >= (totRad * totRad)) { continue; }
+
+				features[sphereQuads[n].second].push_back(*fi);
+			}
+		}
+	}
+
+	// objects covering several quads of a sphere were added once per quad
+	for (unsigned int i = 0; i < spheres.size(); ++i) {
+		RemoveDuplicates(units[i]);
+		RemoveDuplicates(features[i]);
+	}
+}
+
+
+
 // optimization specifically for projectile collisions
 void CQuadField::GetUnitsAndFeaturesExact(const float3& pos, float radius, CUnit**& dstUnit, CFeature**& dstFeature)
 {
@@ -784,8 +960,8 @@ void CQuadField::GetUnitsAndFeaturesExact(const float3& pos, float radius, CUnit
 
 	GetQuads(pos, radius, begQuad, endQuad);
 
-	std::list<CUnit*>::iterator ui;
-	std::list<CFeature*>::iterator fi;
+	std::vector<CUnit*>::const_iterator ui;
+	std::vector<CFeature*>::const_iterator fi;
 
 	for (int* a = begQuad; a != endQuad; ++a) {
 		Quad& quad = baseQuads[*a];
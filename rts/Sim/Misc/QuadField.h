@@ -5,11 +5,11 @@
 
 #include <set>
 #include <vector>
-#include <list>
 #include <boost/noncopyable.hpp>
 
 #include "System/creg/creg_cond.h"
 #include "System/float3.h"
+#include "System/float4.h"
 
 class CUnit;
 class CFeature;
@@ -77,6 +77,45 @@ public:
 
 	std::vector<CSolidObject*> GetSolidsExact(const float3& pos, float radius);
 
+	// allocation-free variants of the above, for hot paths
+	//
+	// results are *appended* to the caller-provided buffer (which is
+	// not cleared first) so its storage can be reused across calls;
+	// the relative order of the appended objects is identical to that
+	// of the vectors returned by the corresponding functions above
+	//
+	void GetUnitsExact(std::vector<CUnit*>& units, const float3& pos, float radius, bool spherical = true);
+	void GetUnitsExact(std::vector<CUnit*>& units, const float3& mins, const float3& maxs);
+	void GetFeaturesExact(std::vector<CFeature*>& features, const float3& pos, float radius);
+	void GetProjectilesExact(std::vector<CProjectile*>& projectiles, const float3& pos, float radius);
+	void GetSolidsExact(std::vector<CSolidObject*>& solids, const float3& pos, float radius);
+
+	/**
+	 * Batched (spherical) GetUnitsExact and GetFeaturesExact for several
+	 * spheres at once (xyz is the center, w the radius), eg. the impact
+	 * explosions of a projectile collision pass: each quad any of them
+	 * touches is walked only once.
+	 * units[i] and features[i] are set to what the single queries for
+	 * spheres[i] would return, in the same order.
+	 */
+	void GetUnitsAndFeaturesExact(
+		const std::vector<float4>& spheres,
+		std::vector< std::vector<CUnit*> >& units,
+		std::vector< std::vector<CFeature*> >& features
+	);
+
+	/**
+	 * Returns the units of all ally-teams <allyTeam> is not allied with in
+	 * the quads within <radius> of <pos>, each unit once, in the order a
+	 * walk over those quads (and then over the ally-teams) finds them.
+	 *
+	 * Consecutive queries for the same quads and enemy ally-teams share one
+	 * result while no unit enters or leaves a quad, eg. for all weapons of a
+	 * unit or the units of a group standing close together auto-targeting in
+	 * the same frame. The result is only valid until the next call.
+	 */
+	const std::vector<CUnit*>& GetEnemyUnitsInQuads(const float3& pos, float radius, int allyTeam);
+
 	void MovedUnit(CUnit* unit);
 	void RemoveUnit(CUnit* unit);
 
@@ -87,13 +126,24 @@ public:
 	void AddProjectile(CProjectile* projectile);
 	void RemoveProjectile(CProjectile* projectile);
 
+	/**
+	 * Each quad stores its objects in dense arrays, so iteration is a linear
+	 * walk over contiguous memory. They keep the order of the lists they
+	 * replace (units and features newest first, projectiles oldest first):
+	 * queries return objects in this order, which decides eg. the order in
+	 * which explosions damage units. Removal shifts the later elements down,
+	 * which is cheap for the few objects of a quad.
+	 *
+	 * NOTE: callers must not add or remove objects while iterating over
+	 * any of these containers.
+	 */
 	struct Quad {
 		CR_DECLARE_STRUCT(Quad);
 		Quad();
-		std::list<CUnit*> units;
-		std::vector< std::list<CUnit*> > teamUnits;
-		std::list<CFeature*> features;
-		std::list<CProjectile*> projectiles;
+		std::vector<CUnit*> units;
+		std::vector< std::vector<CUnit*> > teamUnits;
+		std::vector<CFeature*> features;
+		std::vector<CProjectile*> projectiles;
 	};
 
 	const Quad& GetQuad(int i) const {
@@ -116,6 +166,27 @@ private:
 	std::vector<int> tempQuads;
 	int numQuadsX;
 	int numQuadsZ;
+
+	/// (quad, sphere) pairs of the batched GetUnitsAndFeaturesExact (not saved)
+	std::vector< std::pair<int, unsigned int> > sphereQuads;
+
+	/// changes whenever a unit enters or leaves a quad (not saved)
+	unsigned int unitQuadsVersion;
+
+	/// the last result of GetEnemyUnitsInQuads and what it was made for (not saved)
+	struct EnemyUnitsQuery {
+		EnemyUnitsQuery(): valid(false), unitQuadsVersion(0), tempNum(0) {}
+
+		bool valid;
+		unsigned int unitQuadsVersion;
+		std::vector<int> quads;
+		std::vector<bool> enemyAllyTeams;
+		std::vector<CUnit*> units;
+
+		/// per unit ID, to add each unit only once
+		std::vector<unsigned int> unitTempNums;
+		unsigned int tempNum;
+	} enemyUnitsQuery;
 };
 
 extern CQuadField* quadField;
@@ -5,6 +5,8 @@
 #include "LosHandler.h"
 #include "Map/ReadMap.h"
 #include "Sim/Misc/TeamHandler.h"
+#include "System/OpenMP_cond.h"
+#include "System/Platform/Threading.h"
 #include "System/TimeProfiler.h"
 
 #ifdef SONAR_JAMMER_MAPS
@@ -14,6 +16,7 @@
 #endif
 
 CR_BIND(CRadarHandler, (false));
+CR_BIND(CRadarHandler::SensorUpdate, );
 
 CR_REG_METADATA(CRadarHandler, (
 	CR_MEMBER(radarErrorSize),
@@ -35,7 +38,16 @@ CR_REG_METADATA(CRadarHandler, (
 	SONAR_MAPS
 	CR_MEMBER(seismicMaps),
 	CR_MEMBER(commonJammerMap),
-	CR_MEMBER(commonSonarJammerMap)
+	CR_MEMBER(commonSonarJammerMap),
+	CR_MEMBER(sensorUpdates),
+	CR_MEMBER(numSensorUpdates)
+));
+
+CR_REG_METADATA_SUB(CRadarHandler, SensorUpdate, (
+	CR_MEMBER(pos),
+	CR_MEMBER(radius),
+	CR_MEMBER(amount),
+	CR_MEMBER(squares)
 ));
 
 
@@ -51,7 +63,8 @@ CRadarHandler::CRadarHandler(bool circularRadar)
   xsize(std::max(1, gs->mapx >> radarMipLevel)),
   zsize(std::max(1, gs->mapy >> radarMipLevel)),
   targFacEffect(2),
-  radarAlgo(int2(xsize, zsize), -1000, 20, readmap->GetMIPHeightMapSynced(radarMipLevel))
+  radarAlgo(int2(xsize, zsize), -1000, 20, readmap->GetMIPHeightMapSynced(radarMipLevel)),
+  numSensorUpdates(0)
 {
 	commonJammerMap.SetSize(xsize, zsize, false);
 	commonSonarJammerMap.SetSize(xsize, zsize, false);
@@ -67,6 +80,9 @@ CRadarHandler::CRadarHandler(bool circularRadar)
 	sonarJammerMaps.resize(teamHandler->ActiveAllyTeams(), tmp);
 #endif
 	radarErrorSize.resize(teamHandler->ActiveAllyTeams(), 96);
+
+	// one queue per ally-team map, plus the two common jammer maps
+	sensorUpdates.resize(teamHandler->ActiveAllyTeams() * NUM_SENSOR_MAP_TYPES + 2);
 }
 
 
@@ -75,6 +91,113 @@ CRadarHandler::~CRadarHandler()
 }
 
 
+int CRadarHandler::GetSensorMapIndex(int mapType, int allyTeam) const
+{
+	if (allyTeam < 0) {
+		assert(mapType == SENSOR_MAP_JAMMER || mapType == SENSOR_MAP_SONARJAMMER);
+		return (radarMaps.size() * NUM_SENSOR_MAP_TYPES + (mapType == SENSOR_MAP_SONARJAMMER));
+	}
+
+	return (allyTeam * NUM_SENSOR_MAP_TYPES + mapType);
+}
+
+CLosMap* CRadarHandler::GetSensorMap(int mapIdx)
+{
+	const int numAllyTeamMaps = radarMaps.size() * NUM_SENSOR_MAP_TYPES;
+
+	if (mapIdx >= numAllyTeamMaps)
+		return ((mapIdx == numAllyTeamMaps)? &commonJammerMap: &commonSonarJammerMap);
+
+	const int allyTeam = mapIdx / NUM_SENSOR_MAP_TYPES;
+
+	switch (mapIdx % NUM_SENSOR_MAP_TYPES) {
+		case SENSOR_MAP_RADAR:       { return &radarMaps[allyTeam];       } break;
+		case SENSOR_MAP_AIRRADAR:    { return &airRadarMaps[allyTeam];    } break;
+		case SENSOR_MAP_SONAR:       { return &sonarMaps[allyTeam];       } break;
+		case SENSOR_MAP_JAMMER:      { return &jammerMaps[allyTeam];      } break;
+#ifdef SONAR_JAMMER_MAPS
+		case SENSOR_MAP_SONARJAMMER: { return &sonarJammerMaps[allyTeam]; } break;
+#endif
+		case SENSOR_MAP_SEISMIC:     { return &seismicMaps[allyTeam];     } break;
+		default: {} break;
+	}
+
+	return NULL;
+}
+
+
+CRadarHandler::SensorUpdate& CRadarHandler::QueueUpdate(int mapType, int allyTeam, int amount)
+{
+	std::vector<SensorUpdate>& updates = sensorUpdates[GetSensorMapIndex(mapType, allyTeam)];
+
+	updates.push_back(SensorUpdate());
+	updates.back().amount = amount;
+
+	numSensorUpdates += 1;
+	return updates.back();
+}
+
+void CRadarHandler::QueueAreaUpdate(int mapType, int allyTeam, int2 pos, int radius, int amount)
+{
+	SensorUpdate& update = QueueUpdate(mapType, allyTeam, amount);
+
+	update.pos = pos;
+	update.radius = radius;
+}
+
+
+void CRadarHandler::ApplySensorUpdates(int mapIdx)
+{
+	std::vector<SensorUpdate>& updates = sensorUpdates[mapIdx];
+	CLosMap* map = GetSensorMap(mapIdx);
+
+	if (map != NULL) {
+		for (std::vector<SensorUpdate>::const_iterator it = updates.begin(); it != updates.end(); ++it) {
+			if (it->squares.empty()) {
+				map->AddMapArea(it->pos, -123, it->radius, it->amount);
+			} else {
+				map->AddMapSquares(it->squares, -123, it->amount);
+			}
+		}
+	}
+
+	updates.clear();
+}
+
+
+void CRadarHandler::Update()
+{
+	if (numSensorUpdates == 0)
+		return;
+
+	SCOPED_TIMER("RadarHandler::Update");
+
+	const int numMaps = sensorUpdates.size();
+
+	// NOTE:
+	//   each queue targets its own map and all map changes are integer
+	//   additions, so neither the order in which the maps are processed
+	//   nor how they are distributed over threads affects the result
+	//   (and -123 as ally-team means no unsynced readmap events are sent)
+	//   the few changes made between two reads are not worth the threads
+	#pragma omp parallel for schedule(dynamic) if (numSensorUpdates >= MIN_PARALLEL_SENSOR_UPDATES)
+	for (int mapIdx = 0; mapIdx < numMaps; ++mapIdx) {
+		ApplySensorUpdates(mapIdx);
+	}
+
+	numSensorUpdates = 0;
+}
+
+void CRadarHandler::UpdateSimThread()
+{
+	// unsynced threads may be reading the maps at the same time
+	if (!Threading::IsSimThread())
+		return;
+
+	Update();
+}
+
+
 // TODO: add the LosHandler optimizations (instance-sharing)
 void CRadarHandler::MoveUnit(CUnit* unit)
 {
@@ -101,27 +224,27 @@ void CRadarHandler::MoveUnit(CUnit* unit)
 		RemoveUnit(unit);
 
 		if (unit->jammerRadius) {
-			jammerMaps[unit->allyteam].AddMapArea(newPos, -123, unit->jammerRadius, 1);
-			commonJammerMap.AddMapArea(newPos, -123, unit->jammerRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_JAMMER, unit->allyteam, newPos, unit->jammerRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_JAMMER,             -1, newPos, unit->jammerRadius, 1);
 		}
 		if (unit->sonarJamRadius) {
 #ifdef SONAR_JAMMER_MAPS
-			sonarJammerMaps[unit->allyteam].AddMapArea(newPos, -123, unit->sonarJamRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_SONARJAMMER, unit->allyteam, newPos, unit->sonarJamRadius, 1);
 #endif
-			commonSonarJammerMap.AddMapArea(newPos, -123, unit->sonarJamRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_SONARJAMMER,             -1, newPos, unit->sonarJamRadius, 1);
 		}
 		if (unit->radarRadius) {
-			airRadarMaps[unit->allyteam].AddMapArea(newPos, -123, unit->radarRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_AIRRADAR, unit->allyteam, newPos, unit->radarRadius, 1);
 			if (!circularRadar) {
 				radarAlgo.LosAdd(newPos, unit->radarRadius, unit->radarHeight, unit->radarSquares);
-				radarMaps[unit->allyteam].AddMapSquares(unit->radarSquares, -123, 1);
+				QueueUpdate(SENSOR_MAP_RADAR, unit->allyteam, 1).squares = unit->radarSquares;
 			}
 		}
 		if (unit->sonarRadius) {
-			sonarMaps[unit->allyteam].AddMapArea(newPos, -123, unit->sonarRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_SONAR, unit->allyteam, newPos, unit->sonarRadius, 1);
 		}
 		if (unit->seismicRadius) {
-			seismicMaps[unit->allyteam].AddMapArea(newPos, -123, unit->seismicRadius, 1);
+			QueueAreaUpdate(SENSOR_MAP_SEISMIC, unit->allyteam, newPos, unit->seismicRadius, 1);
 		}
 		unit->oldRadarPos = newPos;
 		unit->hasRadarPos = true;
@@ -137,27 +260,27 @@ void CRadarHandler::RemoveUnit(CUnit* unit)
 
 	if (unit->hasRadarPos) {
 		if (unit->jammerRadius) {
-			jammerMaps[unit->allyteam].AddMapArea(unit->oldRadarPos, -123, unit->jammerRadius, -1);
-			commonJammerMap.AddMapArea(unit->oldRadarPos, -123, unit->jammerRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_JAMMER, unit->allyteam, unit->oldRadarPos, unit->jammerRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_JAMMER,             -1, unit->oldRadarPos, unit->jammerRadius, -1);
 		}
 		if (unit->sonarJamRadius) {
 #ifdef SONAR_JAMMER_MAPS
-			sonarJammerMaps[unit->allyteam].AddMapArea(unit->oldRadarPos, -123, unit->sonarJamRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_SONARJAMMER, unit->allyteam, unit->oldRadarPos, unit->sonarJamRadius, -1);
 #endif
-			commonSonarJammerMap.AddMapArea(unit->oldRadarPos, -123, unit->sonarJamRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_SONARJAMMER,             -1, unit->oldRadarPos, unit->sonarJamRadius, -1);
 		}
 		if (unit->radarRadius) {
-			airRadarMaps[unit->allyteam].AddMapArea(unit->oldRadarPos, -123, unit->radarRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_AIRRADAR, unit->allyteam, unit->oldRadarPos, unit->radarRadius, -1);
 			if (!circularRadar) {
-				radarMaps[unit->allyteam].AddMapSquares(unit->radarSquares, -123, -1);
-				unit->radarSquares.clear();
+				// hand the squares over to the queue, the unit no longer needs them
+				QueueUpdate(SENSOR_MAP_RADAR, unit->allyteam, -1).squares.swap(unit->radarSquares);
 			}
 		}
 		if (unit->sonarRadius) {
-			sonarMaps[unit->allyteam].AddMapArea(unit->oldRadarPos, -123, unit->sonarRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_SONAR, unit->allyteam, unit->oldRadarPos, unit->sonarRadius, -1);
 		}
 		if (unit->seismicRadius) {
-			seismicMaps[unit->allyteam].AddMapArea(unit->oldRadarPos, -123, unit->seismicRadius, -1);
+			QueueAreaUpdate(SENSOR_MAP_SEISMIC, unit->allyteam, unit->oldRadarPos, unit->seismicRadius, -1);
 		}
 		unit->hasRadarPos = false;
 	}
@@ -20,9 +20,23 @@
 //#define SONAR_JAMMER_MAPS
 
 
+/**
+ * Keeps the radar, sonar, jammer and seismic coverage maps of all ally-teams.
+ *
+ * MoveUnit and RemoveUnit do not modify the maps directly; they queue the
+ * coverage changes per target map, and Update applies all of the queued
+ * changes. Every map is independent storage and the changes are plain
+ * integer additions (which commute), so the maps are processed in parallel
+ * and end up bit-identical to applying the changes one by one.
+ * The readers never apply queued changes themselves, they are also used by
+ * unsynced code on other threads; synced code has to call Update (or
+ * UpdateSimThread where it can also run unsynced) before reading the maps,
+ * unsynced readers see them as of the last update.
+ */
 class CRadarHandler : public boost::noncopyable
 {
 	CR_DECLARE_STRUCT(CRadarHandler);
+	CR_DECLARE_SUB(SensorUpdate);
 
 
 public:
@@ -32,6 +46,12 @@ public:
 	void MoveUnit(CUnit* unit);
 	void RemoveUnit(CUnit* unit);
 
+	/// applies all coverage changes queued since the last call
+	void Update();
+	/// calls Update only if on the sim thread, for readers shared with unsynced code
+	void UpdateSimThread();
+	bool HaveQueuedUpdates() const { return (numSensorUpdates != 0); }
+
 	inline int GetSquare(const float3& pos) const
 	{
 		const int gx = pos.x * invRadarDiv;
@@ -122,7 +142,43 @@ public:
 	float targFacEffect;
 
 private:
+	enum {
+		SENSOR_MAP_RADAR        = 0,
+		SENSOR_MAP_AIRRADAR     = 1,
+		SENSOR_MAP_SONAR        = 2,
+		SENSOR_MAP_JAMMER       = 3,
+		SENSOR_MAP_SONARJAMMER  = 4,
+		SENSOR_MAP_SEISMIC      = 5,
+		NUM_SENSOR_MAP_TYPES    = 6,
+	};
+
+	/// below this many queued changes Update does not start any threads
+	static const int MIN_PARALLEL_SENSOR_UPDATES = 64;
+
+	/// a queued coverage change for one map
+	struct SensorUpdate {
+		CR_DECLARE_STRUCT(SensorUpdate);
+
+		int2 pos;
+		int radius;
+		int amount;
+		/// if non-empty, add these squares instead of a circular area
+		std::vector<int> squares;
+	};
+
+	/// common (ally-team independent) maps are queued after the per-ally-team ones
+	int GetSensorMapIndex(int mapType, int allyTeam) const;
+	CLosMap* GetSensorMap(int mapIdx);
+
+	SensorUpdate& QueueUpdate(int mapType, int allyTeam, int amount);
+	void QueueAreaUpdate(int mapType, int allyTeam, int2 pos, int radius, int amount);
+	void ApplySensorUpdates(int mapIdx);
+
 	CLosAlgorithm radarAlgo;
+
+	/// pending changes, indexed by GetSensorMapIndex
+	std::vector< std::vector<SensorUpdate> > sensorUpdates;
+	int numSensorUpdates;
 };
 
 extern CRadarHandler* radarhandler;
@@ -1094,17 +1094,16 @@ bool CClassicGroundMoveType::CheckColH(int x, int y1, int y2, float xmove, int s
 		bool blocked = false;
 		const int idx1 = y * gs->mapx + x;
 		const int idx2 = y * gs->mapx + squareTestX;
-		const BlockingMapCell& c = groundBlockingObjectMap->GetCell(idx1);
-		const BlockingMapCell& d = groundBlockingObjectMap->GetCell(idx2);
-		BlockingMapCellIt it;
+		const BlockingMapCell c = groundBlockingObjectMap->GetCell(idx1);
+		const BlockingMapCell d = groundBlockingObjectMap->GetCell(idx2);
 		float3 posDelta = ZeroVector;
 
-		if (!d.empty() && d.find(owner->id) == d.end()) {
+		if (!d.empty() && !d.Contains(owner)) {
 			continue;
 		}
 
-		for (it = c.begin(); it != c.end(); ++it) {
-			CSolidObject* obj = it->second;
+		for (unsigned int n = 0; n < c.size(); n++) {
+			CSolidObject* obj = c[n];
 
 			if (CMoveMath::IsNonBlocking(*m, obj, owner)) {
 				continue;
@@ -1172,17 +1171,16 @@ bool CClassicGroundMoveType::CheckColV(int y, int x1, int x2, float zmove, int s
 		bool blocked = false;
 		const int idx1 = y * gs->mapx + x;
 		const int idx2 = squareTestY * gs->mapx + x;
-		const BlockingMapCell& c = groundBlockingObjectMap->GetCell(idx1);
-		const BlockingMapCell& d = groundBlockingObjectMap->GetCell(idx2);
-		BlockingMapCellIt it;
+		const BlockingMapCell c = groundBlockingObjectMap->GetCell(idx1);
+		const BlockingMapCell d = groundBlockingObjectMap->GetCell(idx2);
 		float3 posDelta = ZeroVector;
 
-		if (!d.empty() && d.find(owner->id) == d.end()) {
+		if (!d.empty() && !d.Contains(owner)) {
 			continue;
 		}
 
-		for (it = c.begin(); it != c.end(); ++it) {
-			CSolidObject* obj = it->second;
+		for (unsigned int n = 0; n < c.size(); n++) {
+			CSolidObject* obj = c[n];
 
 			if (CMoveMath::IsNonBlocking(*m, obj, owner)) {
 				continue;
@@ -296,10 +296,10 @@ CMoveMath::BlockType CMoveMath::SquareIsBlocked(const MoveDef& moveDef, int xSqu
 	}
 
 	BlockType r = BLOCK_NONE;
-	const BlockingMapCell& c = groundBlockingObjectMap->GetCell(xSquare + zSquare * gs->mapx);
+	const BlockingMapCell c = groundBlockingObjectMap->GetCell(xSquare + zSquare * gs->mapx);
 
-	for (BlockingMapCellIt it = c.begin(); it != c.end(); ++it) {
-		const CSolidObject* obstacle = it->second;
+	for (unsigned int n = 0; n < c.size(); n++) {
+		const CSolidObject* obstacle = c[n];
 
 		if (IsNonBlocking(moveDef, obstacle, collider)) {
 			continue;
@@ -15,13 +15,17 @@ static const unsigned int MAX_SEARCHED_NODES    = 65536U;
 static const unsigned int MAX_SEARCHED_NODES_PF = MAX_SEARCHED_NODES;
 static const unsigned int MAX_SEARCHED_NODES_PE = MAX_SEARCHED_NODES;
 
+// number of PF/PE node expansions the PathManager may spend per
+// frame on queued requests (NOTE: must be the same on all clients)
+static const unsigned int MAX_QUEUED_SEARCH_NODES = MAX_SEARCHED_NODES * 2;
+
 // PathManager distance thresholds (to use PF or PE)
 static const float DETAILED_DISTANCE     = 25.0f;
 static const float ESTIMATE_DISTANCE     = 55.0f;
 static const float MIN_ESTIMATE_DISTANCE = 40.0f;
 static const float MIN_DETAILED_DISTANCE = 12.0f;
 
-static const unsigned int PATHESTIMATOR_VERSION = 53;
+static const unsigned int PATHESTIMATOR_VERSION = 55;
 
 static const unsigned int MEDRES_PE_BLOCKSIZE =  8;
 static const unsigned int LOWRES_PE_BLOCKSIZE = 32;
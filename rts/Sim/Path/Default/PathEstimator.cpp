@@ -5,12 +5,10 @@
 
 #include "PathEstimator.h"
 
-#include <fstream>
+#include <cstring>
 #include <boost/bind.hpp>
 #include <boost/thread/barrier.hpp>
 
-#include "minizip/zip.h"
-
 #include "PathAllocator.h"
 #include "PathCache.h"
 #include "PathFinder.h"
@@ -23,14 +21,14 @@
 #include "Sim/MoveTypes/MoveMath/MoveMath.h"
 #include "Sim/Units/Unit.h"
 #include "Sim/Units/UnitDef.h"
+#include "System/CRC.h"
 #include "System/NetProtocol.h"
 #include "System/TimeProfiler.h"
 #include "System/Config/ConfigHandler.h"
-#include "System/FileSystem/Archives/IArchive.h"
-#include "System/FileSystem/ArchiveLoader.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/MemoryMappedFile.h"
 #include "System/Platform/Watchdog.h"
 
 
@@ -38,6 +36,57 @@ CONFIG(int, MaxPathCostsMemoryFootPrint).defaultValue(512 * 1024 * 1024);
 
 static const std::string PATH_CACHE_DIR = "cache/paths/";
 
+// sections of the cache file start at multiples of this, which
+// is a multiple of the mapping granularity on all our platforms
+static const unsigned int PATH_CACHE_ALIGNMENT = 65536;
+static const char PATH_CACHE_MAGIC[8] = {'S', 'P', 'R', 'I', 'N', 'G', 'P', 'E'};
+
+enum {
+	PATH_CACHE_JOB_OFFSETS = 1,
+	PATH_CACHE_JOB_COSTS   = 2,
+};
+
+/**
+ * Layout of the (uncompressed) PE cache file:
+ *   [header][job flags] [block offsets] [vertex costs]
+ * The last two sections are aligned to PATH_CACHE_ALIGNMENT so
+ * the file can be used in place once mapped. The job flags are
+ * set as soon as a job has written its data into the (shared)
+ * mapping, so an interrupted build picks up where it stopped.
+ */
+struct PathCacheHeader {
+	char magic[8];
+	boost::uint32_t version;
+	boost::uint32_t hash;
+	boost::uint32_t numMoveDefs;
+	boost::uint32_t numBlocksX;
+	boost::uint32_t numBlocksZ;
+	boost::uint32_t jobsOffset;
+	boost::uint32_t offsetsOffset;
+	boost::uint32_t costsOffset;
+	boost::uint32_t fileSize;
+	boost::uint32_t checksum;   ///< CRC over the offset and cost sections
+	boost::uint32_t complete;   ///< non-zero once all jobs are done and checksum is set
+};
+
+static bool SameCacheLayout(const PathCacheHeader& a, const PathCacheHeader& b) {
+	return
+		(std::memcmp(a.magic, b.magic, sizeof(a.magic)) == 0) &&
+		(a.version == b.version) &&
+		(a.hash == b.hash) &&
+		(a.numMoveDefs == b.numMoveDefs) &&
+		(a.numBlocksX == b.numBlocksX) &&
+		(a.numBlocksZ == b.numBlocksZ) &&
+		(a.jobsOffset == b.jobsOffset) &&
+		(a.offsetsOffset == b.offsetsOffset) &&
+		(a.costsOffset == b.costsOffset) &&
+		(a.fileSize == b.fileSize);
+}
+
+static boost::uint32_t AlignCacheSection(boost::uint32_t offset) {
+	return (((offset + PATH_CACHE_ALIGNMENT - 1) / PATH_CACHE_ALIGNMENT) * PATH_CACHE_ALIGNMENT);
+}
+
 static size_t GetNumThreads() {
 	const size_t numThreads = std::max(0, configHandler->GetInt("PathingThreadCount"));
 	const size_t numCores = Threading::GetAvailableCores();
@@ -56,12 +105,18 @@ CPathEstimator::CPathEstimator(CPathFinder* pf, unsigned int BSIZE, const std::s
 	nbrOfBlocksX(gs->mapx / BLOCK_SIZE),
 	nbrOfBlocksZ(gs->mapy / BLOCK_SIZE),
 
+	numExpandedNodes(0),
 	nextOffsetMessageIdx(0),
 	nextCostMessageIdx(0),
 	pathChecksum(0),
-	offsetBlockNum(nbrOfBlocksX * nbrOfBlocksZ),
-	costBlockNum(nbrOfBlocksX * nbrOfBlocksZ),
-	blockStates(int2(nbrOfBlocksX, nbrOfBlocksZ), int2(gs->mapx, gs->mapy))
+	offsetJobNum(moveDefHandler->GetNumMoveDefs() * nbrOfBlocksZ),
+	costJobNum(moveDefHandler->GetNumMoveDefs() * nbrOfBlocksZ),
+	blockStates(int2(nbrOfBlocksX, nbrOfBlocksZ), int2(gs->mapx, gs->mapy)),
+	cacheFile(NULL),
+	cacheData(NULL),
+	cacheJobFlags(NULL),
+	cacheBlockOffsets(NULL),
+	vertexCosts(NULL)
 {
  	pathFinder = pf;
 
@@ -85,7 +140,7 @@ CPathEstimator::CPathEstimator(CPathFinder* pf, unsigned int BSIZE, const std::s
 	mGoalSqrOffset.x = BLOCK_SIZE >> 1;
 	mGoalSqrOffset.y = BLOCK_SIZE >> 1;
 
-	vertexCosts.resize(moveDefHandler->GetNumMoveDefs() * blockStates.GetSize() * PATH_DIRECTION_VERTICES, PATHCOST_INFINITY);
+	numVertexCosts = moveDefHandler->GetNumMoveDefs() * blockStates.GetSize() * PATH_DIRECTION_VERTICES;
 
 	// load precalculated data if it exists
 	InitEstimator(cacheFileName, mapFileName);
@@ -94,6 +149,7 @@ CPathEstimator::CPathEstimator(CPathFinder* pf, unsigned int BSIZE, const std::s
 CPathEstimator::~CPathEstimator()
 {
 	delete pathCache;
+	delete cacheFile;
 }
 
 
@@ -112,6 +168,9 @@ void CPathEstimator::InitEstimator(const std::string& cacheFileName, const std::
 	InitBlocks();
 
 	if (!ReadFile(cacheFileName, map)) {
+		const unsigned int numJobs = GetNumCacheJobs();
+		const unsigned int numDoneJobs = InitCacheImage(cacheFileName, map);
+
 		// start extra threads if applicable, but always keep the total
 		// memory-footprint made by CPathFinder instances within bounds
 		const unsigned int minMemFootPrint = sizeof(CPathFinder) + pathFinder->GetMemFootPrint();
@@ -127,6 +186,11 @@ void CPathEstimator::InitEstimator(const std::string& cacheFileName, const std::
 
 			sprintf(calcMsg, fmtString, BLOCK_SIZE, numExtraThreads + 1, reqMemFootPrint / (1024 * 1024));
 			loadscreen->SetLoadMessage(calcMsg);
+
+			if (numDoneJobs > 0) {
+				sprintf(calcMsg, "PathCosts: resuming PE%u cache (%u of %u jobs done)", BLOCK_SIZE, numDoneJobs, numJobs);
+				loadscreen->SetLoadMessage(calcMsg);
+			}
 		}
 
 		// note: only really needed if numExtraThreads > 0
@@ -184,57 +248,85 @@ void CPathEstimator::CalcOffsetsAndPathCosts(unsigned int threadNum) {
 	// A must be completely finished before B_i can be safely called. This means we cannot
 	// let thread i execute (A_i, B_i), but instead have to split the work such that every
 	// thread finishes its part of A before any starts B_i.
-	const unsigned int maxBlockIdx = blockStates.GetSize() - 1;
+	const unsigned int maxJobIdx = GetNumCacheJobs() - 1;
 	int i;
 
-	while ((i = --offsetBlockNum) >= 0)
-		CalculateBlockOffsets(maxBlockIdx - i, threadNum);
+	while ((i = --offsetJobNum) >= 0)
+		CalculateBlockOffsets(maxJobIdx - i, threadNum);
 
 	pathBarrier->wait();
 
-	while ((i = --costBlockNum) >= 0)
-		EstimatePathCosts(maxBlockIdx - i, threadNum);
+	while ((i = --costJobNum) >= 0)
+		EstimatePathCosts(maxJobIdx - i, threadNum);
 }
 
 
-void CPathEstimator::CalculateBlockOffsets(unsigned int blockIdx, unsigned int threadNum)
+unsigned int CPathEstimator::GetNumCacheJobs() const
+{
+	return (moveDefHandler->GetNumMoveDefs() * nbrOfBlocksZ);
+}
+
+void CPathEstimator::CalculateBlockOffsets(unsigned int jobIdx, unsigned int threadNum)
 {
-	const unsigned int x = blockIdx % nbrOfBlocksX;
-	const unsigned int z = blockIdx / nbrOfBlocksX;
+	const unsigned int pathType = jobIdx / nbrOfBlocksZ;
+	const unsigned int z = jobIdx % nbrOfBlocksZ;
 
-	if (threadNum == 0 && blockIdx >= nextOffsetMessageIdx) {
-		nextOffsetMessageIdx = blockIdx + blockStates.GetSize() / 16;
-		net->Send(CBaseNetProtocol::Get().SendCPUUsage(BLOCK_SIZE | (blockIdx << 8)));
+	if (threadNum == 0 && jobIdx >= nextOffsetMessageIdx) {
+		nextOffsetMessageIdx = jobIdx + GetNumCacheJobs() / 16;
+		net->Send(CBaseNetProtocol::Get().SendCPUUsage(BLOCK_SIZE | (jobIdx << 8)));
 	}
 
-	for (unsigned int i = 0; i < moveDefHandler->GetNumMoveDefs(); i++) {
-		MoveDef* md = moveDefHandler->GetMoveDefByPathType(i);
+	int2* blockOffsets = &cacheBlockOffsets[pathType * blockStates.GetSize() + z * nbrOfBlocksX];
+
+	// skip rows finished by an earlier (interrupted) run
+	if ((cacheJobFlags[jobIdx] & PATH_CACHE_JOB_OFFSETS) == 0) {
+		const MoveDef* md = moveDefHandler->GetMoveDefByPathType(pathType);
+
 		if (md->unitDefRefCount > 0) {
-			blockStates.peNodeOffsets[blockIdx][md->pathType] = FindOffset(*md, x, z);
+			for (unsigned int x = 0; x < nbrOfBlocksX; x++) {
+				blockOffsets[x] = FindOffset(*md, x, z);
+			}
+		} else {
+			std::fill(blockOffsets, blockOffsets + nbrOfBlocksX, int2());
 		}
+
+		cacheJobFlags[jobIdx] |= PATH_CACHE_JOB_OFFSETS;
+	}
+
+	for (unsigned int x = 0; x < nbrOfBlocksX; x++) {
+		blockStates.peNodeOffsets[z * nbrOfBlocksX + x][pathType] = blockOffsets[x];
 	}
 }
 
-void CPathEstimator::EstimatePathCosts(unsigned int blockIdx, unsigned int threadNum) {
-	const unsigned int x = blockIdx % nbrOfBlocksX;
-	const unsigned int z = blockIdx / nbrOfBlocksX;
+void CPathEstimator::EstimatePathCosts(unsigned int jobIdx, unsigned int threadNum) {
+	const unsigned int pathType = jobIdx / nbrOfBlocksZ;
+	const unsigned int z = jobIdx % nbrOfBlocksZ;
 
-	if (threadNum == 0 && blockIdx >= nextCostMessageIdx) {
-		nextCostMessageIdx = blockIdx + blockStates.GetSize() / 16;
+	if (threadNum == 0 && jobIdx >= nextCostMessageIdx) {
+		nextCostMessageIdx = jobIdx + GetNumCacheJobs() / 16;
 
 		char calcMsg[128];
-		sprintf(calcMsg, "PathCosts: precached %d of %d blocks", blockIdx, blockStates.GetSize());
+		sprintf(calcMsg, "PathCosts: precached %d of %d block rows", jobIdx, GetNumCacheJobs());
 
-		net->Send(CBaseNetProtocol::Get().SendCPUUsage(0x1 | BLOCK_SIZE | (blockIdx << 8)));
-		loadscreen->SetLoadMessage(calcMsg, (blockIdx != 0));
+		net->Send(CBaseNetProtocol::Get().SendCPUUsage(0x1 | BLOCK_SIZE | (jobIdx << 8)));
+		loadscreen->SetLoadMessage(calcMsg, (jobIdx != 0));
 	}
 
-	for (unsigned int i = 0; i < moveDefHandler->GetNumMoveDefs(); i++) {
-		MoveDef* md = moveDefHandler->GetMoveDefByPathType(i);
-		if (md->unitDefRefCount > 0) {
+	if ((cacheJobFlags[jobIdx] & PATH_CACHE_JOB_COSTS) != 0)
+		return;
+
+	const MoveDef* md = moveDefHandler->GetMoveDefByPathType(pathType);
+
+	if (md->unitDefRefCount > 0) {
+		for (unsigned int x = 0; x < nbrOfBlocksX; x++) {
 			CalculateVertices(*md, x, z, threadNum);
 		}
+	} else {
+		float* rowCosts = &vertexCosts[(pathType * blockStates.GetSize() + z * nbrOfBlocksX) * PATH_DIRECTION_VERTICES];
+		std::fill(rowCosts, rowCosts + nbrOfBlocksX * PATH_DIRECTION_VERTICES, PATHCOST_INFINITY);
 	}
+
+	cacheJobFlags[jobIdx] |= PATH_CACHE_JOB_COSTS;
 }
 
 
@@ -710,6 +802,7 @@ void CPathEstimator::TestBlock(
 	bool synced
 ) {
 	testedBlocks++;
+	numExpandedNodes++;
 
 	// initial calculations of the new block
 	int2 block;
@@ -728,7 +821,7 @@ void CPathEstimator::TestBlock(
 		return;
 	}
 
-	if (vertexIdx < 0 || vertexIdx >= vertexCosts.size())
+	if (vertexIdx < 0 || vertexIdx >= numVertexCosts)
 		return;
 
 	if (vertexCosts[vertexIdx] >= PATHCOST_INFINITY)
@@ -838,24 +931,70 @@ void CPathEstimator::ResetSearch() {
 }
 
 
+std::string CPathEstimator::GetCacheFileName(const std::string& cacheFileName, const std::string& map) const
+{
+	char hashString[64] = {0};
+	sprintf(hashString, "%u", Hash());
+
+	return (std::string(PATH_CACHE_DIR) + map + hashString + "." + cacheFileName + ".pecache");
+}
+
+void CPathEstimator::GetCacheLayout(PathCacheHeader& header) const
+{
+	const unsigned int numMoveDefs = moveDefHandler->GetNumMoveDefs();
+
+	std::memset(&header, 0, sizeof(PathCacheHeader));
+	std::memcpy(header.magic, PATH_CACHE_MAGIC, sizeof(header.magic));
+
+	header.version       = PATHESTIMATOR_VERSION;
+	header.hash          = Hash();
+	header.numMoveDefs   = numMoveDefs;
+	header.numBlocksX    = nbrOfBlocksX;
+	header.numBlocksZ    = nbrOfBlocksZ;
+	header.jobsOffset    = sizeof(PathCacheHeader);
+	header.offsetsOffset = AlignCacheSection(header.jobsOffset + GetNumCacheJobs());
+	header.costsOffset   = AlignCacheSection(header.offsetsOffset + numMoveDefs * blockStates.GetSize() * sizeof(int2));
+	header.fileSize      = header.costsOffset + numVertexCosts * sizeof(float);
+}
+
+void CPathEstimator::SetCacheImage(unsigned char* data)
+{
+	const PathCacheHeader* header = reinterpret_cast<const PathCacheHeader*>(data);
+
+	cacheData = data;
+	cacheJobFlags = data + header->jobsOffset;
+	cacheBlockOffsets = reinterpret_cast<int2*>(data + header->offsetsOffset);
+	vertexCosts = reinterpret_cast<float*>(data + header->costsOffset);
+}
+
+
 /**
- * Try to read offset and vertices data from file, return false on failure
- * TODO: Read-error-check.
+ * Map a finished cache file (copy-on-write, run-time vertex updates
+ * never reach the file), return false if there is none, it does not
+ * match the current map / MoveDefs or (if verifyChecksum) its data
+ * does not match the stored checksum
  */
-bool CPathEstimator::ReadFile(const std::string& cacheFileName, const std::string& map)
+bool CPathEstimator::ReadFile(const std::string& cacheFileName, const std::string& map, bool verifyChecksum)
 {
-	const unsigned int hash = Hash();
-	char hashString[50];
-	sprintf(hashString, "%u", hash);
+	const std::string filename = GetCacheFileName(cacheFileName, map);
 
-	std::string filename = std::string(PATH_CACHE_DIR) + map + hashString + "." + cacheFileName + ".zip";
 	if (!FileSystem::FileExists(filename))
 		return false;
-	// open file for reading from a suitable location (where the file exists)
-	IArchive* pfile = archiveLoader.OpenArchive(dataDirsAccess.LocateFile(filename), "sdz");
 
-	if (!pfile || !pfile->IsOpen()) {
-		delete pfile;
+	PathCacheHeader layout;
+	GetCacheLayout(layout);
+
+	CMemoryMappedFile* file = new CMemoryMappedFile(dataDirsAccess.LocateFile(filename), CMemoryMappedFile::MAP_COPY_ON_WRITE);
+
+	if (!file->IsOpen() || file->GetSize() != layout.fileSize) {
+		delete file;
+		return false;
+	}
+
+	const PathCacheHeader* header = reinterpret_cast<const PathCacheHeader*>(file->GetData());
+
+	if (!SameCacheLayout(*header, layout) || header->complete == 0) {
+		delete file;
 		return false;
 	}
 
@@ -863,102 +1002,127 @@ bool CPathEstimator::ReadFile(const std::string& cacheFileName, const std::strin
 	sprintf(calcMsg, "Reading Estimate PathCosts [%d]", BLOCK_SIZE);
 	loadscreen->SetLoadMessage(calcMsg);
 
-	std::auto_ptr<IArchive> auto_pfile(pfile);
-	IArchive& file(*pfile);
+	if (verifyChecksum) {
+		// the checksum is compared between clients, a damaged file would desync
+		CRC crc;
+		crc.Update(file->GetData() + header->offsetsOffset, header->fileSize - header->offsetsOffset);
 
-	const unsigned fid = file.FindFile("pathinfo");
+		if (crc.GetDigest() != header->checksum) {
+			LOG_L(L_WARNING, "[%s] checksum mismatch in \"%s\", rebuilding it", __FUNCTION__, filename.c_str());
+			delete file;
+			return false;
+		}
+	}
 
-	if (fid < file.NumFiles()) {
-		pathChecksum = file.GetCrc32(fid);
+	delete cacheFile;
+	cacheFile = file;
+	cacheBuffer.clear();
 
-		std::vector<boost::uint8_t> buffer;
-		file.GetFile(fid, buffer);
+	SetCacheImage(file->GetData());
+	pathChecksum = header->checksum;
 
-		if (buffer.size() < 4)
-			return false;
+	for (unsigned int pathType = 0; pathType < layout.numMoveDefs; pathType++) {
+		for (unsigned int blockIdx = 0; blockIdx < blockStates.GetSize(); blockIdx++) {
+			blockStates.peNodeOffsets[blockIdx][pathType] = cacheBlockOffsets[pathType * blockStates.GetSize() + blockIdx];
+		}
+	}
 
-		unsigned filehash = *((unsigned*)&buffer[0]);
-		if (filehash != hash)
-			return false;
+	return true;
+}
 
-		unsigned pos = sizeof(unsigned);
 
-		// Read block-center-offset data.
-		const unsigned blockSize = moveDefHandler->GetNumMoveDefs() * sizeof(int2);
-		if (buffer.size() < pos + blockSize * blockStates.GetSize())
-			return false;
+/**
+ * Set up the image the cache jobs write into: a shared writable mapping
+ * of the cache file, or a plain buffer if the file can not be created.
+ * Returns the number of jobs an interrupted earlier build already did.
+ */
+unsigned int CPathEstimator::InitCacheImage(const std::string& cacheFileName, const std::string& map)
+{
+	PathCacheHeader layout;
+	GetCacheLayout(layout);
+
+	assert((PATH_CACHE_ALIGNMENT % CMemoryMappedFile::GetPageSize()) == 0);
+
+	if (FileSystem::CreateDirectory(PATH_CACHE_DIR)) {
+		const std::string filename = dataDirsAccess.LocateFile(GetCacheFileName(cacheFileName, map), FileQueryFlags::WRITE);
 
-		for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++) {
-			std::memcpy(&blockStates.peNodeOffsets[blocknr][0], &buffer[pos], blockSize);
-			pos += blockSize;
+		cacheFile = new CMemoryMappedFile(filename, CMemoryMappedFile::MAP_READ_WRITE, layout.fileSize);
+
+		if (!cacheFile->IsOpen()) {
+			delete cacheFile;
+			cacheFile = NULL;
 		}
+	}
 
-		// Read vertices data.
-		if (buffer.size() < pos + vertexCosts.size() * sizeof(float))
-			return false;
-		std::memcpy(&vertexCosts[0], &buffer[pos], vertexCosts.size() * sizeof(float));
+	if (cacheFile == NULL) {
+		cacheBuffer.clear();
+		cacheBuffer.resize(layout.fileSize, 0);
+	}
 
-		// File read successful.
-		return true;
-	} else {
-		return false;
+	unsigned char* data = (cacheFile != NULL)? cacheFile->GetData(): &cacheBuffer[0];
+	PathCacheHeader* header = reinterpret_cast<PathCacheHeader*>(data);
+
+	if (!SameCacheLayout(*header, layout) || header->complete != 0) {
+		// stale or new file, or a finished one ReadFile rejected (bad
+		// checksum); clear the job flags before the header claims they
+		// belong to this layout
+		std::memset(data + layout.jobsOffset, 0, GetNumCacheJobs());
+		*header = layout;
 	}
-}
 
+	// the checksum also covers the padding before the cost section, which
+	// a re-used file may still hold old data in; the jobs never write it
+	const unsigned int jobsEnd = layout.jobsOffset + GetNumCacheJobs();
+	const unsigned int offsetsEnd = layout.offsetsOffset + layout.numMoveDefs * blockStates.GetSize() * sizeof(int2);
 
-/**
- * Try to write offset and vertex data to file.
- */
-void CPathEstimator::WriteFile(const std::string& cacheFileName, const std::string& map)
-{
-	// We need this directory to exist
-	if (!FileSystem::CreateDirectory(PATH_CACHE_DIR))
-		return;
+	std::memset(data + jobsEnd, 0, layout.offsetsOffset - jobsEnd);
+	std::memset(data + offsetsEnd, 0, layout.costsOffset - offsetsEnd);
 
-	const unsigned int hash = Hash();
-	char hashString[64] = {0};
+	header->complete = 0;
+	SetCacheImage(data);
 
-	sprintf(hashString, "%u", hash);
-	printf("[PathEstimator::%s] %s\n", __FUNCTION__, hashString);
+	unsigned int numDoneJobs = 0;
 
-	const std::string filename = std::string(PATH_CACHE_DIR) + map + hashString + "." + cacheFileName + ".zip";
-	zipFile file;
+	for (unsigned int jobIdx = 0; jobIdx < GetNumCacheJobs(); jobIdx++) {
+		numDoneJobs += (cacheJobFlags[jobIdx] == (PATH_CACHE_JOB_OFFSETS | PATH_CACHE_JOB_COSTS));
+	}
 
-	// open file for writing in a suitable location
-	file = zipOpen(dataDirsAccess.LocateFile(filename, FileQueryFlags::WRITE).c_str(), APPEND_STATUS_CREATE);
+	return numDoneJobs;
+}
 
-	if (file) {
-		zipOpenNewFileInZip(file, "pathinfo", NULL, NULL, 0, NULL, 0, NULL, Z_DEFLATED, Z_BEST_COMPRESSION);
 
-		// Write hash. (NOTE: this also affects the CRC!)
-		zipWriteInFileInZip(file, (void*) &hash, 4);
+/**
+ * Seal the cache image once all jobs are done and re-map it for use.
+ */
+void CPathEstimator::WriteFile(const std::string& cacheFileName, const std::string& map)
+{
+	PathCacheHeader* header = reinterpret_cast<PathCacheHeader*>(cacheData);
+
+	CRC crc;
+	crc.Update(cacheData + header->offsetsOffset, header->fileSize - header->offsetsOffset);
 
-		// Write block-center-offsets.
-		for (int blocknr = 0; blocknr < blockStates.GetSize(); blocknr++)
-			zipWriteInFileInZip(file, (void*) &blockStates.peNodeOffsets[blocknr][0], moveDefHandler->GetNumMoveDefs() * sizeof(int2));
+	pathChecksum = crc.GetDigest();
 
-		// Write vertices.
-		zipWriteInFileInZip(file, &vertexCosts[0], vertexCosts.size() * sizeof(float));
+	if (cacheFile == NULL)
+		return;
 
-		zipCloseFileInZip(file);
-		zipClose(file, NULL);
+	header->checksum = pathChecksum;
+	header->complete = 1;
 
+	cacheFile->Flush();
 
-		// get the CRC over the written path data
-		IArchive* pfile = archiveLoader.OpenArchive(dataDirsAccess.LocateFile(filename), "sdz");
+	// swap the shared mapping for a private one (the checksum was
+	// just computed from it); if that fails keep a copy in memory so
+	// the file is never written again
+	if (ReadFile(cacheFileName, map, false))
+		return;
 
-		if (!pfile || !pfile->IsOpen()) {
-			delete pfile;
-			return;
-		}
+	cacheBuffer.assign(cacheData, cacheData + header->fileSize);
 
-		std::auto_ptr<IArchive> auto_pfile(pfile);
-		IArchive& file(*pfile);
+	delete cacheFile;
+	cacheFile = NULL;
 
-		const unsigned fid = file.FindFile("pathinfo");
-		assert(fid < file.NumFiles());
-		pathChecksum = file.GetCrc32(fid);
-	}
+	SetCacheImage(&cacheBuffer[0]);
 }
 
 
@@ -20,6 +20,8 @@ class CPathFinder;
 class CPathEstimatorDef;
 class CPathFinderDef;
 class CPathCache;
+class CMemoryMappedFile;
+struct PathCacheHeader;
 
 namespace boost {
 	class thread;
@@ -107,6 +109,9 @@ public:
 	 */
 	boost::uint32_t GetPathChecksum() const { return pathChecksum; }
 
+	/// total number of blocks tested by all searches so far
+	unsigned int GetNumExpandedNodes() const { return numExpandedNodes; }
+
 	unsigned int GetBlockSize() const { return BLOCK_SIZE; }
 	unsigned int GetNumBlocksX() const { return nbrOfBlocksX; }
 	unsigned int GetNumBlocksZ() const { return nbrOfBlocksZ; }
@@ -118,8 +123,8 @@ private:
 	void InitBlocks();
 
 	void CalcOffsetsAndPathCosts(unsigned int threadNum);
-	void CalculateBlockOffsets(unsigned int, unsigned int);
-	void EstimatePathCosts(unsigned int, unsigned int);
+	void CalculateBlockOffsets(unsigned int jobIdx, unsigned int threadNum);
+	void EstimatePathCosts(unsigned int jobIdx, unsigned int threadNum);
 
 	int2 FindOffset(const MoveDef&, unsigned int, unsigned int);
 	void CalculateVertices(const MoveDef&, unsigned int, unsigned int, unsigned int threadNum = 0);
@@ -131,10 +136,17 @@ private:
 	void FinishSearch(const MoveDef& moveDef, IPath::Path& path);
 	void ResetSearch();
 
-	bool ReadFile(const std::string& cacheFileName, const std::string& map);
+	bool ReadFile(const std::string& cacheFileName, const std::string& map, bool verifyChecksum = true);
 	void WriteFile(const std::string& cacheFileName, const std::string& map);
+	unsigned int InitCacheImage(const std::string& cacheFileName, const std::string& map);
+	void SetCacheImage(unsigned char* data);
+	void GetCacheLayout(PathCacheHeader& header) const;
+	std::string GetCacheFileName(const std::string& cacheFileName, const std::string& map) const;
 	unsigned int Hash() const;
 
+	/// one cache job covers one block row for one MoveDef
+	unsigned int GetNumCacheJobs() const;
+
 private:
 	friend class CPathManager;
 
@@ -153,14 +165,15 @@ private:
 
 	unsigned int maxBlocksToBeSearched;
 	unsigned int testedBlocks;
+	unsigned int numExpandedNodes;
 
 	unsigned int nextOffsetMessageIdx;
 	unsigned int nextCostMessageIdx;
 
 	boost::uint32_t pathChecksum;               ///< currently crc from the zip
 
-	boost::detail::atomic_count offsetBlockNum;
-	boost::detail::atomic_count costBlockNum;
+	boost::detail::atomic_count offsetJobNum;
+	boost::detail::atomic_count costJobNum;
 	boost::barrier* pathBarrier;
 
 	CPathFinder* pathFinder;
@@ -173,7 +186,13 @@ private:
 	std::vector<CPathFinder*> pathFinders;
 	std::vector<boost::thread*> threads;
 
-	std::vector<float> vertexCosts;
+	CMemoryMappedFile* cacheFile;               /// The mapped cache, NULL if the cache lives in cacheBuffer.
+	std::vector<unsigned char> cacheBuffer;     /// In-memory cache image if no cache file could be mapped.
+	unsigned char* cacheData;                   /// Start of the cache image (header, job flags, offsets, costs).
+	unsigned char* cacheJobFlags;               /// Per-job progress flags (PATH_CACHE_JOB_*) within the image.
+	int2* cacheBlockOffsets;                    /// (pathType, block) ==> offset, within the image.
+	float* vertexCosts;                         /// (pathType, block, direction) ==> cost, within the image.
+	unsigned int numVertexCosts;
 	std::list<unsigned int> dirtyBlocks;        /// List of blocks changed in last search.
 	std::list<SingleBlock> updatedBlocks;       /// Blocks that may need an update due to map changes.
 
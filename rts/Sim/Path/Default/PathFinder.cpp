@@ -36,6 +36,7 @@ CPathFinder::CPathFinder()
 	, needPath(false)
 	, maxOpenNodes(0)
 	, testedNodes(0)
+	, numExpandedNodes(0)
 	, squareStates(int2(gs->mapx, gs->mapy), int2(gs->mapx, gs->mapy))
 {
 	static const int   dirScale = 2;
@@ -273,6 +274,7 @@ bool CPathFinder::TestSquare(
 	bool synced
 ) {
 	testedNodes++;
+	numExpandedNodes++;
 
 	const int2& dirVec2D = directionVectors2D[pathOptDir];
 	const float3& dirVec3D = directionVectors3D[pathOptDir];
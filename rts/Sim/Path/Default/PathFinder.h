@@ -60,6 +60,9 @@ public:
 		bool synced
 	);
 
+	/// total number of nodes tested by all searches so far
+	unsigned int GetNumExpandedNodes() const { return numExpandedNodes; }
+
 
 	// size of the memory-region we hold allocated (excluding sizeof(*this))
 	// (PathManager stores HeatMap and FlowMap, so we do not need to add them)
@@ -123,6 +126,7 @@ private:
 
 	unsigned int maxOpenNodes;
 	unsigned int testedNodes;
+	unsigned int numExpandedNodes;
 
 	PathNodeBuffer openSquareBuffer;
 	PathNodeStateBuffer squareStates;
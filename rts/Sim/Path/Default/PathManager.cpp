@@ -9,6 +9,7 @@
 #include "PathHeatMap.hpp"
 #include "Map/MapInfo.h"
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/ModInfo.h"
 #include "Sim/Objects/SolidObjectDef.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
 #include "System/Log/ILog.h"
@@ -95,17 +96,49 @@ unsigned int CPathManager::RequestPath(
 	assert(md == moveDef);
 
 	// Creates a new multipath.
-	IPath::SearchResult result = IPath::Error;
 	MultiPath* newPath = new MultiPath(startPos, pfDef, moveDef);
 	newPath->finalGoal = goalPos;
 	newPath->caller = caller;
 
+	// synced requests made on behalf of an object are queued and
+	// searched in Update so that a large group of units ordered to
+	// move at once cannot stall a single frame; requests from Lua
+	// and AI's expect an immediate answer, as does CClassicGroundMoveType
+	// (it takes every waypoint as real and a 0 path-ID as failure)
+	if (caller != NULL && synced && !modInfo.useClassicGroundMoveType)
+		return (QueueSearch(newPath));
+
+	if (ExecuteSearch(newPath, synced) != IPath::Error)
+		return (Store(newPath));
+
+	delete newPath;
+	return 0;
+}
+
+
+/*
+Runs the multi-resolution search for a (possibly queued) multipath.
+*/
+IPath::SearchResult CPathManager::ExecuteSearch(MultiPath* newPath, bool synced)
+{
+	IPath::SearchResult result = IPath::Error;
+
+	const MoveDef* moveDef = newPath->moveDef;
+	const float3& startPos = newPath->start;
+	const float3& goalPos = newPath->finalGoal;
+
+	CPathFinderDef* pfDef = newPath->peDef;
+	CSolidObject* caller = newPath->caller;
+
+	// queued searches can run some frames after the request, by
+	// which time the caller might no longer be on the blocking-map
+	// (eg. if it was picked up by a transport)
+	const bool blockCaller = (caller != NULL && (!newPath->queued || caller->isMarkedOnBlockingMap));
+
 	if (caller) {
 		caller->UnBlock();
 	}
 
-	unsigned int pathID = 0;
-
 	// choose the PF or the PE depending on the projected 2D goal-distance
 	// NOTE: this distance can be far smaller than the actual path length!
 	// FIXME: Why are we taking the height difference into consideration?
@@ -182,21 +215,114 @@ unsigned int CPathManager::RequestPath(
 				newPath->maxResPath.squares.push_back(int2(startPos.x / SQUARE_SIZE, startPos.z / SQUARE_SIZE));
 			}
 		}
-
-		newPath->searchResult = result;
-		pathID = Store(newPath);
-	} else {
-		delete newPath;
 	}
 
-	if (caller) {
+	if (blockCaller) {
 		caller->Block();
 	}
 
+	newPath->searchResult = result;
+	newPath->queued = false;
+	return result;
+}
+
+
+/*
+Stores a multipath whose search is deferred to Update, merging it
+with an identical request made earlier in the same frame.
+*/
+unsigned int CPathManager::QueueSearch(MultiPath* newPath)
+{
+	newPath->queued = true;
+
+	const unsigned int pathID = Store(newPath);
+	const float sqGoalRadius = newPath->peDef->sqGoalRadius;
+
+	// requests made in the current frame are always at the back
+	for (std::deque<QueuedPathRequest>::reverse_iterator it = pathRequests.rbegin(); it != pathRequests.rend(); ++it) {
+		QueuedPathRequest& req = *it;
+
+		if (req.frameNum != gs->frameNum)
+			break;
+
+		if (req.moveDef != newPath->moveDef)
+			continue;
+		if (req.startPos != newPath->start || req.goalPos != newPath->finalGoal)
+			continue;
+		if (req.sqGoalRadius != sqGoalRadius)
+			continue;
+
+		req.pathIDs.push_back(pathID);
+		return pathID;
+	}
+
+	pathRequests.push_back(QueuedPathRequest());
+
+	QueuedPathRequest& req = pathRequests.back();
+	req.moveDef = newPath->moveDef;
+	req.startPos = newPath->start;
+	req.goalPos = newPath->finalGoal;
+	req.sqGoalRadius = sqGoalRadius;
+	req.frameNum = gs->frameNum;
+	req.pathIDs.push_back(pathID);
+
 	return pathID;
 }
 
 
+/*
+Searches queued requests in FIFO order until this frame's budget
+of node expansions is used up. Expansion counts and queue order do
+not depend on wall-clock time, so every client processes the same
+requests in the same frame.
+*/
+void CPathManager::UpdateQueuedSearches()
+{
+	SCOPED_TIMER("PathManager::UpdateQueuedSearches");
+
+	const unsigned int numNodesStart = GetNumExpandedNodes();
+
+	while (!pathRequests.empty()) {
+		// always service at least one request per frame
+		if ((GetNumExpandedNodes() - numNodesStart) >= MAX_QUEUED_SEARCH_NODES)
+			break;
+
+		QueuedPathRequest& req = pathRequests.front();
+		MultiPath* leader = NULL;
+
+		for (size_t n = 0; n < req.pathIDs.size(); n++) {
+			// skip IDs that were deleted while waiting
+			MultiPath* path = GetMultiPath(req.pathIDs[n]);
+
+			if (path == NULL)
+				continue;
+
+			if (leader == NULL) {
+				ExecuteSearch(leader = path, true);
+				continue;
+			}
+
+			// merged request: copy the search results (including
+			// the state of the goal's constraint, since that is
+			// read again when the path is refined)
+			path->lowResPath = leader->lowResPath;
+			path->medResPath = leader->medResPath;
+			path->maxResPath = leader->maxResPath;
+			path->searchResult = leader->searchResult;
+			path->queued = false;
+
+			*static_cast<CRangedGoalWithCircularConstraint*>(path->peDef) = *static_cast<const CRangedGoalWithCircularConstraint*>(leader->peDef);
+		}
+
+		pathRequests.pop_front();
+	}
+}
+
+unsigned int CPathManager::GetNumExpandedNodes() const {
+	return (maxResPF->GetNumExpandedNodes() + medResPE->GetNumExpandedNodes() + lowResPE->GetNumExpandedNodes());
+}
+
+
 /*
 Store a new multipath into the pathmap.
 */
@@ -327,6 +453,19 @@ float3 CPathManager::NextWayPoint(
 	if (multiPath == NULL)
 		return noPathPoint;
 
+	if (multiPath->queued) {
+		// the request has not been searched yet; hand out a point a
+		// fixed small distance toward the goal, the negative height
+		// tells GMT it is temporary and should wait for the real path
+		float3 targetDirec = float3(multiPath->finalGoal.x - callerPos.x, 0.0f, multiPath->finalGoal.z - callerPos.z);
+		targetDirec.SafeNormalize();
+		targetDirec *= SQUARE_SIZE;
+		return float3(callerPos.x + targetDirec.x, -1.0f, callerPos.z + targetDirec.z);
+	}
+
+	if (multiPath->searchResult == IPath::Error)
+		return noPathPoint;
+
 	if (callerPos == ZeroVector) {
 		if (!multiPath->maxResPath.path.empty())
 			callerPos = multiPath->maxResPath.path.back();
@@ -383,7 +522,7 @@ float3 CPathManager::NextWayPoint(
 	} while (callerPos.SqDistance2D(waypoint) < Square(radius) && waypoint != multiPath->maxResPath.pathGoal);
 
 	// indicate this is not a temporary waypoint
-	// (the default PFS does not queue requests)
+	// (the search for this path has been completed)
 	waypoint.y = 0.0f;
 
 	return waypoint;
@@ -423,6 +562,8 @@ void CPathManager::Update()
 
 	medResPE->Update();
 	lowResPE->Update();
+
+	UpdateQueuedSearches();
 }
 
 
@@ -3,7 +3,9 @@
 #ifndef PATHMANAGER_H
 #define PATHMANAGER_H
 
+#include <deque>
 #include <map>
+#include <vector>
 #include <boost/cstdint.hpp> /* Replace with <stdint.h> if appropriate */
 
 #include "Sim/Path/IPathManager.h"
@@ -91,13 +93,14 @@ private:
 	);
 
 	struct MultiPath {
-		MultiPath(const float3& pos, const CPathFinderDef* def, const MoveDef* moveDef)
+		MultiPath(const float3& pos, CPathFinderDef* def, const MoveDef* moveDef)
 			: searchResult(IPath::Error)
 			, start(pos)
 			, peDef(def)
 			, moveDef(moveDef)
 			, finalGoal(ZeroVector)
 			, caller(NULL)
+			, queued(false)
 		{}
 
 		~MultiPath() { delete peDef; }
@@ -110,16 +113,38 @@ private:
 
 		// Request definition
 		const float3 start;
-		const CPathFinderDef* peDef;
+		CPathFinderDef* peDef;
 		const MoveDef* moveDef;
 
 		// Additional information.
 		float3 finalGoal;
 		CSolidObject* caller;
+
+		// true until the search for this path has been run by Update
+		bool queued;
+	};
+
+	/**
+	 * A synced request waiting to be searched; requests with the same
+	 * parameters made in the same frame share one search (the result
+	 * is copied to every path-ID that is still alive at that point)
+	 */
+	struct QueuedPathRequest {
+		const MoveDef* moveDef;
+		float3 startPos;
+		float3 goalPos;
+		float sqGoalRadius;
+		int frameNum;
+
+		std::vector<unsigned int> pathIDs;
 	};
 
 	inline MultiPath* GetMultiPath(int pathID) const;
 	unsigned int Store(MultiPath* path);
+	unsigned int QueueSearch(MultiPath* path);
+	IPath::SearchResult ExecuteSearch(MultiPath* path, bool synced);
+	void UpdateQueuedSearches();
+	unsigned int GetNumExpandedNodes() const;
 	void LowRes2MedRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
 	void MedRes2MaxRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
 
@@ -131,6 +156,7 @@ private:
 	PathHeatMap* pathHeatMap;
 
 	std::map<unsigned int, MultiPath*> pathMap;
+	std::deque<QueuedPathRequest> pathRequests;
 	unsigned int nextPathID;
 };
 
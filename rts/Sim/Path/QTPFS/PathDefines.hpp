@@ -13,6 +13,7 @@
 #define QTPFS_CORNER_CONNECTED_NODES
 // #define QTPFS_SLOW_ACCURATE_TESSELATION
 // #define QTPFS_OPENMP_ENABLED
+#define QTPFS_PARALLEL_SEARCHES
 // #define QTPFS_ORTHOPROJECTED_EDGE_TRANSITIONS
 #define QTPFS_STAGGERED_LAYER_UPDATES
 //
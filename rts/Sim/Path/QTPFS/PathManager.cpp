@@ -131,10 +131,14 @@ QTPFS::PathManager::~PathManager() {
 	pathTypes.clear();
 	pathTraces.clear();
 
+	sharedPaths.clear();
+	searchResults.clear();
+
 	numCurrExecutedSearches.clear();
 	numPrevExecutedSearches.clear();
+	searchStateOffsets.clear();
 
-	PathSearch::FreeGlobalQueue();
+	PathSearch::FreeGlobalQueues();
 
 	#ifdef QTPFS_ENABLE_THREADED_UPDATE
 	// at this point the thread is waiting, so notify it
@@ -158,8 +162,6 @@ void QTPFS::PathManager::InitStatic() {
 void QTPFS::PathManager::Load() {
 	pmLoadScreen.SetLoading(true);
 
-	// NOTE: offset *must* start at a non-zero value
-	searchStateOffset = NODE_STATE_OFFSET;
 	numTerrainChanges = 0;
 	numPathRequests   = 0;
 	maxNumLeafNodes   = 0;
@@ -168,10 +170,15 @@ void QTPFS::PathManager::Load() {
 	nodeLayers.resize(moveDefHandler->GetNumMoveDefs());
 	pathCaches.resize(moveDefHandler->GetNumMoveDefs());
 	pathSearches.resize(moveDefHandler->GetNumMoveDefs());
+	sharedPaths.resize(moveDefHandler->GetNumMoveDefs());
+	searchResults.resize(moveDefHandler->GetNumMoveDefs());
 
 	// add one extra element for object-less requests
-	numCurrExecutedSearches.resize(teamHandler->ActiveTeams() + 1, 0);
-	numPrevExecutedSearches.resize(teamHandler->ActiveTeams() + 1, 0);
+	numCurrExecutedSearches.resize(moveDefHandler->GetNumMoveDefs(), std::vector<unsigned int>(teamHandler->ActiveTeams() + 1, 0));
+	numPrevExecutedSearches.resize(moveDefHandler->GetNumMoveDefs(), std::vector<unsigned int>(teamHandler->ActiveTeams() + 1, 0));
+
+	// NOTE: offsets *must* start at a non-zero value
+	searchStateOffsets.resize(moveDefHandler->GetNumMoveDefs(), NODE_STATE_OFFSET);
 
 	{
 		const boost::uint32_t mapCheckSum = archiveScanner->GetArchiveCompleteChecksum(gameSetup->mapName);
@@ -215,7 +222,7 @@ void QTPFS::PathManager::Load() {
 		{ SyncedUint tmp(pfsCheckSum); }
 		#endif
 
-		PathSearch::InitGlobalQueue(maxNumLeafNodes);
+		PathSearch::InitGlobalQueues(maxNumLeafNodes, 1);
 	}
 
 	{
@@ -710,22 +717,46 @@ void QTPFS::PathManager::ThreadUpdate() {
 		static unsigned int minPathTypeUpdate = 0;
 		static unsigned int maxPathTypeUpdate = numPathTypeUpdates;
 
-		sharedPaths.clear();
-
+		#ifndef QTPFS_IGNORE_DEAD_PATHS
+		// this touches the shared path-ID map, so is not done by the workers
 		for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
-			#ifndef QTPFS_IGNORE_DEAD_PATHS
 			QueueDeadPathSearches(pathTypeUpdate);
-			#endif
+		}
+		#endif
 
-			#ifdef QTPFS_STAGGERED_LAYER_UPDATES
-			// NOTE: *must* be called between QueueDeadPathSearches and ExecuteQueuedSearches
-			ExecQueuedNodeLayerUpdates(pathTypeUpdate, !pathSearches[pathTypeUpdate].empty());
+		#ifdef QTPFS_PARALLEL_SEARCHES
+		{
+			// each layer (its tree, node-states, path-cache and search
+			// queue) is only ever touched by the one thread updating it
+			// and layers never depend on each other, so the outcome of
+			// every search is the same regardless of thread scheduling
+			const int minLayer = minPathTypeUpdate;
+			const int maxLayer = maxPathTypeUpdate;
+
+			#ifdef _OPENMP
+			PathSearch::InitGlobalQueues(maxNumLeafNodes, omp_get_max_threads());
 			#endif
 
-			ExecuteQueuedSearches(pathTypeUpdate);
+			Threading::OMPCheck();
+			#pragma omp parallel for schedule(dynamic)
+			for (int pathTypeUpdate = minLayer; pathTypeUpdate < maxLayer; pathTypeUpdate++) {
+				#ifdef _OPENMP
+				UpdateLayerSearches(pathTypeUpdate, omp_get_thread_num());
+				#else
+				UpdateLayerSearches(pathTypeUpdate, 0);
+				#endif
+			}
+		}
+		#else
+		for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
+			UpdateLayerSearches(pathTypeUpdate, 0);
 		}
+		#endif
 
-		std::copy(numCurrExecutedSearches.begin(), numCurrExecutedSearches.end(), numPrevExecutedSearches.begin());
+		// frame boundary: hand the results over to the sim-thread
+		for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
+			ApplySearchResults(pathTypeUpdate);
+		}
 
 		minPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
 		maxPathTypeUpdate = (minPathTypeUpdate + numPathTypeUpdates);
@@ -747,7 +778,34 @@ void QTPFS::PathManager::ThreadUpdate() {
 
 
 
-void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType) {
+void QTPFS::PathManager::UpdateLayerSearches(unsigned int pathType, unsigned int threadNum) {
+	sharedPaths[pathType].clear();
+
+	#ifdef QTPFS_STAGGERED_LAYER_UPDATES
+	// NOTE: *must* be called between QueueDeadPathSearches and ExecuteQueuedSearches
+	ExecQueuedNodeLayerUpdates(pathType, !pathSearches[pathType].empty());
+	#endif
+
+	ExecuteQueuedSearches(pathType, threadNum);
+
+	std::copy(numCurrExecutedSearches[pathType].begin(), numCurrExecutedSearches[pathType].end(), numPrevExecutedSearches[pathType].begin());
+}
+
+void QTPFS::PathManager::ApplySearchResults(unsigned int pathType) {
+	SearchResults& results = searchResults[pathType];
+
+	for (unsigned int n = 0; n < results.pathTraces.size(); n++) {
+		pathTraces[results.pathTraces[n].first] = results.pathTraces[n].second;
+	}
+	for (unsigned int n = 0; n < results.failedPathIDs.size(); n++) {
+		DeletePath(results.failedPathIDs[n]);
+	}
+
+	results.pathTraces.clear();
+	results.failedPathIDs.clear();
+}
+
+void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType, unsigned int threadNum) {
 	NodeLayer& nodeLayer = nodeLayers[pathType];
 	PathCache& pathCache = pathCaches[pathType];
 
@@ -758,8 +816,8 @@ void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType) {
 		// execute pending searches collected via
 		// RequestPath and QueueDeadPathSearches
 		while (searchesIt != searches.end()) {
-			if (ExecuteSearch(searches, searchesIt, nodeLayer, pathCache, pathType)) {
-				searchStateOffset += NODE_STATE_OFFSET;
+			if (ExecuteSearch(searches, searchesIt, nodeLayer, pathCache, pathType, threadNum)) {
+				searchStateOffsets[pathType] += NODE_STATE_OFFSET;
 			}
 		}
 	}
@@ -770,7 +828,8 @@ bool QTPFS::PathManager::ExecuteSearch(
 	PathSearchListIt& searchesIt,
 	NodeLayer& nodeLayer,
 	PathCache& pathCache,
-	unsigned int pathType
+	unsigned int pathType,
+	unsigned int threadNum
 ) {
 	IPathSearch* search = *searchesIt;
 	IPath* path = pathCache.GetTempPath(search->GetID());
@@ -799,9 +858,9 @@ bool QTPFS::PathManager::ExecuteSearch(
 
 	{
 		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		SharedPathMap::const_iterator sharedPathsIt = sharedPaths.find(path->GetHash());
+		SharedPathMap::const_iterator sharedPathsIt = sharedPaths[pathType].find(path->GetHash());
 
-		if (sharedPathsIt != sharedPaths.end()) {
+		if (sharedPathsIt != sharedPaths[pathType].end()) {
 			if (search->SharedFinalize(sharedPathsIt->second, path)) {
 				DeleteSearch(search, searchesIt);
 				return false;
@@ -810,30 +869,31 @@ bool QTPFS::PathManager::ExecuteSearch(
 		#endif
 
 		#ifdef QTPFS_LIMIT_TEAM_SEARCHES
-		const unsigned int numCurrSearches = numCurrExecutedSearches[search->GetTeam()];
-		const unsigned int numPrevSearches = numPrevExecutedSearches[search->GetTeam()];
+		const unsigned int numCurrSearches = numCurrExecutedSearches[pathType][search->GetTeam()];
+		const unsigned int numPrevSearches = numPrevExecutedSearches[pathType][search->GetTeam()];
 
 		if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES) {
 			++searchesIt; return false;
 		}
 
-		numCurrExecutedSearches[search->GetTeam()] += 1;
+		numCurrExecutedSearches[pathType][search->GetTeam()] += 1;
 		#endif
 	}
 
 	// removes path from temp-paths, adds it to live-paths
-	if (search->Execute(searchStateOffset, numTerrainChanges)) {
+	if (search->Execute(searchStateOffsets[pathType], numTerrainChanges, threadNum)) {
 		search->Finalize(path);
 
 		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		sharedPaths[path->GetHash()] = path;
+		sharedPaths[pathType][path->GetHash()] = path;
 		#endif
 
 		#ifdef QTPFS_TRACE_PATH_SEARCHES
-		pathTraces[path->GetID()] = search->GetExecutionTrace();
+		searchResults[pathType].pathTraces.push_back(std::make_pair(path->GetID(), search->GetExecutionTrace()));
 		#endif
 	} else {
-		DeletePath(path->GetID());
+		// deleted by ApplySearchResults
+		searchResults[pathType].failedPathIDs.push_back(path->GetID());
 	}
 
 	DeleteSearch(search, searchesIt);
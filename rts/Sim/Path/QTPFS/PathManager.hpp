@@ -90,6 +90,15 @@ namespace QTPFS {
 		typedef std::list<IPathSearch*> PathSearchList;
 		typedef std::list<IPathSearch*>::iterator PathSearchListIt;
 
+		// outcomes of one layer's searches that touch state shared by
+		// all layers; written only by the thread updating that layer,
+		// applied (in layer order) by the sim-thread once all workers
+		// are done
+		struct SearchResults {
+			std::vector<unsigned int> failedPathIDs;
+			std::vector< std::pair<unsigned int, PathSearchTrace::Execution*> > pathTraces;
+		};
+
 		void SpawnBoostThreads(MemberFunc f, const SRectangle& r);
 
 		void InitNodeLayersThreaded(const SRectangle& rect);
@@ -112,7 +121,9 @@ namespace QTPFS {
 		void ExecQueuedNodeLayerUpdates(unsigned int layerNum, bool flushQueue);
 		#endif
 
-		void ExecuteQueuedSearches(unsigned int pathType);
+		void UpdateLayerSearches(unsigned int pathType, unsigned int threadNum);
+		void ApplySearchResults(unsigned int pathType);
+		void ExecuteQueuedSearches(unsigned int pathType, unsigned int threadNum);
 		void QueueDeadPathSearches(unsigned int pathType);
 
 		unsigned int QueueSearch(
@@ -130,7 +141,8 @@ namespace QTPFS {
 			PathSearchListIt& searchesIt,
 			NodeLayer& nodeLayer,
 			PathCache& pathCache,
-			unsigned int pathType
+			unsigned int pathType,
+			unsigned int threadNum
 		);
 
 
@@ -144,16 +156,19 @@ namespace QTPFS {
 		std::map<unsigned int, unsigned int> pathTypes;
 		std::map<unsigned int, PathSearchTrace::Execution*> pathTraces;
 
-		// maps "hashes" of executed searches to the found paths
-		std::map<boost::uint64_t, IPath*> sharedPaths;
+		// per layer, maps "hashes" of executed searches to the found paths
+		std::vector<SharedPathMap> sharedPaths;
+		std::vector<SearchResults> searchResults;
 
-		std::vector<unsigned int> numCurrExecutedSearches;
-		std::vector<unsigned int> numPrevExecutedSearches;
+		// per layer and team (each layer keeps its own counts so
+		// layers can be searched concurrently and deterministically)
+		std::vector< std::vector<unsigned int> > numCurrExecutedSearches;
+		std::vector< std::vector<unsigned int> > numPrevExecutedSearches;
+		std::vector<unsigned int> searchStateOffsets;
 
 		static unsigned int LAYERS_PER_UPDATE;
 		static unsigned int MAX_TEAM_SEARCHES;
 
-		unsigned int searchStateOffset;
 		unsigned int numTerrainChanges;
 		unsigned int numPathRequests;
 		unsigned int maxNumLeafNodes;
@@ -16,7 +16,20 @@
 
 #include "System/float3.h"
 
-QTPFS::binary_heap<QTPFS::INode*> QTPFS::PathSearch::openNodes;
+std::vector< QTPFS::binary_heap<QTPFS::INode*> > QTPFS::PathSearch::openNodeQueues;
+
+void QTPFS::PathSearch::InitGlobalQueues(unsigned int numNodes, unsigned int numThreads) {
+	const unsigned int numQueues = openNodeQueues.size();
+
+	if (numQueues >= numThreads)
+		return;
+
+	openNodeQueues.resize(numThreads);
+
+	for (unsigned int n = numQueues; n < numThreads; n++) {
+		openNodeQueues[n].reserve(numNodes);
+	}
+}
 
 
 
@@ -45,11 +58,15 @@ void QTPFS::PathSearch::Initialize(
 
 bool QTPFS::PathSearch::Execute(
 	unsigned int searchStateOffset,
-	unsigned int searchMagicNumber
+	unsigned int searchMagicNumber,
+	unsigned int searchThreadNum
 ) {
 	searchState = searchStateOffset; // starts at NODE_STATE_OFFSET
 	searchMagic = searchMagicNumber; // starts at numTerrainChanges
 
+	assert(searchThreadNum < openNodeQueues.size());
+	openNodes = &openNodeQueues[searchThreadNum];
+
 	haveFullPath = (srcNode == tgtNode);
 	havePartPath = false;
 
@@ -83,7 +100,7 @@ bool QTPFS::PathSearch::Execute(
 	ResetState(srcNode);
 	UpdateNode(srcNode, NULL, 0);
 
-	while (!openNodes.empty()) {
+	while (!openNodes->empty()) {
 		IterateNodes(nodeLayer->GetNodes());
 
 		#ifdef QTPFS_TRACE_PATH_SEARCHES
@@ -95,7 +112,7 @@ bool QTPFS::PathSearch::Execute(
 		havePartPath = (minNode != srcNode);
 
 		if (haveFullPath) {
-			openNodes.reset();
+			openNodes->reset();
 		}
 	}
 
@@ -140,8 +157,8 @@ void QTPFS::PathSearch::ResetState(INode* node) {
 		hCosts[i] = 0.0f;
 	}
 
-	openNodes.reset();
-	openNodes.push(node);
+	openNodes->reset();
+	openNodes->push(node);
 }
 
 void QTPFS::PathSearch::UpdateNode(INode* nextNode, INode* prevNode, unsigned int netPointIdx) {
@@ -157,7 +174,7 @@ void QTPFS::PathSearch::UpdateNode(INode* nextNode, INode* prevNode, unsigned in
 }
 
 void QTPFS::PathSearch::IterateNodes(const std::vector<INode*>& allNodes) {
-	curNode = openNodes.top();
+	curNode = openNodes->top();
 	curNode->SetSearchState(searchState | NODE_STATE_CLOSED);
 	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
 	// in the non-conservative case, this is done from
@@ -165,8 +182,8 @@ void QTPFS::PathSearch::IterateNodes(const std::vector<INode*>& allNodes) {
 	curNode->SetMagicNumber(searchMagic);
 	#endif
 
-	openNodes.pop();
-	openNodes.check_heap_property(0);
+	openNodes->pop();
+	openNodes->check_heap_property(0);
 
 	#ifdef QTPFS_TRACE_PATH_SEARCHES
 	searchIter.SetPoppedNodeIdx(curNode->zmin() * gs->mapx + curNode->xmin());
@@ -270,8 +287,8 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		if (!isCurrent) {
 			UpdateNode(nxtNode, curNode, netPointIdx);
 
-			openNodes.push(nxtNode);
-			openNodes.check_heap_property(0);
+			openNodes->push(nxtNode);
+			openNodes->check_heap_property(0);
 
 			#ifdef QTPFS_TRACE_PATH_SEARCHES
 			searchIter.AddPushedNodeIdx(nxtNode->zmin() * gs->mapx + nxtNode->xmin());
@@ -282,7 +299,7 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		if (gCosts[netPointIdx] >= nxtNode->GetPathCost(NODE_PATH_COST_G))
 			continue;
 		if (isClosed)
-			openNodes.push(nxtNode);
+			openNodes->push(nxtNode);
 
 		UpdateNode(nxtNode, curNode, netPointIdx);
 
@@ -290,8 +307,8 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		// (changing the f-cost of an OPEN node messes up the
 		// queue's internal consistency; a pushed node remains
 		// OPEN until it gets popped)
-		openNodes.resort(nxtNode);
-		openNodes.check_heap_property(0);
+		openNodes->resort(nxtNode);
+		openNodes->check_heap_property(0);
 	}
 }
 
@@ -81,7 +81,8 @@ namespace QTPFS {
 		) = 0;
 		virtual bool Execute(
 			unsigned int searchStateOffset = 0,
-			unsigned int searchMagicNumber = 0
+			unsigned int searchMagicNumber = 0,
+			unsigned int searchThreadNum = 0
 		) = 0;
 		virtual void Finalize(IPath* path) = 0;
 		virtual bool SharedFinalize(const IPath* srcPath, IPath* dstPath) { return false; }
@@ -111,6 +112,7 @@ namespace QTPFS {
 			, nodeLayer(NULL)
 			, pathCache(NULL)
 			, searchExec(NULL)
+			, openNodes(NULL)
 			, srcNode(NULL)
 			, tgtNode(NULL)
 			, curNode(NULL)
@@ -120,7 +122,7 @@ namespace QTPFS {
 			, haveFullPath(false)
 			, havePartPath(false)
 			{}
-		~PathSearch() { openNodes.reset(); }
+		~PathSearch() {}
 
 		void Initialize(
 			NodeLayer* layer,
@@ -131,7 +133,8 @@ namespace QTPFS {
 		);
 		bool Execute(
 			unsigned int searchStateOffset = 0,
-			unsigned int searchMagicNumber = 0
+			unsigned int searchMagicNumber = 0,
+			unsigned int searchThreadNum = 0
 		);
 		void Finalize(IPath* path);
 		bool SharedFinalize(const IPath* srcPath, IPath* dstPath);
@@ -139,8 +142,8 @@ namespace QTPFS {
 
 		const boost::uint64_t GetHash(unsigned int N, unsigned int k) const;
 
-		static void InitGlobalQueue(unsigned int n) { openNodes.reserve(n); }
-		static void FreeGlobalQueue() { openNodes.clear(); }
+		static void InitGlobalQueues(unsigned int numNodes, unsigned int numThreads);
+		static void FreeGlobalQueues() { openNodeQueues.clear(); }
 
 	private:
 		void ResetState(INode* node);
@@ -152,9 +155,10 @@ namespace QTPFS {
 		void TracePath(IPath* path);
 		void SmoothPath(IPath* path);
 
-		// global queue: allocated once, re-used by all searches without clear()'s
-		// this relies on INode::operator< to sort the INode*'s by increasing f-cost
-		static binary_heap<INode*> openNodes;
+		// global queues (one per search-thread): allocated once, re-used by all
+		// searches without clear()'s; this relies on INode::operator< to sort
+		// the INode*'s by increasing f-cost
+		static std::vector< binary_heap<INode*> > openNodeQueues;
 
 		NodeLayer* nodeLayer;
 		PathCache* pathCache;
@@ -163,6 +167,9 @@ namespace QTPFS {
 		PathSearchTrace::Execution* searchExec;
 		PathSearchTrace::Iteration searchIter;
 
+		// queue of the thread executing us, only valid during Execute
+		binary_heap<INode*>* openNodes;
+
 		SRectangle searchRect;
 
 		INode *srcNode, *tgtNode;
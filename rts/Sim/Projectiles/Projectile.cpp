@@ -36,13 +36,12 @@ CR_REG_METADATA(CProjectile,
 	CR_MEMBER(collisionFlags),
 
 	CR_MEMBER(quadFieldCellCoors),
+	CR_MEMBER(quadFieldCellIndex),
 
 	CR_MEMBER(mygravity),
 	CR_MEMBER_BEGINFLAG(CM_Config),
 		CR_MEMBER(speed),
-	CR_MEMBER_ENDFLAG(CM_Config),
-
-	CR_IGNORED(quadFieldCellIter) // runtime. set in ctor
+	CR_MEMBER_ENDFLAG(CM_Config)
 ));
 
 
@@ -74,6 +73,7 @@ CProjectile::CProjectile()
 
 	, projectileType(-1u)
 	, collisionFlags(0)
+	, quadFieldCellIndex(-1u)
 {
 	GML::GetTicks(lastProjUpdate);
 }
@@ -100,6 +100,7 @@ CProjectile::CProjectile(const float3& pos, const float3& spd, CUnit* owner, boo
 
 	, projectileType(-1u)
 	, collisionFlags(0)
+	, quadFieldCellIndex(-1u)
 {
 	Init(ZeroVector, owner);
 	GML::GetTicks(lastProjUpdate);
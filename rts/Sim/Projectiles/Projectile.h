@@ -47,8 +47,8 @@ public:
 	void SetQuadFieldCellCoors(const int2& cell) { quadFieldCellCoors = cell; }
 	int2 GetQuadFieldCellCoors() const { return quadFieldCellCoors; }
 
-	void SetQuadFieldCellIter(const std::list<CProjectile*>::iterator& it) { quadFieldCellIter = it; }
-	const std::list<CProjectile*>::iterator& GetQuadFieldCellIter() { return quadFieldCellIter; }
+	void SetQuadFieldCellIndex(unsigned int idx) { quadFieldCellIndex = idx; }
+	unsigned int GetQuadFieldCellIndex() const { return quadFieldCellIndex; }
 
 	unsigned int GetProjectileType() const { return projectileType; }
 	unsigned int GetCollisionFlags() const { return collisionFlags; }
@@ -87,7 +87,8 @@ protected:
 	unsigned int collisionFlags;
 
 	int2 quadFieldCellCoors;
-	std::list<CProjectile*>::iterator quadFieldCellIter;
+	/// slot in the projectile array of our quadfield cell
+	unsigned int quadFieldCellIndex;
 };
 
 #endif /* PROJECTILE_H */
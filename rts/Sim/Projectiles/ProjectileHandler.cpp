@@ -4,6 +4,7 @@
 
 #include "Projectile.h"
 #include "ProjectileHandler.h"
+#include "Game/GameHelper.h"
 #include "Game/GlobalUnsynced.h"
 #include "Game/TraceRay.h"
 #include "Map/Ground.h"
@@ -23,8 +24,8 @@
 #include "System/EventHandler.h"
 #include "System/Log/ILog.h"
 #include "System/TimeProfiler.h"
+#include "System/creg/STL_Deque.h"
 #include "System/creg/STL_Map.h"
-#include "System/creg/STL_List.h"
 #include "lib/gml/gmlmut.h"
 
 // reserve 5% of maxNanoParticles for important stuff such as capture and reclaim other teams' units
@@ -105,6 +106,9 @@ CProjectileHandler::CProjectileHandler()
 
 	maxUsedSyncedID = freeSyncedIDs.size();
 	maxUsedUnsyncedID = freeUnsyncedIDs.size();
+
+	syncedProjectileIDs.resize(maxUsedSyncedID + 1, ProjectileMapValPair(NULL, -1));
+	unsyncedProjectileIDs.resize(maxUsedUnsyncedID + 1, ProjectileMapValPair(NULL, -1));
 }
 
 CProjectileHandler::~CProjectileHandler()
@@ -169,8 +173,20 @@ void CProjectileHandler::PostLoad()
 
 
 
+void CProjectileHandler::FreeProjectileID(ProjectileIDTable& projectileIDs, std::deque<int>& freeIDs, int id)
+{
+	projectileIDs[id] = ProjectileMapValPair(NULL, -1);
+	freeIDs.push_back(id);
+}
+
 void CProjectileHandler::UpdateProjectileContainer(ProjectileContainer& pc, bool synced) {
-	ProjectileContainer::iterator pci = pc.begin();
+	// NOTE:
+	//   projectiles created during this loop are appended to <pc> and
+	//   must be updated in the same pass (as with the old std::list),
+	//   so the size is re-read on every iteration and elements are only
+	//   accessed by index; live projectiles are shifted down over dead
+	//   ones which keeps them in creation (and hence update) order
+	size_t numLive = 0;
 
 	#define VECTOR_SANITY_CHECK(v)                              \
 		assert(!math::isnan(v.x) && !math::isinf(v.x)); \
@@ -187,37 +203,30 @@ void CProjectileHandler::UpdateProjectileContainer(ProjectileContainer& pc, bool
 		VECTOR_SANITY_CHECK(p->pos);   \
 		MAPPOS_SANITY_CHECK(p->pos);
 
-	while (pci != pc.end()) {
-		CProjectile* p = *pci;
+	for (size_t i = 0; i < pc.size(); i++) {
+		CProjectile* p = pc[i];
 
 		if (p->deleteMe) {
-			ProjectileMap::iterator pIt;
-
 			if (p->synced) {
-				//! iterator is always valid
-				pIt = syncedProjectileIDs.find(p->id);
+				const ProjectileMapValPair& pp = syncedProjectileIDs[p->id];
 
-				eventHandler.ProjectileDestroyed((pIt->second).first, (pIt->second).second);
+				eventHandler.ProjectileDestroyed(pp.first, pp.second);
 				syncedRenderProjectileIDs.erase_delete(p);
-				syncedProjectileIDs.erase(pIt);
-
-				freeSyncedIDs.push_back(p->id);
+				FreeProjectileID(syncedProjectileIDs, freeSyncedIDs, p->id);
 
 				//! push_back this projectile for deletion
-				pci = pc.erase_delete_synced(pci);
+				pc.delete_synced(p);
 			} else {
 #if UNSYNCED_PROJ_NOEVENT
 				eventHandler.UnsyncedProjectileDestroyed(p);
 #else
-				pIt = unsyncedProjectileIDs.find(p->id);
+				const ProjectileMapValPair& pp = unsyncedProjectileIDs[p->id];
 
-				eventHandler.ProjectileDestroyed((pIt->second).first, (pIt->second).second);
+				eventHandler.ProjectileDestroyed(pp.first, pp.second);
 				unsyncedRenderProjectileIDs.erase_delete(p);
-				unsyncedProjectileIDs.erase(pIt);
-
-				freeUnsyncedIDs.push_back(p->id);
+				FreeProjectileID(unsyncedProjectileIDs, freeUnsyncedIDs, p->id);
 #endif
-				pci = pc.erase_detach(pci);
+				pc.detach(p);
 			}
 		} else {
 			PROJECTILE_SANITY_CHECK(p);
@@ -228,9 +237,11 @@ void CProjectileHandler::UpdateProjectileContainer(ProjectileContainer& pc, bool
 			PROJECTILE_SANITY_CHECK(p);
 			GML::GetTicks(p->lastProjUpdate);
 
-			++pci;
+			pc[numLive++] = p;
 		}
 	}
+
+	pc.resize(numLive);
 }
 
 
@@ -320,8 +331,8 @@ void CProjectileHandler::AddProjectile(CProjectile* p)
 	// already initialized?
 	assert(p->id < 0);
 
-	std::list<int>* freeIDs = NULL;
-	ProjectileMap* proIDs = NULL;
+	std::deque<int>* freeIDs = NULL;
+	ProjectileIDTable* proIDs = NULL;
 	ProjectileRenderMap* newProIDs = NULL;
 
 	int* maxUsedID = NULL;
@@ -367,9 +378,11 @@ void CProjectileHandler::AddProjectile(CProjectile* p)
 	p->id = newUsedID;
 
 	const ProjectileMapValPair vp(p, p->owner() ? p->owner()->allyteam : -1);
-	const ProjectileMapKeyPair kp(p->id, vp);
 
-	proIDs->insert(kp);
+	if (p->id >= int(proIDs->size()))
+		proIDs->resize(p->id + 1, ProjectileMapValPair(NULL, -1));
+
+	(*proIDs)[p->id] = vp;
 	newProIDs->push(p, vp);
 
 	eventHandler.ProjectileCreated(vp.first, vp.second);
@@ -385,10 +398,37 @@ void CProjectileHandler::CheckUnitCollisions(
 	const float3& ppos0,
 	const float3& ppos1)
 {
+	// scratch arrays for the broad-phase pre-test; candidates are kept
+	// in quadfield order so the first unit hit is the same as without it
+	static std::vector<float> xs(unitHandler->MaxUnits());
+	static std::vector<float> ys(unitHandler->MaxUnits());
+	static std::vector<float> zs(unitHandler->MaxUnits());
+	static std::vector<float> rs(unitHandler->MaxUnits());
+	static std::vector<unsigned char> mask(unitHandler->MaxUnits());
+
+	const unsigned int numUnits = endUnit - &tempUnits[0];
+
+	if (numUnits == 0)
+		return;
+
+	for (unsigned int n = 0; n < numUnits; n++) {
+		const CUnit* unit = tempUnits[n];
+
+		xs[n] = unit->midPos.x;
+		ys[n] = unit->midPos.y;
+		zs[n] = unit->midPos.z;
+		rs[n] = CCollisionHandler::GetPreTestRadius(unit->collisionVolume);
+	}
+
+	CCollisionHandler::SegmentSpheresPreTest(ppos0, ppos1, &xs[0], &ys[0], &zs[0], &rs[0], &mask[0], numUnits);
+
 	CollisionQuery cq;
 
-	for (CUnit** ui = &tempUnits[0]; ui != endUnit; ++ui) {
-		CUnit* unit = *ui;
+	for (unsigned int n = 0; n < numUnits; n++) {
+		if (mask[n] == 0)
+			continue;
+
+		CUnit* unit = tempUnits[n];
 
 		const CUnit* attacker = p->owner();
 
@@ -466,8 +506,9 @@ void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc) {
 	static std::vector<CUnit*> tempUnits(unitHandler->MaxUnits(), NULL);
 	static std::vector<CFeature*> tempFeatures(unitHandler->MaxUnits(), NULL);
 
-	for (ProjectileContainer::iterator pci = pc.begin(); pci != pc.end(); ++pci) {
-		CProjectile* p = *pci;
+	// collisions can spawn new projectiles (which may reallocate <pc>)
+	for (size_t i = 0; i < pc.size(); i++) {
+		CProjectile* p = pc[i];
 
 		if (p->checkCol && !p->deleteMe) {
 			const float3 ppos0 = p->pos;
@@ -486,10 +527,8 @@ void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc) {
 }
 
 void CProjectileHandler::CheckGroundCollisions(ProjectileContainer& pc) {
-	ProjectileContainer::iterator pci;
-
-	for (pci = pc.begin(); pci != pc.end(); ++pci) {
-		CProjectile* p = *pci;
+	for (size_t i = 0; i < pc.size(); i++) {
+		CProjectile* p = pc[i];
 
 		if (!p->checkCol) {
 			continue;
@@ -523,11 +562,17 @@ void CProjectileHandler::CheckCollisions()
 {
 	SCOPED_TIMER("ProjectileHandler::CheckCollisions");
 
+	// impact explosions take effect together after all collision tests,
+	// but before the exploded projectiles get deleted
+	helper->BeginExplosionBatch();
+
 	CheckUnitFeatureCollisions(syncedProjectiles); //! changes simulation state
 	CheckUnitFeatureCollisions(unsyncedProjectiles); //! does not change simulation state
 
 	CheckGroundCollisions(syncedProjectiles); //! changes simulation state
 	CheckGroundCollisions(unsyncedProjectiles); //! does not change simulation state
+
+	helper->ResolveExplosions();
 }
 
 
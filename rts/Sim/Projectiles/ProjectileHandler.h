@@ -3,6 +3,7 @@
 #ifndef PROJECTILE_HANDLER_H
 #define PROJECTILE_HANDLER_H
 
+#include <deque>
 #include <list>
 #include <set>
 #include <vector>
@@ -34,7 +35,14 @@ typedef std::pair<CProjectile*, int> ProjectileMapValPair;
 typedef std::pair<int, ProjectileMapValPair> ProjectileMapKeyPair;
 typedef std::map<int, ProjectileMapValPair> ProjectileMap;
 
-typedef ThreadListSim<std::list<CProjectile*>, std::set<CProjectile*>, CProjectile*, ProjectileDetacher> ProjectileContainer;
+// ID ==> <projectile, allyteam>, indexed directly by projectile ID;
+// slots of dead projectiles (and never-used IDs) hold a NULL pointer
+typedef std::vector<ProjectileMapValPair> ProjectileIDTable;
+
+// projectiles are kept in creation order in a contiguous array which is
+// compacted in-place (preserving that order) once per frame, see
+// CProjectileHandler::UpdateProjectileContainer
+typedef ThreadListSim<std::vector<CProjectile*>, std::set<CProjectile*>, CProjectile*, ProjectileDetacher> ProjectileContainer;
 typedef ThreadListSimRender<std::list<CGroundFlash*>, std::set<CGroundFlash*>, CGroundFlash*> GroundFlashContainer;
 
 #if defined(USE_GML) && GML_ENABLE_SIM
@@ -57,28 +65,20 @@ public:
 	void PostLoad();
 
 	inline const ProjectileMapValPair* GetMapPairBySyncedID(int id) const {
-		const bool renderAccess = (GML::SimEnabled() && !Threading::IsSimThread());
-		const ProjectileMap& projectileIDs = renderAccess ? syncedRenderProjectileIDs.get_render_map() : syncedProjectileIDs;
-		const ProjectileMap::const_iterator it = projectileIDs.find(id);
+		if (GML::SimEnabled() && !Threading::IsSimThread())
+			return GetRenderMapPair(syncedRenderProjectileIDs.get_render_map(), id);
 
-		if (it == projectileIDs.end())
-			return NULL;
-
-		return &(it->second);
+		return GetMapPair(syncedProjectileIDs, id);
 	}
 
 	inline const ProjectileMapValPair* GetMapPairByUnsyncedID(int id) const {
 		if (UNSYNCED_PROJ_NOEVENT)
 			return NULL; // unsynced projectiles have no IDs if UNSYNCED_PROJ_NOEVENT
 
-		const bool renderAccess = (GML::SimEnabled() && !Threading::IsSimThread());
-		const ProjectileMap& projectileIDs = renderAccess ? unsyncedRenderProjectileIDs.get_render_map() : unsyncedProjectileIDs;
-		const ProjectileMap::const_iterator it = projectileIDs.find(id);
+		if (GML::SimEnabled() && !Threading::IsSimThread())
+			return GetRenderMapPair(unsyncedRenderProjectileIDs.get_render_map(), id);
 
-		if (it == projectileIDs.end())
-			return NULL;
-
-		return &(it->second);
+		return GetMapPair(unsyncedProjectileIDs, id);
 	}
 
 	void CheckUnitCollisions(CProjectile*, std::vector<CUnit*>&, CUnit**, const float3&, const float3&);
@@ -105,6 +105,26 @@ public:
 	void AddNanoParticle(const float3&, const float3&, const UnitDef*, int team, float radius, bool inverse, bool highPriority);
 	bool RenderAccess(const CProjectile *p) const;
 
+private:
+	static const ProjectileMapValPair* GetMapPair(const ProjectileIDTable& projectileIDs, int id) {
+		if (id < 0 || id >= int(projectileIDs.size()))
+			return NULL;
+		if (projectileIDs[id].first == NULL)
+			return NULL;
+
+		return &projectileIDs[id];
+	}
+	static const ProjectileMapValPair* GetRenderMapPair(const ProjectileMap& projectileIDs, int id) {
+		const ProjectileMap::const_iterator it = projectileIDs.find(id);
+
+		if (it == projectileIDs.end())
+			return NULL;
+
+		return &(it->second);
+	}
+
+	void FreeProjectileID(ProjectileIDTable& projectileIDs, std::deque<int>& freeIDs, int id);
+
 public:
 	ProjectileContainer syncedProjectiles;    // contains only projectiles that can change simulation state
 	ProjectileContainer unsyncedProjectiles;  // contains only projectiles that cannot change simulation state
@@ -125,10 +145,10 @@ public:
 private:
 	int maxUsedSyncedID;
 	int maxUsedUnsyncedID;
-	std::list<int> freeSyncedIDs;             // available synced (weapon, piece) projectile ID's
-	std::list<int> freeUnsyncedIDs;           // available unsynced projectile ID's
-	ProjectileMap syncedProjectileIDs;        // ID ==> <projectile, allyteam> map for living synced projectiles
-	ProjectileMap unsyncedProjectileIDs;      // ID ==> <projectile, allyteam> map for living unsynced projectiles
+	std::deque<int> freeSyncedIDs;            // available synced (weapon, piece) projectile ID's
+	std::deque<int> freeUnsyncedIDs;          // available unsynced projectile ID's
+	ProjectileIDTable syncedProjectileIDs;    // ID ==> <projectile, allyteam> table for living synced projectiles
+	ProjectileIDTable unsyncedProjectileIDs;  // ID ==> <projectile, allyteam> table for living unsynced projectiles
 };
 
 
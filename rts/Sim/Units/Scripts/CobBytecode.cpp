@@ -0,0 +1,404 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+
+#include "CobBytecode.h"
+#include "CobOpcodes.h"
+#include "UnitScriptLog.h"
+
+#include <boost/static_assert.hpp>
+
+// labels as values, ie. direct-threaded dispatch (a plain switch otherwise)
+#if defined(__GNUC__)
+	#define COB_THREADED_DISPATCH
+#endif
+
+
+CCobBytecode::Opcode CCobBytecode::GetOpcode(int word)
+{
+	switch (word) {
+		case PUSH_CONSTANT:        return OP_PUSH_CONSTANT;
+		case PUSH_LOCAL_VAR:       return OP_PUSH_LOCAL_VAR;
+		case PUSH_STATIC:          return OP_PUSH_STATIC;
+		case CREATE_LOCAL_VAR:     return OP_CREATE_LOCAL_VAR;
+		case POP_LOCAL_VAR:        return OP_POP_LOCAL_VAR;
+		case POP_STATIC:           return OP_POP_STATIC;
+		case POP_STACK:            return OP_POP_STACK;
+		case ADD:                  return OP_ADD;
+		case SUB:                  return OP_SUB;
+		case MUL:                  return OP_MUL;
+		case DIV:                  return OP_DIV;
+		case MOD:                  return OP_MOD;
+		case BITWISE_AND:          return OP_BITWISE_AND;
+		case BITWISE_OR:           return OP_BITWISE_OR;
+		case BITWISE_XOR:          return OP_BITWISE_XOR;
+		case BITWISE_NOT:          return OP_BITWISE_NOT;
+		case SET_LESS:             return OP_SET_LESS;
+		case SET_LESS_OR_EQUAL:    return OP_SET_LESS_OR_EQUAL;
+		case SET_GREATER:          return OP_SET_GREATER;
+		case SET_GREATER_OR_EQUAL: return OP_SET_GREATER_OR_EQUAL;
+		case SET_EQUAL:            return OP_SET_EQUAL;
+		case SET_NOT_EQUAL:        return OP_SET_NOT_EQUAL;
+		case LOGICAL_AND:          return OP_LOGICAL_AND;
+		case LOGICAL_OR:           return OP_LOGICAL_OR;
+		case LOGICAL_XOR:          return OP_LOGICAL_XOR;
+		case LOGICAL_NOT:          return OP_LOGICAL_NOT;
+		case JUMP:                 return OP_JUMP;
+		case JUMP_NOT_EQUAL:       return OP_JUMP_NOT_EQUAL;
+		case REAL_CALL:            return OP_REAL_CALL;
+		case RETURN:               return OP_RETURN;
+		case CACHE:                return OP_CACHE;
+		case DONT_CACHE:           return OP_DONT_CACHE;
+		case SHADE:                return OP_SHADE;
+		case DONT_SHADE:           return OP_DONT_SHADE;
+
+		case MOVE:                 return OP_MOVE;
+		case TURN:                 return OP_TURN;
+		case SPIN:                 return OP_SPIN;
+		case STOP_SPIN:            return OP_STOP_SPIN;
+		case SHOW:                 return OP_SHOW;
+		case HIDE:                 return OP_HIDE;
+		case MOVE_NOW:             return OP_MOVE_NOW;
+		case TURN_NOW:             return OP_TURN_NOW;
+		case EMIT_SFX:             return OP_EMIT_SFX;
+		case WAIT_TURN:            return OP_WAIT_TURN;
+		case WAIT_MOVE:            return OP_WAIT_MOVE;
+		case SLEEP:                return OP_SLEEP;
+		case RAND:                 return OP_RAND;
+		case GET_UNIT_VALUE:       return OP_GET_UNIT_VALUE;
+		case GET:                  return OP_GET;
+		case START:                return OP_START;
+		case LUA_CALL:             return OP_LUA_CALL;
+		case SIGNAL:               return OP_SIGNAL;
+		case SET_SIGNAL_MASK:      return OP_SET_SIGNAL_MASK;
+		case EXPLODE:              return OP_EXPLODE;
+		case PLAY_SOUND:           return OP_PLAY_SOUND;
+		case SET:                  return OP_SET;
+		case ATTACH:               return OP_ATTACH;
+		case DROP:                 return OP_DROP;
+	}
+
+	// CALL is resolved by Load
+	return OP_UNKNOWN;
+}
+
+
+void CCobBytecode::Load(
+	const std::vector<int>& words,
+	const std::vector<std::string>& scriptNames,
+	const std::vector<int>& scriptOffsets,
+	const std::vector<int>& scriptLengths
+) {
+	this->code = words;
+	this->scriptOffsets = scriptOffsets;
+	this->scriptLengths = scriptLengths;
+
+	// any word can be jumped to, so decode all of them (whether a word is an
+	// opcode or an operand is only known when the code actually runs there)
+	opcodes.clear();
+	opcodes.resize(code.size(), OP_UNKNOWN);
+
+	for (size_t i = 0; i < code.size(); ++i) {
+		Opcode op = GetOpcode(code[i]);
+
+		if (code[i] == CALL || code[i] == REAL_CALL) {
+			// a call needs a valid function id following it
+			const int functionId = ((i + 1) < code.size())? code[i + 1]: -1;
+
+			if (functionId < 0 || static_cast<size_t>(functionId) >= scriptNames.size()) {
+				op = OP_UNKNOWN;
+			} else if (code[i] == CALL) {
+				op = (scriptNames[functionId].find("lua_") == 0)? OP_LUA_CALL: OP_REAL_CALL;
+			}
+		}
+
+		opcodes[i] = op;
+	}
+}
+
+
+static inline int POP(std::vector<int>& stack)
+{
+	if (!stack.empty()) {
+		const int r = stack.back();
+		stack.pop_back();
+		return r;
+	}
+
+	return 0;
+}
+
+
+CCobBytecode::Opcode CCobBytecode::Run(
+	int& threadPC,
+	int& paramCount,
+	int& retCode,
+	std::vector<int>& stack,
+	std::vector<CallInfo>& callStack,
+	std::vector<int>& staticVars
+) const {
+	const int* words = &code[0];
+	const unsigned char* ops = &opcodes[0];
+
+	// kept local so the compiler need not assume the stack writes alias it
+	int PC = threadPC;
+	int r1, r2;
+
+#ifdef COB_THREADED_DISPATCH
+	// in the order of Opcode
+	static const void* const labels[] = {
+		&&OP_EXTERNAL, // OP_UNKNOWN
+
+		&&OP_PUSH_CONSTANT,
+		&&OP_PUSH_LOCAL_VAR,
+		&&OP_PUSH_STATIC,
+		&&OP_CREATE_LOCAL_VAR,
+		&&OP_POP_LOCAL_VAR,
+		&&OP_POP_STATIC,
+		&&OP_POP_STACK,
+		&&OP_ADD,
+		&&OP_SUB,
+		&&OP_MUL,
+		&&OP_DIV,
+		&&OP_MOD,
+		&&OP_BITWISE_AND,
+		&&OP_BITWISE_OR,
+		&&OP_BITWISE_XOR,
+		&&OP_BITWISE_NOT,
+		&&OP_SET_LESS,
+		&&OP_SET_LESS_OR_EQUAL,
+		&&OP_SET_GREATER,
+		&&OP_SET_GREATER_OR_EQUAL,
+		&&OP_SET_EQUAL,
+		&&OP_SET_NOT_EQUAL,
+		&&OP_LOGICAL_AND,
+		&&OP_LOGICAL_OR,
+		&&OP_LOGICAL_XOR,
+		&&OP_LOGICAL_NOT,
+		&&OP_JUMP,
+		&&OP_JUMP_NOT_EQUAL,
+		&&OP_REAL_CALL,
+		&&OP_RETURN,
+		&&OP_CACHE,
+		&&OP_DONT_CACHE,
+		&&OP_SHADE,
+		&&OP_DONT_SHADE,
+
+		&&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, // MOVE .. STOP_SPIN
+		&&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, // SHOW .. TURN_NOW
+		&&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, // EMIT_SFX .. SLEEP
+		&&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, // RAND .. START
+		&&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, // LUA_CALL .. EXPLODE
+		&&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, &&OP_EXTERNAL, // PLAY_SOUND .. DROP
+	};
+
+	BOOST_STATIC_ASSERT((sizeof(labels) / sizeof(labels[0])) == NUM_OPCODES);
+
+	#define DISPATCH() goto *labels[ops[PC++]]
+	#define OPCODE(op) op
+
+	DISPATCH();
+	{
+#else
+	#define DISPATCH() continue
+	#define OPCODE(op) case op
+
+	for (;;) {
+		switch (ops[PC++]) {
+			default: goto OP_EXTERNAL;
+#endif
+
+		OPCODE(OP_PUSH_CONSTANT):
+			stack.push_back(words[PC++]);
+			DISPATCH();
+		OPCODE(OP_PUSH_LOCAL_VAR):
+			r1 = words[PC++];
+			r2 = stack[callStack.back().stackTop + r1];
+			stack.push_back(r2);
+			DISPATCH();
+		OPCODE(OP_PUSH_STATIC):
+			r1 = words[PC++];
+			stack.push_back(staticVars[r1]);
+			DISPATCH();
+		OPCODE(OP_CREATE_LOCAL_VAR):
+			if (paramCount == 0) {
+				stack.push_back(0);
+			} else {
+				paramCount--;
+			}
+			DISPATCH();
+		OPCODE(OP_POP_LOCAL_VAR):
+			r1 = words[PC++];
+			r2 = POP(stack);
+			stack[callStack.back().stackTop + r1] = r2;
+			DISPATCH();
+		OPCODE(OP_POP_STATIC):
+			r1 = words[PC++];
+			r2 = POP(stack);
+			staticVars[r1] = r2;
+			DISPATCH();
+		OPCODE(OP_POP_STACK):
+			POP(stack);
+			DISPATCH();
+
+		OPCODE(OP_ADD):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			stack.push_back(r1 + r2);
+			DISPATCH();
+		OPCODE(OP_SUB):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			stack.push_back(r1 - r2);
+			DISPATCH();
+		OPCODE(OP_MUL):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 * r2);
+			DISPATCH();
+		OPCODE(OP_DIV):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			if (r2 != 0) {
+				stack.push_back(r1 / r2);
+			} else {
+				stack.push_back(1000); // infinity!
+				LOG_L(L_ERROR, "division by zero");
+			}
+			DISPATCH();
+		OPCODE(OP_MOD):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			if (r2 != 0) {
+				stack.push_back(r1 % r2);
+			} else {
+				stack.push_back(0);
+				LOG_L(L_ERROR, "modulo division by zero");
+			}
+			DISPATCH();
+		OPCODE(OP_BITWISE_AND):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 & r2);
+			DISPATCH();
+		OPCODE(OP_BITWISE_OR):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 | r2);
+			DISPATCH();
+		OPCODE(OP_BITWISE_XOR):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 ^ r2);
+			DISPATCH();
+		OPCODE(OP_BITWISE_NOT):
+			r1 = POP(stack);
+			stack.push_back(~r1);
+			DISPATCH();
+
+		OPCODE(OP_SET_LESS):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			stack.push_back(r1 < r2);
+			DISPATCH();
+		OPCODE(OP_SET_LESS_OR_EQUAL):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			stack.push_back(r1 <= r2);
+			DISPATCH();
+		OPCODE(OP_SET_GREATER):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			stack.push_back(r1 > r2);
+			DISPATCH();
+		OPCODE(OP_SET_GREATER_OR_EQUAL):
+			r2 = POP(stack);
+			r1 = POP(stack);
+			stack.push_back(r1 >= r2);
+			DISPATCH();
+		OPCODE(OP_SET_EQUAL):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 == r2);
+			DISPATCH();
+		OPCODE(OP_SET_NOT_EQUAL):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 != r2);
+			DISPATCH();
+		OPCODE(OP_LOGICAL_AND):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 && r2);
+			DISPATCH();
+		OPCODE(OP_LOGICAL_OR):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back(r1 || r2);
+			DISPATCH();
+		OPCODE(OP_LOGICAL_XOR):
+			r1 = POP(stack);
+			r2 = POP(stack);
+			stack.push_back((!!r1) ^ (!!r2));
+			DISPATCH();
+		OPCODE(OP_LOGICAL_NOT):
+			r1 = POP(stack);
+			stack.push_back(r1 == 0);
+			DISPATCH();
+
+		OPCODE(OP_JUMP):
+			PC = words[PC];
+			DISPATCH();
+		OPCODE(OP_JUMP_NOT_EQUAL):
+			r1 = words[PC++];
+			r2 = POP(stack);
+			if (r2 == 0) {
+				PC = r1;
+			}
+			DISPATCH();
+		OPCODE(OP_REAL_CALL):
+			r1 = words[PC++];
+			r2 = words[PC++];
+
+			// calls to zero-length scripts are skipped
+			if (scriptLengths[r1] != 0) {
+				const CallInfo ci = {r1, PC, stack.size() - r2};
+				callStack.push_back(ci);
+				paramCount = r2;
+				PC = scriptOffsets[r1];
+			}
+			DISPATCH();
+		OPCODE(OP_RETURN):
+			retCode = POP(stack);
+
+			if (callStack.back().returnAddr == -1) {
+				// leave the stack intact in case the caller wants to check it
+				threadPC = PC;
+				return OP_RETURN;
+			}
+
+			PC = callStack.back().returnAddr;
+			while (stack.size() > callStack.back().stackTop) {
+				stack.pop_back();
+			}
+			callStack.pop_back();
+			DISPATCH();
+
+		OPCODE(OP_CACHE):
+		OPCODE(OP_DONT_CACHE):
+		OPCODE(OP_SHADE):
+		OPCODE(OP_DONT_SHADE):
+			// not used by spring, skip the piece
+			PC++;
+			DISPATCH();
+	}
+#ifndef COB_THREADED_DISPATCH
+	}
+#endif
+
+	#undef OPCODE
+	#undef DISPATCH
+
+OP_EXTERNAL:
+	threadPC = PC;
+	return static_cast<Opcode>(ops[PC - 1]);
+}
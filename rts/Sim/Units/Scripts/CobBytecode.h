@@ -0,0 +1,140 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_BYTECODE_H
+#define COB_BYTECODE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The code of a COB script, decoded for the interpreter
+ *
+ * Every code word gets the (dense) id of the opcode it would be if it was
+ * executed, so the interpreter dispatches through a table instead of
+ * searching the sparse opcode values, while PCs, jump targets and return
+ * addresses all stay what they are in the file. Operands and constants
+ * are still read from the code words (they follow their opcode). CALLs
+ * are resolved once here, to REAL_CALL or LUA_CALL by the callee's name.
+ *
+ * Run executes the instructions that only touch the thread's own state
+ * (stack, locals, statics, arithmetic, jumps, calls and returns) itself,
+ * with direct-threaded dispatch where the compiler supports it, and hands
+ * everything else (which needs the unit, the scheduler or Lua) back to
+ * CCobThread::Tick.
+ */
+class CCobBytecode
+{
+public:
+	enum Opcode {
+		OP_UNKNOWN = 0,
+
+		// handled by Run
+		OP_PUSH_CONSTANT,
+		OP_PUSH_LOCAL_VAR,
+		OP_PUSH_STATIC,
+		OP_CREATE_LOCAL_VAR,
+		OP_POP_LOCAL_VAR,
+		OP_POP_STATIC,
+		OP_POP_STACK,
+		OP_ADD,
+		OP_SUB,
+		OP_MUL,
+		OP_DIV,
+		OP_MOD,
+		OP_BITWISE_AND,
+		OP_BITWISE_OR,
+		OP_BITWISE_XOR,
+		OP_BITWISE_NOT,
+		OP_SET_LESS,
+		OP_SET_LESS_OR_EQUAL,
+		OP_SET_GREATER,
+		OP_SET_GREATER_OR_EQUAL,
+		OP_SET_EQUAL,
+		OP_SET_NOT_EQUAL,
+		OP_LOGICAL_AND,
+		OP_LOGICAL_OR,
+		OP_LOGICAL_XOR,
+		OP_LOGICAL_NOT,
+		OP_JUMP,
+		OP_JUMP_NOT_EQUAL,
+		OP_REAL_CALL,
+		OP_RETURN, ///< handed back only when returning from the thread's function
+		OP_CACHE,
+		OP_DONT_CACHE,
+		OP_SHADE,
+		OP_DONT_SHADE,
+
+		// handed back to the caller
+		OP_MOVE,
+		OP_TURN,
+		OP_SPIN,
+		OP_STOP_SPIN,
+		OP_SHOW,
+		OP_HIDE,
+		OP_MOVE_NOW,
+		OP_TURN_NOW,
+		OP_EMIT_SFX,
+		OP_WAIT_TURN,
+		OP_WAIT_MOVE,
+		OP_SLEEP,
+		OP_RAND,
+		OP_GET_UNIT_VALUE,
+		OP_GET,
+		OP_START,
+		OP_LUA_CALL,
+		OP_SIGNAL,
+		OP_SET_SIGNAL_MASK,
+		OP_EXPLODE,
+		OP_PLAY_SOUND,
+		OP_SET,
+		OP_ATTACH,
+		OP_DROP,
+
+		NUM_OPCODES
+	};
+
+	struct CallInfo {
+		int functionId;
+		int returnAddr;
+		size_t stackTop;
+	};
+
+public:
+	/**
+	 * @param words the script code, followed by a few words of padding
+	 * @param scriptNames by function id, to resolve CALLs
+	 */
+	void Load(
+		const std::vector<int>& words,
+		const std::vector<std::string>& scriptNames,
+		const std::vector<int>& scriptOffsets,
+		const std::vector<int>& scriptLengths
+	);
+
+	/**
+	 * Executes from <PC> on, until an instruction Run does not handle
+	 * itself. Returns its opcode, with <PC> pointing to its first operand,
+	 * or OP_RETURN (with the value in <retCode>) when the function the
+	 * thread was started with returns.
+	 */
+	Opcode Run(
+		int& PC,
+		int& paramCount,
+		int& retCode,
+		std::vector<int>& stack,
+		std::vector<CallInfo>& callStack,
+		std::vector<int>& staticVars
+	) const;
+
+	/// the opcode id of the raw opcode <word>, OP_UNKNOWN if it is none
+	static Opcode GetOpcode(int word);
+
+public:
+	std::vector<int> code;
+	std::vector<unsigned char> opcodes;
+	std::vector<int> scriptOffsets;
+	/// Assumes that the scripts are sorted by offset in the file
+	std::vector<int> scriptLengths;
+};
+
+#endif // COB_BYTECODE_H
@@ -8,6 +8,8 @@
 #include "UnitScriptLog.h"
 #include "System/FileSystem/FileHandler.h"
 
+#include <algorithm>
+
 #ifndef _CONSOLE
 #include "System/TimeProfiler.h"
 #endif
@@ -28,7 +30,8 @@ int GCurrentTime;
 
 
 CCobEngine::CCobEngine()
-	: curThread(NULL)
+	: wheelTime(0)
+	, curThread(NULL)
 {
 	GCurrentTime = 0;
 }
@@ -36,25 +39,34 @@ CCobEngine::CCobEngine()
 
 CCobEngine::~CCobEngine()
 {
+	std::vector<CCobThread*> threads;
+
 	//Should delete all things that the scheduler knows
-	do {
-		while (!running.empty()) {
-			CCobThread* tmp = running.front();
-			running.pop_front();
-			delete tmp;
-		}
-		while (!wantToRun.empty()) {
-			CCobThread* tmp = wantToRun.front();
-			wantToRun.pop_front();
-			delete tmp;
-		}
-		while (!sleeping.empty()) {
-			CCobThread* tmp = sleeping.top();
-			sleeping.pop();
-			delete tmp;
+	bool haveThreads = true;
+	while (haveThreads) {
+		threads.clear();
+		threads.swap(running);
+		threads.insert(threads.end(), wantToRun.begin(), wantToRun.end());
+		wantToRun.clear();
+
+		for (int level = 0; level < WHEEL_LEVELS; ++level) {
+			for (int slot = 0; slot < WHEEL_SIZE; ++slot) {
+				threads.insert(threads.end(), sleeping[level][slot].begin(), sleeping[level][slot].end());
+				sleeping[level][slot].clear();
+			}
 		}
+
+		haveThreads = !threads.empty();
+
 		// callbacks may add new threads
-	} while (!running.empty() || !wantToRun.empty() || !sleeping.empty());
+		for (size_t i = 0; i < threads.size(); ++i) {
+			delete threads[i];
+		}
+	}
+
+	for (size_t i = 0; i < freeThreadMem.size(); ++i) {
+		::operator delete(freeThreadMem[i]);
+	}
 }
 
 
@@ -72,10 +84,10 @@ void CCobEngine::AddThread(CCobThread *thread)
 {
 	switch (thread->state) {
 		case CCobThread::Run:
-			wantToRun.push_front(thread);
+			wantToRun.push_back(thread);
 			break;
 		case CCobThread::Sleep:
-			sleeping.push(thread);
+			AddSleeping(thread);
 			break;
 		default:
 			LOG_L(L_ERROR, "thread added to scheduler with unknown state (%d)", thread->state);
@@ -84,6 +96,76 @@ void CCobEngine::AddThread(CCobThread *thread)
 }
 
 
+void CCobEngine::AddSleeping(CCobThread* thread)
+{
+	// a wake time that has passed already means the next slot to be woken
+	const unsigned int wakeTime = std::max(thread->GetWakeTime(), wheelTime);
+	const unsigned int diffBits = wakeTime ^ (unsigned int) wheelTime;
+
+	// the lowest level on which the wake time is in the current span
+	int level = 0;
+	while ((level < (WHEEL_LEVELS - 1)) && ((diffBits >> (WHEEL_BITS * (level + 1))) != 0)) {
+		++level;
+	}
+
+	sleeping[level][(wakeTime >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)].push_back(thread);
+}
+
+
+void CCobEngine::CascadeSleeping(int level, int slot)
+{
+	std::vector<CCobThread*> threads;
+	threads.swap(sleeping[level][slot]);
+
+	for (size_t i = 0; i < threads.size(); ++i) {
+		AddSleeping(threads[i]);
+	}
+}
+
+
+void CCobEngine::WakeSleeping()
+{
+	while (wheelTime < GCurrentTime) {
+		if ((wheelTime & (WHEEL_SIZE - 1)) == 0) {
+			// entering a new span of level 0 slots, higher levels first
+			int level = 1;
+			while ((level < (WHEEL_LEVELS - 1)) && (((wheelTime >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)) == 0)) {
+				++level;
+			}
+			for (; level > 0; --level) {
+				CascadeSleeping(level, (wheelTime >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1));
+			}
+		}
+
+		// threads put to sleep from here with a passed wake time land in
+		// this slot, so it can grow while it is worked off
+		std::vector<CCobThread*>& slot = sleeping[0][wheelTime & (WHEEL_SIZE - 1)];
+
+		for (size_t i = 0; i < slot.size(); ++i) {
+			CCobThread* cur = slot[i];
+
+			//Run forward again. This can quite possibly readd the thread to the sleeping array again
+			//But it will not interfere since it is guaranteed to sleep > 0 ms
+			//LOG_L(L_DEBUG, "Now 2running %d: %s", GCurrentTime, cur->GetName().c_str());
+#ifdef _CONSOLE
+			printf("+++\n");
+#endif
+			if (cur->state == CCobThread::Sleep) {
+				cur->state = CCobThread::Run;
+				TickThread(cur);
+			} else if (cur->state == CCobThread::Dead) {
+				delete cur;
+			} else {
+				LOG_L(L_ERROR, "Sleeping thread strange state %d", cur->state);
+			}
+		}
+
+		slot.clear();
+		++wheelTime;
+	}
+}
+
+
 void CCobEngine::TickThread(CCobThread* thread)
 {
 	curThread = thread; // for error messages originating in CUnitScript
@@ -104,7 +186,7 @@ void CCobEngine::Tick(int deltaTime)
 	LOG_L(L_DEBUG, "----");
 
 	// Advance all running threads
-	for (std::list<CCobThread*>::iterator i = running.begin(); i != running.end(); ++i) {
+	for (std::vector<CCobThread*>::iterator i = running.begin(); i != running.end(); ++i) {
 		//LOG_L(L_DEBUG, "Now 1running %d: %s", GCurrentTime, (*i)->GetName().c_str());
 #ifdef _CONSOLE
 		printf("----\n");
@@ -116,44 +198,34 @@ void CCobEngine::Tick(int deltaTime)
 	// note: if preemption was to be added, this would no longer hold
 	// however, ta scripts can not run preemptively anyway since there
 	// isn't any synchronization methods available
+	// The threads that just ran may have added new threads that should run next tick
 	running.clear();
+	running.swap(wantToRun);
 
-	// The threads that just ran may have added new threads that should run next tick
-	for (std::list<CCobThread *>::iterator i = wantToRun.begin(); i != wantToRun.end(); ++i) {
-		running.push_front(*i);
-	}
+	//Check on the sleeping threads
+	WakeSleeping();
+}
 
-	wantToRun.clear();
 
-	//Check on the sleeping threads
-	if (!sleeping.empty()) {
-		CCobThread* cur = sleeping.top();
+void* CCobEngine::AllocThreadMem(size_t size)
+{
+	if (size != sizeof(CCobThread) || freeThreadMem.empty())
+		return ::operator new(size);
 
-		while ((cur != NULL) && (cur->GetWakeTime() < GCurrentTime)) {
-			// Start with removing the executing thread from the queue
-			sleeping.pop();
+	void* p = freeThreadMem.back();
+	freeThreadMem.pop_back();
+	return p;
+}
 
-			//Run forward again. This can quite possibly readd the thread to the sleeping array again
-			//But it will not interfere since it is guaranteed to sleep > 0 ms
-			//LOG_L(L_DEBUG, "Now 2running %d: %s", GCurrentTime, cur->GetName().c_str());
-#ifdef _CONSOLE
-			printf("+++\n");
-#endif
-			if (cur->state == CCobThread::Sleep) {
-				cur->state = CCobThread::Run;
-				TickThread(cur);
-			} else if (cur->state == CCobThread::Dead) {
-				delete cur;
-			} else {
-				LOG_L(L_ERROR, "Sleeping thread strange state %d", cur->state);
-			}
 
-			if (!sleeping.empty())
-				cur = sleeping.top();
-			else
-				cur = NULL;
-		}
+void CCobEngine::FreeThreadMem(void* p, size_t size)
+{
+	if (size != sizeof(CCobThread)) {
+		::operator delete(p);
+		return;
 	}
+
+	freeThreadMem.push_back(p);
 }
 
 
@@ -11,8 +11,7 @@
 
 #include "CobThread.h"
 
-#include <list>
-#include <queue>
+#include <vector>
 #include <map>
 
 class CCobThread;
@@ -20,32 +19,48 @@ class CCobInstance;
 class CCobFile;
 
 
-class CCobThreadPtr_less : public std::binary_function<CCobThread*, CCobThread*, bool> {
-public:
-	bool operator() (const CCobThread* const& a, const CCobThread* const& b) const {
-		return a->GetWakeTime() > b->GetWakeTime();
-	}
-};
-
-
 class CCobEngine
 {
 protected:
-	std::list<CCobThread*> running;
+	std::vector<CCobThread*> running;
 	/**
 	 * Threads are added here if they are in Running.
 	 * And moved to real running after running is empty.
 	 */
-	std::list<CCobThread*> wantToRun;
-	std::priority_queue<CCobThread*, std::vector<CCobThread*>, CCobThreadPtr_less> sleeping;
+	std::vector<CCobThread*> wantToRun;
+
+	/**
+	 * Sleeping threads, in a hierarchical timer wheel keyed on wake time
+	 * (in ms). Level 0 has a slot per ms, every higher level a slot per
+	 * whole span of the level below; a slot is cascaded down when the
+	 * wheel reaches it. Threads with the same wake time wake in the order
+	 * they reached the level 0 slot.
+	 */
+	static const int WHEEL_BITS = 8;
+	static const int WHEEL_SIZE = (1 << WHEEL_BITS);
+	static const int WHEEL_LEVELS = 4;
+
+	std::vector<CCobThread*> sleeping[WHEEL_LEVELS][WHEEL_SIZE];
+	/// threads waking before this time have been woken
+	int wheelTime;
+
+	/// memory of deleted threads, for reuse
+	std::vector<void*> freeThreadMem;
+
 	CCobThread* curThread;
 	void TickThread(CCobThread* thread);
+	void AddSleeping(CCobThread* thread);
+	void CascadeSleeping(int level, int slot);
+	void WakeSleeping();
 public:
 	CCobEngine();
 	~CCobEngine();
 	void AddThread(CCobThread* thread);
 	void Tick(int deltaTime);
 	void ShowScriptError(const std::string& msg);
+
+	void* AllocThreadMem(size_t size);
+	void FreeThreadMem(void* p, size_t size);
 };
 
 
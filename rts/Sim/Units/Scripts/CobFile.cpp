@@ -106,6 +106,9 @@ CCobFile::CCobFile(CFileHandler &in, string name)
 	COBHeader ch;
 	READ_COBHEADER(ch,cobdata);
 
+	std::vector<int> scriptOffsets;
+	std::vector<int> scriptLengths;
+
 	// prepare
 	luaScripts.reserve(ch.NumberOfScripts);
 	scriptNames.reserve(ch.NumberOfScripts);
@@ -149,12 +152,14 @@ CCobFile::CCobFile(CFileHandler &in, string name)
 
 	int code_octets = size - ch.OffsetToScriptCode;
 	int code_ints = (code_octets) / 4 + 4;
-	code = new int[code_ints];
-	memcpy(code, &cobdata[ch.OffsetToScriptCode], code_octets);
+	std::vector<int> code(code_ints, 0);
+	memcpy(&code[0], &cobdata[ch.OffsetToScriptCode], code_octets);
 	for (int i = 0; i < code_ints; i++) {
 		swabDWordInPlace(code[i]);
 	}
 
+	bytecode.Load(code, scriptNames, scriptOffsets, scriptLengths);
+
 	numStaticVars = ch.NumberOfStaticVars;
 
 	// If this is a TA:K script, read the sound names
@@ -199,7 +204,6 @@ CCobFile::CCobFile(CFileHandler &in, string name)
 
 CCobFile::~CCobFile()
 {
-	delete[] code;
 }
 
 
@@ -8,6 +8,7 @@
 #include <map>
 
 #include "Lua/LuaHashString.h"
+#include "CobBytecode.h"
 #include "CobScriptNames.h"
 
 class CFileHandler;
@@ -22,15 +23,13 @@ public:
 
 
 	std::vector<std::string> scriptNames;
-	std::vector<int> scriptOffsets;
-	/// Assumes that the scripts are sorted by offset in the file
-	std::vector<int> scriptLengths;
 	std::vector<std::string> pieceNames;
 	std::vector<int> scriptIndex;
 	std::vector<int> sounds;
 	std::map<std::string, int> scriptMap;
 	std::vector<LuaHashString> luaScripts;
-	int* code;
+	/// the script code (and where each script starts), decoded at load
+	CCobBytecode bytecode;
 	int numStaticVars;
 	std::string name;
 };
@@ -3,6 +3,7 @@
 #ifndef COB_THREAD_H
 #define COB_THREAD_H
 
+#include "CobBytecode.h"
 #include "CobInstance.h"
 #include "System/Object.h"
 #include "Lua/LuaRules.h"
@@ -21,6 +22,10 @@ public:
 	/// Inform the vultures that we finally croaked
 	~CCobThread();
 
+	/// threads are started and killed all the time, so CCobEngine pools them
+	void* operator new(size_t size);
+	void operator delete(void* p, size_t size);
+
 	/**
 	 * Returns false if this thread is dead and needs to be killed.
 	 */
@@ -77,12 +82,7 @@ protected:
 
 	int luaArgs[MAX_LUA_COB_ARGS];
 
-	struct callInfo {
-		int functionId;
-		int returnAddr;
-		size_t stackTop;
-	};
-	vector<struct callInfo> callStack;
+	vector<CCobBytecode::CallInfo> callStack;
 
 	CBCobThreadFinish callback;
 	void* cbParam1;
@@ -813,6 +813,9 @@ unsigned short CUnit::CalcLosStatus(int at)
 	unsigned short newStatus = currStatus;
 	unsigned short mask = ~(currStatus >> 8);
 
+	// apply the coverage changes queued by units moved earlier this frame
+	radarhandler->Update();
+
 	if (loshandler->InLos(this, at)) {
 		if (!beingBuilt) {
 			newStatus |= (mask & (LOS_INLOS   | LOS_INRADAR |
@@ -1378,6 +1381,8 @@ void CUnit::DoSeismicPing(float pingSize)
 	float rz = gs->randFloat();
 
 	const float* errorScale = &radarhandler->radarErrorSize[0];
+	radarhandler->Update();
+
 	if (!(losStatus[gu->myAllyTeam] & LOS_INLOS) &&
 	    radarhandler->InSeismicDistance(this, gu->myAllyTeam)) {
 		const float3 err(errorScale[gu->myAllyTeam] * (0.5f - rx), 0.0f,
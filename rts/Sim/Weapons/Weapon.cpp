@@ -722,13 +722,12 @@ bool CWeapon::AllowWeaponTargetCheck()
 void CWeapon::AutoTarget() {
 	lastTargetRetry = gs->frameNum;
 
-	std::multimap<float, CUnit*> targets;
-	std::multimap<float, CUnit*>::const_iterator targetsIt;
+	// reused by all weapons (AutoTarget is never called recursively)
+	static std::vector<CGameHelper::WeaponTarget> targets;
 
 	// NOTE:
-	//   sorts by INCREASING order of priority, so lower equals better
-	//   <targets> can contain duplicates if a unit covers multiple quads
-	//   <targets> is normally sorted such that all bad TC units are at the
+	//   visited in INCREASING order of priority, so lower equals better
+	//   <targets> is normally ordered such that all bad TC units are at the
 	//   end, but Lua can mess with the ordering arbitrarily
 	CGameHelper::GenerateWeaponTargets(this, targetUnit, targets);
 
@@ -738,8 +737,17 @@ void CWeapon::AutoTarget() {
 
 	float3 nextTargetPos = ZeroVector;
 
-	for (targetsIt = targets.begin(); targetsIt != targets.end(); ++targetsIt) {
-		CUnit* nextTargetUnit = targetsIt->second;
+	// one of the first few candidates is usually taken, so only sort as
+	// many as needed (in growing batches) instead of all of them
+	size_t numSortedTargets = 0;
+
+	for (size_t i = 0; i < targets.size(); ++i) {
+		if (i == numSortedTargets) {
+			numSortedTargets = std::min(targets.size(), std::max(numSortedTargets * 2, size_t(8)));
+			std::partial_sort(targets.begin() + i, targets.begin() + numSortedTargets, targets.end());
+		}
+
+		CUnit* nextTargetUnit = targets[i].unit;
 
 		if (nextTargetUnit == prevTargetUnit)
 			continue; // filter consecutive duplicates
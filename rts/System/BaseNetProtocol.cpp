@@ -399,6 +399,17 @@ PacketType CBaseNetProtocol::SendCurrentFrameProgress(int frameNum)
 	return PacketType(packet);
 }
 
+PacketType CBaseNetProtocol::SendGameState(int frameNum, uint stateSize, const boost::uint8_t* data, unsigned length)
+{
+	if ((11 + length) >= (1 << (sizeof(boost::uint16_t) * 8)))
+		throw netcode::PackPacketException("Maximum size exceeded");
+	boost::uint16_t size = 11 + length;
+	PackPacket* packet = new PackPacket(size, NETMSG_GAMESTATE);
+	*packet << size << frameNum << stateSize;
+	std::memcpy(packet->GetWritingPos(), data, length);
+	return PacketType(packet);
+}
+
 
 
 #ifdef SYNCDEBUG
@@ -504,6 +515,7 @@ CBaseNetProtocol::CBaseNetProtocol()
 	proto->AddType(NETMSG_AI_CREATED, -1);
 	proto->AddType(NETMSG_AI_STATE_CHANGED, 4);
 	proto->AddType(NETMSG_GAME_FRAME_PROGRESS,5);
+	proto->AddType(NETMSG_GAMESTATE, -2);
 
 #ifdef SYNCDEBUG
 	proto->AddType(NETMSG_SD_CHKREQUEST, 5);
@@ -14,7 +14,7 @@ namespace netcode
 }
 struct PlayerStatistics;
 
-const unsigned short NETWORK_VERSION = 7;
+const unsigned short NETWORK_VERSION = 8;
 
 /*
  * Comment behind NETMSG enumeration constant gives the extra data belonging to
@@ -101,6 +101,8 @@ enum NETMSG {
 
 	NETMSG_GAME_FRAME_PROGRESS= 77, // int frameNum # this special packet skips queue & cache entirely, indicates current game progress for clients fast-forwarding to current point the game #
 
+	NETMSG_GAMESTATE        = 78, // ushort msgsize, int frameNum, uint stateSize, std::vector<uint8_t> data # part of a creg game-state snapshot taken after frameNum, sent by the host and handed to mid-game joiners #
+
 
 	NETMSG_LAST //max types of netmessages, internal only
 };
@@ -184,6 +186,8 @@ public:
 	PacketType SendPlayerLeft(uchar myPlayerNum, uchar bIntended);
 	PacketType SendLuaMsg(uchar myPlayerNum, unsigned short script, uchar mode, const std::vector<boost::uint8_t>& msg);
 	PacketType SendCurrentFrameProgress(int frameNum);
+	/// one part of a game-state snapshot, <length> bytes at <data> (the whole state is <stateSize> bytes)
+	PacketType SendGameState(int frameNum, uint stateSize, const boost::uint8_t* data, unsigned length);
 
 	PacketType SendGiveAwayEverything(uchar myPlayerNum, uchar giveToTeam);
 	/**
@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "ArchiveScanner.h"
 
@@ -21,7 +23,6 @@
 #include "System/CRC.h"
 #include "System/Util.h"
 #include "System/Exceptions.h"
-#include "System/OpenMP_cond.h"
 #if       !defined(DEDICATED) && !defined(UNITSYNC)
 #include "System/Platform/Threading.h"
 #include "System/Platform/Watchdog.h"
@@ -45,7 +46,7 @@ LOG_REGISTER_SECTION_GLOBAL(LOG_SECTION_ARCHIVESCANNER)
  * but mapping them all, every time to make the list is)
  */
 
-const int INTERNAL_VER = 9;
+const int INTERNAL_VER = 10;
 CArchiveScanner* archiveScanner = NULL;
 
 
@@ -395,6 +396,8 @@ void CArchiveScanner::Scan(const std::string& curPath, bool doChecksum)
 	const int flags = (FileQueryFlags::INCLUDE_DIRS | FileQueryFlags::RECURSE);
 	const std::vector<std::string> &found = dataDirsAccess.FindFiles(curPath, "*", flags);
 
+	std::vector<ArchiveScan> scans;
+
 	for (std::vector<std::string>::const_iterator it = found.begin(); it != found.end(); ++it) {
 		std::string fullName = *it;
 
@@ -423,7 +426,35 @@ void CArchiveScanner::Scan(const std::string& curPath, bool doChecksum)
 #endif // !defined(DEDICATED) && !defined(UNITSYNC)
 		// Is this an archive we should look into?
 		if (archiveLoader.IsArchiveFile(fullName)) {
-			ScanArchive(fullName, doChecksum);
+			ArchiveScan scan;
+			if (PrepareScan(fullName, doChecksum, scan)) {
+				scans.push_back(scan);
+			}
+		}
+	}
+
+	// Open, read and checksum the new and modified archives in parallel
+	// (the main thread being one of the workers); the results are merged in
+	// the order the archives were found, so the outcome does not depend on
+	// the number of threads
+	if (!scans.empty()) {
+		const size_t numThreads = std::min(scans.size(), size_t(std::max(1u, boost::thread::hardware_concurrency())));
+		std::vector<boost::thread*> threads(numThreads - 1, NULL);
+		size_t nextScan = 0;
+
+		for (size_t i = 0; i < threads.size(); ++i) {
+			threads[i] = new boost::thread(boost::bind(&CArchiveScanner::ReadArchivesWorker, this, &scans, &nextScan));
+		}
+
+		ReadArchivesWorker(&scans, &nextScan);
+
+		for (size_t i = 0; i < threads.size(); ++i) {
+			threads[i]->join();
+			delete threads[i];
+		}
+
+		for (std::vector<ArchiveScan>::iterator it = scans.begin(); it != scans.end(); ++it) {
+			FinishScan(*it);
 		}
 	}
 
@@ -467,72 +498,94 @@ static void AddDependency(std::vector<std::string>& deps, const std::string& dep
 
 void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 {
-	const std::string fn    = FileSystem::GetFilename(fullName);
-	const std::string fpath = FileSystem::GetDirectory(fullName);
-	const std::string lcfn  = StringToLower(fn);
+	ArchiveScan scan;
+
+	if (PrepareScan(fullName, doChecksum, scan)) {
+		ReadArchive(scan);
+		FinishScan(scan);
+	}
+}
+
+bool CArchiveScanner::PrepareScan(const std::string& fullName, bool doChecksum, ArchiveScan& scan)
+{
+	scan.fullName   = fullName;
+	scan.fn         = FileSystem::GetFilename(fullName);
+	scan.fpath      = FileSystem::GetDirectory(fullName);
+	scan.lcfn       = StringToLower(scan.fn);
+	scan.doChecksum = doChecksum;
 
 	// Cache variables
 	std::map<std::string, ArchiveInfo>::iterator aii;
-	bool cached = false;
 
 	// Stat file
 	struct stat info = {0};
 	int statfailed = stat(fullName.c_str(), &info);
 
+	scan.modified = info.st_mtime;
+	scan.isDir = ((info.st_mode & S_IFDIR) != 0);
+
 	// If stat fails, assume the archive is not broken nor cached
 	if (!statfailed) {
 		// Determine whether this archive has earlier be found to be broken
-		std::map<std::string, BrokenArchive>::iterator bai = brokenArchives.find(lcfn);
+		std::map<std::string, BrokenArchive>::iterator bai = brokenArchives.find(scan.lcfn);
 		if (bai != brokenArchives.end()) {
-			if ((unsigned)info.st_mtime == bai->second.modified && fpath == bai->second.path) {
+			if ((unsigned)info.st_mtime == bai->second.modified && scan.fpath == bai->second.path) {
 				bai->second.updated = true;
-				return;
+				return false;
 			}
 		}
 
 
 		// Determine whether to rely on the cached info or not
-		if ((aii = archiveInfos.find(lcfn)) != archiveInfos.end()) {
+		if ((aii = archiveInfos.find(scan.lcfn)) != archiveInfos.end()) {
 			// This archive may have been obsoleted, do not process it if so
 			if (aii->second.replaced.length() > 0) {
-				return;
+				return false;
 			}
 
-			if ((unsigned)info.st_mtime == aii->second.modified && fpath == aii->second.path) {
-				cached = true;
+			// keep the file checksums of directory archives even if the
+			// rest is outdated, they are validated file by file
+			scan.fileCRCs = aii->second.fileCRCs;
+
+			if ((unsigned)info.st_mtime == aii->second.modified && scan.fpath == aii->second.path) {
 				aii->second.updated = true;
-			}
 
-			// If we are here, we could have invalid info in the cache
-			// Force a reread if it is a directory archive (.sdd), as
-			// st_mtime only reflects changes to the directory itself,
-			// not the contents.
-			if (!cached) {
-				archiveInfos.erase(aii);
+				// st_mtime of a directory archive (.sdd) only reflects
+				// changes to the directory itself, not the contents, so
+				// its checksum always needs a (cheap, see GetCRC) update
+				scan.needInfo = false;
+				return (doChecksum && (aii->second.checksum == 0 || scan.isDir));
 			}
+
+			archiveInfos.erase(aii);
 		}
 	}
 
-	// Time to parse the info we are interested in
-	if (cached) {
-		// If cached is true, aii will point to the archive
-		if (doChecksum && (aii->second.checksum == 0))
-			aii->second.checksum = GetCRC(fullName);
-	} else {
-		IArchive* ar = archiveLoader.OpenArchive(fullName);
-		if (!ar || !ar->IsOpen()) {
-			LOG("Unable to open archive: %s", fullName.c_str());
-			return;
-		}
+	return true;
+}
 
-		ArchiveInfo ai;
+void CArchiveScanner::ReadArchive(ArchiveScan& scan)
+{
+	IArchive* ar = NULL;
 
-		std::string error;
-		std::string mapfile;
+	{
+		// the archive factories are not reentrant (7z sets up its global
+		// CRC table whenever it opens an archive)
+		boost::mutex::scoped_lock lock(scanMutex);
+		ar = archiveLoader.OpenArchive(scan.fullName);
+	}
+
+	if (!ar || !ar->IsOpen()) {
+		delete ar;
+		return;
+	}
+
+	scan.opened = true;
+
+	if (scan.needInfo) {
+		scan.hasModinfo = ar->FileExists("modinfo.lua");
+		scan.hasMapinfo = ar->FileExists("mapinfo.lua");
 
-		const bool hasModinfo = ar->FileExists("modinfo.lua");
-		const bool hasMapinfo = ar->FileExists("mapinfo.lua");
-		
 		// check for smf/sm3 and if the uncompression of important files is too costy
 		for (unsigned fid = 0; fid != ar->NumFiles(); ++fid) {
 			std::string name;
@@ -542,7 +595,7 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 			const std::string ext = FileSystem::GetExtension(lowerName);
 
 			if ((ext == "smf") || (ext == "sm3")) {
-				mapfile = name;
+				scan.mapfile = name;
 			}
 
 			const unsigned char metaFileClass = GetMetaFileClass(lowerName);
@@ -550,104 +603,143 @@ void CArchiveScanner::ScanArchive(const std::string& fullName, bool doChecksum)
 				// is a meta-file and not cheap to read
 				if (metaFileClass == 1) {
 					// 1st class
-					error = "Unpacking/reading cost for meta file " + name
+					scan.error = "Unpacking/reading cost for meta file " + name
 							+ " is too high, please repack the archive (make sure to use a non-solid algorithm, if applicable)";
 					break;
 				} else if (metaFileClass == 2) {
 					// 2nd class
 					LOG_SL(LOG_SECTION_ARCHIVESCANNER, L_WARNING,
 							"Archive %s: The cost for reading a 2nd-class meta-file is too high: %s",
-							fullName.c_str(), name.c_str());
+							scan.fullName.c_str(), name.c_str());
 				}
 			}
 		}
 
-		/*
-		if (!error.empty()) {
-			// we already have an error, no further evaluation required
+		// maps may use modinfo.lua for backwards-compatibility
+		const std::string infoFile = scan.hasMapinfo? "mapinfo.lua": (scan.hasModinfo? "modinfo.lua": "");
+		std::vector<boost::uint8_t> buf;
+
+		if (!infoFile.empty() && ar->GetFile(infoFile, buf)) {
+			scan.infoFile = infoFile;
+			scan.infoLua.assign((char*)(&buf[0]), buf.size());
 		}
-		*/
-		if (hasMapinfo || !mapfile.empty()) {
-			// it is a map
-			if (hasMapinfo) {
-				ScanArchiveLua(ar, "mapinfo.lua", ai, error);
-			} else if (hasModinfo) {
-				// backwards-compat for modinfo.lua in maps
-				ScanArchiveLua(ar, "modinfo.lua", ai, error);
-			}
+	}
 
-			if (ai.archiveData.GetName().empty()) {
-				// FIXME The name will never be empty, if version is set (see HACK in ArchiveData)
-				ai.archiveData.SetInfoItemValueString("name", FileSystem::GetBasename(mapfile));
-			}
-			if (ai.archiveData.GetMapFile().empty()) {
-				ai.archiveData.SetInfoItemValueString("mapfile", mapfile);
-			}
+	// Optionally calculate a checksum for the file
+	// (there is no point for archives that are going to be marked as broken)
+	if (scan.doChecksum && scan.error.empty()) {
+		scan.checksum = GetCRC(ar, scan.fullName, scan.isDir? &scan.fileCRCs: NULL);
+	}
 
-			AddDependency(ai.archiveData.GetDependencies(), "Map Helper v1");
-			ai.archiveData.SetInfoItemValueInteger("modType", modtype::map);
-
-			LOG_S(LOG_SECTION_ARCHIVESCANNER, "Found new map: %s",
-					ai.archiveData.GetName().c_str());
-		} else if (hasModinfo) {
-			// it is a mod
-			ScanArchiveLua(ar, "modinfo.lua", ai, error);
-			if (ai.archiveData.GetModType() == modtype::primary) {
-				AddDependency(ai.archiveData.GetDependencies(), "Spring content v1");
-			}
+	delete ar;
+}
 
-			LOG_S(LOG_SECTION_ARCHIVESCANNER, "Found new game: %s",
-					ai.archiveData.GetName().c_str());
-		} else {
-			// neither a map nor a mod: error
-			error = "missing modinfo.lua/mapinfo.lua";
+void CArchiveScanner::ReadArchivesWorker(std::vector<ArchiveScan>* scans, size_t* nextScan)
+{
+	while (true) {
+		ArchiveScan* scan = NULL;
+
+		{
+			boost::mutex::scoped_lock lock(scanMutex);
+			if (*nextScan >= scans->size())
+				return;
+
+			scan = &(*scans)[(*nextScan)++];
 		}
 
-		delete ar;
+		try {
+			ReadArchive(*scan);
+		} catch (const std::exception& ex) {
+			// do not let it escape the worker thread, FinishScan handles it
+			scan->error = ex.what();
+		}
+	}
+}
 
-		if (!error.empty()) {
-			// for some reason, the archive is marked as broken
-			LOG_L(L_WARNING, "Failed to scan %s (%s)",
-					fullName.c_str(), error.c_str());
-
-			// record it as broken, so we don't need to look inside everytime
-			BrokenArchive ba;
-			ba.path = fpath;
-			ba.modified = info.st_mtime;
-			ba.updated = true;
-			ba.problem = error;
-			brokenArchives[lcfn] = ba;
-			return;
+void CArchiveScanner::FinishScan(ArchiveScan& scan)
+{
+	if (!scan.needInfo) {
+		// only the checksum changed (if at all)
+		if (scan.opened && scan.error.empty()) {
+			ArchiveInfo& ai = archiveInfos[scan.lcfn];
+			ai.checksum = scan.checksum;
+			ai.fileCRCs.swap(scan.fileCRCs);
 		}
+		return;
+	}
 
-		ai.path = fpath;
-		ai.modified = info.st_mtime;
-		ai.origName = fn;
-		ai.updated = true;
-
-		// Optionally calculate a checksum for the file
-		// To prevent reading all files in all directory (.sdd) archives
-		// every time this function is called, directory archive checksums
-		// are calculated on the fly.
-		if (doChecksum) {
-			ai.checksum = GetCRC(fullName);
-		} else {
-			ai.checksum = 0;
+	if (!scan.opened) {
+		LOG("Unable to open archive: %s", scan.fullName.c_str());
+		return;
+	}
+
+	ArchiveInfo ai;
+	std::string error = scan.error;
+
+	if (scan.hasMapinfo || !scan.mapfile.empty()) {
+		// it is a map
+		ScanArchiveLua(scan, ai, error);
+
+		if (ai.archiveData.GetName().empty()) {
+			// FIXME The name will never be empty, if version is set (see HACK in ArchiveData)
+			ai.archiveData.SetInfoItemValueString("name", FileSystem::GetBasename(scan.mapfile));
 		}
+		if (ai.archiveData.GetMapFile().empty()) {
+			ai.archiveData.SetInfoItemValueString("mapfile", scan.mapfile);
+		}
+
+		AddDependency(ai.archiveData.GetDependencies(), "Map Helper v1");
+		ai.archiveData.SetInfoItemValueInteger("modType", modtype::map);
 
-		archiveInfos[lcfn] = ai;
+		LOG_S(LOG_SECTION_ARCHIVESCANNER, "Found new map: %s",
+				ai.archiveData.GetName().c_str());
+	} else if (scan.hasModinfo) {
+		// it is a mod
+		ScanArchiveLua(scan, ai, error);
+		if (ai.archiveData.GetModType() == modtype::primary) {
+			AddDependency(ai.archiveData.GetDependencies(), "Spring content v1");
+		}
+
+		LOG_S(LOG_SECTION_ARCHIVESCANNER, "Found new game: %s",
+				ai.archiveData.GetName().c_str());
+	} else {
+		// neither a map nor a mod: error
+		error = "missing modinfo.lua/mapinfo.lua";
 	}
+
+	if (!error.empty()) {
+		// for some reason, the archive is marked as broken
+		LOG_L(L_WARNING, "Failed to scan %s (%s)",
+				scan.fullName.c_str(), error.c_str());
+
+		// record it as broken, so we don't need to look inside everytime
+		BrokenArchive ba;
+		ba.path = scan.fpath;
+		ba.modified = scan.modified;
+		ba.updated = true;
+		ba.problem = error;
+		brokenArchives[scan.lcfn] = ba;
+		return;
+	}
+
+	ai.path = scan.fpath;
+	ai.modified = scan.modified;
+	ai.origName = scan.fn;
+	ai.updated = true;
+	ai.checksum = (scan.doChecksum? scan.checksum: 0);
+	ai.fileCRCs.swap(scan.fileCRCs);
+
+	archiveInfos[scan.lcfn] = ai;
 }
 
-bool CArchiveScanner::ScanArchiveLua(IArchive* ar, const std::string& fileName, ArchiveInfo& ai, std::string& err)
+bool CArchiveScanner::ScanArchiveLua(const ArchiveScan& scan, ArchiveInfo& ai, std::string& err)
 {
-	std::vector<boost::uint8_t> buf;
-	if (!ar->GetFile(fileName, buf)) {
+	if (scan.infoFile.empty()) {
 		return false;
 	}
 
-	const std::string cleanbuf((char*)(&buf[0]), buf.size());
-	LuaParser p(cleanbuf, SPRING_VFS_MOD);
+	const std::string& fileName = scan.infoFile;
+	LuaParser p(scan.infoLua, SPRING_VFS_MOD);
 
 	if (!p.Execute()) {
 		err = "Error in " + fileName + ": " + p.GetErrorLog();
@@ -695,19 +787,12 @@ struct CRCPair {
 
 /**
  * Get CRC of the data in the specified archive.
- * Returns 0 if file could not be opened.
  */
-unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
+unsigned int CArchiveScanner::GetCRC(IArchive* ar, const std::string& fullName, std::map<std::string, FileCRC>* fileCRCs)
 {
 	CRC crc;
-	IArchive* ar;
 	std::list<std::string> files;
-
-	// Try to open an archive
-	ar = archiveLoader.OpenArchive(arcName);
-	if (!ar) {
-		return 0; // It wasn't an archive
-	}
+	std::map<std::string, FileCRC> curFileCRCs;
 
 	// Load ignore list.
 	IFileFilter* ignore = CreateIgnoreFilter(ar);
@@ -729,7 +814,6 @@ unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
 	// Sort by FileName
 	files.sort();
 
-	// Push the filenames into a std::vector, cause OMP can better iterate over those
 	std::vector<CRCPair> crcs;
 	crcs.reserve(files.size());
 	CRCPair crcp;
@@ -739,23 +823,43 @@ unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
 	}
 
 	// Compute CRCs of the files
-	// Hint: Multithreading only speedups `.sdd` loading. For those the CRC generation is extremely slow -
-	//       it has to load the full file to calc it! For the other formats (sd7, sdz, sdp) the CRC is saved
-	//       in the metainformation of the container and so the loading is much faster. Neither does any of our
-	//       current (2011) packing libraries support multithreading :/
-	int i;
-#if !defined(DEDICATED) && !defined(UNITSYNC)
-//	Threading::OMPCheck();
-#endif
-//	This is currently used too early, OMP is not initialized here
-//	#pragma omp parallel for private(i)
-	for (i=0; i<crcs.size(); ++i) {
+	// Hint: The CRC generation is only slow for `.sdd` archives - it has to
+	//       load the full file to calc it! For the other formats (sd7, sdz, sdp)
+	//       the CRC is saved in the metainformation of the container. That is
+	//       why the CRCs of files in directory archives are cached and reused
+	//       for as long as the size and mtime of the file stay the same.
+	//       Archives are checksummed in parallel (see Scan), the files of one
+	//       are not: none of our packing libraries supports that.
+	for (size_t i = 0; i < crcs.size(); ++i) {
 		CRCPair& crcp = crcs[i];
 		const unsigned int nameCRC = CRC().Update(crcp.filename->data(), crcp.filename->size()).GetDigest();
 		const unsigned fid = ar->FindFile(*crcp.filename);
-		const unsigned int dataCRC = ar->GetCrc32(fid);
+
 		crcp.nameCRC = nameCRC;
-		crcp.dataCRC = dataCRC;
+
+		if (fileCRCs != NULL) {
+			std::string name;
+			int size;
+			ar->FileInfo(fid, name, size);
+
+			struct stat info = {0};
+			stat((fullName + "/" + name).c_str(), &info);
+
+			FileCRC& fileCRC = curFileCRCs[*crcp.filename];
+			fileCRC.modified = info.st_mtime;
+			fileCRC.size = info.st_size;
+
+			const std::map<std::string, FileCRC>::const_iterator cfi = fileCRCs->find(*crcp.filename);
+			if (cfi != fileCRCs->end() && cfi->second.modified == fileCRC.modified && cfi->second.size == fileCRC.size) {
+				fileCRC.crc = cfi->second.crc;
+			} else {
+				fileCRC.crc = ar->GetCrc32(fid);
+			}
+
+			crcp.dataCRC = fileCRC.crc;
+		} else {
+			crcp.dataCRC = ar->GetCrc32(fid);
+		}
 	#if !defined(DEDICATED) && !defined(UNITSYNC)
 		Watchdog::ClearTimer(WDT_MAIN);
 	#endif
@@ -765,13 +869,13 @@ unsigned int CArchiveScanner::GetCRC(const std::string& arcName)
 	for (std::vector<CRCPair>::iterator it = crcs.begin(); it != crcs.end(); ++it) {
 		crc.Update(it->nameCRC);
 		crc.Update(it->dataCRC);
-	#if !defined(DEDICATED) && !defined(UNITSYNC)
-		Watchdog::ClearTimer();
-	#endif
 	}
 
 	delete ignore;
-	delete ar;
+
+	if (fileCRCs != NULL) {
+		fileCRCs->swap(curFileCRCs);
+	}
 
 	unsigned int digest = crc.GetDigest();
 
@@ -822,6 +926,16 @@ void CArchiveScanner::ReadCacheData(const std::string& filename)
 		ai.checksum = strtoul(curArchive.GetString("checksum", "0").c_str(), 0, 10);
 		ai.updated = false;
 
+		const LuaTable files = curArchive.SubTable("files");
+		for (int f = 1; files.KeyExists(f); ++f) {
+			const LuaTable curFile = files.SubTable(f);
+			FileCRC& fileCRC = ai.fileCRCs[curFile.GetString("name", "")];
+
+			fileCRC.modified = strtoul(curFile.GetString("modified", "0").c_str(), 0, 10);
+			fileCRC.size     = strtoul(curFile.GetString("size", "0").c_str(), 0, 10);
+			fileCRC.crc      = strtoul(curFile.GetString("crc", "0").c_str(), 0, 10);
+		}
+
 		ai.archiveData = CArchiveScanner::ArchiveData(archived, true);
 		if (ai.archiveData.GetModType() == modtype::map) {
 			AddDependency(ai.archiveData.GetDependencies(), "Map Helper v1");
@@ -852,16 +966,21 @@ void CArchiveScanner::ReadCacheData(const std::string& filename)
 	isDirty = false;
 }
 
+static inline std::string QuoteStr(const std::string& str)
+{
+	if (str.find_first_of("\\\"") == std::string::npos) {
+		return "\"" + str + "\"";
+	} else {
+		return "[[" + str + "]]";
+	}
+}
+
 static inline void SafeStr(FILE* out, const char* prefix, const std::string& str)
 {
 	if (str.empty()) {
 		return;
 	}
-	if (str.find_first_of("\\\"") == std::string::npos) {
-		fprintf(out, "%s\"%s\",\n", prefix, str.c_str());
-	} else {
-		fprintf(out, "%s[[%s]],\n", prefix, str.c_str());
-	}
+	fprintf(out, "%s%s,\n", prefix, QuoteStr(str).c_str());
 }
 
 void FilterDep(std::vector<std::string>& deps, const std::string& exclude)
@@ -923,6 +1042,18 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 		fprintf(out, "\t\t\tchecksum = \"%u\",\n", arcInfo.checksum);
 		SafeStr(out, "\t\t\treplaced = ",          arcInfo.replaced);
 
+		if (!arcInfo.fileCRCs.empty()) {
+			fprintf(out, "\t\t\tfiles = {\n");
+
+			std::map<std::string, FileCRC>::const_iterator fi;
+			for (fi = arcInfo.fileCRCs.begin(); fi != arcInfo.fileCRCs.end(); ++fi) {
+				fprintf(out, "\t\t\t\t{ name = %s, modified = \"%u\", size = \"%u\", crc = \"%u\" },\n",
+						QuoteStr(fi->first).c_str(), fi->second.modified, fi->second.size, fi->second.crc);
+			}
+
+			fprintf(out, "\t\t\t},\n");
+		}
+
 		// mod info?
 		const ArchiveData& archData = arcInfo.archiveData;
 		if (!archData.GetName().empty()) {
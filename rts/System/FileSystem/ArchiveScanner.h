@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <boost/thread/mutex.hpp>
 #include "System/Info.h"
 
 class IArchive;
@@ -148,6 +149,18 @@ public:
 	static unsigned char GetMetaFileClass(const std::string& filePath);
 
 private:
+	/// checksum of a file in a directory archive, valid as long as its size and mtime match
+	struct FileCRC
+	{
+		FileCRC()
+			: modified(0)
+			, size(0)
+			, crc(0)
+			{}
+		unsigned int modified;
+		unsigned int size;
+		unsigned int crc;
+	};
 	struct ArchiveInfo
 	{
 		ArchiveInfo()
@@ -162,6 +175,8 @@ private:
 		unsigned int modified;
 		unsigned int checksum;
 		bool updated;
+		/// by lower-case file name, only kept for directory archives (.sdd)
+		std::map<std::string, FileCRC> fileCRCs;
 	};
 	struct BrokenArchive
 	{
@@ -175,12 +190,63 @@ private:
 		std::string problem;
 	};
 
+	/**
+	 * One archive to (re)scan, see Scan().
+	 * PrepareScan and FinishScan fill in and evaluate it on the calling
+	 * thread, ReadArchive does the expensive part in between and may run on
+	 * a worker thread, so it must neither touch the scanner's state nor run
+	 * Lua (LuaParser is not reentrant).
+	 */
+	struct ArchiveScan
+	{
+		ArchiveScan()
+			: modified(0)
+			, isDir(false)
+			, needInfo(true)
+			, doChecksum(false)
+			, opened(false)
+			, hasModinfo(false)
+			, hasMapinfo(false)
+			, checksum(0)
+			{}
+		std::string fullName;
+		std::string fn;
+		std::string fpath;
+		std::string lcfn;
+		unsigned int modified;
+		bool isDir;
+		/// false if the cached info is up to date and only the checksum is needed
+		bool needInfo;
+		bool doChecksum;
+
+		bool opened;
+		bool hasModinfo;
+		bool hasMapinfo;
+		std::string mapfile;
+		/// the info file to parse (mapinfo.lua or modinfo.lua), empty if none could be read
+		std::string infoFile;
+		std::string infoLua;
+		std::string error;
+		unsigned int checksum;
+		/// as cached on input, as found on output
+		std::map<std::string, FileCRC> fileCRCs;
+	};
+
 private:
 	void ScanDirs(const std::vector<std::string>& dirs, bool checksum = false);
 	void Scan(const std::string& curPath, bool doChecksum);
 
+	/// check the cache, @return false if the archive needs no (re)scan
+	bool PrepareScan(const std::string& fullName, bool doChecksum, ArchiveScan& scan);
+	/// open the archive, read its info file and calculate its checksum
+	void ReadArchive(ArchiveScan& scan);
+	/// parse the info file and store the results
+	void FinishScan(ArchiveScan& scan);
+	/// runs ReadArchive on each of <scans> not yet taken by another worker
+	void ReadArchivesWorker(std::vector<ArchiveScan>* scans, size_t* nextScan);
+
 	/// scan mapinfo / modinfo lua files
-	bool ScanArchiveLua(IArchive* ar, const std::string& fileName, ArchiveInfo& ai, std::string& err);
+	bool ScanArchiveLua(const ArchiveScan& scan, ArchiveInfo& ai, std::string& err);
 
 	void ReadCacheData(const std::string& filename);
 	void WriteCacheData(const std::string& filename);
@@ -188,15 +254,20 @@ private:
 	IFileFilter* CreateIgnoreFilter(IArchive* ar);
 
 	/**
-	 * Get CRC of the data in the specified archive.
-	 * Returns 0 if file could not be opened.
+	 * Get CRC of the data in the specified (open) archive.
+	 * @param fileCRCs for directory archives, the cached CRCs of its files on
+	 *   input, which are reused for files whose size and mtime did not change;
+	 *   the CRCs of its current files on output. NULL for other archives.
 	 */
-	unsigned int GetCRC(const std::string& filename);
+	unsigned int GetCRC(IArchive* ar, const std::string& fullName, std::map<std::string, FileCRC>* fileCRCs);
 
 private:
 	std::map<std::string, ArchiveInfo> archiveInfos;
 	std::map<std::string, BrokenArchive> brokenArchives;
 
+	/// serializes ReadArchive's workers where they share state
+	boost::mutex scanMutex;
+
 	bool isDirty;
 	std::string cachefile;
 };
@@ -6,6 +6,7 @@
 
 CBufferedArchive::CBufferedArchive(const std::string& name, bool cache)
 	: IArchive(name)
+	, cacheSize(0)
 {
 	caching = cache;
 }
@@ -14,24 +15,81 @@ CBufferedArchive::~CBufferedArchive()
 {
 }
 
-bool CBufferedArchive::GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer)
+CBufferedArchive::BufferPtr CBufferedArchive::GetFileBuffer(unsigned int fid)
 {
-	boost::mutex::scoped_lock lck(archiveLock);
-	assert(IsFileId(fid));
-
 	if (!caching) {
-		return GetFileImpl(fid,buffer);
+		boost::shared_ptr< std::vector<boost::uint8_t> > buffer(new std::vector<boost::uint8_t>());
+		if (!GetFileImpl(fid, *buffer))
+			return BufferPtr();
+		return buffer;
 	}
 
 	if (fid >= cache.size()) {
 		cache.resize(fid + 1);
 	}
-	
-	if (!cache[fid].populated) {
-		cache[fid].exists = GetFileImpl(fid, cache[fid].data);
-		cache[fid].populated = true;
+
+	FileBuffer& fb = cache[fid];
+
+	if (fb.populated) {
+		if (fb.exists) {
+			// move to the front
+			lruList.splice(lruList.begin(), lruList, fb.lruPos);
+		}
+		return fb.data;
+	}
+
+	boost::shared_ptr< std::vector<boost::uint8_t> > buffer(new std::vector<boost::uint8_t>());
+	fb.exists = GetFileImpl(fid, *buffer);
+	fb.populated = true;
+
+	if (!fb.exists)
+		return BufferPtr();
+
+	fb.data = buffer;
+	fb.lruPos = lruList.insert(lruList.begin(), fid);
+	cacheSize += buffer->size();
+
+	// drop the least recently used files, but never the one just read
+	while (cacheSize > CACHE_MAX_SIZE && lruList.size() > 1) {
+		FileBuffer& old = cache[lruList.back()];
+
+		cacheSize -= old.data->size();
+		old.data.reset();
+		old.populated = false;
+		lruList.pop_back();
+	}
+
+	return fb.data;
+}
+
+bool CBufferedArchive::GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer)
+{
+	boost::mutex::scoped_lock lck(archiveLock);
+	assert(IsFileId(fid));
+
+	if (!caching) {
+		return GetFileImpl(fid, buffer);
 	}
 
-	buffer = cache[fid].data;
-	return cache[fid].exists;
+	const BufferPtr data = GetFileBuffer(fid);
+
+	if (!data)
+		return false;
+
+	buffer = *data;
+	return true;
+}
+
+bool CBufferedArchive::GetFileView(unsigned int fid, CArchiveFileView& view)
+{
+	boost::mutex::scoped_lock lck(archiveLock);
+	assert(IsFileId(fid));
+
+	const BufferPtr data = GetFileBuffer(fid);
+
+	if (!data)
+		return false;
+
+	view = CArchiveFileView(data, data->empty() ? NULL : &(*data)[0], data->size());
+	return true;
 }
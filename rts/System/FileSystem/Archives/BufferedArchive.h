@@ -3,7 +3,9 @@
 #ifndef _BUFFERED_ARCHIVE_H
 #define _BUFFERED_ARCHIVE_H
 
+#include <list>
 #include <map>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "IArchive.h"
@@ -11,6 +13,10 @@
 /**
  * Provides a helper implementation for archive types that can only uncompress
  * one file to memory at a time.
+ *
+ * Uncompressed files are kept in a cache, least recently used ones are
+ * dropped once it grows past CACHE_MAX_SIZE bytes. Views handed out by
+ * GetFileView share the cached buffers and stay valid after that.
  */
 class CBufferedArchive : public IArchive
 {
@@ -19,21 +25,38 @@ public:
 	virtual ~CBufferedArchive();
 
 	virtual bool GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer);
+	virtual bool GetFileView(unsigned int fid, CArchiveFileView& view);
+
+	/// upper bound of the uncompressed bytes kept per archive
+	static const size_t CACHE_MAX_SIZE = 64 * 1024 * 1024;
 
 protected:
 	virtual bool GetFileImpl(unsigned int fid, std::vector<boost::uint8_t>& buffer) = 0;
 
+	typedef boost::shared_ptr< const std::vector<boost::uint8_t> > BufferPtr;
+
 	boost::mutex archiveLock; // neither 7zip nor zlib are threadsafe
 	struct FileBuffer
 	{
 		FileBuffer() : populated(false), exists(false) {};
 		bool populated; // cause a file may be 0 bytes big
 		bool exists;
-		std::vector<boost::uint8_t> data;
+		BufferPtr data;
+		/// position in lruList, valid if populated and exists
+		std::list<unsigned int>::iterator lruPos;
 	};
 	std::vector<FileBuffer> cache; // cache[fileId]
+
+private:
+	/// @return the uncompressed file (NULL if it could not be read), archiveLock must be held
+	BufferPtr GetFileBuffer(unsigned int fid);
+
 private:
 	bool caching;
+
+	/// cached file ids, most recently used first
+	std::list<unsigned int> lruList;
+	size_t cacheSize;
 };
 
 #endif // _BUFFERED_ARCHIVE_H
@@ -9,6 +9,7 @@
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/MemoryMappedFile.h"
 #include "System/Util.h"
 
 
@@ -77,6 +78,26 @@ bool CDirArchive::GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer)
 	}
 }
 
+bool CDirArchive::GetFileView(unsigned int fid, CArchiveFileView& view)
+{
+	assert(IsFileId(fid));
+
+	const std::string rawpath = dataDirsAccess.LocateFile(dirName + searchFiles[fid]);
+
+	const size_t fileSize = FileSystem::GetFileSize(rawpath);
+
+	if (fileSize >= MMAP_MIN_SIZE && fileSize != size_t(-1)) {
+		boost::shared_ptr<CMemoryMappedFile> mapping(new CMemoryMappedFile(rawpath, CMemoryMappedFile::MAP_READ_ONLY));
+
+		if (mapping->IsOpen()) {
+			view = CArchiveFileView(mapping, mapping->GetData(), mapping->GetSize());
+			return true;
+		}
+	}
+
+	return IArchive::GetFileView(fid, view);
+}
+
 void CDirArchive::FileInfo(unsigned int fid, std::string& name, int& size) const
 {
 	assert(IsFileId(fid));
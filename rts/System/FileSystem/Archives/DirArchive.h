@@ -36,8 +36,13 @@ public:
 	
 	virtual unsigned int NumFiles() const;
 	virtual bool GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer);
+	/// maps files of at least MMAP_MIN_SIZE bytes instead of reading them
+	virtual bool GetFileView(unsigned int fid, CArchiveFileView& view);
 	virtual void FileInfo(unsigned int fid, std::string& name, int& size) const;
 	
+	/// smaller files are cheaper to read than to map
+	static const size_t MMAP_MIN_SIZE = 64 * 1024;
+
 private:
 	/// "ExampleArchive.sdd/"
 	std::string dirName;
@@ -7,6 +7,35 @@
 #include <vector>
 #include <map>
 #include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * @brief Read-only view of the contents of an archive file
+ *
+ * Keeps whatever holds the contents (a memory mapping, a cached buffer)
+ * alive for as long as the view or a copy of it exists, so it stays valid
+ * even after the archive dropped it from its cache.
+ */
+class CArchiveFileView
+{
+public:
+	CArchiveFileView(): data(NULL), size(0) {}
+	template<typename T>
+	CArchiveFileView(const boost::shared_ptr<T>& holder, const boost::uint8_t* data, size_t size)
+		: holder(holder)
+		, data(data)
+		, size(size)
+	{}
+
+	const boost::uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+	bool Empty() const { return (size == 0); }
+
+private:
+	boost::shared_ptr<const void> holder;
+	const boost::uint8_t* data;
+	size_t size;
+};
 
 /**
  * @brief Abstraction of different archive types
@@ -72,6 +101,19 @@ public:
 	 * @see GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer)
 	 */
 	bool GetFile(const std::string& name, std::vector<boost::uint8_t>& buffer);
+	/**
+	 * Fetches the content of a file by its ID without copying it, where
+	 * the archive type allows (the default implementation wraps GetFile).
+	 * @param fid file ID in [0, NumFiles())
+	 * @param view on success, a view of the contents of the file
+	 * @return true if the file was found and could be read
+	 */
+	virtual bool GetFileView(unsigned int fid, CArchiveFileView& view);
+	/**
+	 * Fetches the content of a file by its name without copying it.
+	 * @see GetFileView(unsigned int fid, CArchiveFileView& view)
+	 */
+	bool GetFileView(const std::string& name, CArchiveFileView& view);
 	/**
 	 * Fetches the name and size in bytes of a file by its ID.
 	 */
@@ -10,6 +10,7 @@
 #include <boost/cstdint.hpp>
 
 #include "VFSModes.h"
+#include "Archives/IArchive.h"
 
 /**
  * This is for direct VFS file content access.
@@ -40,6 +41,11 @@ public:
 	int FileSize() const;
 
 	bool LoadStringData(std::string& data);
+	/**
+	 * @brief contents of a file from the VFS, without copying them
+	 * @return NULL if the file is read from the real file-system (use Read)
+	 */
+	const boost::uint8_t* GetData() const { return fileView.GetData(); }
 	std::string GetFileExt() const;
 
 	static bool InReadDir(const std::string& path);
@@ -71,7 +77,7 @@ private:
 
 	std::string fileName;
 	std::ifstream ifs;
-	std::vector<boost::uint8_t> fileBuffer;
+	CArchiveFileView fileView;
 	int filePos;
 	int fileSize;
 };
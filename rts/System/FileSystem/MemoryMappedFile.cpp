@@ -0,0 +1,186 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "MemoryMappedFile.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "System/Log/ILog.h"
+
+#ifdef _WIN32
+/// paths are in the ANSI code page (like those the CRT and the narrow shell API hand out)
+static std::wstring GetWidePath(const std::string& path)
+{
+	const int length = MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, NULL, 0);
+
+	if (length <= 0)
+		return std::wstring();
+
+	std::wstring widePath(length, L'\0');
+	MultiByteToWideChar(CP_ACP, 0, path.c_str(), -1, &widePath[0], length);
+	// drop the terminator MultiByteToWideChar wrote
+	widePath.resize(length - 1);
+	return widePath;
+}
+#endif
+
+
+CMemoryMappedFile::CMemoryMappedFile(const std::string& filePath, MapMode mapMode, size_t mapSize)
+	: data(NULL)
+	, size(0)
+	, mode(mapMode)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE)
+	, mappingHandle(NULL)
+#else
+	, fileDesc(-1)
+#endif
+{
+#ifdef _WIN32
+	const DWORD access = (mode == MAP_READ_WRITE)? (GENERIC_READ | GENERIC_WRITE): GENERIC_READ;
+	const DWORD creation = (mode == MAP_READ_WRITE)? OPEN_ALWAYS: OPEN_EXISTING;
+
+	const std::wstring widePath = GetWidePath(filePath);
+
+	if (widePath.empty())
+		return;
+
+	fileHandle = CreateFileW(widePath.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(fileHandle, &fileSize)) {
+		Close();
+		return;
+	}
+
+	size = size_t(fileSize.QuadPart);
+
+	if (mode == MAP_READ_WRITE && mapSize != 0)
+		size = mapSize;
+
+	if (size == 0) {
+		Close();
+		return;
+	}
+
+	const DWORD protect[] = {PAGE_READONLY, PAGE_WRITECOPY, PAGE_READWRITE};
+	const DWORD viewAccess[] = {FILE_MAP_READ, FILE_MAP_COPY, FILE_MAP_WRITE};
+
+	// for MAP_READ_WRITE this also grows the file to <size>
+	mappingHandle = CreateFileMappingW(fileHandle, NULL, protect[mode], DWORD((unsigned long long)(size) >> 32), DWORD(size & 0xFFFFFFFF), NULL);
+
+	if (mappingHandle == NULL) {
+		Close();
+		return;
+	}
+
+	data = reinterpret_cast<unsigned char*>(MapViewOfFile(mappingHandle, viewAccess[mode], 0, 0, size));
+#else
+	const int flags = (mode == MAP_READ_WRITE)? (O_RDWR | O_CREAT): O_RDONLY;
+
+	if ((fileDesc = open(filePath.c_str(), flags, 0644)) == -1)
+		return;
+
+	struct stat info;
+
+	if (fstat(fileDesc, &info) != 0) {
+		Close();
+		return;
+	}
+
+	size = info.st_size;
+
+	if (mode == MAP_READ_WRITE && mapSize != 0 && mapSize != size) {
+		if (ftruncate(fileDesc, mapSize) != 0) {
+			Close();
+			return;
+		}
+
+		size = mapSize;
+	}
+
+	if (size == 0) {
+		Close();
+		return;
+	}
+
+	const int prot = (mode == MAP_READ_ONLY)? PROT_READ: (PROT_READ | PROT_WRITE);
+	const int share = (mode == MAP_READ_WRITE)? MAP_SHARED: MAP_PRIVATE;
+
+	void* ptr = mmap(NULL, size, prot, share, fileDesc, 0);
+
+	if (ptr != MAP_FAILED)
+		data = reinterpret_cast<unsigned char*>(ptr);
+#endif
+
+	if (data == NULL) {
+		LOG_L(L_WARNING, "[%s] could not map file \"%s\"", __FUNCTION__, filePath.c_str());
+		Close();
+	}
+}
+
+CMemoryMappedFile::~CMemoryMappedFile()
+{
+	Close();
+}
+
+
+void CMemoryMappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != NULL)
+		munmap(data, size);
+	if (fileDesc != -1)
+		close(fileDesc);
+
+	fileDesc = -1;
+#endif
+
+	data = NULL;
+	size = 0;
+}
+
+bool CMemoryMappedFile::Flush()
+{
+	if (data == NULL || mode != MAP_READ_WRITE)
+		return false;
+
+#ifdef _WIN32
+	return (FlushViewOfFile(data, size) != 0);
+#else
+	return (msync(data, size, MS_SYNC) == 0);
+#endif
+}
+
+
+size_t CMemoryMappedFile::GetPageSize()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	// views must start at multiples of this, not just of the page size
+	return info.dwAllocationGranularity;
+#else
+	return sysconf(_SC_PAGESIZE);
+#endif
+}
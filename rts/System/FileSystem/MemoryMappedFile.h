@@ -0,0 +1,67 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef MEMORY_MAPPED_FILE_H
+#define MEMORY_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+/**
+ * @brief Maps a (real, non-VFS) file into memory
+ *
+ * Thin wrapper around mmap / MapViewOfFile. The whole file is mapped,
+ * pages are read in lazily by the OS on first access.
+ */
+class CMemoryMappedFile
+{
+public:
+	enum MapMode {
+		/// read-only view, the file must exist
+		MAP_READ_ONLY = 0,
+		/// writable private view, writes never reach the file
+		MAP_COPY_ON_WRITE = 1,
+		/// writable shared view, the file is created and/or resized to the given size
+		MAP_READ_WRITE = 2,
+	};
+
+	/**
+	 * @param filePath absolute path (see DataDirsAccess::LocateFile)
+	 * @param mode see MapMode
+	 * @param size only used by MAP_READ_WRITE, 0 keeps the current size
+	 */
+	CMemoryMappedFile(const std::string& filePath, MapMode mode, size_t size = 0);
+	~CMemoryMappedFile();
+
+	bool IsOpen() const { return (data != NULL); }
+
+	unsigned char* GetData() { return data; }
+	const unsigned char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+	MapMode GetMode() const { return mode; }
+
+	/// flush a MAP_READ_WRITE view to disk
+	bool Flush();
+
+	/// granularity of mappings, sections in mapped file formats should be aligned to this
+	static size_t GetPageSize();
+
+private:
+	CMemoryMappedFile(const CMemoryMappedFile&);
+	CMemoryMappedFile& operator = (const CMemoryMappedFile&);
+
+	void Close();
+
+private:
+	unsigned char* data;
+	size_t size;
+	MapMode mode;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDesc;
+#endif
+};
+
+#endif // MEMORY_MAPPED_FILE_H
@@ -4,7 +4,6 @@
 #include "VFSHandler.h"
 
 #include <algorithm>
-#include <set>
 #include <cstring>
 
 #include "ArchiveLoader.h"
@@ -59,21 +58,21 @@ bool CVFSHandler::AddArchive(const std::string& archiveName, bool override, cons
 		ar->FileInfo(fid, name, size);
 		StringToLowerInPlace(name);
 
-		if (!override) {
-			if (files.find(name) != files.end()) {
-				LOG_L(L_DEBUG, "%s (skipping, exists)", name.c_str());
-				continue;
-			} else {
-				LOG_L(L_DEBUG, "%s (adding, does not exist)", name.c_str());
-			}
-		} else {
-			LOG_L(L_DEBUG, "%s (overriding)", name.c_str());
-		} 
-
 		FileData d;
 		d.ar = ar;
 		d.size = size;
-		files[name] = d;
+
+		const std::pair<boost::unordered_map<std::string, FileData>::iterator, bool> fi = files.insert(std::make_pair(name, d));
+
+		if (fi.second) {
+			LOG_L(L_DEBUG, "%s (adding, does not exist)", name.c_str());
+			AddToDirIndex(name);
+		} else if (!override) {
+			LOG_L(L_DEBUG, "%s (skipping, exists)", name.c_str());
+		} else {
+			LOG_L(L_DEBUG, "%s (overriding)", name.c_str());
+			fi.first->second = d;
+		}
 	}
 	return true;
 }
@@ -103,12 +102,17 @@ bool CVFSHandler::RemoveArchive(const std::string& archiveName)
 	}
 	
 	// remove the files loaded from the archive-to-remove
-	for (std::map<std::string, FileData>::iterator f = files.begin(); f != files.end();) {
-		if (f->second.ar == ar) {
-			LOG_L(L_DEBUG, "%s (removing)", f->first.c_str());
-			f = set_erase(files, f);
-		} else {
-			 ++f;
+	for (unsigned fid = 0; fid != ar->NumFiles(); ++fid) {
+		std::string name;
+		int size;
+		ar->FileInfo(fid, name, size);
+		StringToLowerInPlace(name);
+
+		const boost::unordered_map<std::string, FileData>::iterator f = files.find(name);
+		if (f != files.end() && f->second.ar == ar) {
+			LOG_L(L_DEBUG, "%s (removing)", name.c_str());
+			files.erase(f);
+			RemoveFromDirIndex(name);
 		}
 	}
 	delete ar;
@@ -133,11 +137,114 @@ std::string CVFSHandler::GetNormalizedPath(const std::string& rawPath)
 	return path;
 }
 
+std::string CVFSHandler::GetNormalizedDirPath(const std::string& rawDir)
+{
+	std::string dir = GetNormalizedPath(rawDir);
+
+	// Non-empty directories to look in should have a trailing slash
+	if (!dir.empty() && dir[dir.length() - 1] != '/') {
+		dir += "/";
+	}
+
+	return dir;
+}
+
+/// splits "a/b/c.lua" into "a/b/" and "c.lua", "a/b/" into "a/" and "b/"
+static void SplitPath(const std::string& path, std::string& parent, std::string& name)
+{
+	const std::string::size_type slash = (path.length() > 1)? path.rfind('/', path.length() - 2): std::string::npos;
+	const std::string::size_type nameStart = (slash == std::string::npos)? 0: (slash + 1);
+
+	parent = path.substr(0, nameStart);
+	name = path.substr(nameStart);
+}
+
+void CVFSHandler::AddToDirIndex(const std::string& normalizedFilePath)
+{
+	if (normalizedFilePath.empty()) {
+		return;
+	}
+
+	std::string dir, name;
+	DirData* dirData = NULL;
+	bool isNewDir = false;
+
+	if (normalizedFilePath[normalizedFilePath.length() - 1] == '/') {
+		// a directory entry, which has to be listed even if it stays empty
+		dir = normalizedFilePath;
+		dirData = &dirs[dir];
+		isNewDir = dirData->IsEmpty();
+		dirData->isEntry = true;
+	} else {
+		SplitPath(normalizedFilePath, dir, name);
+		dirData = &dirs[dir];
+		isNewDir = dirData->IsEmpty();
+		dirData->files.insert(name);
+	}
+
+	// register new directories with their parents, up to the first known one
+	while (isNewDir && !dir.empty()) {
+		std::string parent;
+		SplitPath(dir, parent, name);
+
+		dirData = &dirs[parent];
+		isNewDir = dirData->IsEmpty();
+		dirData->dirs.insert(name);
+		dir = parent;
+	}
+}
+
+void CVFSHandler::RemoveFromDirIndex(const std::string& normalizedFilePath)
+{
+	if (normalizedFilePath.empty()) {
+		return;
+	}
+
+	const bool isDirEntry = (normalizedFilePath[normalizedFilePath.length() - 1] == '/');
+	std::string dir, name;
+
+	if (isDirEntry) {
+		dir = normalizedFilePath;
+	} else {
+		SplitPath(normalizedFilePath, dir, name);
+	}
+
+	boost::unordered_map<std::string, DirData>::iterator di = dirs.find(dir);
+	if (di == dirs.end()) {
+		return;
+	}
+
+	if (isDirEntry) {
+		di->second.isEntry = false;
+	} else {
+		di->second.files.erase(name);
+	}
+
+	// drop directories left empty, from their parents as well
+	while (di->second.IsEmpty()) {
+		dirs.erase(di);
+
+		if (dir.empty()) {
+			break;
+		}
+
+		std::string parent;
+		SplitPath(dir, parent, name);
+
+		if ((di = dirs.find(parent)) == dirs.end()) {
+			break;
+		}
+
+		di->second.dirs.erase(name);
+		dir = parent;
+	}
+}
+
 const CVFSHandler::FileData* CVFSHandler::GetFileData(const std::string& normalizedFilePath)
 {
 	const FileData* fileData = NULL;
 
-	const std::map<std::string, FileData>::const_iterator fi = files.find(normalizedFilePath);
+	const boost::unordered_map<std::string, FileData>::const_iterator fi = files.find(normalizedFilePath);
 	if (fi != files.end()) {
 		fileData = &(fi->second);
 	}
@@ -165,6 +272,26 @@ bool CVFSHandler::LoadFile(const std::string& filePath, std::vector<boost::uint8
 	return true;
 }
 
+bool CVFSHandler::LoadFileView(const std::string& filePath, CArchiveFileView& view)
+{
+	LOG_L(L_DEBUG, "LoadFileView(filePath = \"%s\", )", filePath.c_str());
+
+	const std::string normalizedPath = GetNormalizedPath(filePath);
+
+	const FileData* fileData = GetFileData(normalizedPath);
+	if (fileData == NULL) {
+		LOG_L(L_DEBUG, "LoadFileView: File '%s' does not exist in VFS.", filePath.c_str());
+		return false;
+	}
+
+	if (!fileData->ar->GetFileView(normalizedPath, view))
+	{
+		LOG_L(L_DEBUG, "LoadFileView: File '%s' does not exist in archive.", filePath.c_str());
+		return false;
+	}
+	return true;
+}
+
 bool CVFSHandler::FileExists(const std::string& filePath)
 {
 	LOG_L(L_DEBUG, "FileExists(filePath = \"%s\", )", filePath.c_str());
@@ -190,43 +317,10 @@ std::vector<std::string> CVFSHandler::GetFilesInDir(const std::string& rawDir)
 	LOG_L(L_DEBUG, "GetFilesInDir(rawDir = \"%s\")", rawDir.c_str());
 
 	std::vector<std::string> ret;
-	std::string dir = GetNormalizedPath(rawDir);
-
-	std::map<std::string, FileData>::const_iterator filesStart = files.begin();
-	std::map<std::string, FileData>::const_iterator filesEnd   = files.end();
 
-	// Non-empty directories to look in should have a trailing backslash
-	if (!dir.empty()) {
-		std::string::size_type dirLast = (dir.length() - 1);
-		if (dir[dirLast] != '/') {
-			dir += "/";
-			dirLast++;
-		}
-		// limit the iterator range
-		std::string dirEnd = dir;
-		dirEnd[dirLast] = dirEnd[dirLast] + 1;
-		filesStart = files.lower_bound(dir);
-		filesEnd   = files.upper_bound(dirEnd);
-	}
-
-	while (filesStart != filesEnd) {
-		const std::string path = FileSystem::GetDirectory(filesStart->first);
-
-		// Check if this file starts with the dir path
-		if (path.compare(0, dir.length(), dir) == 0) {
-
-			// Strip pathname
-			const std::string name = filesStart->first.substr(dir.length());
-
-			// Do not return files in subfolders
-			if ((name.find('/') == std::string::npos)
-					&& (name.find('\\') == std::string::npos))
-			{
-				ret.push_back(name);
-				LOG_L(L_DEBUG, "%s", name.c_str());
-			}
-		}
-		++filesStart;
+	const boost::unordered_map<std::string, DirData>::const_iterator di = dirs.find(GetNormalizedDirPath(rawDir));
+	if (di != dirs.end()) {
+		ret.assign(di->second.files.begin(), di->second.files.end());
 	}
 
 	return ret;
@@ -238,44 +332,10 @@ std::vector<std::string> CVFSHandler::GetDirsInDir(const std::string& rawDir)
 	LOG_L(L_DEBUG, "GetDirsInDir(rawDir = \"%s\")", rawDir.c_str());
 
 	std::vector<std::string> ret;
-	std::string dir = GetNormalizedPath(rawDir);
-
-	std::map<std::string, FileData>::const_iterator filesStart = files.begin();
-	std::map<std::string, FileData>::const_iterator filesEnd   = files.end();
-
-	// Non-empty directories to look in should have a trailing backslash
-	if (!dir.empty()) {
-		std::string::size_type dirLast = (dir.length() - 1);
-		if (dir[dirLast] != '/') {
-			dir += "/";
-			++dirLast;
-		}
-		// limit the iterator range
-		std::string dirEnd = dir;
-		dirEnd[dirLast] = dirEnd[dirLast] + 1;
-		filesStart = files.lower_bound(dir);
-		filesEnd   = files.upper_bound(dirEnd);
-	}
-
-	std::set<std::string> dirs;
-
-	while (filesStart != filesEnd) {
-		const std::string path = FileSystem::GetDirectory(filesStart->first);
-		// Test to see if this file start with the dir path
-		if (path.compare(0, dir.length(), dir) == 0) {
-			// Strip pathname
-			const std::string name = filesStart->first.substr(dir.length());
-			const std::string::size_type slash = name.find_first_of("/\\");
-			if (slash != std::string::npos) {
-				dirs.insert(name.substr(0, slash + 1));
-			}
-		}
-		++filesStart;
-	}
 
-	for (std::set<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++it) {
-		ret.push_back(*it);
-		LOG_L(L_DEBUG, "%s", it->c_str());
+	const boost::unordered_map<std::string, DirData>::const_iterator di = dirs.find(GetNormalizedDirPath(rawDir));
+	if (di != dirs.end()) {
+		ret.assign(di->second.dirs.begin(), di->second.dirs.end());
 	}
 
 	return ret;
@@ -4,11 +4,14 @@
 #define _VFS_HANDLER_H
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
 
 class IArchive;
+class CArchiveFileView;
 
 /**
  * Main API for accessing the Virtual File System (VFS).
@@ -37,6 +40,14 @@ public:
 	 * @return true if the file exists in the VFS and was successfully read
 	 */
 	bool LoadFile(const std::string& filePath, std::vector<boost::uint8_t>& buffer);
+	/**
+	 * Gets the contents of a file from within the VFS without copying them.
+	 * @param filePath raw file path, for example "maps/myMap.smf",
+	 *   case-insensitive
+	 * @return true if the file exists in the VFS and was successfully read
+	 * @see IArchive::GetFileView
+	 */
+	bool LoadFileView(const std::string& filePath, CArchiveFileView& view);
 
 	/**
 	 * Returns all the files in the given (virtual) directory without the
@@ -78,12 +89,34 @@ protected:
 		IArchive* ar;
 		int size;
 	};
-	std::map<std::string, FileData> files; 
+	/// contents of a (virtual) directory, kept sorted for the listings
+	struct DirData {
+		DirData(): isEntry(false) {}
+		bool IsEmpty() const { return (files.empty() && dirs.empty() && !isEntry); }
+
+		std::set<std::string> files;
+		/// sub-directories, with trailing slash
+		std::set<std::string> dirs;
+		/// whether <files> holds the directory itself (an explicit, maybe empty, directory entry)
+		bool isEntry;
+	};
+	/// by normalized path, eg. "maps/mymap.smf"
+	boost::unordered_map<std::string, FileData> files;
+	/// by normalized path with trailing slash, eg. "maps/", "" is the root;
+	/// only holds directories that (indirectly) contain files or directory entries
+	boost::unordered_map<std::string, DirData> dirs;
 	std::map<std::string, IArchive*> archives;
 
 private:
 	std::string GetNormalizedPath(const std::string& rawPath);
+	/// like GetNormalizedPath, with a trailing slash unless it is the root
+	std::string GetNormalizedDirPath(const std::string& rawDir);
 	const FileData* GetFileData(const std::string& normalizedFilePath);
+
+	/// adds a new entry of <files> (a file, or a directory with trailing slash) to <dirs>, creating its parents as needed
+	void AddToDirIndex(const std::string& normalizedFilePath);
+	/// removes an entry erased from <files> from <dirs>, along with the parents it leaves empty
+	void RemoveFromDirIndex(const std::string& normalizedFilePath);
 };
 
 extern CVFSHandler* vfsHandler;
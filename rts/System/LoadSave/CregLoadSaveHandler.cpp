@@ -39,7 +39,9 @@ CCregLoadSaveHandler::CCregLoadSaveHandler()
 {}
 
 CCregLoadSaveHandler::~CCregLoadSaveHandler()
-{}
+{
+	delete ifs;
+}
 
 class CGameStateCollector
 {
@@ -112,11 +114,20 @@ static void PrintSize(const char* txt, int size)
 void CCregLoadSaveHandler::SaveGame(const std::string& file)
 {
 	LOG("Saving game");
+
+	std::ofstream ofs(dataDirsAccess.LocateFile(file, FileQueryFlags::WRITE).c_str(), std::ios::out|std::ios::binary);
+	if (ofs.bad() || !ofs.is_open()) {
+		LOG_L(L_ERROR, "Save failed(content error): Unable to save game to file \"%s\"", file.c_str());
+		return;
+	}
+
+	SaveGame(ofs, true);
+}
+
+bool CCregLoadSaveHandler::SaveGame(std::ostream& ofs, bool logSizes)
+{
 	try {
-		std::ofstream ofs(dataDirsAccess.LocateFile(file, FileQueryFlags::WRITE).c_str(), std::ios::out|std::ios::binary);
-		if (ofs.bad() || !ofs.is_open()) {
-			throw content_error("Unable to save game to file \"" + file + "\"");
-		}
+		const int start = ofs.tellp();
 
 		// write our own header. SavePackage() will add its own
 		WriteString(ofs, gameSetup->gameSetupText);
@@ -128,14 +139,17 @@ void CCregLoadSaveHandler::SaveGame(const std::string& file)
 		// save creg state
 		creg::COutputStreamSerializer os;
 		os.SavePackage(&ofs, &gsc, gsc.GetClass());
-		PrintSize("Game", ofs.tellp());
+		if (logSizes)
+			PrintSize("Game", ((int)ofs.tellp()) - start);
 
 		// save ai state
 		int aistart = ofs.tellp();
 		eoh->Save(&ofs);
-		PrintSize("AIs", ((int)ofs.tellp()) - aistart);
+		if (logSizes)
+			PrintSize("AIs", ((int)ofs.tellp()) - aistart);
 
 		//FIXME add lua state
+		return true;
 	} catch (const content_error& ex) {
 		LOG_L(L_ERROR, "Save failed(content error): %s", ex.what());
 	} catch (const std::exception& ex) {
@@ -147,13 +161,21 @@ void CCregLoadSaveHandler::SaveGame(const std::string& file)
 	} catch (...) {
 		LOG_L(L_ERROR, "Save failed(unknown error)");
 	}
+
+	return false;
 }
 
 /// this just loads the mapname and some other early stuff
 void CCregLoadSaveHandler::LoadGameStartInfo(const std::string& file)
 {
 	const std::string file2 = FindSaveFile(file);
-	ifs = new std::ifstream(dataDirsAccess.LocateFile(file2).c_str(), std::ios::in|std::ios::binary);
+	LoadGameStartInfo(new std::ifstream(dataDirsAccess.LocateFile(file2).c_str(), std::ios::in|std::ios::binary), file);
+}
+
+void CCregLoadSaveHandler::LoadGameStartInfo(std::istream* stream, const std::string& saveName)
+{
+	delete ifs;
+	ifs = stream;
 
 	// in case these contained values alredy
 	// (this is the case when loading a game through the spring menu eg),
@@ -175,7 +197,7 @@ void CCregLoadSaveHandler::LoadGameStartInfo(const std::string& file)
 			delete temp;
 			temp = NULL;
 		} else {
-			temp->saveName = file;
+			temp->saveName = saveName;
 			gameSetup = temp;
 		}
 	}
@@ -189,6 +211,10 @@ void CCregLoadSaveHandler::LoadGame()
 {
 	ENTER_SYNCED_CODE();
 
+	// gu is part of the state, but whoever saved it need not be us
+	// (game-states are also handed to players joining mid-game)
+	const int myPlayerNum = gu->myPlayerNum;
+
 	void* pGSC = NULL;
 	creg::Class* gsccls = NULL;
 
@@ -213,6 +239,9 @@ void CCregLoadSaveHandler::LoadGame()
 	delete ifs;
 	ifs = NULL;
 
+	if (gu->myPlayerNum != myPlayerNum)
+		gu->SetMyPlayer(myPlayerNum);
+
 	gs->paused = false;
 	if (gameServer) {
 		gameServer->isPaused = false;
@@ -4,7 +4,7 @@
 #define CREG_LOAD_SAVE_HANDLER_H
 
 #include <string>
-#include <fstream>
+#include <iosfwd>
 #include "LoadSaveHandler.h"
 
 class CCregLoadSaveHandler : public ILoadSaveHandler
@@ -13,12 +13,24 @@ public:
 	CCregLoadSaveHandler();
 	~CCregLoadSaveHandler();
 	void SaveGame(const std::string& file);
+	/**
+	 * @brief save the game state to a stream instead of a file
+	 * @param logSizes print the size of the saved state
+	 * @return false if saving failed (the error is logged)
+	 */
+	bool SaveGame(std::ostream& ofs, bool logSizes);
 	/// load things such as map and mod, needed to fire up the engine
 	void LoadGameStartInfo(const std::string& file);
+	/**
+	 * @brief read the start info from a stream, LoadGame() reads the rest
+	 * @param stream owned (and deleted) by the handler from now on
+	 * @param saveName goes to CGameSetup::saveName if the stream sets up the game
+	 */
+	void LoadGameStartInfo(std::istream* stream, const std::string& saveName);
 	void LoadGame();
 
 protected:
-	std::ifstream* ifs;
+	std::istream* ifs;
 };
 
 #endif // CREG_LOAD_SAVE_HANDLER_H
@@ -23,12 +23,20 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime)
 		throw user_error(std::string("Demofile not found: ")+filename);
 	}
 
-	playbackDemo->Read((char*)&fileHeader, sizeof(fileHeader));
+	// demos recorded before the key-frame index have a header that ends
+	// just before keyFrameIndexSize; read that much first, then the rest
+	// only if the header says it is there (fileHeader starts zeroed)
+	playbackDemo->Read((char*)&fileHeader, DEMOFILE_HEADER_SIZE_NO_KEYFRAMES);
+
+	if (swabDWord(fileHeader.headerSize) == int(sizeof(fileHeader))) {
+		playbackDemo->Read(((char*)&fileHeader) + DEMOFILE_HEADER_SIZE_NO_KEYFRAMES, sizeof(fileHeader) - DEMOFILE_HEADER_SIZE_NO_KEYFRAMES);
+	}
+
 	fileHeader.swab();
 
 	if (memcmp(fileHeader.magic, DEMOFILE_MAGIC, sizeof(fileHeader.magic))
 		|| fileHeader.version != DEMOFILE_VERSION
-		|| fileHeader.headerSize != sizeof(fileHeader)
+		|| (fileHeader.headerSize != sizeof(fileHeader) && fileHeader.headerSize != DEMOFILE_HEADER_SIZE_NO_KEYFRAMES)
 		|| fileHeader.playerStatElemSize != sizeof(PlayerStatistics)
 		|| fileHeader.teamStatElemSize != sizeof(TeamStatistics)
 		// Don't compare spring version in debug mode: we don't want to make
@@ -48,6 +56,8 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime)
 		delete[] buf;
 	}
 
+	demoStreamStart = playbackDemo->GetPos();
+
 	playbackDemo->Read((char*)&chunkHeader, sizeof(chunkHeader));
 	chunkHeader.swab();
 
@@ -68,6 +78,8 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime)
 		bytesRemaining = playbackDemoSize - curPos;
 	}
 	playbackDemo->Seek(curPos);
+
+	LoadKeyFrameIndex();
 }
 
 
@@ -174,3 +186,62 @@ void CDemoReader::LoadStats()
 
 	playbackDemo->Seek(curPos);
 }
+
+
+void CDemoReader::LoadKeyFrameIndex()
+{
+	keyFrames.clear();
+
+	// no index if Spring crashed while writing the demo
+	if (fileHeader.demoStreamSize == 0 || fileHeader.keyFrameIndexSize <= 0)
+		return;
+
+	const int curPos = playbackDemo->GetPos();
+	const int indexPos =
+		demoStreamStart +
+		fileHeader.demoStreamSize +
+		fileHeader.winningAllyTeamsSize +
+		fileHeader.playerStatSize +
+		fileHeader.teamStatSize;
+
+	keyFrames.resize(fileHeader.keyFrameIndexSize / sizeof(DemoKeyFrame));
+
+	playbackDemo->Seek(indexPos);
+
+	for (std::vector<DemoKeyFrame>::iterator it = keyFrames.begin(); it != keyFrames.end(); ++it) {
+		if (playbackDemo->Read((char*) &(*it), sizeof(DemoKeyFrame)) < sizeof(DemoKeyFrame)) {
+			keyFrames.clear();
+			break;
+		}
+
+		it->swab();
+	}
+
+	playbackDemo->Seek(curPos);
+}
+
+const DemoKeyFrame* CDemoReader::GetKeyFrame(int frameNum) const
+{
+	const DemoKeyFrame* keyFrame = NULL;
+
+	for (std::vector<DemoKeyFrame>::const_iterator it = keyFrames.begin(); it != keyFrames.end(); ++it) {
+		if (it->frameNum > frameNum)
+			break;
+
+		keyFrame = &(*it);
+	}
+
+	return keyFrame;
+}
+
+void CDemoReader::SeekToKeyFrame(const DemoKeyFrame& keyFrame, float curTime)
+{
+	playbackDemo->Seek(demoStreamStart + keyFrame.streamOffset);
+	playbackDemo->Read((char*)&chunkHeader, sizeof(chunkHeader));
+	chunkHeader.swab();
+
+	// same bookkeeping as in the constructor, relative to this chunk
+	demoTimeOffset = curTime - chunkHeader.modGameTime - 0.1f;
+	nextDemoReadTime = curTime - 0.01f;
+	bytesRemaining = fileHeader.demoStreamSize - keyFrame.streamOffset;
+}
@@ -55,6 +55,29 @@ public:
 	/// Not needed for normal demo watching
 	void LoadStats();
 
+	/**
+	@brief the key-frame index, for tools that start reading at a frame
+	(replays simulate every frame anyway, so CGameServer::SkipTo does not
+	use it); empty for demos without index (e.g. when Spring crashed while
+	recording, or demos recorded before the index existed)
+	*/
+	const std::vector<DemoKeyFrame>& GetKeyFrames() const { return keyFrames; }
+
+	/**
+	@brief find the last key-frame at or before the given frame
+	@return NULL if there is none
+	*/
+	const DemoKeyFrame* GetKeyFrame(int frameNum) const;
+
+	/**
+	@brief continue reading at a key-frame instead of the current position
+	@param curTime treated like the constructor's curTime
+	*/
+	void SeekToKeyFrame(const DemoKeyFrame& keyFrame, float curTime);
+
+private:
+	void LoadKeyFrameIndex();
+
 private:
 	CFileHandler* playbackDemo;
 
@@ -62,6 +85,8 @@ private:
 	float nextDemoReadTime;
 	int bytesRemaining;
 	int playbackDemoSize;
+	/// file offset of the first chunk header
+	int demoStreamStart;
 
 	DemoStreamChunkHeader chunkHeader;
 
@@ -70,6 +95,7 @@ private:
 	std::vector<PlayerStatistics> playerStats; // one stat per player
 	std::vector< std::vector<TeamStatistics> > teamStats; // many stats per team
 	std::vector<unsigned char> winningAllyTeams;
+	std::vector<DemoKeyFrame> keyFrames;
 };
 
 #endif
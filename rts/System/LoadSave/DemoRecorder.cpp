@@ -6,32 +6,156 @@
 #include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileHandler.h"
 #include "Game/GameVersion.h"
+#include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamStatistics.h"
+#include "System/BaseNetProtocol.h"
 #include "System/Util.h"
 #include "System/TimeUtil.h"
+#include "System/Platform/Threading.h"
 
 #include "System/Log/ILog.h"
 
+#include <boost/bind.hpp>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
-#include <fstream>
 
-CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName): demoStream(std::ios::binary | std::ios::out)
+// distance (in frames) between entries of the key-frame index
+static const int DEMO_KEYFRAME_INTERVAL = GAME_SPEED * 30;
+
+// the writer thread flushes at least this often (in milliseconds)
+static const int DEMO_FLUSH_INTERVAL = 1000;
+// ... or as soon as this many bytes are queued
+static const unsigned int DEMO_FLUSH_SIZE = 256 * 1024;
+// Write blocks once this many bytes are queued
+static const unsigned int DEMO_MAX_BUFFER_SIZE = 4 * 1024 * 1024;
+
+CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName)
+	: numFrames(0)
+	, writerThread(NULL)
+	, writePendingHeader(false)
+	, quitWriterThread(false)
 {
 	SetName(mapName, modName);
+
+	demoFile.open(dataDirsAccess.LocateFile(demoName, FileQueryFlags::WRITE).c_str(), std::ios::binary | std::ios::out);
+
+	if (!demoFile.is_open()) {
+		LOG_L(L_ERROR, "[%s] could not open demo file \"%s\" for writing", __FUNCTION__, demoName.c_str());
+	}
+
 	SetFileHeader();
+	StartWriterThread();
 }
 
 CDemoRecorder::~CDemoRecorder()
 {
+	// everything below is written directly
+	StopWriterThread();
+
 	WriteWinnerList();
 	WritePlayerStats();
 	WriteTeamStats();
+	WriteKeyFrameIndex();
 	WriteFileHeader(true);
-	WriteDemoFile(dataDirsAccess.LocateFile(demoName, FileQueryFlags::WRITE), demoStream.str());
+
+	demoFile.flush();
+	demoFile.close();
+}
+
+
+void CDemoRecorder::StartWriterThread()
+{
+	writeBuffer.reserve(DEMO_FLUSH_SIZE * 2);
+	flushBuffer.reserve(DEMO_FLUSH_SIZE * 2);
+
+	writerThread = new boost::thread(boost::bind(&CDemoRecorder::WriterThreadProc, this));
+}
+
+void CDemoRecorder::StopWriterThread()
+{
+	if (writerThread == NULL)
+		return;
+
+	{
+		boost::mutex::scoped_lock lock(writerMutex);
+		quitWriterThread = true;
+		writerCondition.notify_all();
+	}
+
+	writerThread->join();
+	delete writerThread;
+	writerThread = NULL;
+}
+
+void CDemoRecorder::WriterThreadProc()
+{
+	Threading::SetThreadName("demo-recorder");
+
+	boost::mutex::scoped_lock lock(writerMutex);
+
+	while (true) {
+		if (!quitWriterThread && !writePendingHeader && writeBuffer.size() < DEMO_FLUSH_SIZE) {
+			writerCondition.timed_wait(lock, boost::posix_time::milliseconds(DEMO_FLUSH_INTERVAL));
+		}
+
+		const bool quit = quitWriterThread;
+		const bool writeHeader = writePendingHeader;
+		const DemoFileHeader header = pendingHeader;
+
+		flushBuffer.swap(writeBuffer);
+		writePendingHeader = false;
+
+		// let Write continue while the (possibly slow) disk I/O happens
+		writerCondition.notify_all();
+		lock.unlock();
+
+		if (!flushBuffer.empty()) {
+			demoFile.write(&flushBuffer[0], flushBuffer.size());
+			flushBuffer.clear();
+		}
+
+		if (writeHeader) {
+			const std::streampos pos = demoFile.tellp();
+
+			demoFile.seekp(0);
+			demoFile.write((const char*) &header, sizeof(header));
+			demoFile.seekp(pos);
+		}
+
+		// hand everything to the OS, so it survives a crash of the process
+		demoFile.flush();
+
+		lock.lock();
+
+		if (quit && writeBuffer.empty() && !writePendingHeader)
+			break;
+	}
 }
 
+void CDemoRecorder::Write(const char* data, unsigned int size)
+{
+	if (writerThread == NULL) {
+		demoFile.write(data, size);
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(writerMutex);
+
+	// bounded memory: if the disk cannot keep up, wait for the writer
+	while (writeBuffer.size() >= DEMO_MAX_BUFFER_SIZE) {
+		writerCondition.notify_all();
+		writerCondition.wait(lock);
+	}
+
+	writeBuffer.insert(writeBuffer.end(), data, data + size);
+
+	if (writeBuffer.size() >= DEMO_FLUSH_SIZE) {
+		writerCondition.notify_all();
+	}
+}
+
+
 void CDemoRecorder::SetFileHeader()
 {
 	memset(&fileHeader, 0, sizeof(DemoFileHeader));
@@ -45,22 +169,8 @@ void CDemoRecorder::SetFileHeader()
 	fileHeader.teamStatPeriod = TeamStatistics::statsPeriod;
 	fileHeader.winningAllyTeamsSize = 0;
 
-	demoStream.seekp(WriteFileHeader(false) + sizeof(DemoFileHeader));
-}
-
-void CDemoRecorder::WriteDemoFile(const std::string& name, const std::string& data)
-{
-	std::ofstream file;
-
-	// using operator<<(basic_stringbuf*) requires the stream to be opened with std::ios::in
-	// stringbuf::{eback(), egptr(), gptr()} are protected so we cannot access them directly
-	// (plus data is not guaranteed to be stored contiguously) ==> the only clean OO solution
-	// that avoids str()'s copy would be to supply our own stringbuffer backend to demoStream
-	// which is slightly overdoing it
-	file.open(name.c_str(), std::ios::binary | std::ios::out);
-	file.write(data.c_str(), data.size());
-	file.flush();
-	file.close();
+	// reserve the space for the header (called before the writer thread exists)
+	WriteFileHeader(false);
 }
 
 void CDemoRecorder::WriteSetupText(const std::string& text)
@@ -71,18 +181,33 @@ void CDemoRecorder::WriteSetupText(const std::string& text)
 	}
 
 	fileHeader.scriptSize = length;
-	demoStream.write(text.c_str(), length);
+	Write(text.c_str(), length);
+
+	// readers need scriptSize to find the demo stream if we never finish
+	WriteFileHeader(false);
 }
 
 void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime)
 {
 	DemoStreamChunkHeader chunkHeader;
 
+	if (length > 0 && (buf[0] == NETMSG_NEWFRAME || buf[0] == NETMSG_KEYFRAME)) {
+		if ((numFrames % DEMO_KEYFRAME_INTERVAL) == 0) {
+			DemoKeyFrame keyFrame;
+			keyFrame.frameNum = numFrames;
+			keyFrame.streamOffset = fileHeader.demoStreamSize;
+			keyFrame.modGameTime = modGameTime;
+			keyFrames.push_back(keyFrame);
+		}
+
+		numFrames += 1;
+	}
+
 	chunkHeader.modGameTime = modGameTime;
 	chunkHeader.length = length;
 	chunkHeader.swab();
-	demoStream.write((char*) &chunkHeader, sizeof(chunkHeader));
-	demoStream.write((char*) buf, length);
+	Write((char*) &chunkHeader, sizeof(chunkHeader));
+	Write((char*) buf, length);
 	fileHeader.demoStreamSize += length + sizeof(chunkHeader);
 }
 
@@ -168,22 +293,33 @@ void CDemoRecorder::SetWinningAllyTeams(const std::vector<unsigned char>& winnin
 
 /** @brief Write DemoFileHeader
 Write the DemoFileHeader at the start of the file and restores the original
-position in the file afterwards. */
-unsigned int CDemoRecorder::WriteFileHeader(bool updateStreamLength)
+position in the file afterwards. While the writer thread runs this only
+queues the header, it is written out with the next flush. */
+void CDemoRecorder::WriteFileHeader(bool updateStreamLength)
 {
-	const unsigned int pos = demoStream.tellp();
-
 	DemoFileHeader tmpHeader;
 	memcpy(&tmpHeader, &fileHeader, sizeof(fileHeader));
 	if (!updateStreamLength)
 		tmpHeader.demoStreamSize = 0;
 	tmpHeader.swab(); // to little endian
 
-	demoStream.seekp(0);
-	demoStream.write((char*) &tmpHeader, sizeof(tmpHeader));
-	demoStream.seekp(pos);
+	if (writerThread == NULL) {
+		const std::streampos pos = demoFile.tellp();
+
+		demoFile.seekp(0);
+		demoFile.write((char*) &tmpHeader, sizeof(tmpHeader));
+
+		// the first write reserves the space for the header
+		if (pos > std::streampos(0))
+			demoFile.seekp(pos);
 
-	return pos;
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(writerMutex);
+	pendingHeader = tmpHeader;
+	writePendingHeader = true;
+	writerCondition.notify_all();
 }
 
 /** @brief Write the CPlayer::Statistics at the current position in the file. */
@@ -192,16 +328,14 @@ void CDemoRecorder::WritePlayerStats()
 	if (fileHeader.numPlayers == 0)
 		return;
 
-	int pos = demoStream.tellp();
-
 	for (std::vector< PlayerStatistics >::iterator it = playerStats.begin(); it != playerStats.end(); ++it) {
 		PlayerStatistics& stats = *it;
 		stats.swab();
-		demoStream.write((char*) &stats, sizeof(PlayerStatistics));
+		Write((char*) &stats, sizeof(PlayerStatistics));
 	}
-	playerStats.clear();
 
-	fileHeader.playerStatSize = (int)demoStream.tellp() - pos;
+	fileHeader.playerStatSize = playerStats.size() * sizeof(PlayerStatistics);
+	playerStats.clear();
 }
 
 
@@ -212,16 +346,13 @@ void CDemoRecorder::WriteWinnerList()
 	if (fileHeader.numTeams == 0)
 		return;
 
-	const int pos = demoStream.tellp();
-
 	// Write the array of winningAllyTeams.
 	for (std::vector<unsigned char>::const_iterator it = winningAllyTeams.begin(); it != winningAllyTeams.end(); ++it) {
-		demoStream.write((char*) &(*it), sizeof(unsigned char));
+		Write((char*) &(*it), sizeof(unsigned char));
 	}
 
+	fileHeader.winningAllyTeamsSize = winningAllyTeams.size() * sizeof(unsigned char);
 	winningAllyTeams.clear();
-
-	fileHeader.winningAllyTeamsSize = int(demoStream.tellp()) - pos;
 }
 
 /** @brief Write the TeamStatistics at the current position in the file. */
@@ -230,12 +361,13 @@ void CDemoRecorder::WriteTeamStats()
 	if (fileHeader.numTeams == 0)
 		return;
 
-	int pos = demoStream.tellp();
+	int size = 0;
 
 	// Write array of dwords indicating number of TeamStatistics per team.
 	for (std::vector< std::vector< TeamStatistics > >::iterator it = teamStats.begin(); it != teamStats.end(); ++it) {
 		unsigned int c = swabDWord(it->size());
-		demoStream.write((char*)&c, sizeof(unsigned int));
+		Write((char*)&c, sizeof(unsigned int));
+		size += sizeof(unsigned int);
 	}
 
 	// Write big array of TeamStatistics.
@@ -243,10 +375,24 @@ void CDemoRecorder::WriteTeamStats()
 		for (std::vector< TeamStatistics >::iterator it2 = it->begin(); it2 != it->end(); ++it2) {
 			TeamStatistics& stats = *it2;
 			stats.swab();
-			demoStream.write((char*)&stats, sizeof(TeamStatistics));
+			Write((char*)&stats, sizeof(TeamStatistics));
+			size += sizeof(TeamStatistics);
 		}
 	}
 	teamStats.clear();
 
-	fileHeader.teamStatSize = (int)demoStream.tellp() - pos;
+	fileHeader.teamStatSize = size;
+}
+
+/** @brief Write the key-frame index at the current position in the file. */
+void CDemoRecorder::WriteKeyFrameIndex()
+{
+	for (std::vector<DemoKeyFrame>::iterator it = keyFrames.begin(); it != keyFrames.end(); ++it) {
+		DemoKeyFrame& keyFrame = *it;
+		keyFrame.swab();
+		Write((char*) &keyFrame, sizeof(DemoKeyFrame));
+	}
+
+	fileHeader.keyFrameIndexSize = keyFrames.size() * sizeof(DemoKeyFrame);
+	keyFrames.clear();
 }
@@ -4,15 +4,26 @@
 #define DEMO_RECORDER
 
 #include <vector>
-#include <sstream>
+#include <fstream>
 #include <list>
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+
 #include "Demo.h"
 #include "Game/PlayerStatistics.h"
 #include "Sim/Misc/TeamStatistics.h"
 
 /**
  * @brief Used to record demos
+ *
+ * The demo is streamed to disk while it is recorded: data is appended to
+ * a bounded buffer which a background thread writes out at least once per
+ * DEMO_FLUSH_INTERVAL. Until the recorder is destroyed the on-disk header
+ * has demoStreamSize 0, so a demo cut short by a crash is still readable
+ * (see DemoFileHeader); the destructor appends the statistics and fixes
+ * up the header.
  */
 class CDemoRecorder : public CDemo
 {
@@ -22,7 +33,7 @@ public:
 
 	void WriteSetupText(const std::string& text);
 	void SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime);
-	
+
 	/**
 	@brief assign a map name for the demo file
 	*/
@@ -38,17 +49,43 @@ public:
 	void SetWinningAllyTeams(const std::vector<unsigned char>& winningAllyTeams);
 
 private:
-	unsigned int WriteFileHeader(bool updateStreamLength);
+	void WriteFileHeader(bool updateStreamLength);
 	void SetFileHeader();
 	void WritePlayerStats();
 	void WriteTeamStats();
 	void WriteWinnerList();
-	void WriteDemoFile(const std::string& name, const std::string& data);
+	void WriteKeyFrameIndex();
+
+	/// queue <size> bytes for writing, blocks while the buffer is full
+	void Write(const char* data, unsigned int size);
+
+	void StartWriterThread();
+	void StopWriterThread();
+	void WriterThreadProc();
+
+	std::ofstream demoFile;
 
-	std::stringstream demoStream;
 	std::vector<PlayerStatistics> playerStats;
 	std::vector< std::vector<TeamStatistics> > teamStats;
 	std::vector<unsigned char> winningAllyTeams;
+
+	/// one entry every DEMO_KEYFRAME_INTERVAL frames, see DemoKeyFrame
+	std::vector<DemoKeyFrame> keyFrames;
+	/// number of frame messages saved so far
+	int numFrames;
+
+	boost::thread* writerThread;
+	boost::mutex writerMutex;
+	boost::condition writerCondition;
+
+	/// filled by Write, swapped with flushBuffer and written out by the writer thread
+	std::vector<char> writeBuffer;
+	std::vector<char> flushBuffer;
+
+	/// (byte-swapped) copy of fileHeader the writer thread should put at the start of the file
+	DemoFileHeader pendingHeader;
+	bool writePendingHeader;
+	bool quitWriterThread;
 };
 
 
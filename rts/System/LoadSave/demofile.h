@@ -40,6 +40,8 @@
  *         CTeam::Statistics for each team.
  *       - Array of all CTeam::Statistics (total number of items is the
  *         sum of the elements in the array of dwords).
+ *     - Key-frame index (keyFrameIndexSize), an array of DemoKeyFrame
+ *       ordered by frame number
  *
  * The header is designed to be extensible: it contains a version field and a
  * headerSize field to support this. The version field is a major version number
@@ -48,7 +50,8 @@
  * minor version number, which happens to be equal to sizeof(DemoFileHeader).
  *
  * If Spring did not cleanup properly (crashed), the demoStreamSize is 0 and it
- * can be assumed the demo stream continues until the end of the file.
+ * can be assumed the demo stream continues until the end of the file (there
+ * is no key-frame index in that case).
  */
 struct DemoFileHeader
 {
@@ -70,6 +73,7 @@ struct DemoFileHeader
 	int teamStatElemSize;         ///< sizeof(CTeam::Statistics)
 	int teamStatPeriod;           ///< Interval (in seconds) between team stats.
 	int winningAllyTeamsSize;     ///< The size of the vector of the winning ally teams
+	int keyFrameIndexSize;        ///< Size of the key-frame index chunk (0 if none).
 
 
 	/// Change structure from host endian to little endian or vice versa.
@@ -89,6 +93,7 @@ struct DemoFileHeader
 		swabDWordInPlace(teamStatElemSize);
 		swabDWordInPlace(teamStatPeriod);
 		swabDWordInPlace(winningAllyTeamsSize);
+		swabDWordInPlace(keyFrameIndexSize);
 	}
 };
 
@@ -115,6 +120,33 @@ struct DemoStreamChunkHeader
 	}
 };
 
+/**
+ * @brief Spring demo key-frame index entry
+ *
+ * Points at the chunk holding the NETMSG_KEYFRAME / NETMSG_NEWFRAME message
+ * of frame (frameNum + 1), so a reader that starts at streamOffset has seen
+ * exactly frameNum frames before it reads this chunk.
+ */
+struct DemoKeyFrame
+{
+	int frameNum;                 ///< Number of frames before the chunk.
+	int streamOffset;             ///< Offset of the chunk header, relative to the start of the demo stream.
+	float modGameTime;            ///< Gametime at which the chunk was written.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swabDWordInPlace(frameNum);
+		swabDWordInPlace(streamOffset);
+		swabFloatInPlace(modGameTime);
+	}
+};
+
 #pragma pack(pop)
 
+/**
+ * headerSize of demos recorded before DemoFileHeader::keyFrameIndexSize was
+ * added; these are still read, as if keyFrameIndexSize was 0.
+ */
+#define DEMOFILE_HEADER_SIZE_NO_KEYFRAMES (sizeof(DemoFileHeader) - sizeof(int))
+
 #endif // DEMO_FILE_H
@@ -3,6 +3,15 @@
 #include "Socket.h"
 
 #include <boost/system/error_code.hpp>
+#include <boost/version.hpp>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#if defined(__linux__)
+	#include <errno.h>
+	#include <sys/socket.h>
+	#include <sys/uio.h>
+#endif
 #include "lib/streflop/streflop_cond.h"
 
 #include "System/Log/ILog.h"
@@ -100,5 +109,171 @@ boost::asio::ip::tcp::resolver::iterator WrapResolve(
 	return resolveIt;
 }
 
+
+#if defined(__linux__)
+// datagrams per recvmmsg/sendmmsg call
+static const unsigned maxBatchDatagrams = 64;
+// iovec's per sendmmsg call, one of our datagrams needs at most a few hundred
+static const unsigned maxBatchBuffers = 1024;
+
+static int GetNativeHandle(boost::asio::ip::udp::socket& socket)
+{
+#if BOOST_VERSION < 104700
+	return socket.native();
+#else
+	return socket.native_handle();
+#endif
+}
+
+static boost::system::error_code SystemError(int code)
+{
+#if BOOST_VERSION < 104400
+	return boost::system::error_code(code, boost::system::system_category);
+#else
+	return boost::system::error_code(code, boost::system::system_category());
+#endif
+}
+#endif
+
+
+unsigned ReceiveDatagrams(boost::asio::ip::udp::socket& socket,
+		unsigned char* buffers, unsigned bufferSize,
+		unsigned* sizes, boost::asio::ip::udp::endpoint* senders,
+		unsigned count, boost::system::error_code& err)
+{
+	err = boost::system::error_code();
+
+#if defined(__linux__)
+	mmsghdr msgs[maxBatchDatagrams];
+	iovec iovs[maxBatchDatagrams];
+
+	count = std::min(count, maxBatchDatagrams);
+	memset(msgs, 0, sizeof(msgs[0]) * count);
+
+	for (unsigned i = 0; i < count; ++i) {
+		iovs[i].iov_base = buffers + i * bufferSize;
+		iovs[i].iov_len = bufferSize;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = senders[i].data();
+		msgs[i].msg_hdr.msg_namelen = senders[i].capacity();
+	}
+
+	const int received = recvmmsg(GetNativeHandle(socket), msgs, count, MSG_DONTWAIT, NULL);
+
+	if (received < 0) {
+		err = SystemError(errno);
+		return 0;
+	}
+
+	for (int i = 0; i < received; ++i) {
+		sizes[i] = msgs[i].msg_len;
+		senders[i].resize(msgs[i].msg_hdr.msg_namelen);
+	}
+
+	return received;
+#else
+	unsigned received = 0;
+
+	while (received < count && socket.available() > 0) {
+		sizes[received] = socket.receive_from(boost::asio::buffer(buffers + received * bufferSize, bufferSize), senders[received], 0, err);
+
+		if (err)
+			break;
+
+		++received;
+	}
+
+	return received;
+#endif
+}
+
+unsigned SendDatagrams(boost::asio::ip::udp::socket& socket,
+		const boost::asio::const_buffer* buffers, const unsigned* numBuffers,
+		const boost::asio::ip::udp::endpoint* targets,
+		unsigned count, boost::system::error_code& err)
+{
+	using boost::asio::buffer_cast;
+	using boost::asio::buffer_size;
+
+	err = boost::system::error_code();
+
+#if defined(__linux__)
+	mmsghdr msgs[maxBatchDatagrams];
+	iovec iovs[maxBatchBuffers];
+
+	unsigned sent = 0;
+
+	while (sent < count) {
+		unsigned numMsgs = 0;
+		unsigned numIovs = 0;
+
+		// fill one call, a datagram is never split between two
+		while ((sent + numMsgs) < count && numMsgs < maxBatchDatagrams && (numIovs + numBuffers[sent + numMsgs]) <= maxBatchBuffers) {
+			const unsigned n = sent + numMsgs;
+
+			memset(&msgs[numMsgs], 0, sizeof(msgs[numMsgs]));
+			msgs[numMsgs].msg_hdr.msg_iov = &iovs[numIovs];
+			msgs[numMsgs].msg_hdr.msg_iovlen = numBuffers[n];
+			msgs[numMsgs].msg_hdr.msg_name = const_cast<void*>(static_cast<const void*>(targets[n].data()));
+			msgs[numMsgs].msg_hdr.msg_namelen = targets[n].size();
+
+			for (unsigned i = 0; i < numBuffers[n]; ++i, ++buffers) {
+				iovs[numIovs].iov_base = const_cast<void*>(buffer_cast<const void*>(*buffers));
+				iovs[numIovs].iov_len = buffer_size(*buffers);
+				++numIovs;
+			}
+
+			++numMsgs;
+		}
+
+		if (numMsgs == 0) {
+			// more buffers than one call takes, we never build such datagrams
+			err = SystemError(EMSGSIZE);
+			break;
+		}
+
+		const int result = sendmmsg(GetNativeHandle(socket), msgs, numMsgs, 0);
+
+		if (result < 0) {
+			err = SystemError(errno);
+			break;
+		}
+
+		sent += result;
+
+		if (unsigned(result) < numMsgs)
+			break;
+	}
+
+	return sent;
+#else
+	// asio passes at most 64 buffers to one send call, copy larger datagrams
+	std::vector<unsigned char> data;
+
+	for (unsigned n = 0; n < count; ++n) {
+		if (numBuffers[n] <= 64) {
+			socket.send_to(std::vector<boost::asio::const_buffer>(buffers, buffers + numBuffers[n]), targets[n], 0, err);
+		} else {
+			data.clear();
+
+			for (unsigned i = 0; i < numBuffers[n]; ++i) {
+				const unsigned char* p = buffer_cast<const unsigned char*>(buffers[i]);
+				data.insert(data.end(), p, p + buffer_size(buffers[i]));
+			}
+
+			socket.send_to(boost::asio::buffer(data), targets[n], 0, err);
+		}
+
+		buffers += numBuffers[n];
+
+		if (err)
+			return n;
+	}
+
+	return count;
+#endif
+}
+
 } // namespace netcode
 
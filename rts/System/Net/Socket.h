@@ -4,6 +4,7 @@
 #define SOCKET_H
 
 //#include <boost/asio.hpp> must be included before streflop!
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -49,6 +50,29 @@ boost::asio::ip::tcp::resolver::iterator WrapResolve(
 		boost::asio::ip::tcp::resolver::query& query,
 		boost::system::error_code* err = NULL);
 
+/**
+ * Receives up to <count> waiting datagrams without blocking.
+ * Datagram i is written to <buffers> + i * <bufferSize>, its length to
+ * sizes[i] and its sender to senders[i]. On Linux all of them are read
+ * with a single recvmmsg call.
+ * @returns the number of datagrams received
+ */
+unsigned ReceiveDatagrams(boost::asio::ip::udp::socket& socket,
+		unsigned char* buffers, unsigned bufferSize,
+		unsigned* sizes, boost::asio::ip::udp::endpoint* senders,
+		unsigned count, boost::system::error_code& err);
+
+/**
+ * Sends <count> datagrams, datagram i is made of the next numBuffers[i]
+ * entries of <buffers> and goes to targets[i]. On Linux they are passed
+ * to the kernel with one sendmmsg call per (up to) 64 datagrams.
+ * @returns the number of datagrams sent, stops at the first error
+ */
+unsigned SendDatagrams(boost::asio::ip::udp::socket& socket,
+		const boost::asio::const_buffer* buffers, const unsigned* numBuffers,
+		const boost::asio::ip::udp::endpoint* targets,
+		unsigned count, boost::system::error_code& err);
+
 } // namespace netcode
 
 #endif // SOCKET_H
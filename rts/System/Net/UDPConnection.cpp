@@ -24,9 +24,9 @@
 namespace netcode {
 using namespace boost::asio;
 
-static const unsigned udpMaxPacketSize = 4096;
-static const int maxChunkSize = 254;
 static const int chunksPerSec = 30;
+// asio passes at most this many buffers to a single sendmsg call
+static const unsigned maxSendBuffers = 64;
 
 #if NETWORK_TEST
 static int lastRand = 0; // spring has some srand calls that interfere with the random seed
@@ -70,12 +70,28 @@ inline void EMULATE_PACKET_CORRUPTION(uint8_t& crc) {}
 #define EMULATE_LATENCY(cond) if(cond)
 #endif
 
+Chunk::Chunk(int32_t _chunkNumber)
+	: chunkNumber(_chunkNumber)
+	, chunkSize(0)
+{
+	memcpy(&buffer[0], &chunkNumber, sizeof(chunkNumber));
+	buffer[sizeof(chunkNumber)] = chunkSize;
+}
+
+void Chunk::Append(const uint8_t* data, unsigned length) {
+
+	assert((chunkSize + length) <= maxSize);
+	memcpy(&buffer[headerSize + chunkSize], data, length);
+	chunkSize += length;
+	buffer[sizeof(chunkNumber)] = chunkSize;
+}
+
 void Chunk::UpdateChecksum(CRC& crc) const {
 
 	crc << chunkNumber;
 	crc << (unsigned int)chunkSize;
-	if (!data.empty()) {
-		crc.Update(&data[0], data.size());
+	if (chunkSize > 0) {
+		crc.Update(GetData(), chunkSize);
 	}
 }
 
@@ -121,9 +137,10 @@ public:
 		pos += sizeof(t);
 	}
 
-	void Unpack(std::vector<uint8_t>& t, unsigned unpackLength) {
-		std::copy(data + pos, data + pos + unpackLength, std::back_inserter(t));
-		pos += unpackLength;
+	const unsigned char* Skip(unsigned skipLength) {
+		const unsigned char* skipped = data + pos;
+		pos += skipLength;
+		return skipped;
 	}
 
 	unsigned Remaining() const {
@@ -135,30 +152,6 @@ private:
 	unsigned pos;
 };
 
-class Packer
-{
-public:
-	Packer(std::vector<uint8_t>& data)
-		: data(data)
-	{
-		assert(data.empty());
-	}
-
-	template<typename T>
-	void Pack(T& t) {
-		const size_t pos = data.size();
-		data.resize(pos + sizeof(T));
-		*reinterpret_cast<T*>(&data[pos]) = t;
-	}
-
-	void Pack(std::vector<uint8_t>& _data) {
-		std::copy(_data.begin(), _data.end(), std::back_inserter(data));
-	}
-
-private:
-	std::vector<uint8_t>& data;
-};
-
 Packet::Packet(const unsigned char* data, unsigned length)
 {
 	Unpacker buf(data, length);
@@ -181,11 +174,13 @@ Packet::Packet(const unsigned char* data, unsigned length)
 	}
 
 	while (buf.Remaining() > Chunk::headerSize) {
-		ChunkPtr temp(new Chunk);
-		buf.Unpack(temp->chunkNumber);
-		buf.Unpack(temp->chunkSize);
-		if (buf.Remaining() >= temp->chunkSize) {
-			buf.Unpack(temp->data, temp->chunkSize);
+		int32_t chunkNumber;
+		uint8_t chunkSize;
+		buf.Unpack(chunkNumber);
+		buf.Unpack(chunkSize);
+		if (buf.Remaining() >= chunkSize) {
+			ChunkPtr temp(new Chunk(chunkNumber));
+			temp->Append(buf.Skip(chunkSize), chunkSize);
 			chunks.push_back(temp);
 		} else {
 			// defective, ignore
@@ -200,26 +195,99 @@ Packet::Packet(int _lastContinuous, int _nak)
 {
 }
 
-void Packet::Serialize(std::vector<uint8_t>& data)
+void Packet::SerializeHeader(uint8_t* buf) const
+{
+	memcpy(buf, &lastContinuous, sizeof(lastContinuous));
+	buf[4] = nakType;
+	buf[5] = checksum;
+}
+
+void Packet::Serialize(std::vector<const_buffer>& buffers)
 {
-	data.reserve(GetSize());
-	Packer buf(data);
-	buf.Pack(lastContinuous);
-	buf.Pack(nakType);
-	buf.Pack(checksum);
-	buf.Pack(naks);
+	SerializeHeader(header);
+
+	buffers.push_back(buffer(header, headerSize));
+	if (!naks.empty()) {
+		buffers.push_back(buffer(naks));
+	}
 	std::list<ChunkPtr>::const_iterator ci;
 	for (ci = chunks.begin(); ci != chunks.end(); ++ci) {
-		buf.Pack((*ci)->chunkNumber);
-		buf.Pack((*ci)->chunkSize);
-		buf.Pack((*ci)->data);
+		buffers.push_back(buffer((*ci)->GetBuffer(), (*ci)->GetSize()));
+	}
+}
+
+UDPSendBatch::UDPSendBatch(boost::shared_ptr<ip::udp::socket> _socket)
+	: socket(_socket)
+	, isOpen(false)
+	, numDatagrams(0)
+{
+}
+
+bool UDPSendBatch::Add(const ip::udp::endpoint& to, const Packet& pkt)
+{
+	if (!isOpen)
+		return false;
+
+	if (numDatagrams == datagrams.size()) {
+		datagrams.push_back(Datagram());
+		targets.push_back(to);
+	}
+
+	Datagram& dgram = datagrams[numDatagrams];
+	targets[numDatagrams] = to;
+	++numDatagrams;
+
+	dgram.head.resize(Packet::headerSize + pkt.naks.size());
+	pkt.SerializeHeader(&dgram.head[0]);
+	std::copy(pkt.naks.begin(), pkt.naks.end(), dgram.head.begin() + Packet::headerSize);
+
+	dgram.chunks.assign(pkt.chunks.begin(), pkt.chunks.end());
+	return true;
+}
+
+void UDPSendBatch::Send()
+{
+	isOpen = false;
+
+	if (numDatagrams == 0)
+		return;
+
+	buffers.clear();
+	numBuffers.resize(numDatagrams);
+
+	for (unsigned n = 0; n < numDatagrams; ++n) {
+		const Datagram& dgram = datagrams[n];
+
+		buffers.push_back(buffer(dgram.head));
+		for (unsigned i = 0; i < dgram.chunks.size(); ++i) {
+			buffers.push_back(buffer(dgram.chunks[i]->GetBuffer(), dgram.chunks[i]->GetSize()));
+		}
+
+		numBuffers[n] = dgram.chunks.size() + 1;
 	}
+
+	boost::system::error_code err;
+	const unsigned sent = SendDatagrams(*socket, &buffers[0], &numBuffers[0], &targets[0], numDatagrams, err);
+
+	if (CheckErrorCode(err) || sent < numDatagrams) {
+		// lost like any other datagram, the connections resend what is not acked
+		LOG_L(L_DEBUG, "[UDPSendBatch] sent %u of %u datagrams", sent, numDatagrams);
+	}
+
+	// release the chunks, keep the memory
+	for (unsigned n = 0; n < numDatagrams; ++n) {
+		datagrams[n].chunks.clear();
+	}
+
+	numDatagrams = 0;
 }
 
-UDPConnection::UDPConnection(boost::shared_ptr<ip::udp::socket> netSocket, const ip::udp::endpoint& myAddr)
+
+UDPConnection::UDPConnection(boost::shared_ptr<ip::udp::socket> netSocket, const ip::udp::endpoint& myAddr, boost::shared_ptr<UDPSendBatch> batch)
 	: addr(myAddr)
 	, sharedSocket(true)
 	, mySocket(netSocket)
+	, sendBatch(batch)
 {
 	Init();
 }
@@ -254,18 +322,17 @@ void UDPConnection::ReconnectTo(CConnection& conn) {
 }
 
 void UDPConnection::CopyConnection(UDPConnection &conn) {
-	conn.InitConnection(addr, mySocket);
+	conn.InitConnection(addr, mySocket, sendBatch);
 }
 
-void UDPConnection::InitConnection(ip::udp::endpoint address, boost::shared_ptr<ip::udp::socket> socket) {
+void UDPConnection::InitConnection(ip::udp::endpoint address, boost::shared_ptr<ip::udp::socket> socket, boost::shared_ptr<UDPSendBatch> batch) {
 	addr = address;
 	mySocket = socket;
+	sendBatch = batch;
 }
 
 UDPConnection::~UDPConnection()
 {
-	delete fragmentBuffer;
-	fragmentBuffer = NULL;
 	Flush(true);
 }
 
@@ -412,28 +479,34 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 			++droppedChunks;
 			continue;
 		}
-		waitingPackets.insert((*ci)->chunkNumber, new RawPacket(&(*ci)->data[0], (*ci)->data.size()));
+		// the chunk is shared, not copied
+		waitingPackets[(*ci)->chunkNumber] = *ci;
 	}
 
 	packetMap::iterator wpi;
 	// process all in order packets that we have waiting
 	while ((wpi = waitingPackets.find(lastInOrder+1)) != waitingPackets.end()) {
-		std::vector<boost::uint8_t> buf;
-		if (fragmentBuffer) {
-			buf.resize(fragmentBuffer->length);
-			// combine with fragment buffer
-			std::copy(fragmentBuffer->data, fragmentBuffer->data+fragmentBuffer->length, buf.begin());
-			delete fragmentBuffer;
-			fragmentBuffer = NULL;
+		const unsigned char* buf = wpi->second->GetData();
+		unsigned bufLength = wpi->second->chunkSize;
+
+		// messages are read straight from the chunk, unless the
+		// previous one ended with an incomplete message
+		const bool fragmented = !fragmentBuffer.empty();
+
+		if (fragmented) {
+			fragmentBuffer.insert(fragmentBuffer.end(), buf, buf + bufLength);
+			buf = &fragmentBuffer[0];
+			bufLength = fragmentBuffer.size();
 		}
 
 		lastInOrder++;
-		std::copy(wpi->second->data, wpi->second->data + wpi->second->length, std::back_inserter(buf));
-		waitingPackets.erase(wpi);
 
-		for (unsigned pos = 0; pos < buf.size(); ) {
-			unsigned char* bufp = &buf[pos];
-			unsigned msglength = buf.size() - pos;
+		unsigned pos = 0;
+		bool partial = false;
+
+		while (pos < bufLength) {
+			const unsigned char* bufp = buf + pos;
+			unsigned msglength = bufLength - pos;
 
 			int pktlength = ProtocolDef::GetInstance()->PacketLength(bufp, msglength);
 			if (ProtocolDef::GetInstance()->IsValidLength(pktlength, msglength)) { // this returns false for zero/invalid pktlength
@@ -442,7 +515,7 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 			} else {
 				if (pktlength >= 0) {
 					// partial packet in buffer
-					fragmentBuffer = new RawPacket(bufp, msglength);
+					partial = true;
 					break;
 				}
 				LOG_L(L_ERROR,
@@ -453,6 +526,16 @@ void UDPConnection::ProcessRawPacket(Packet& incoming)
 				++pos;
 			}
 		}
+
+		if (!partial) {
+			fragmentBuffer.clear();
+		} else if (fragmented) {
+			fragmentBuffer.erase(fragmentBuffer.begin(), fragmentBuffer.begin() + pos);
+		} else {
+			fragmentBuffer.assign(buf + pos, buf + bufLength);
+		}
+
+		waitingPackets.erase(wpi);
 	}
 }
 
@@ -476,12 +559,12 @@ void UDPConnection::Flush(const bool forced)
 	}
 
 	if (forced || (!waitMore && outgoingLength > requiredLength)) {
-		boost::uint8_t buffer[udpMaxPacketSize];
-		unsigned pos = 0;
+		// the data is copied once, straight into the chunk it is sent in
+		ChunkPtr chunk;
 		// Manually fragment packets to respect configured UDP_MTU.
 		// This is an attempt to fix the bug where players drop out of the game if
 		// someone in the game gives a large order.
-		bool partialPacket = false;
+		bool partialPacket = (outgoingDataPos != 0);
 		bool sendMore = true;
 
 		do {
@@ -490,7 +573,7 @@ void UDPConnection::Flush(const bool forced)
 					|| partialPacket
 					|| forced;
 			if (!outgoingData.empty() && sendMore) {
-				boost::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
+				const boost::shared_ptr<const RawPacket>& packet = outgoingData.front();
 				if (!partialPacket && !ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length)) {
 					LOG_L(L_ERROR,
 							"Discarding outgoing invalid packet: ID %d, LEN %d",
@@ -498,23 +581,24 @@ void UDPConnection::Flush(const bool forced)
 							packet->length);
 					outgoingData.pop_front();
 				} else {
-					unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length);
+					if (!chunk)
+						chunk.reset(new Chunk(currentNum++));
+					const unsigned numBytes = std::min(Chunk::maxSize - chunk->chunkSize, packet->length - outgoingDataPos);
 					assert(packet->length > 0);
-					memcpy(buffer+pos, packet->data, numBytes);
-					pos+= numBytes;
+					chunk->Append(packet->data + outgoingDataPos, numBytes);
+					outgoingDataPos += numBytes;
 					outgoing.DataSent(numBytes, true);
-					partialPacket = (numBytes != packet->length);
-					if (partialPacket) {
-						// partially transfered
-						packet.reset(new RawPacket(packet->data + numBytes, packet->length - numBytes));
-					} else { // full packet copied
+					partialPacket = (outgoingDataPos != packet->length);
+					if (!partialPacket) { // full packet copied
 						outgoingData.pop_front();
+						outgoingDataPos = 0;
 					}
 				}
 			}
-			if ((pos > 0) && (outgoingData.empty() || (pos == maxChunkSize) || !sendMore)) {
-				CreateChunk(buffer, pos, currentNum++);
-				pos = 0;
+			if (chunk && (outgoingData.empty() || (chunk->chunkSize == Chunk::maxSize) || !sendMore)) {
+				newChunks.push_back(chunk);
+				lastChunkCreated = spring_gettime();
+				chunk.reset();
 			}
 		} while (!outgoingData.empty() && sendMore);
 	}
@@ -585,7 +669,7 @@ std::string UDPConnection::GetFullAddress() const
 
 void UDPConnection::SetMTU(unsigned mtu2)
 {
-	if ((mtu2 > 300) && (mtu2 < udpMaxPacketSize)) {
+	if ((mtu2 > 300) && (mtu2 < Packet::maxSize)) {
 		mtu = mtu2;
 	}
 }
@@ -599,11 +683,12 @@ void UDPConnection::Init()
 	lastReceiveTime = spring_gettime();
 	lastInOrder = -1;
 	waitingPackets.clear();
+	outgoingDataPos = 0;
 	currentNum = 0;
 	lastNak = -1;
 	sentOverhead = 0;
 	recvOverhead = 0;
-	fragmentBuffer = 0;
+	fragmentBuffer.clear();
 	resentChunks = 0;
 	sentPackets = recvPackets = 0;
 	droppedChunks = 0;
@@ -620,17 +705,6 @@ void UDPConnection::Init()
 #endif
 }
 
-void UDPConnection::CreateChunk(const unsigned char* data, const unsigned length, const int packetNum)
-{
-	assert((length > 0) && (length < 255));
-	ChunkPtr buf(new Chunk);
-	buf->chunkNumber = packetNum;
-	buf->chunkSize = length;
-	std::copy(data, data+length, std::back_inserter(buf->data));
-	newChunks.push_back(buf);
-	lastChunkCreated = spring_gettime();
-}
-
 void UDPConnection::SendIfNecessary(bool flushed)
 {
 	const spring_time curTime = spring_gettime();
@@ -795,23 +869,53 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 void UDPConnection::SendPacket(Packet& pkt)
 {
-	std::vector<uint8_t> data;
-	pkt.Serialize(data);
+	if (!NETWORK_TEST && sendBatch && sendBatch->Add(addr, pkt)) {
+		// sent (and counted) when the listener sends its batch
+		outgoing.DataSent(pkt.GetSize());
+		lastSendTime = spring_gettime();
+		dataSent += pkt.GetSize();
+		++sentPackets;
+		return;
+	}
+
+	// gather the header, naks and chunks where they are (sendmsg on POSIX)
+	sendBuffers.clear();
+	pkt.Serialize(sendBuffers);
 
-	outgoing.DataSent(data.size());
+	const unsigned size = pkt.GetSize();
+
+	if (NETWORK_TEST || sendBuffers.size() > maxSendBuffers) {
+		// asio would silently drop the buffers beyond maxSendBuffers,
+		// so packets made of many tiny chunks are sent as one copy
+		sendData.resize(size);
+
+		unsigned pos = 0;
+		for (unsigned i = 0; i < sendBuffers.size(); ++i) {
+			memcpy(&sendData[pos], buffer_cast<const uint8_t*>(sendBuffers[i]), buffer_size(sendBuffers[i]));
+			pos += buffer_size(sendBuffers[i]);
+		}
+
+		sendBuffers.assign(1, buffer(sendData));
+	}
+
+	outgoing.DataSent(size);
 	lastSendTime = spring_gettime();
 	ip::udp::socket::message_flags flags = 0;
 	boost::system::error_code err;
 
+#if NETWORK_TEST
+	const std::vector<uint8_t>& data = sendData;
+#endif
+
 	EMULATE_LATENCY( !EMULATE_PACKET_LOSS( LOSS_COUNTER ) ) {
-		mySocket->send_to(buffer(data), addr, flags, err);
+		mySocket->send_to(sendBuffers, addr, flags, err);
 	}
 
 	if (CheckErrorCode(err)) {
 		return;
 	}
 
-	dataSent += data.size();
+	dataSent += size;
 	++sentPackets;
 }
 
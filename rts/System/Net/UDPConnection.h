@@ -3,11 +3,13 @@
 #ifndef _UDP_CONNECTION_H
 #define _UDP_CONNECTION_H
 
-#include <boost/ptr_container/ptr_map.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <deque>
 #include <list>
+#include <map>
+#include <vector>
 
 #include "Connection.h"
 #include "System/Misc/SpringTime.h"
@@ -26,18 +28,37 @@ namespace netcode {
 #define PACKET_MIN_LATENCY 750                // in [milliseconds] minimum latency
 #define PACKET_MAX_LATENCY 1250               // in [milliseconds] maximum latency
 
+/**
+ * @brief Piece of the outgoing data stream with a continuous number
+ *
+ * The wire header (chunkNumber, chunkSize) is kept in front of the data in
+ * one fixed-size buffer, so a chunk is sent as is (see Packet::Serialize)
+ * and its single allocation is shared between newChunks, unackedChunks,
+ * resendRequested and the packets it goes out in.
+ */
 class Chunk
 {
 public:
+	Chunk(int32_t chunkNumber);
+
 	unsigned GetSize() const {
-		return data.size() + headerSize;
+		return chunkSize + headerSize;
 	}
+	/// header followed by the data, GetSize() bytes
+	const uint8_t* GetBuffer() const { return buffer; }
+	const uint8_t* GetData() const { return buffer + headerSize; }
+
+	/// append <length> bytes, chunkSize + length must not exceed maxSize
+	void Append(const uint8_t* data, unsigned length);
+
 	void UpdateChecksum(CRC& crc) const;
 	static const unsigned maxSize = 254;
 	static const unsigned headerSize = 5;
 	int32_t chunkNumber;
 	uint8_t chunkSize;
-	std::vector<uint8_t> data;
+
+private:
+	uint8_t buffer[headerSize + maxSize];
 };
 typedef boost::shared_ptr<Chunk> ChunkPtr;
 
@@ -45,6 +66,8 @@ class Packet
 {
 public:
 	static const unsigned headerSize = 6;
+	/// largest datagram we send or accept
+	static const unsigned maxSize = 4096;
 	Packet(const unsigned char* data, unsigned length);
 	Packet(int lastContinuous, int nak);
 
@@ -52,7 +75,13 @@ public:
 
 	uint8_t GetChecksum() const;
 
-	void Serialize(std::vector<uint8_t>& data);
+	/// write lastContinuous, nakType and checksum (headerSize bytes) to <buf>
+	void SerializeHeader(uint8_t* buf) const;
+	/**
+	 * @brief list the pieces of the wire format (header, naks, chunks)
+	 * The buffers point into this packet and its chunks, no data is copied.
+	 */
+	void Serialize(std::vector<boost::asio::const_buffer>& buffers);
 
 	int32_t lastContinuous;
 	/// if < 0, we lost -x packets since lastContinuous, if >0, x = size of naks
@@ -60,6 +89,55 @@ public:
 	uint8_t checksum;
 	std::vector<uint8_t> naks;
 	std::list<ChunkPtr> chunks;
+
+private:
+	/// serialized lastContinuous, nakType and checksum
+	uint8_t header[headerSize];
+};
+
+/**
+ * @brief Packets of the connections sharing one socket, sent together
+ *
+ * While the batch is open (see UDPListener::Update) the packets of its
+ * connections are queued instead of sent, Send then hands all of them to
+ * SendDatagrams (one sendmmsg call per 64 datagrams on Linux). A queued
+ * packet keeps references to its chunks, only its header and naks are
+ * copied. Like the connections themselves this is only used from the
+ * thread that updates the listener.
+ */
+class UDPSendBatch
+{
+public:
+	UDPSendBatch(boost::shared_ptr<boost::asio::ip::udp::socket> socket);
+
+	void Open() { isOpen = true; }
+	/// send everything queued since Open and close the batch
+	void Send();
+
+	/**
+	 * @brief queue <pkt> for <to>
+	 * @return false if the batch is not open, the caller has to send it
+	 */
+	bool Add(const boost::asio::ip::udp::endpoint& to, const Packet& pkt);
+
+private:
+	struct Datagram {
+		/// serialized packet header and naks
+		std::vector<uint8_t> head;
+		std::vector<ChunkPtr> chunks;
+	};
+
+	boost::shared_ptr<boost::asio::ip::udp::socket> socket;
+	bool isOpen;
+
+	/// only the first numDatagrams are in use, the rest keep their capacity
+	std::vector<Datagram> datagrams;
+	std::vector<boost::asio::ip::udp::endpoint> targets;
+	unsigned numDatagrams;
+
+	/// scatter/gather list for SendDatagrams
+	std::vector<boost::asio::const_buffer> buffers;
+	std::vector<unsigned> numBuffers;
 };
 
 /*
@@ -77,7 +155,8 @@ class UDPConnection : public CConnection
 {
 public:
 	UDPConnection(boost::shared_ptr<boost::asio::ip::udp::socket> netSocket,
-			const boost::asio::ip::udp::endpoint& myAddr);
+			const boost::asio::ip::udp::endpoint& myAddr,
+			boost::shared_ptr<UDPSendBatch> sendBatch = boost::shared_ptr<UDPSendBatch>());
 	UDPConnection(int sourceport, const std::string& address,
 			const unsigned port);
 	UDPConnection(CConnection& conn);
@@ -126,7 +205,8 @@ public:
 
 private:
 	void InitConnection(boost::asio::ip::udp::endpoint address,
-			boost::shared_ptr<boost::asio::ip::udp::socket> socket);
+			boost::shared_ptr<boost::asio::ip::udp::socket> socket,
+			boost::shared_ptr<UDPSendBatch> batch);
 
 	void CopyConnection(UDPConnection& conn);
 
@@ -134,9 +214,6 @@ private:
 
 	void Init();
 
-	/// add header to data and send it
-	void CreateChunk(const unsigned char* data, const unsigned length,
-			const int packetNum);
 	void SendIfNecessary(bool flushed);
 	void AckChunks(int lastAck);
 
@@ -147,7 +224,7 @@ private:
 	spring_time lastReceiveTime;
 	spring_time lastSendTime;
 
-	typedef boost::ptr_map<int,RawPacket> packetMap;
+	typedef std::map<int, ChunkPtr> packetMap;
 	typedef std::list< boost::shared_ptr<const RawPacket> > packetList;
 	/// address of the other end
 	boost::asio::ip::udp::endpoint addr;
@@ -166,6 +243,8 @@ private:
 
 	/// outgoing stuff (pure data without header) waiting to be sended
 	packetList outgoingData;
+	/// bytes of outgoingData.front() that are already in chunks
+	unsigned outgoingDataPos;
 
 	/// Newly created and not yet sent
 	std::deque<ChunkPtr> newChunks;
@@ -192,8 +271,16 @@ private:
 
 	/// Our socket
 	boost::shared_ptr<boost::asio::ip::udp::socket> mySocket;
+	/// set for connections of a UDPListener, collects what we send
+	boost::shared_ptr<UDPSendBatch> sendBatch;
+
+	/// start of a message that continues in the next chunk
+	std::vector<uint8_t> fragmentBuffer;
 
-	RawPacket* fragmentBuffer;
+	/// scatter/gather list of the packet being sent, see Packet::Serialize
+	std::vector<boost::asio::const_buffer> sendBuffers;
+	/// contiguous copy of a packet with too many pieces for one send call
+	std::vector<uint8_t> sendData;
 
 	// Traffic statistics and stuff
 
@@ -13,6 +13,7 @@
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/asio.hpp>
+#include <boost/functional/hash.hpp>
 #include <list>
 #include <queue>
 
@@ -28,8 +29,14 @@ namespace netcode
 {
 using namespace boost::asio;
 
+// datagrams read per ReceiveDatagrams call
+static const unsigned recvRingSize = 64;
+
 UDPListener::UDPListener(int port, const std::string& ip)
 	: acceptNewConnections(false)
+	, recvBuffer(recvRingSize * Packet::maxSize)
+	, recvSizes(recvRingSize)
+	, recvSenders(recvRingSize)
 {
 	SocketPtr socket;
 
@@ -38,6 +45,7 @@ UDPListener::UDPListener(int port, const std::string& ip)
 		socket->io_control(socketCommand);
 
 		mySocket = socket;
+		sendBatch.reset(new UDPSendBatch(mySocket));
 		SetAcceptingConnections(true);
 	}
 
@@ -48,6 +56,24 @@ UDPListener::UDPListener(int port, const std::string& ip)
 	}
 }
 
+UDPListener::~UDPListener()
+{
+}
+
+size_t UDPListener::EndpointHash::operator () (const ip::udp::endpoint& endpoint) const
+{
+	size_t hash = endpoint.port();
+
+	if (endpoint.address().is_v6()) {
+		const ip::address_v6::bytes_type bytes = endpoint.address().to_v6().to_bytes();
+		boost::hash_range(hash, bytes.begin(), bytes.end());
+	} else {
+		boost::hash_combine(hash, endpoint.address().to_v4().to_ulong());
+	}
+
+	return hash;
+}
+
 bool UDPListener::TryBindSocket(int port, SocketPtr* socket, const std::string& ip) {
 
 	std::string errorMsg = "";
@@ -119,57 +145,20 @@ bool UDPListener::TryBindSocket(int port, SocketPtr* socket, const std::string&
 void UDPListener::Update() {
 	netservice.poll();
 
-	size_t bytes_avail = 0;
-
-	while ((bytes_avail = mySocket->available()) > 0) {
-		std::vector<uint8_t> buffer(bytes_avail);
-		ip::udp::endpoint sender_endpoint;
-		boost::asio::ip::udp::socket::message_flags flags = 0;
+	while (true) {
 		boost::system::error_code err;
-		size_t bytesReceived = mySocket->receive_from(boost::asio::buffer(buffer), sender_endpoint, flags, err);
+		const unsigned numReceived = ReceiveDatagrams(*mySocket, &recvBuffer[0], Packet::maxSize, &recvSizes[0], &recvSenders[0], recvRingSize, err);
 
-		ConnMap::iterator ci = conn.find(sender_endpoint);
-		bool knownConnection = (ci != conn.end());
-
-		if (knownConnection && ci->second.expired())
-			continue;
+		for (unsigned n = 0; n < numReceived; ++n) {
+			ProcessDatagram(&recvBuffer[n * Packet::maxSize], recvSizes[n], recvSenders[n]);
+		}
 
-		if (CheckErrorCode(err))
+		if (CheckErrorCode(err) || numReceived < recvRingSize)
 			break;
-
-		if (bytesReceived < Packet::headerSize)
-			continue;
-
-		Packet data(&buffer[0], bytesReceived);
-
-		if (knownConnection) {
-			ci->second.lock()->ProcessRawPacket(data);
-		}
-		else { // still have the packet (means no connection with the sender's address found)
-			if (acceptNewConnections && data.lastContinuous == -1 && data.nakType == 0)	{
-				if (!data.chunks.empty() && (*data.chunks.begin())->chunkNumber == 0) {
-					// new client wants to connect
-					boost::shared_ptr<UDPConnection> incoming(new UDPConnection(mySocket, sender_endpoint));
-					waiting.push(incoming);
-					conn[sender_endpoint] = incoming;
-					incoming->ProcessRawPacket(data);
-				}
-			}
-			else {
-				LOG_L(L_WARNING, "Dropping packet from unknown IP: [%s]:%i",
-						sender_endpoint.address().to_string().c_str(),
-						sender_endpoint.port());
-			#ifdef DEBUG
-				std::string conns;
-				for (ConnMap::iterator it = conn.begin(); it != conn.end(); ++it) {
-					conns += str(boost::format(" [%s]:%i;") %it->first.address().to_string().c_str() %it->first.port());
-				}
-				LOG_L(L_DEBUG, "Open connections: %s", conns.c_str());
-			#endif
-			}
-		}
 	}
 
+	sendBatch->Open();
+
 	for (ConnMap::iterator i = conn.begin(); i != conn.end(); ) {
 		if (i->second.expired()) {
 			LOG_L(L_DEBUG, "Connection closed: [%s]:%i", i->first.address().to_string().c_str(), i->first.port());
@@ -179,11 +168,72 @@ void UDPListener::Update() {
 		i->second.lock()->Update();
 		++i;
 	}
+
+	sendBatch->Send();
+}
+
+void UDPListener::FlushConnections() {
+	sendBatch->Open();
+
+	for (ConnMap::iterator i = conn.begin(); i != conn.end(); ++i) {
+		boost::shared_ptr<UDPConnection> uc = i->second.lock();
+		if (uc)
+			uc->Flush(false);
+	}
+
+	sendBatch->Send();
+}
+
+void UDPListener::ProcessDatagram(const unsigned char* buf, unsigned length, const ip::udp::endpoint& sender_endpoint) {
+	ConnMap::iterator ci = conn.find(sender_endpoint);
+	bool knownConnection = (ci != conn.end());
+
+	if (knownConnection && ci->second.expired())
+		return;
+
+	if (length < Packet::headerSize)
+		return;
+
+	Packet data(buf, length);
+
+	if (knownConnection) {
+		ci->second.lock()->ProcessRawPacket(data);
+	}
+	else { // still have the packet (means no connection with the sender's address found)
+		if (acceptNewConnections && data.lastContinuous == -1 && data.nakType == 0)	{
+			if (!data.chunks.empty() && (*data.chunks.begin())->chunkNumber == 0) {
+				// new client wants to connect
+				boost::shared_ptr<UDPConnection> incoming(new UDPConnection(mySocket, sender_endpoint, sendBatch));
+				waiting.push(incoming);
+				conn[sender_endpoint] = incoming;
+				incoming->ProcessRawPacket(data);
+			}
+		}
+		else {
+			LOG_L(L_WARNING, "Dropping packet from unknown IP: [%s]:%i",
+					sender_endpoint.address().to_string().c_str(),
+					sender_endpoint.port());
+		#ifdef DEBUG
+			std::string conns;
+			for (ConnMap::iterator it = conn.begin(); it != conn.end(); ++it) {
+				conns += str(boost::format(" [%s]:%i;") %it->first.address().to_string().c_str() %it->first.port());
+			}
+			LOG_L(L_DEBUG, "Open connections: %s", conns.c_str());
+		#endif
+		}
+	}
 }
 
 boost::shared_ptr<UDPConnection> UDPListener::SpawnConnection(const std::string& ip, const unsigned port)
 {
-	boost::shared_ptr<UDPConnection> newConn(new UDPConnection(mySocket, ip::udp::endpoint(WrapIP(ip), port)));
+	ip::address addr = WrapIP(ip);
+
+	// a v6 socket receives the replies of a v4 peer from its v4-mapped
+	// address, which has to be the key in <conn> for them to arrive
+	if (addr.is_v4() && mySocket->local_endpoint().address().is_v6())
+		addr = ip::address_v6::v4_mapped(addr.to_v4());
+
+	boost::shared_ptr<UDPConnection> newConn(new UDPConnection(mySocket, ip::udp::endpoint(addr, port), sendBatch));
 	conn[newConn->GetEndpoint()] = newConn;
 	return newConn;
 }
@@ -222,15 +272,22 @@ void UDPListener::RejectConnection()
 }
 
 void UDPListener::UpdateConnections() {
+	// inserting may rehash, so re-insert after the loop
+	std::vector< boost::shared_ptr<UDPConnection> > moved;
+
 	for (ConnMap::iterator i = conn.begin(); i != conn.end(); ) {
 		boost::shared_ptr<UDPConnection> uc = i->second.lock();
 		if (uc && i->first != uc->GetEndpoint()) {
-			conn[uc->GetEndpoint()] = uc; // inserting does not invalidate iterators
+			moved.push_back(uc);
 			i = set_erase(conn, i);
 		}
 		else
 			++i;
 	}
+
+	for (size_t n = 0; n < moved.size(); ++n) {
+		conn[moved[n]->GetEndpoint()] = moved[n];
+	}
 }
 
 }
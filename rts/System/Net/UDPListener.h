@@ -7,14 +7,16 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/asio/ip/udp.hpp>
+#include <boost/unordered_map.hpp>
 #include <list>
-#include <map>
 #include <queue>
 #include <string>
+#include <vector>
 
 namespace netcode
 {
 class UDPConnection;
+class UDPSendBatch;
 typedef boost::shared_ptr<boost::asio::ip::udp::socket> SocketPtr;
 
 /**
@@ -37,7 +39,7 @@ public:
 	/**
 	 * @brief close the socket and DELETE all connections
 	 */
-	~UDPListener() {}
+	~UDPListener();
 
 	/**
 	 * Try to bind a socket to a local address and port.
@@ -59,6 +61,13 @@ public:
 	 */
 	void Update();
 
+	/**
+	 * @brief Flush all connections
+	 * Sends what was queued since the last Update right away, with as few
+	 * system calls as possible (see UDPSendBatch).
+	 */
+	void FlushConnections();
+
 	/**
 	 * @brief Initiate a connection
 	 * Make a new connection to ip:port. It will be pushed back in conn.
@@ -81,6 +90,14 @@ public:
 	void UpdateConnections(); // Updates connections when the endpoint has been reconnected
 
 private:
+	/// hand one received datagram to its connection
+	void ProcessDatagram(const unsigned char* buf, unsigned length,
+			const boost::asio::ip::udp::endpoint& sender);
+
+	struct EndpointHash {
+		size_t operator () (const boost::asio::ip::udp::endpoint& endpoint) const;
+	};
+
 	/**
 	 * @brief Do we accept packets from unknown sources?
 	 * If true, we will create a new connection, if false, they get dropped.
@@ -92,9 +109,17 @@ private:
 	SocketPtr mySocket;
 
 	/// all connections
-	typedef std::map< boost::asio::ip::udp::endpoint, boost::weak_ptr<UDPConnection> > ConnMap;
+	typedef boost::unordered_map< boost::asio::ip::udp::endpoint, boost::weak_ptr<UDPConnection>, EndpointHash > ConnMap;
 	ConnMap conn;
 
+	/// shared by all connections, sends what they produce in one go
+	boost::shared_ptr<UDPSendBatch> sendBatch;
+
+	/// datagrams read by one ReceiveDatagrams call, Packet::maxSize bytes each
+	std::vector<unsigned char> recvBuffer;
+	std::vector<unsigned> recvSizes;
+	std::vector<boost::asio::ip::udp::endpoint> recvSenders;
+
 	std::queue< boost::shared_ptr<UDPConnection> > waiting;
 };
 
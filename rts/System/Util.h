@@ -5,6 +5,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 #include <algorithm>
 #include <boost/utility.hpp>
 
@@ -183,6 +184,23 @@ inline I set_erase(S &s, I i) {
 #endif
 }
 
+/**
+ * @brief Removes the first occurrence of an element from a vector
+ * Keeps the order of the remaining elements, like std::list::remove would.
+ * @return true if the element was found and removed
+ */
+template<typename T>
+inline bool VectorErase(std::vector<T>& v, const T& e)
+{
+	typename std::vector<T>::iterator it = std::find(v.begin(), v.end(), e);
+
+	if (it == v.end())
+		return false;
+
+	v.erase(it);
+	return true;
+}
+
 
 
 
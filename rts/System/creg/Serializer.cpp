@@ -63,32 +63,6 @@ static std::string ReadZStr(std::istream& file)
 	return std::string(cstr);
 }
 
-static void WriteZStr(std::ostream& file, const std::string& str)
-{
-	assert(str.length() < 1024); // check func above!
-	file.write(str.c_str(), str.length() + 1);
-}
-
-void WriteVarSizeUInt(std::ostream* stream, unsigned int val)
-{
-	if (val < 0x80) {
-		unsigned char a = val;
-		stream->write((char*)&a, sizeof(char));
-	} else if (val < 0x4000) {
-		unsigned char a = (val & 0x7F) | 0x80;
-		unsigned char b = val >> 7;
-		stream->write((char*)&a, sizeof(char));
-		stream->write((char*)&b, sizeof(char));
-	} else if (val < 0x40000000) {
-		unsigned char a = (val & 0x7F) | 0x80;
-		unsigned char b = ((val >> 7) & 0x7F) | 0x80;
-		unsigned short c = swabWord(val >> 14);
-		stream->write((char*)&a, sizeof(char));
-		stream->write((char*)&b, sizeof(char));
-		stream->write((char*)&c, sizeof(short));
-	} else throw "Cannot save varible-size int";
-}
-
 void ReadVarSizeUInt(std::istream* stream, unsigned int* buf)
 {
 	unsigned char a;
@@ -116,6 +90,32 @@ COutputStreamSerializer::COutputStreamSerializer()
 	stream = NULL;
 }
 
+void COutputStreamSerializer::WriteZStr(const std::string& str)
+{
+	assert(str.length() < 1024); // check ReadZStr!
+	Write(str.c_str(), str.length() + 1);
+}
+
+void COutputStreamSerializer::WriteVarSizeUInt(unsigned int val)
+{
+	if (val < 0x80) {
+		unsigned char a = val;
+		Write(&a, sizeof(char));
+	} else if (val < 0x4000) {
+		unsigned char a = (val & 0x7F) | 0x80;
+		unsigned char b = val >> 7;
+		Write(&a, sizeof(char));
+		Write(&b, sizeof(char));
+	} else if (val < 0x40000000) {
+		unsigned char a = (val & 0x7F) | 0x80;
+		unsigned char b = ((val >> 7) & 0x7F) | 0x80;
+		unsigned short c = swabWord(val >> 14);
+		Write(&a, sizeof(char));
+		Write(&b, sizeof(char));
+		Write(&c, sizeof(short));
+	} else throw "Cannot save varible-size int";
+}
+
 bool COutputStreamSerializer::IsWriting()
 {
 	return true;
@@ -136,8 +136,10 @@ void COutputStreamSerializer::SerializeObject(Class* c, void* ptr, ObjectRef* ob
 	if (c->base)
 		SerializeObject(c->base, ptr, objr);
 
-	ObjectMemberGroup omg;
+	objr->memberGroups.push_back(ObjectMemberGroup());
+	ObjectMemberGroup& omg = objr->memberGroups.back();
 	omg.membersClass = c;
+	omg.members.reserve(c->members.size() + 1);
 
 	for (uint a = 0; a < c->members.size(); a++)
 	{
@@ -149,10 +151,10 @@ void COutputStreamSerializer::SerializeObject(Class* c, void* ptr, ObjectRef* ob
 		om.member = m;
 		om.memberId = a;
 		void* memberAddr = ((char*)ptr) + m->offset;
-		unsigned mstart = stream->tellp();
+		unsigned mstart = buffer.size();
 		LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s::%s type:%s", c->name.c_str(), m->name, m->type->GetName().c_str());
 		m->type->Serialize(this, memberAddr);
-		unsigned mend = stream->tellp();
+		unsigned mend = buffer.size();
 		om.size = mend - mstart;
 		omg.members.push_back(om);
 		omg.size += om.size;
@@ -164,16 +166,14 @@ void COutputStreamSerializer::SerializeObject(Class* c, void* ptr, ObjectRef* ob
 		ObjectMember om;
 		om.member = NULL;
 		om.memberId = -1;
-		unsigned mstart = stream->tellp();
+		unsigned mstart = buffer.size();
 		_DummyStruct *obj = (_DummyStruct*)ptr;
 		(obj->*(c->serializeProc))(*this);
-		unsigned mend = stream->tellp();
+		unsigned mend = buffer.size();
 		om.size = mend - mstart;
 		omg.members.push_back(om);
 		omg.size += om.size;
 	}
-
-	objr->memberGroups.push_back(omg);
 }
 
 void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* objClass)
@@ -198,7 +198,7 @@ void COutputStreamSerializer::SerializeObjectInstance(void* inst, creg::Class* o
 	obj->isEmbedded = true;
 
 	// write an object ID
-	WriteVarSizeUInt(stream, obj->id);
+	WriteVarSizeUInt(obj->id);
 
 	// write the object
 	SerializeObject(objClass, inst, obj);
@@ -218,16 +218,16 @@ void COutputStreamSerializer::SerializeObjectPtr(void** ptr, creg::Class* objCla
 		}
 		id = obj->id;
 
-		WriteVarSizeUInt(stream, id);
+		WriteVarSizeUInt(id);
 	} else {
 		// null pointer, write a zero
-		WriteVarSizeUInt(stream, 0);
+		WriteVarSizeUInt(0);
 	}
 }
 
 void COutputStreamSerializer::Serialize(void* data, int byteSize)
 {
-	stream->write((char*)data, byteSize);
+	Write(data, byteSize);
 }
 
 void COutputStreamSerializer::SerializeInt(void* data, int byteSize)
@@ -255,7 +255,7 @@ void COutputStreamSerializer::SerializeInt(void* data, int byteSize)
 			throw "Unknown int type";
 		}
 	}
-	stream->write((char*)data, byteSize); //TODO write buf?
+	Write(data, byteSize); //TODO write buf?
 }
 
 
@@ -270,10 +270,12 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	PackageHeader ph;
 
 	stream = s;
-	unsigned startOffset = stream->tellp();
-	stream->write((char*)&ph, sizeof(PackageHeader));
-	stream->seekp(startOffset + sizeof(PackageHeader));
-	ph.objDataOffset = (int)stream->tellp();
+	// offsets in the header are stream positions
+	const unsigned startOffset = stream->tellp();
+	buffer.clear();
+	buffer.reserve(1 << 20);
+	buffer.resize(sizeof(PackageHeader));
+	ph.objDataOffset = startOffset + buffer.size();
 
 	// Insert dummy object with id 0
 	objects.push_back(ObjectRef(0, 0, true, 0));
@@ -296,9 +298,9 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 		for (std::vector<ObjectRef*>::const_iterator i = po.begin(); i != po.end(); ++i)
 		{
 			ObjectRef* obj = *i;
-			const unsigned objstart = stream->tellp();
+			const unsigned objstart = buffer.size();
 			SerializeObject(obj->class_, obj->ptr, obj);
-			const unsigned objend = stream->tellp();
+			const unsigned objend = buffer.size();
 			const int sz = objend - objstart;
 			classSizes[obj->class_] += sz;
 			LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG, "Serialized %s size:%i", obj->class_->name.c_str(), sz);
@@ -309,7 +311,7 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 	std::map<creg::Class*, ClassRef> classMap;
 	std::vector<ClassRef*> classRefs;
 	std::map<int, int> classObjects;
-	for (std::list<ObjectRef>::iterator i = objects.begin(); i != objects.end(); ++i) {
+	for (std::deque<ObjectRef>::iterator i = objects.begin(); i != objects.end(); ++i) {
 		if (i->ptr == NULL) continue;
 
 		creg::Class* c = i->class_;
@@ -342,33 +344,33 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 
 	// Write the class references & calc their checksum
 	ph.numObjClassRefs = classRefs.size();
-	ph.objClassRefOffset = (int)stream->tellp();
+	ph.objClassRefOffset = startOffset + buffer.size();
 	for (uint a = 0; a < classRefs.size(); a++) {
 		creg::Class* c =  classRefs[a]->class_;
-		WriteZStr(*stream, c->name);
+		WriteZStr(c->name);
 	};
 
 	// Write object info
-	ph.objTableOffset = (int)stream->tellp();
+	ph.objTableOffset = startOffset + buffer.size();
 	ph.numObjects = objects.size();
-	for (std::list<ObjectRef>::iterator i = objects.begin(); i != objects.end(); ++i) {
+	for (std::deque<ObjectRef>::iterator i = objects.begin(); i != objects.end(); ++i) {
 		int classRefIndex = i->classIndex;
 		char isEmbedded = i->isEmbedded ? 1 : 0;
-		WriteVarSizeUInt(stream, classRefIndex);
-		stream->write((char*)&isEmbedded, sizeof(char));
+		WriteVarSizeUInt(classRefIndex);
+		Write(&isEmbedded, sizeof(char));
 
 		char mgcnt = i->memberGroups.size();
-		WriteVarSizeUInt(stream, mgcnt);
+		WriteVarSizeUInt(mgcnt);
 
 		std::vector<COutputStreamSerializer::ObjectMemberGroup>::iterator j;
 		for (j = i->memberGroups.begin(); j != i->memberGroups.end(); ++j) {
 			std::map<creg::Class*, ClassRef>::iterator cr = classMap.find(j->membersClass);
 			if (cr == classMap.end()) throw "Cannot find member class ref";
 			int cid = cr->second.index;
-			WriteVarSizeUInt(stream, cid);
+			WriteVarSizeUInt(cid);
 
 			unsigned int mcnt = j->members.size();
-			WriteVarSizeUInt(stream, mcnt);
+			WriteVarSizeUInt(mcnt);
 
 			bool hasSerializerMember = false;
 			char groupFlags = 0;
@@ -376,7 +378,7 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 				groupFlags |= 0x01;
 				hasSerializerMember = true;
 			}
-			stream->write((char*)&groupFlags, sizeof(char));
+			Write(&groupFlags, sizeof(char));
 
 			int midx = 0;
 			std::vector<COutputStreamSerializer::ObjectMember>::iterator k;
@@ -384,7 +386,7 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 				if ((k->memberId != midx) && (!hasSerializerMember || k != (j->members.end() - 1))) {
 					throw "Invalid member id";
 				}
-				WriteVarSizeUInt(stream, k->size);
+				WriteVarSizeUInt(k->size);
 			}
 		}
 	}
@@ -397,17 +399,18 @@ void COutputStreamSerializer::SavePackage(std::ostream* s, void* rootObj, Class*
 		c->CalculateChecksum(ph.metadataChecksum);
 	}
 
-	int endOffset = stream->tellp();
-	stream->seekp(startOffset);
 	memcpy(ph.magic, CREG_PACKAGE_FILE_ID, 4);
 	ph.SwapBytes();
-	stream->write((const char*)&ph, sizeof(PackageHeader));
+	memcpy(&buffer[0], &ph, sizeof(PackageHeader));
+
+	// one large write instead of one per member
+	stream->write(&buffer[0], buffer.size());
 
 	LOG_SL(LOG_SECTION_CREG_SERIALIZER, L_DEBUG,
 			"Checksum: %X\nNumber of objects saved: %d\nNumber of classes involved: %d",
 			ph.metadataChecksum, objects.size(), classRefs.size());
 
-	stream->seekp(endOffset);
+	std::vector<char>().swap(buffer);
 	ptrToId.clear();
 	pendingObjects.clear();
 	objects.clear();
@@ -7,8 +7,9 @@
 #include "creg_cond.h"
 #include <map>
 #include <vector>
-#include <list>
+#include <deque>
 #include <istream>
+#include <boost/unordered_map.hpp>
 
 namespace creg {
 
@@ -26,6 +27,7 @@ namespace creg {
 			int size;
 		};
 		struct ObjectMemberGroup {
+			ObjectMemberGroup(): membersClass(NULL), size(0) {}
 			Class* membersClass;
 			std::vector<COutputStreamSerializer::ObjectMember> members;
 			int size;
@@ -78,8 +80,11 @@ namespace creg {
 		struct ClassRef;
 
 		std::ostream* stream;
-		std::map<void*,std::vector<ObjectRef*> > ptrToId;
-		std::list<ObjectRef> objects;
+		// the whole package is built here and written to stream at once
+		std::vector<char> buffer;
+		boost::unordered_map<void*, std::vector<ObjectRef*> > ptrToId;
+		// a deque allocates in blocks and never moves its elements on push_back
+		std::deque<ObjectRef> objects;
 		std::vector<ObjectRef*> pendingObjects; // these objects still have to be saved
 
 		// Serialize all class names
@@ -87,6 +92,13 @@ namespace creg {
 		// Helper for instance/ptr saving
 		void WriteObjectRef(void* inst, Class* cls, bool embedded);
 
+		void Write(const void* data, int byteSize) {
+			const char* bytes = (const char*)data;
+			buffer.insert(buffer.end(), bytes, bytes + byteSize);
+		}
+		void WriteVarSizeUInt(unsigned int val);
+		void WriteZStr(const std::string& str);
+
 		ObjectRef* FindObjectRef(void* inst, Class* objClass, bool isEmbedded);
 
 		void SerializeObject(Class* c, void* ptr, ObjectRef* objr);
@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <cstdlib>
 #include <string>
 
 #ifdef _WIN32
@@ -9,6 +10,7 @@
 #include <SDL.h>
 
 #include "Game/GameServer.h"
+#include "Game/Server/SpectatorRelay.h"
 #include "Game/GameSetup.h"
 #include "Game/ClientSetup.h"
 #include "Game/GameData.h"
@@ -52,7 +54,19 @@ extern "C"
 #endif
 
 
-void ParseCmdLine(int argc, char* argv[], std::string* script_txt)
+struct RelaySettings {
+	RelaySettings(): serverPort(0), hostPort(8452), name("relay") {}
+
+	std::string serverIP;
+	int serverPort;
+	int hostPort;
+	std::string name;
+	std::string passwd;
+	std::string specPasswd;
+};
+
+
+void ParseCmdLine(int argc, char* argv[], std::string* script_txt, RelaySettings* relay)
 {
 	#undef  LOG_SECTION_CURRENT
 	#define LOG_SECTION_CURRENT LOG_SECTION_DEFAULT
@@ -60,12 +74,17 @@ void ParseCmdLine(int argc, char* argv[], std::string* script_txt)
 	std::string binaryname = argv[0];
 	
 	CmdLineParams cmdline(argc, argv);
-	cmdline.SetUsageDescription("Usage: " + binaryname + " [options] path_to_script.txt");
+	cmdline.SetUsageDescription("Usage: " + binaryname + " [options] path_to_script.txt\n       " + binaryname + " [options] --relay IP:port");
 	cmdline.AddSwitch(0,   "sync-version",       "Display program sync version (for online gaming)");
 	cmdline.AddString('C', "config",             "Configuration file");
 	cmdline.AddSwitch(0,   "list-config-vars",   "Dump a list of config vars and meta data to stdout");
 	cmdline.AddSwitch('i', "isolation",          "Limit the data-dir (games & maps) scanner to one directory");
 	cmdline.AddString(0,   "isolation-dir",      "Specify the isolation-mode data-dir (see --isolation)");
+	cmdline.AddString(0,   "relay",              "Instead of hosting a game, relay the one hosted at IP:port to spectators (anyone can join unless --relay-spec-password is set)");
+	cmdline.AddInt   (0,   "relay-port",         "Port spectators connect to in relay mode (default 8452)");
+	cmdline.AddString(0,   "relay-name",         "Player name the relay joins the game as (default \"relay\")");
+	cmdline.AddString(0,   "relay-password",     "Password for the relay's player name");
+	cmdline.AddString(0,   "relay-spec-password","Password spectators need to join the relay (default: none)");
 
 	try {
 		cmdline.Parse();
@@ -89,8 +108,29 @@ void ParseCmdLine(int argc, char* argv[], std::string* script_txt)
 	}
 
 
+	if (cmdline.IsSet("relay")) {
+		const std::string serverAddr = cmdline.GetString("relay");
+		const size_t colon = serverAddr.rfind(':');
+
+		if (colon == std::string::npos || (relay->serverPort = atoi(serverAddr.substr(colon + 1).c_str())) <= 0) {
+			LOG_L(L_ERROR, "--relay expects IP:port, got \"%s\"", serverAddr.c_str());
+			exit(1);
+		}
+
+		relay->serverIP = serverAddr.substr(0, colon);
+
+		if (cmdline.IsSet("relay-port"))
+			relay->hostPort = cmdline.GetInt("relay-port");
+		if (cmdline.IsSet("relay-name"))
+			relay->name = cmdline.GetString("relay-name");
+		if (cmdline.IsSet("relay-password"))
+			relay->passwd = cmdline.GetString("relay-password");
+		if (cmdline.IsSet("relay-spec-password"))
+			relay->specPasswd = cmdline.GetString("relay-spec-password");
+	}
+
 	*script_txt = cmdline.GetInputFile();
-	if (script_txt->empty() && !cmdline.IsSet("list-config-vars")) {
+	if (script_txt->empty() && relay->serverIP.empty() && !cmdline.IsSet("list-config-vars")) {
 		cmdline.PrintUsage();
 		exit(1);
 	}
@@ -141,8 +181,9 @@ int main(int argc, char* argv[])
 #endif
 	std::string scriptName;
 	std::string scriptText;
+	RelaySettings relay;
 
-	ParseCmdLine(argc, argv, &scriptName);
+	ParseCmdLine(argc, argv, &scriptName, &relay);
 
 	// Initialize crash reporting
 	CrashHandler::Install();
@@ -151,6 +192,22 @@ int main(int argc, char* argv[])
 	logOutput.Initialize();
 
 	LOG("report any errors to Mantis or the forums.");
+
+	if (!relay.serverIP.empty()) {
+		// no game of our own, so no script, archives or demo either
+		CSpectatorRelay* relayServer = new CSpectatorRelay("", relay.hostPort, relay.serverIP, relay.serverPort, relay.name, relay.passwd, relay.specPasswd);
+
+		while (!relayServer->HasFinished()) {
+			zzz(1);
+		}
+
+		delete relayServer;
+
+		GlobalConfig::Deallocate();
+		ConfigHandler::Deallocate();
+		return GetExitCode();
+	}
+
 	LOG("loading script from file: %s", scriptName.c_str());
 
 	FileSystemInitializer::Initialize();
@@ -1091,6 +1091,24 @@ public:
 		return cont.erase(it);
 	}
 
+	//! variants of the above for callers that compact <cont> themselves
+	//! (erasing from the middle of a vector one element at a time is O(n))
+	void delete_synced(const T& x) {
+		del.push_back(x);
+	}
+
+	void detach(const T& x) {
+#if !defined(USE_GML) || !GML_ENABLE_SIM
+		delete x;
+#else
+		D::Detach(x);
+#endif
+	}
+
+	T& operator [] (size_t i) {
+		return cont[i];
+	}
+
 public:
 	typedef SimIT iterator;
 
@@ -0,0 +1,123 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Checks the projectile-vs-unit broad phase against the engine's exact
+ * collision tests: every segment that hits a CollisionVolume according to
+ * CCollisionHandler must also pass CCollisionHandler::SegmentSpheresPreTest
+ * with the radius CCollisionHandler::GetPreTestRadius gives that volume,
+ * or CheckUnitCollisions would miss the hit.
+ */
+
+#include "Sim/Misc/CollisionHandler.h"
+#include "Sim/Misc/CollisionVolume.h"
+#include "System/Matrix44f.h"
+
+#include <cstddef>
+
+#define BOOST_TEST_MODULE CollisionBroadPhase
+#include <boost/test/unit_test.hpp>
+
+class CGlobalSynced;
+class CGroundBlockingObjectMap;
+
+// referenced by CCollisionHandler, not used by the tests below
+CGlobalSynced* gs = NULL;
+CGroundBlockingObjectMap* groundBlockingObjectMap = NULL;
+
+
+/**
+ * Exact hit-test of the world-space segment [p0, p1] against <v> of an
+ * object with its midPos at the origin, as DetectHit does it (the object
+ * is not rotated, the bounding radius does not depend on that)
+ */
+static bool IntersectVolume(const CollisionVolume& v, const float3& p0, const float3& p1)
+{
+	CMatrix44f m;
+	m.Translate(v.GetOffsets());
+
+	CollisionQuery q;
+	return CCollisionHandler::Intersect(&v, m, p0, p1, &q);
+}
+
+
+BOOST_AUTO_TEST_CASE( SegmentSpheresPreTest )
+{
+	const float xs[] = {0.0f, 10.0f, 10.0f, -5.0f};
+	const float ys[] = {0.0f,  0.0f,  5.0f,  0.0f};
+	const float zs[] = {0.0f,  0.0f,  0.0f,  0.0f};
+	const float rs[] = {1.0f,  1.0f,  4.0f,  3.5f};
+	unsigned char mask[4];
+
+	// segment from (-1, 0, 0) to (11, 0, 0)
+	CCollisionHandler::SegmentSpheresPreTest(float3(-1.0f, 0.0f, 0.0f), float3(11.0f, 0.0f, 0.0f), xs, ys, zs, rs, mask, 4);
+
+	BOOST_CHECK(mask[0] == 1);
+	BOOST_CHECK(mask[1] == 1);
+	BOOST_CHECK(mask[2] == 0); // 5 above the segment
+	BOOST_CHECK(mask[3] == 0); // 4 behind the start point (radius 3.5)
+
+	// degenerate (zero-length) segment
+	CCollisionHandler::SegmentSpheresPreTest(float3(10.0f, 0.5f, 0.0f), float3(10.0f, 0.5f, 0.0f), xs, ys, zs, rs, mask, 4);
+
+	BOOST_CHECK(mask[0] == 0);
+	BOOST_CHECK(mask[1] == 1);
+	BOOST_CHECK(mask[2] == 0); // 4.5 above the point
+	BOOST_CHECK(mask[3] == 0);
+}
+
+BOOST_AUTO_TEST_CASE( PreTestKeepsExactHits )
+{
+	const CollisionVolume volumes[] = {
+		CollisionVolume("box",       float3(30.0f, 12.0f, 20.0f), float3( 0.0f,  0.0f,  0.0f)),
+		CollisionVolume("box",       float3(10.0f, 40.0f, 10.0f), float3( 8.0f, 15.0f, -6.0f)),
+		CollisionVolume("cylX",      float3(36.0f, 14.0f, 14.0f), float3( 0.0f,  4.0f,  0.0f)),
+		CollisionVolume("cylY",      float3(20.0f, 44.0f, 20.0f), float3(-5.0f, 10.0f,  5.0f)),
+		CollisionVolume("cylZ",      float3(16.0f, 24.0f, 50.0f), float3( 0.0f,  0.0f, 12.0f)),
+		CollisionVolume("ellipsoid", float3(24.0f, 24.0f, 24.0f), float3( 0.0f,  6.0f,  0.0f)),
+		CollisionVolume("ellipsoid", float3(40.0f, 10.0f, 22.0f), float3( 3.0f,  0.0f,  3.0f)),
+	};
+	const float3 dirs[] = {
+		float3( 1.0f,  0.0f,  0.0f),
+		float3( 0.0f,  0.0f, -1.0f),
+		float3( 0.0f, -1.0f,  0.0f),
+		float3( 0.7f, -0.2f,  0.7f),
+		float3(-0.6f,  0.3f,  0.5f),
+	};
+
+	for (size_t v = 0; v < sizeof(volumes) / sizeof(volumes[0]); v++) {
+		const CollisionVolume& cv = volumes[v];
+		const float r = CCollisionHandler::GetPreTestRadius(&cv);
+		const float x = 0.0f, y = 0.0f, z = 0.0f;
+
+		unsigned int numHits = 0;
+		unsigned int numCulled = 0;
+
+		// segments (one projectile-update long) starting on a grid around
+		// the volume, in several directions
+		for (float sx = -60.0f; sx <= 60.0f; sx += 4.0f) {
+			for (float sy = -60.0f; sy <= 60.0f; sy += 8.0f) {
+				for (float sz = -60.0f; sz <= 60.0f; sz += 4.0f) {
+					for (size_t d = 0; d < sizeof(dirs) / sizeof(dirs[0]); d++) {
+						const float3 p0(sx, sy, sz);
+						const float3 p1 = p0 + dirs[d] * 12.0f;
+
+						unsigned char mask = 0;
+						CCollisionHandler::SegmentSpheresPreTest(p0, p1, &x, &y, &z, &r, &mask, 1);
+
+						if (IntersectVolume(cv, p0, p1)) {
+							BOOST_CHECK_MESSAGE(mask == 1, "volume " << v << ": hit culled by the pre-test");
+							numHits += 1;
+						} else {
+							numCulled += (mask == 0);
+						}
+					}
+				}
+			}
+		}
+
+		// both outcomes must actually have been exercised (cylinders are
+		// never culled, IntersectCylinder also hits behind the segment)
+		BOOST_CHECK(numHits > 0);
+		BOOST_CHECK(numCulled > 0 || cv.GetVolumeType() == CollisionVolume::COLVOL_TYPE_CYLINDER);
+	}
+}
@@ -0,0 +1,129 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Checks that CLosAlgorithm::LosRecast, which CLosHandler uses after terrain
+ * damage instead of re-adding the whole footprint of every unit near it,
+ * leaves an instance with the same squares as a fresh LosAdd on the changed
+ * heightmap, and that the removed and added squares it reports turn the old
+ * footprint into the new one.
+ */
+
+#include "Sim/Misc/LosMap.h"
+#include "Map/ReadMap.h"
+#include "System/Rectangle.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+#define BOOST_TEST_MODULE LosRecast
+#include <boost/test/unit_test.hpp>
+
+class CGlobalSynced;
+class CGlobalUnsynced;
+
+// referenced by CLosMap, not used by the tests below
+CGlobalSynced* gs = NULL;
+CGlobalUnsynced* gu = NULL;
+CReadMap* readmap = NULL;
+
+void CReadMap::UpdateLOS(const SRectangle& rect) {}
+
+
+static const int MAP_SIZE = 96;
+
+
+/// rolling hills with a ridge, so that rays actually get blocked
+static std::vector<float> CreateHeightMap()
+{
+	std::vector<float> heights(MAP_SIZE * MAP_SIZE);
+
+	for (int y = 0; y < MAP_SIZE; y++) {
+		for (int x = 0; x < MAP_SIZE; x++) {
+			const int hx = (x * 37) % 23;
+			const int hy = (y * 53) % 29;
+			const float ridge = (x > 40 && x < 44) ? 120.0f : 0.0f;
+
+			heights[y * MAP_SIZE + x] = (hx * hy) * 0.25f + ridge;
+		}
+	}
+
+	return heights;
+}
+
+/// digs a crater into <rect> (inclusive), with a rim around its center
+static void DamageTerrain(std::vector<float>& heights, const SRectangle& rect)
+{
+	const int cx = (rect.x1 + rect.x2) / 2;
+	const int cy = (rect.y1 + rect.y2) / 2;
+
+	for (int y = std::max(0, rect.y1); y <= std::min(MAP_SIZE - 1, rect.y2); y++) {
+		for (int x = std::max(0, rect.x1); x <= std::min(MAP_SIZE - 1, rect.x2); x++) {
+			const int d = std::max(std::abs(x - cx), std::abs(y - cy));
+			heights[y * MAP_SIZE + x] += ((d <= 1) ? -60.0f : 45.0f);
+		}
+	}
+}
+
+static std::vector<int> Sorted(std::vector<int> squares)
+{
+	std::sort(squares.begin(), squares.end());
+	return squares;
+}
+
+
+BOOST_AUTO_TEST_CASE( RecastMatchesLosAdd )
+{
+	const int2 positions[] = {
+		int2(30, 30), int2(48, 50), int2(5, 70), int2(90, 3), int2(60, 60),
+	};
+	const int radii[] = {4, 10, 20};
+	const SRectangle rects[] = {
+		SRectangle(35, 28, 39, 33), // beside the unit at (30, 30)
+		SRectangle(40, 40, 44, 44), // the ridge
+		SRectangle(26, 26, 34, 34), // around the unit at (30, 30)
+		SRectangle(0, 60, 8, 80),   // at the map edge
+		SRectangle(85, 85, 95, 95), // far from most units
+	};
+
+	for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); r++) {
+		for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); p++) {
+			for (size_t s = 0; s < sizeof(radii) / sizeof(radii[0]); s++) {
+				std::vector<float> heights = CreateHeightMap();
+				CLosAlgorithm losAlgo(int2(MAP_SIZE, MAP_SIZE), -1e6f, 15, &heights[0]);
+
+				std::vector<int> squares;
+				std::vector<int> rayOffsets;
+				losAlgo.LosAdd(positions[p], radii[s], 20.0f, squares, &rayOffsets);
+
+				const std::vector<int> oldSquares = squares;
+
+				DamageTerrain(heights, rects[r]);
+
+				std::vector<int> removed;
+				std::vector<int> added;
+				losAlgo.LosRecast(positions[p], radii[s], 20.0f, rects[r], squares, rayOffsets, removed, added);
+
+				std::vector<int> freshSquares;
+				losAlgo.LosAdd(positions[p], radii[s], 20.0f, freshSquares);
+
+				BOOST_CHECK_MESSAGE(Sorted(squares) == Sorted(freshSquares),
+					"rect " << r << ", position " << p << ", radius " << radii[s] << ": recast differs from LosAdd");
+
+				// what CLosHandler::LosRecast does to the LOS-map
+				std::vector<int> patched = oldSquares;
+				patched.insert(patched.end(), added.begin(), added.end());
+				patched = Sorted(patched);
+
+				const std::vector<int> sortedRemoved = Sorted(removed);
+				std::vector<int> remaining;
+				std::set_difference(patched.begin(), patched.end(), sortedRemoved.begin(), sortedRemoved.end(), std::back_inserter(remaining));
+
+				BOOST_CHECK_EQUAL(remaining.size() + removed.size(), patched.size());
+				BOOST_CHECK(remaining == Sorted(freshSquares));
+			}
+		}
+	}
+}
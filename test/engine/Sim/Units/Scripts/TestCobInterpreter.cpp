@@ -0,0 +1,588 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Checks the COB interpreter: runs a few sample scripts (an animation loop,
+ * aiming, a recursive call tree and a pure arithmetic loop, assembled below)
+ * through the old switch-over-raw-opcodes interpreter, kept here as the
+ * reference, and through the pre-decoded CCobBytecode.
+ * The instructions that need a unit are handled by the same stand-in for
+ * both, which records what it was asked to do. Both must produce the same
+ * records, return codes, stacks and static variables.
+ */
+
+#include "Sim/Units/Scripts/CobBytecode.h"
+#include "Sim/Units/Scripts/CobOpcodes.h"
+
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE CobInterpreter
+#include <boost/test/unit_test.hpp>
+
+static const int NUM_STATIC_VARS = 8;
+/// runs of each sample, static variables carry over from one to the next
+static const int NUM_RUNS = 2;
+
+
+/// assembles COB code, functions are numbered in the order they are begun
+class CTestAssembler
+{
+public:
+	int BeginFunction(const std::string& name) {
+		names.push_back(name);
+		offsets.push_back(code.size());
+		return (names.size() - 1);
+	}
+	/// a function without code, calls to it are skipped
+	int EmptyFunction(const std::string& name) {
+		return BeginFunction(name);
+	}
+
+	void Emit(int w0) { code.push_back(w0); }
+	void Emit(int w0, int w1) { Emit(w0); Emit(w1); }
+	void Emit(int w0, int w1, int w2) { Emit(w0, w1); Emit(w2); }
+
+	int Here() const { return code.size(); }
+	/// emits a jump with its target left open, returns where to patch it
+	int EmitJump(int opcode) { Emit(opcode, -1); return (Here() - 1); }
+	void PatchJump(int at, int target) { code[at] = target; }
+
+	void Finish() {
+		for (size_t i = 0; i < offsets.size(); ++i) {
+			const int end = ((i + 1) < offsets.size())? offsets[i + 1]: code.size();
+			lengths.push_back(end - offsets[i]);
+		}
+
+		// CCobFile pads the code the same way
+		code.resize(code.size() + 4, 0);
+	}
+
+	std::vector<int> code;
+	std::vector<std::string> names;
+	std::vector<int> offsets;
+	std::vector<int> lengths;
+};
+
+
+struct TestThread {
+	TestThread(): PC(0), paramCount(0), retCode(-1), signalMask(0), numRandCalls(0), staticVars(NUM_STATIC_VARS, 0) {}
+
+	void Start(const CTestAssembler& as, int functionId, const std::vector<int>& args) {
+		const CCobBytecode::CallInfo ci = {functionId, -1, 0};
+
+		PC = as.offsets[functionId];
+		paramCount = args.size();
+		retCode = -1;
+		stack = args;
+		callStack.assign(1, ci);
+	}
+
+	int POP() {
+		if (stack.empty())
+			return 0;
+
+		const int r = stack.back();
+		stack.pop_back();
+		return r;
+	}
+
+	int PC;
+	int paramCount;
+	int retCode;
+	int signalMask;
+	unsigned int numRandCalls;
+
+	std::vector<int> stack;
+	std::vector<CCobBytecode::CallInfo> callStack;
+	std::vector<int> staticVars;
+
+	/// what the unit was asked to do, one opcode and its values per entry
+	std::vector<int> records;
+};
+
+
+/**
+ * The stand-in for the unit, scheduler and Lua: handles <opcode> like
+ * CCobThread::Tick does, with <PC> at its first operand.
+ */
+static void RunExternal(CCobBytecode::Opcode opcode, const std::vector<int>& code, TestThread& t)
+{
+	int& PC = t.PC;
+	int r1, r2, r3, r4;
+
+	t.records.push_back(opcode);
+
+	switch (opcode) {
+		case CCobBytecode::OP_MOVE:
+			r1 = code[PC++];
+			r2 = code[PC++];
+			r4 = t.POP();
+			r3 = t.POP();
+			t.records.push_back(r1); t.records.push_back(r2); t.records.push_back(r3); t.records.push_back(r4);
+			break;
+		case CCobBytecode::OP_TURN:
+			r2 = t.POP();
+			r1 = t.POP();
+			r3 = code[PC++];
+			r4 = code[PC++];
+			t.records.push_back(r1); t.records.push_back(r2); t.records.push_back(r3); t.records.push_back(r4);
+			break;
+		case CCobBytecode::OP_SPIN:
+			r1 = code[PC++];
+			r2 = code[PC++];
+			r3 = t.POP();
+			r4 = t.POP();
+			t.records.push_back(r1); t.records.push_back(r2); t.records.push_back(r3); t.records.push_back(r4);
+			break;
+		case CCobBytecode::OP_HIDE:
+		case CCobBytecode::OP_SHOW:
+			t.records.push_back(code[PC++]);
+			break;
+		case CCobBytecode::OP_EMIT_SFX:
+			r1 = t.POP();
+			r2 = code[PC++];
+			t.records.push_back(r1); t.records.push_back(r2);
+			break;
+		case CCobBytecode::OP_EXPLODE:
+			r1 = code[PC++];
+			r2 = t.POP();
+			t.records.push_back(r1); t.records.push_back(r2);
+			break;
+		case CCobBytecode::OP_SLEEP:
+			// the sample threads are not scheduled, they just go on
+			t.records.push_back(t.POP());
+			break;
+		case CCobBytecode::OP_RAND:
+			r2 = t.POP();
+			r1 = t.POP();
+			// any sequence will do, as long as both interpreters see the same
+			t.stack.push_back(int((t.numRandCalls++ * 7u) % unsigned(r2 - r1 + 1)) + r1);
+			break;
+		case CCobBytecode::OP_GET_UNIT_VALUE:
+			r1 = t.POP();
+			t.stack.push_back(r1 * 3 + 1);
+			break;
+		case CCobBytecode::OP_SET:
+			r2 = t.POP();
+			r1 = t.POP();
+			t.records.push_back(r1); t.records.push_back(r2);
+			break;
+		case CCobBytecode::OP_SIGNAL:
+			t.records.push_back(t.POP());
+			break;
+		case CCobBytecode::OP_SET_SIGNAL_MASK:
+			t.signalMask = t.POP();
+			break;
+		case CCobBytecode::OP_LUA_CALL:
+			r1 = code[PC++];
+			r2 = code[PC++];
+			t.records.push_back(r1);
+			for (r3 = 0; r3 < r2; ++r3) {
+				t.records.push_back(t.POP());
+			}
+			break;
+		default:
+			BOOST_ERROR("unexpected opcode " << opcode << " at " << (PC - 1));
+			t.callStack.clear();
+			break;
+	}
+}
+
+
+/**
+ * The interpreter as it was before CCobBytecode, for the instructions
+ * CCobBytecode::Run handles (including converting CALLs in the code).
+ * Returns when the thread's function returns.
+ */
+static void RunReference(CTestAssembler& as, TestThread& t)
+{
+	std::vector<int>& code = as.code;
+	int& PC = t.PC;
+	int r1, r2, r3;
+
+	while (!t.callStack.empty()) {
+		const int opcode = code[PC++];
+
+		switch (opcode) {
+			case PUSH_CONSTANT:
+				r1 = code[PC++];
+				t.stack.push_back(r1);
+				break;
+			case RETURN:
+				t.retCode = t.POP();
+				if (t.callStack.back().returnAddr == -1) {
+					return;
+				}
+
+				PC = t.callStack.back().returnAddr;
+				while (t.stack.size() > t.callStack.back().stackTop) {
+					t.stack.pop_back();
+				}
+				t.callStack.pop_back();
+				break;
+			case SHADE:
+			case DONT_SHADE:
+			case CACHE:
+			case DONT_CACHE:
+				r1 = code[PC++];
+				break;
+			case CALL: {
+				r1 = code[PC++];
+				PC--;
+				const std::string& name = as.names[r1];
+				if (name.find("lua_") == 0) {
+					code[PC - 1] = LUA_CALL;
+					RunExternal(CCobBytecode::OP_LUA_CALL, code, t);
+					break;
+				}
+				code[PC - 1] = REAL_CALL;
+
+				// fall through //
+			}
+			case REAL_CALL: {
+				r1 = code[PC++];
+				r2 = code[PC++];
+
+				if (as.lengths[r1] == 0) {
+					break;
+				}
+
+				const CCobBytecode::CallInfo ci = {r1, PC, t.stack.size() - r2};
+				t.callStack.push_back(ci);
+				t.paramCount = r2;
+
+				PC = as.offsets[r1];
+			} break;
+			case POP_STATIC:
+				r1 = code[PC++];
+				r2 = t.POP();
+				t.staticVars[r1] = r2;
+				break;
+			case POP_STACK:
+				t.POP();
+				break;
+			case CREATE_LOCAL_VAR:
+				if (t.paramCount == 0) {
+					t.stack.push_back(0);
+				}
+				else {
+					t.paramCount--;
+				}
+				break;
+			case JUMP_NOT_EQUAL:
+				r1 = code[PC++];
+				r2 = t.POP();
+				if (r2 == 0) {
+					PC = r1;
+				}
+				break;
+			case JUMP:
+				r1 = code[PC++];
+				PC = r1;
+				break;
+			case POP_LOCAL_VAR:
+				r1 = code[PC++];
+				r2 = t.POP();
+				t.stack[t.callStack.back().stackTop + r1] = r2;
+				break;
+			case PUSH_LOCAL_VAR:
+				r1 = code[PC++];
+				r2 = t.stack[t.callStack.back().stackTop + r1];
+				t.stack.push_back(r2);
+				break;
+			case PUSH_STATIC:
+				r1 = code[PC++];
+				t.stack.push_back(t.staticVars[r1]);
+				break;
+			case SET_LESS_OR_EQUAL: r2 = t.POP(); r1 = t.POP(); t.stack.push_back((r1 <= r2)? 1: 0); break;
+			case SET_LESS:          r2 = t.POP(); r1 = t.POP(); t.stack.push_back((r1 <  r2)? 1: 0); break;
+			case SET_GREATER:       r2 = t.POP(); r1 = t.POP(); t.stack.push_back((r1 >  r2)? 1: 0); break;
+			case SET_GREATER_OR_EQUAL: r2 = t.POP(); r1 = t.POP(); t.stack.push_back((r1 >= r2)? 1: 0); break;
+			case SET_NOT_EQUAL:     r1 = t.POP(); r2 = t.POP(); t.stack.push_back((r1 != r2)? 1: 0); break;
+			case SET_EQUAL:         r1 = t.POP(); r2 = t.POP(); t.stack.push_back((r1 == r2)? 1: 0); break;
+			case BITWISE_AND:       r1 = t.POP(); r2 = t.POP(); t.stack.push_back(r1 & r2); break;
+			case BITWISE_OR:        r1 = t.POP(); r2 = t.POP(); t.stack.push_back(r1 | r2); break;
+			case BITWISE_XOR:       r1 = t.POP(); r2 = t.POP(); t.stack.push_back(r1 ^ r2); break;
+			case BITWISE_NOT:       r1 = t.POP(); t.stack.push_back(~r1); break;
+			case LOGICAL_NOT:       r1 = t.POP(); t.stack.push_back((r1 == 0)? 1: 0); break;
+			case LOGICAL_AND:       r1 = t.POP(); r2 = t.POP(); t.stack.push_back((r1 && r2)? 1: 0); break;
+			case LOGICAL_OR:        r1 = t.POP(); r2 = t.POP(); t.stack.push_back((r1 || r2)? 1: 0); break;
+			case LOGICAL_XOR:       r1 = t.POP(); r2 = t.POP(); t.stack.push_back(((!!r1) ^ (!!r2))? 1: 0); break;
+			case MUL:               r1 = t.POP(); r2 = t.POP(); t.stack.push_back(r1 * r2); break;
+			case ADD:               r2 = t.POP(); r1 = t.POP(); t.stack.push_back(r1 + r2); break;
+			case SUB:               r2 = t.POP(); r1 = t.POP(); r3 = r1 - r2; t.stack.push_back(r3); break;
+			case DIV:
+				r2 = t.POP();
+				r1 = t.POP();
+				r3 = (r2 != 0)? (r1 / r2): 1000;
+				t.stack.push_back(r3);
+				break;
+			case MOD:
+				r2 = t.POP();
+				r1 = t.POP();
+				t.stack.push_back((r2 != 0)? (r1 % r2): 0);
+				break;
+			default:
+				RunExternal(CCobBytecode::GetOpcode(opcode), code, t);
+				break;
+		}
+	}
+}
+
+static void RunDecoded(const CCobBytecode& bytecode, TestThread& t)
+{
+	while (!t.callStack.empty()) {
+		const CCobBytecode::Opcode opcode = bytecode.Run(t.PC, t.paramCount, t.retCode, t.stack, t.callStack, t.staticVars);
+
+		if (opcode == CCobBytecode::OP_RETURN)
+			return;
+
+		RunExternal(opcode, bytecode.code, t);
+	}
+}
+
+
+/// the sample scripts, returns the function ids to run and their arguments
+static void AssembleSamples(CTestAssembler& as, std::vector<int>& entries, std::vector< std::vector<int> >& entryArgs)
+{
+	const int luaFunc = as.EmptyFunction("lua_AimDone");
+	const int emptyFunc = as.EmptyFunction("Empty");
+
+	// Fib(n): adds the n-th fibonacci number to static 0, the slow way
+	{
+		const int fib = as.BeginFunction("Fib");
+		as.Emit(CREATE_LOCAL_VAR);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(PUSH_CONSTANT, 2);
+		as.Emit(SET_LESS);
+		const int recurse = as.EmitJump(JUMP_NOT_EQUAL);
+		as.Emit(PUSH_STATIC, 0);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(ADD);
+		as.Emit(POP_STATIC, 0);
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(RETURN);
+		as.PatchJump(recurse, as.Here());
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(PUSH_CONSTANT, 1);
+		as.Emit(SUB);
+		as.Emit(CALL, fib, 1);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(PUSH_CONSTANT, 2);
+		as.Emit(SUB);
+		as.Emit(CALL, fib, 1);
+		as.Emit(CALL, emptyFunc, 0);
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(RETURN);
+
+		entries.push_back(fib);
+		entryArgs.push_back(std::vector<int>(1, 16));
+	}
+
+	// Crunch(n): integer noise, like the math done in bigger scripts
+	{
+		const int crunch = as.BeginFunction("Crunch");
+		as.Emit(CREATE_LOCAL_VAR); // n
+		as.Emit(CREATE_LOCAL_VAR); // i
+		as.Emit(CREATE_LOCAL_VAR); // x
+		as.Emit(PUSH_CONSTANT, 12345);
+		as.Emit(POP_LOCAL_VAR, 2);
+
+		const int loop = as.Here();
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(SET_LESS);
+		const int done = as.EmitJump(JUMP_NOT_EQUAL);
+
+		// x = ((x * 1103 + i) ^ (x / 7)) % 65521
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_CONSTANT, 1103);
+		as.Emit(MUL);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(ADD);
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_CONSTANT, 7);
+		as.Emit(DIV);
+		as.Emit(BITWISE_XOR);
+		as.Emit(PUSH_CONSTANT, 65521);
+		as.Emit(MOD);
+		as.Emit(POP_LOCAL_VAR, 2);
+
+		// static 1 += (x & 255) | (!(x > 30000) && (x != i)) ^ ~i
+		as.Emit(PUSH_STATIC, 1);
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_CONSTANT, 255);
+		as.Emit(BITWISE_AND);
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_CONSTANT, 30000);
+		as.Emit(SET_GREATER);
+		as.Emit(LOGICAL_NOT);
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(SET_NOT_EQUAL);
+		as.Emit(LOGICAL_AND);
+		as.Emit(BITWISE_OR);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(BITWISE_NOT);
+		as.Emit(BITWISE_XOR);
+		as.Emit(ADD);
+		as.Emit(POP_STATIC, 1);
+
+		// static 2 counts odd/even flips, with the other comparisons
+		as.Emit(PUSH_STATIC, 2);
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_CONSTANT, 2);
+		as.Emit(MOD);
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(SET_EQUAL);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(PUSH_CONSTANT, 100);
+		as.Emit(SET_LESS_OR_EQUAL);
+		as.Emit(LOGICAL_XOR);
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(SET_GREATER_OR_EQUAL);
+		as.Emit(LOGICAL_OR);
+		as.Emit(ADD);
+		as.Emit(POP_STATIC, 2);
+		as.Emit(CACHE, 3);
+
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(PUSH_CONSTANT, 1);
+		as.Emit(ADD);
+		as.Emit(POP_LOCAL_VAR, 1);
+		as.Emit(JUMP, loop);
+
+		as.PatchJump(done, as.Here());
+		as.Emit(PUSH_LOCAL_VAR, 2);
+		as.Emit(RETURN);
+
+		entries.push_back(crunch);
+		entryArgs.push_back(std::vector<int>(1, 2000));
+	}
+
+	// AimWeapon(heading, pitch): the usual aiming script
+	{
+		const int aim = as.BeginFunction("AimWeapon1");
+		as.Emit(CREATE_LOCAL_VAR); // heading
+		as.Emit(CREATE_LOCAL_VAR); // pitch
+		as.Emit(PUSH_CONSTANT, 2);
+		as.Emit(SIGNAL);
+		as.Emit(PUSH_CONSTANT, 2);
+		as.Emit(SET_SIGNAL_MASK);
+		as.Emit(PUSH_CONSTANT, 0x2000);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(TURN, 1, 1);
+		as.Emit(PUSH_CONSTANT, 0x1000);
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(SUB);
+		as.Emit(TURN, 2, 0);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(CALL, luaFunc, 2);
+		as.Emit(PUSH_CONSTANT, 1);
+		as.Emit(RETURN);
+
+		std::vector<int> args;
+		args.push_back(0x1234);
+		args.push_back(-0x0800);
+		entries.push_back(aim);
+		entryArgs.push_back(args);
+	}
+
+	// Walk(steps): an animation loop
+	{
+		const int walk = as.BeginFunction("Walk");
+		as.Emit(CREATE_LOCAL_VAR); // steps
+		as.Emit(CREATE_LOCAL_VAR); // i
+
+		const int loop = as.Here();
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(PUSH_LOCAL_VAR, 0);
+		as.Emit(SET_LESS);
+		const int done = as.EmitJump(JUMP_NOT_EQUAL);
+
+		as.Emit(PUSH_CONSTANT, 0x4000);
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(PUSH_CONSTANT, 2);
+		as.Emit(MOD);
+		as.Emit(PUSH_CONSTANT, 0x1800);
+		as.Emit(MUL);
+		as.Emit(TURN, 3, 0);
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(PUSH_CONSTANT, 65536 * 2);
+		as.Emit(RAND);
+		as.Emit(PUSH_CONSTANT, 65536);
+		as.Emit(MOVE, 4, 1);
+		as.Emit(PUSH_CONSTANT, 1);
+		as.Emit(GET_UNIT_VALUE);
+		as.Emit(POP_STATIC, 3);
+		as.Emit(PUSH_CONSTANT, 1024);
+		as.Emit(EMIT_SFX, 5);
+		as.Emit(PUSH_CONSTANT, 5);
+		as.Emit(PUSH_STATIC, 3);
+		as.Emit(SET);
+		as.Emit(PUSH_CONSTANT, 100);
+		as.Emit(PUSH_CONSTANT, 200);
+		as.Emit(SPIN, 6, 2);
+		as.Emit(HIDE, 7);
+		as.Emit(SHOW, 7);
+		as.Emit(PUSH_CONSTANT, 33);
+		as.Emit(SLEEP);
+
+		as.Emit(PUSH_LOCAL_VAR, 1);
+		as.Emit(PUSH_CONSTANT, 1);
+		as.Emit(ADD);
+		as.Emit(POP_LOCAL_VAR, 1);
+		as.Emit(JUMP, loop);
+
+		as.PatchJump(done, as.Here());
+		as.Emit(PUSH_CONSTANT, 0);
+		as.Emit(RETURN);
+
+		entries.push_back(walk);
+		entryArgs.push_back(std::vector<int>(1, 50));
+	}
+
+	as.Finish();
+}
+
+
+BOOST_AUTO_TEST_CASE(CobInterpreter)
+{
+	CTestAssembler as;
+	std::vector<int> entries;
+	std::vector< std::vector<int> > entryArgs;
+
+	AssembleSamples(as, entries, entryArgs);
+
+	CCobBytecode bytecode;
+	bytecode.Load(as.code, as.names, as.offsets, as.lengths);
+
+	BOOST_CHECK_EQUAL(bytecode.opcodes.size(), as.code.size());
+
+	for (size_t n = 0; n < entries.size(); ++n) {
+		TestThread refThread;
+		TestThread decThread;
+
+		// the reference converts CALLs in its code as it goes, like CCobThread did
+		CTestAssembler refAs = as;
+
+		for (int run = 0; run < NUM_RUNS; ++run) {
+			refThread.Start(refAs, entries[n], entryArgs[n]);
+			RunReference(refAs, refThread);
+		}
+		for (int run = 0; run < NUM_RUNS; ++run) {
+			decThread.Start(as, entries[n], entryArgs[n]);
+			RunDecoded(bytecode, decThread);
+		}
+
+		BOOST_CHECK_EQUAL(refThread.retCode, decThread.retCode);
+		BOOST_CHECK_EQUAL(refThread.signalMask, decThread.signalMask);
+		BOOST_CHECK(refThread.stack == decThread.stack);
+		BOOST_CHECK(refThread.staticVars == decThread.staticVars);
+		BOOST_CHECK(refThread.records == decThread.records);
+		BOOST_CHECK(!decThread.callStack.empty());
+	}
+}
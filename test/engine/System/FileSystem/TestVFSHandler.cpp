@@ -0,0 +1,278 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Checks the CVFSHandler indices: adds a synthetic archive of files spread
+ * over nested directories (like a big game), looks up every file and lists
+ * every directory, and compares the listings with a walk over a sorted
+ * std::map of all paths, which is how CVFSHandler used to list directories.
+ * Then adds and removes an overriding archive, with directory entries of its
+ * own, and checks the listings are still right.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "System/FileSystem/ArchiveLoader.h"
+#include "System/FileSystem/ArchiveScanner.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/FileSystem/VFSHandler.h"
+#include "System/FileSystem/Archives/IArchive.h"
+#include "System/Util.h"
+
+#define BOOST_TEST_MODULE VFSHandler
+#include <boost/test/unit_test.hpp>
+
+static const int NUM_FILES = 5000;
+static const int NUM_OVERRIDE_FILES = 500;
+
+
+class CSyntheticArchive : public IArchive
+{
+public:
+	CSyntheticArchive(const std::string& name, const std::vector<std::string>& fileNames)
+		: IArchive(name)
+		, fileNames(fileNames)
+	{
+		for (unsigned int fid = 0; fid < fileNames.size(); ++fid) {
+			lcNameIndex[StringToLower(fileNames[fid])] = fid;
+		}
+	}
+
+	bool IsOpen() { return true; }
+	unsigned int NumFiles() const { return fileNames.size(); }
+
+	bool GetFile(unsigned int fid, std::vector<boost::uint8_t>& buffer) {
+		buffer.assign(fileNames[fid].begin(), fileNames[fid].end());
+		return true;
+	}
+	void FileInfo(unsigned int fid, std::string& name, int& size) const {
+		name = fileNames[fid];
+		size = name.size();
+	}
+
+private:
+	const std::vector<std::string> fileNames;
+};
+
+
+// CVFSHandler opens its archives through these, the test's are synthetic
+static std::map<std::string, std::vector<std::string> > syntheticArchives;
+
+CArchiveLoader::CArchiveLoader() {}
+CArchiveLoader::~CArchiveLoader() {}
+
+CArchiveLoader& CArchiveLoader::GetInstance()
+{
+	static CArchiveLoader instance;
+	return instance;
+}
+
+IArchive* CArchiveLoader::OpenArchive(const std::string& fileName, const std::string& type) const
+{
+	const std::map<std::string, std::vector<std::string> >::const_iterator it = syntheticArchives.find(fileName);
+
+	if (it == syntheticArchives.end())
+		return NULL;
+
+	return (new CSyntheticArchive(fileName, it->second));
+}
+
+CArchiveScanner* archiveScanner = NULL;
+
+std::vector<std::string> CArchiveScanner::GetArchives(const std::string& root, int depth) const
+{
+	return std::vector<std::string>();
+}
+
+
+
+// CVFSHandler's lookups before the indices, over all (lower-case) paths
+struct MapListing {
+	std::vector<std::string> GetFilesInDir(const std::string& dir) const {
+		std::vector<std::string> ret;
+		std::map<std::string, int>::const_iterator filesStart = files.begin();
+		std::map<std::string, int>::const_iterator filesEnd   = files.end();
+
+		if (!dir.empty()) {
+			std::string dirEnd = dir;
+			dirEnd[dir.length() - 1] = dirEnd[dir.length() - 1] + 1;
+			filesStart = files.lower_bound(dir);
+			filesEnd   = files.upper_bound(dirEnd);
+		}
+
+		for (; filesStart != filesEnd; ++filesStart) {
+			const std::string path = FileSystem::GetDirectory(filesStart->first);
+
+			if (path.compare(0, dir.length(), dir) == 0) {
+				const std::string name = filesStart->first.substr(dir.length());
+
+				// the directory entry of <dir> itself is not a file
+				if (!name.empty() && name.find('/') == std::string::npos)
+					ret.push_back(name);
+			}
+		}
+
+		return ret;
+	}
+
+	std::vector<std::string> GetDirsInDir(const std::string& dir) const {
+		std::set<std::string> dirs;
+		std::map<std::string, int>::const_iterator filesStart = files.begin();
+		std::map<std::string, int>::const_iterator filesEnd   = files.end();
+
+		if (!dir.empty()) {
+			std::string dirEnd = dir;
+			dirEnd[dir.length() - 1] = dirEnd[dir.length() - 1] + 1;
+			filesStart = files.lower_bound(dir);
+			filesEnd   = files.upper_bound(dirEnd);
+		}
+
+		for (; filesStart != filesEnd; ++filesStart) {
+			const std::string path = FileSystem::GetDirectory(filesStart->first);
+
+			if (path.compare(0, dir.length(), dir) == 0) {
+				const std::string name = filesStart->first.substr(dir.length());
+				const std::string::size_type slash = name.find('/');
+
+				if (slash != std::string::npos)
+					dirs.insert(name.substr(0, slash + 1));
+			}
+		}
+
+		return std::vector<std::string>(dirs.begin(), dirs.end());
+	}
+
+	/// by path, value is the number of the archive it came from
+	std::map<std::string, int> files;
+};
+
+
+/// the path of file <n>, 0 to 3 sub-directories deep
+static std::string CreatePath(int n)
+{
+	static const char* topDirs[] = {
+		"Units", "Scripts", "Objects3d", "UnitTextures", "Sounds",
+		"LuaRules/Gadgets", "LuaUI/Widgets", "GameData", "Bitmaps", "Features",
+	};
+	static const int numTopDirs = sizeof(topDirs) / sizeof(topDirs[0]);
+
+	std::string path = topDirs[n % numTopDirs];
+	char buf[32];
+
+	for (int depth = (n / numTopDirs) % 4, subDirs = n / (numTopDirs * 4); depth > 0; --depth, subDirs /= 6) {
+		sprintf(buf, "/Sub%d", subDirs % 6);
+		path += buf;
+	}
+
+	sprintf(buf, "/File%05d.dat", n);
+	return (path + buf);
+}
+
+/// every directory holding a file, with trailing slash, and the root
+static std::vector<std::string> GetAllDirs(const MapListing& listing)
+{
+	std::set<std::string> dirs;
+	dirs.insert("");
+
+	for (std::map<std::string, int>::const_iterator it = listing.files.begin(); it != listing.files.end(); ++it) {
+		for (std::string::size_type slash = it->first.find('/'); slash != std::string::npos; slash = it->first.find('/', slash + 1)) {
+			dirs.insert(it->first.substr(0, slash + 1));
+		}
+	}
+
+	// not in the VFS
+	dirs.insert("missing/");
+	dirs.insert("units/missing/");
+
+	return std::vector<std::string>(dirs.begin(), dirs.end());
+}
+
+static void CheckListings(CVFSHandler& vfs, const MapListing& listing)
+{
+	const std::vector<std::string> dirs = GetAllDirs(listing);
+	size_t numMismatches = 0;
+
+	for (size_t i = 0; i < dirs.size(); ++i) {
+		numMismatches += (vfs.GetFilesInDir(dirs[i]) != listing.GetFilesInDir(dirs[i]));
+		numMismatches += (vfs.GetDirsInDir(dirs[i]) != listing.GetDirsInDir(dirs[i]));
+	}
+
+	BOOST_CHECK_EQUAL(numMismatches, size_t(0));
+}
+
+
+BOOST_AUTO_TEST_CASE(VFSHandlerIndex)
+{
+	MapListing listing;
+
+	std::vector<std::string>& gameFiles = syntheticArchives["game.sdd"];
+	gameFiles.reserve(NUM_FILES);
+
+	for (int n = 0; n < NUM_FILES; ++n) {
+		gameFiles.push_back(CreatePath(n));
+		listing.files[StringToLower(gameFiles.back())] = 0;
+	}
+
+	CVFSHandler vfs;
+
+	// add the archive, then look everything up like the loaders do
+	BOOST_CHECK(vfs.AddArchive("game.sdd", false));
+
+	size_t numFound = 0;
+	for (int n = 0; n < NUM_FILES; ++n) {
+		numFound += vfs.FileExists(gameFiles[n]);
+	}
+
+	BOOST_CHECK_EQUAL(numFound, size_t(NUM_FILES));
+	BOOST_CHECK(!vfs.FileExists("units/missing.lua"));
+
+	CheckListings(vfs, listing);
+
+	// an archive overriding part of the game and adding directories of its
+	// own, an empty one and one that already has files among them
+	std::vector<std::string>& patchFiles = syntheticArchives["patch.sdz"];
+
+	for (int n = 0; n < NUM_OVERRIDE_FILES; ++n) {
+		patchFiles.push_back(gameFiles[(n * 7919) % NUM_FILES]);
+		listing.files[StringToLower(patchFiles.back())] = 1;
+	}
+	for (int n = 0; n < NUM_OVERRIDE_FILES; ++n) {
+		patchFiles.push_back(CreatePath(NUM_FILES + n).insert(0, "Patch/"));
+		listing.files[StringToLower(patchFiles.back())] = 1;
+	}
+
+	patchFiles.push_back("Units/Empty/");
+	listing.files["units/empty/"] = 1;
+	patchFiles.push_back("Sounds/");
+	listing.files["sounds/"] = 1;
+
+	BOOST_CHECK(vfs.AddArchive("patch.sdz", true));
+	CheckListings(vfs, listing);
+	BOOST_CHECK(!vfs.GetDirsInDir("patch").empty());
+
+	const std::vector<std::string> unitDirs = vfs.GetDirsInDir("units");
+	BOOST_CHECK(std::find(unitDirs.begin(), unitDirs.end(), "empty/") != unitDirs.end());
+	BOOST_CHECK(vfs.GetFilesInDir("units/empty").empty());
+
+	// removes everything the patch provided, overridden files included
+	BOOST_CHECK(vfs.RemoveArchive("patch.sdz"));
+
+	for (std::map<std::string, int>::iterator it = listing.files.begin(); it != listing.files.end(); ) {
+		if (it->second == 1) {
+			listing.files.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	CheckListings(vfs, listing);
+	BOOST_CHECK(vfs.GetDirsInDir("patch").empty());
+	BOOST_CHECK(vfs.GetFilesInDir("patch/units").empty());
+	const std::vector<std::string> unitDirsLeft = vfs.GetDirsInDir("units");
+	BOOST_CHECK(std::find(unitDirsLeft.begin(), unitDirsLeft.end(), "empty/") == unitDirsLeft.end());
+	BOOST_CHECK(!vfs.GetFilesInDir("sounds").empty());
+}
@@ -0,0 +1,172 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+/*
+ * Loopback test for UDPConnection: one "server" endpoint per client sends
+ * the same shared packets (like CGameServer::Broadcast) over 127.0.0.1, each
+ * client drains its connection and checks that every message arrives
+ * complete and in order. Mixes small frame messages with LuaMsg's that need
+ * to be split over several chunks.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "System/Net/UDPConnection.h"
+#include "System/Net/RawPacket.h"
+#include "System/BaseNetProtocol.h"
+#include "System/GlobalConfig.h"
+#include "System/Misc/SpringTime.h"
+
+#define BOOST_TEST_MODULE UDPConnectionBroadcast
+#include <boost/test/unit_test.hpp>
+
+using netcode::RawPacket;
+using netcode::UDPConnection;
+
+static const int BASE_PORT = 11200;
+static const int NUM_FRAMES = 200;
+// messages broadcast per frame besides NETMSG_NEWFRAME
+static const int NUM_FRAME_MESSAGES = 4;
+
+typedef boost::shared_ptr<const RawPacket> PacketPtr;
+
+
+struct InitFixture {
+	InitFixture() {
+		SDL_Init(SDL_INIT_TIMER);
+		GlobalConfig::Instantiate();
+		// test the connection, not the rate-limiter
+		globalConfig->linkOutgoingBandwidth = 0;
+	}
+	~InitFixture() {
+		GlobalConfig::Deallocate();
+	}
+};
+
+BOOST_GLOBAL_FIXTURE(InitFixture);
+
+
+static PacketPtr CreateMessage(int frame, int n)
+{
+	// 8 .. 1000 bytes, larger ones span up to four chunks
+	std::vector<boost::uint8_t> msg(8 + ((frame * 131 + n * 257) % 993));
+
+	for (size_t i = 0; i < msg.size(); i++) {
+		msg[i] = (frame + n + i) & 0xFF;
+	}
+
+	return CBaseNetProtocol::Get().SendLuaMsg(n, frame & 0xFFFF, 0, msg);
+}
+
+static bool SamePacket(const PacketPtr& a, const PacketPtr& b)
+{
+	if (a->length != b->length)
+		return false;
+
+	return (std::equal(a->data, a->data + a->length, b->data));
+}
+
+
+static void RunBroadcast(int numClients)
+{
+	std::vector<UDPConnection*> servers(numClients);
+	std::vector<UDPConnection*> clients(numClients);
+
+	for (int c = 0; c < numClients; c++) {
+		servers[c] = new UDPConnection(BASE_PORT + c, "127.0.0.1", BASE_PORT + 100 + c);
+		clients[c] = new UDPConnection(BASE_PORT + 100 + c, "127.0.0.1", BASE_PORT + c);
+		servers[c]->Unmute();
+		clients[c]->Unmute();
+	}
+
+	// like a joining client, say hello first: until the server has received
+	// something its packets look like reconnection attempts to the client
+	for (int c = 0; c < numClients; c++) {
+		clients[c]->SendData(CBaseNetProtocol::Get().SendNewFrame());
+		clients[c]->Flush(true);
+
+		for (int tries = 0; tries < 100 && !servers[c]->HasIncomingData(); tries++) {
+			servers[c]->Update();
+			spring_sleep(spring_msecs(1));
+		}
+
+		BOOST_REQUIRE(servers[c]->GetData());
+	}
+
+	std::vector<PacketPtr> sent;
+	std::vector<size_t> numReceived(numClients, 0);
+	size_t numMismatches = 0;
+
+	sent.reserve(NUM_FRAMES * (NUM_FRAME_MESSAGES + 1));
+
+	for (int frame = 0; frame < NUM_FRAMES; frame++) {
+		const size_t first = sent.size();
+
+		sent.push_back(CBaseNetProtocol::Get().SendNewFrame());
+
+		for (int n = 0; n < NUM_FRAME_MESSAGES; n++) {
+			sent.push_back(CreateMessage(frame, n));
+		}
+
+		for (int c = 0; c < numClients; c++) {
+			for (size_t i = first; i < sent.size(); i++) {
+				servers[c]->SendData(sent[i]);
+			}
+
+			servers[c]->Flush(true);
+		}
+
+		for (int c = 0; c < numClients; c++) {
+			clients[c]->Update();
+			servers[c]->Update();
+
+			PacketPtr msg;
+
+			while ((msg = clients[c]->GetData())) {
+				numMismatches += (numReceived[c] >= sent.size() || !SamePacket(msg, sent[numReceived[c]]));
+				numReceived[c] += 1;
+			}
+		}
+	}
+
+	// wait for stragglers (lost datagrams are resent after a NAK)
+	for (int tries = 0; tries < 500; tries++) {
+		bool done = true;
+
+		for (int c = 0; c < numClients; c++) {
+			clients[c]->Update();
+			servers[c]->Update();
+
+			PacketPtr msg;
+
+			while ((msg = clients[c]->GetData())) {
+				numMismatches += (numReceived[c] >= sent.size() || !SamePacket(msg, sent[numReceived[c]]));
+				numReceived[c] += 1;
+			}
+
+			done &= (numReceived[c] == sent.size());
+		}
+
+		if (done)
+			break;
+
+		spring_sleep(spring_msecs(10));
+	}
+
+	for (int c = 0; c < numClients; c++) {
+		BOOST_CHECK(numReceived[c] == sent.size());
+	}
+
+	BOOST_CHECK(numMismatches == 0);
+
+	for (int c = 0; c < numClients; c++) {
+		delete clients[c];
+		delete servers[c];
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( UDPConnectionBroadcast1 ) { RunBroadcast( 1); }
+BOOST_AUTO_TEST_CASE( UDPConnectionBroadcast16 ) { RunBroadcast(16); }
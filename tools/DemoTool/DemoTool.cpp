@@ -24,7 +24,7 @@ When compiling for windows with MinGW, make sure to use the
 no console output (you still could use this.exe > z.tzt though).
 */
 
-void TrafficDump(CDemoReader& reader, bool trafficStats);
+void TrafficDump(CDemoReader& reader, bool trafficStats, int startFrame);
 void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string& file);
 
 int main (int argc, char* argv[])
@@ -38,6 +38,7 @@ int main (int argc, char* argv[])
 	p.add("demofile", 1);
 	all.add_options()("help,h", "This one");
 	all.add_options()("dump,d", "Only dump networc traffic saved in demo");
+	all.add_options()("frame", po::value<int>(), "Start the dump at this frame (seeks to the nearest key-frame)");
 	all.add_options()("stats,s", "Print all game, player and team stats");
 	all.add_options()("header,H", "Print demoheader content");
 	all.add_options()("playerstats,p", "Print playerstats");
@@ -71,7 +72,7 @@ int main (int argc, char* argv[])
 	reader.LoadStats();
 	if (vm.count("dump"))
 	{
-		TrafficDump(reader, true);
+		TrafficDump(reader, true, vm.count("frame")? vm["frame"].as<int>(): 0);
 		return 0;
 	}
 	if (vm.count("teamsstatcsv"))
@@ -195,12 +196,32 @@ const std::string& GetCommandName(int commandId)
 	return CMD_NAME_UNKNOWN;
 }
 
-void TrafficDump(CDemoReader& reader, bool trafficStats)
+void TrafficDump(CDemoReader& reader, bool trafficStats, int startFrame)
 {
 	InitCommandNames();
 	std::vector<unsigned> trafficCounter(NETMSG_LAST, 0);
 	int frame = 0;
 	int cmdId = 0;
+
+	if (startFrame > 0) {
+		const DemoKeyFrame* keyFrame = reader.GetKeyFrame(startFrame);
+
+		if (keyFrame != NULL) {
+			reader.SeekToKeyFrame(*keyFrame, 0.0f);
+			frame = keyFrame->frameNum;
+		}
+
+		// fast-forward from the key-frame (or the start) to <startFrame>
+		while (!reader.ReachedEnd() && frame < startFrame) {
+			netcode::RawPacket* packet = reader.GetData(3.402823466e+38f);
+			if (packet == NULL)
+				continue;
+			if (packet->data[0] == NETMSG_NEWFRAME || packet->data[0] == NETMSG_KEYFRAME)
+				++frame;
+			delete packet;
+		}
+	}
+
 	while (!reader.ReachedEnd())
 	{
 		netcode::RawPacket* packet;
@@ -40,6 +40,7 @@ wstringstream& operator<<(wstringstream& str, const DemoFileHeader& header)
 	str<<L"TeamStatSize: " <<header.teamStatSize<<endl;
 	str<<L"TeamStatElemSize: " <<header.teamStatElemSize<<endl;
 	str<<L"TeamStatPeriod: " <<header.teamStatPeriod<<endl;
+	str<<L"KeyFrameIndexSize: " <<header.keyFrameIndexSize<<endl;
 	return str;
 }
 